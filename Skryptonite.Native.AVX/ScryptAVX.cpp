@@ -17,41 +17,104 @@
 */
 #include "pch.h"
 #include "ScryptAVX.h"
-#include "..\Skryptonite.Native\ScryptCommon.h"
+#include "../Skryptonite.Native/ScryptCommon.h"
+
+#define _MM256_BLEND_ARG(i0, i1, i2, i3, i4, i5, i6, i7)	i0 | (i1 << 1) | (i2 << 2) | (i3 << 3) | (i4 << 4) | (i5 << 5) | (i6 << 6) | (i7 << 7)
 
 using namespace Skryptonite::Native;
 
-void ScryptAVX::PrepareData(ScryptElementPtr& workingBuffer, SalsaBlock* source)
+const int ElementBlendArg = _MM256_BLEND_ARG(1, 0, 0, 1, 0, 0, 1, 1);
+const int EvenElementsBlendArg = _MM256_BLEND_ARG(1, 0, 1, 0, 1, 0, 1, 0);
+
+template<CachePolicy policy, unsigned fixedBlockCount>
+void ScryptAVX::PrepareCopyAndMixBlocks(SalsaBlock* copyDestination, SalsaBlock* source, SalsaBlock* mixDestination, unsigned blockCount)
 {
-	ScryptCommon::PrepareData<SalsaBlock256x2>(workingBuffer, source, PrepareBlock);
+	ScryptCommon::PrepareCopyAndMixBlocks<SalsaBlock128x4, policy, fixedBlockCount>(copyDestination, source, mixDestination, blockCount, PrepareBlock);
 }
 
 void ScryptAVX::PrepareBlock(SalsaBlock256x2& arrangedBlock, SalsaBlock256x2& block)
 {
-	arrangedBlock.rows01 = _mm256_setr_epi32(block.rows23.m256i_u32[4], block.rows01.m256i_u32[1], block.rows01.m256i_u32[6], block.rows23.m256i_u32[3],
-											 block.rows01.m256i_u32[0], block.rows01.m256i_u32[5], block.rows23.m256i_u32[2], block.rows23.m256i_u32[7]);
-	arrangedBlock.rows23 = _mm256_setr_epi32(block.rows01.m256i_u32[4], block.rows23.m256i_u32[1], block.rows23.m256i_u32[6], block.rows01.m256i_u32[3],
-										     block.rows23.m256i_u32[0], block.rows23.m256i_u32[5], block.rows01.m256i_u32[2], block.rows01.m256i_u32[7]);
+	__m256 rows01 = SwapEvenElements(_mm256_castsi256_ps(block.rows01));
+	__m256 rows23 = SwapEvenElements(_mm256_castsi256_ps(block.rows23));
+
+	arrangedBlock.rows01 = _mm256_castps_si256(_mm256_blend_ps(rows01, rows23, ElementBlendArg));
+	arrangedBlock.rows23 = _mm256_castps_si256(_mm256_blend_ps(rows23, rows01, ElementBlendArg));
 }
 
-void ScryptAVX::RestoreData(SalsaBlock* destination, ScryptElementPtr& workingBuffer)
+template<CachePolicy policy, unsigned fixedBlockCount>
+void ScryptAVX::XorMixAndRestoreBlocks(SalsaBlock* destination, ScryptElementPtr& workingBuffer, SalsaBlock* xorSource)
 {
-	ScryptCommon::RestoreData<SalsaBlock256x2>(destination, workingBuffer, RestoreBlock);
+	ScryptCommon::XorMixAndRestoreBlocks<SalsaBlock128x4, policy, fixedBlockCount>(destination, workingBuffer, xorSource, RestoreBlock);
 }
 
 void ScryptAVX::RestoreBlock(SalsaBlock256x2& block, SalsaBlock256x2& arrangedBlock)
 {
-	block.rows01 = _mm256_setr_epi32(arrangedBlock.rows01.m256i_u32[4], arrangedBlock.rows01.m256i_u32[1], arrangedBlock.rows23.m256i_u32[6], arrangedBlock.rows23.m256i_u32[3],
-									 arrangedBlock.rows23.m256i_u32[0], arrangedBlock.rows01.m256i_u32[5], arrangedBlock.rows01.m256i_u32[2], arrangedBlock.rows23.m256i_u32[7]);
-	block.rows23 = _mm256_setr_epi32(arrangedBlock.rows23.m256i_u32[4], arrangedBlock.rows23.m256i_u32[1], arrangedBlock.rows01.m256i_u32[6], arrangedBlock.rows01.m256i_u32[3],
-									 arrangedBlock.rows01.m256i_u32[0], arrangedBlock.rows23.m256i_u32[5], arrangedBlock.rows23.m256i_u32[2], arrangedBlock.rows01.m256i_u32[7]);}
+	__m256 rows01 = _mm256_castsi256_ps(arrangedBlock.rows01);
+	__m256 rows23 = _mm256_castsi256_ps(arrangedBlock.rows23);
+
+	block.rows01 = _mm256_castps_si256(SwapEvenElements(_mm256_blend_ps(rows01, rows23, ElementBlendArg)));
+	block.rows23 = _mm256_castps_si256(SwapEvenElements(_mm256_blend_ps(rows23, rows01, ElementBlendArg)));
+}
+
+void ScryptAVX::PrepareBlock(SalsaBlock128x4& arrangedBlock, SalsaBlock128x4& block)
+{
+	// AVX mixes in 128-bit registers but can rearrange in 256-bit ones
+	SalsaBlock256x2 packedBlock = Pack(block);
+	SalsaBlock256x2 arrangedPackedBlock;
+
+	PrepareBlock(arrangedPackedBlock, packedBlock);
+	arrangedBlock = Unpack(arrangedPackedBlock);
+}
+
+void ScryptAVX::RestoreBlock(SalsaBlock128x4& block, SalsaBlock128x4& arrangedBlock)
+{
+	SalsaBlock256x2 arrangedPackedBlock = Pack(arrangedBlock);
+	SalsaBlock256x2 packedBlock;
+
+	RestoreBlock(packedBlock, arrangedPackedBlock);
+	block = Unpack(packedBlock);
+}
+
+SalsaBlock256x2 ScryptAVX::Pack(const SalsaBlock128x4& block)
+{
+	SalsaBlock256x2 packedBlock;
+	packedBlock.rows01 = _mm256_insertf128_si256(_mm256_castsi128_si256(block.row0), block.row1, 1);
+	packedBlock.rows23 = _mm256_insertf128_si256(_mm256_castsi128_si256(block.row2), block.row3, 1);
+	return packedBlock;
+}
 
+SalsaBlock128x4 ScryptAVX::Unpack(const SalsaBlock256x2& packedBlock)
+{
+	SalsaBlock128x4 block;
+	block.row0 = _mm256_castsi256_si128(packedBlock.rows01);
+	block.row1 = _mm256_extractf128_si256(packedBlock.rows01, 1);
+	block.row2 = _mm256_castsi256_si128(packedBlock.rows23);
+	block.row3 = _mm256_extractf128_si256(packedBlock.rows23, 1);
+	return block;
+}
+
+__m256 ScryptAVX::SwapEvenElements(__m256 value)
+{
+	// AVX lacks a cross-lane 32-bit permute, so swap the 128-bit halves and keep the odd elements from the original.
+	return _mm256_blend_ps(value, _mm256_permute2f128_ps(value, value, 1), EvenElementsBlendArg);
+}
+
+template<unsigned fixedBlockCount>
+void ScryptAVX::MixBlocksInto(SalsaBlock* destination, SalsaBlock* source, unsigned blockCount)
+{
+	ScryptCommon::MixBlocksInto<SalsaBlock128x4, fixedBlockCount>(destination, source, blockCount);
+}
+
+template<CachePolicy policy, unsigned fixedBlockCount>
 void ScryptAVX::CopyAndMixBlocks(SalsaBlock* copyDestination, ScryptElementPtr& workingBuffer, ScryptElementPtr& shuffleBuffer)
 {
-	ScryptCommon::MixBlocks<SalsaBlock128x4>(workingBuffer, copyDestination, shuffleBuffer, MixBlocksMode::Copy);
+	ScryptCommon::MixBlocks<SalsaBlock128x4, policy, MixBlocksMode::Copy, fixedBlockCount>(workingBuffer, copyDestination, shuffleBuffer);
 }
 
+template<CachePolicy policy, unsigned fixedBlockCount>
 void ScryptAVX::XorAndMixBlocks(ScryptElementPtr& workingBuffer, SalsaBlock* xorSource, ScryptElementPtr& shuffleBuffer)
 {
-	ScryptCommon::MixBlocks<SalsaBlock128x4>(workingBuffer, xorSource, shuffleBuffer, MixBlocksMode::Xor);
+	ScryptCommon::MixBlocks<SalsaBlock128x4, policy, MixBlocksMode::Xor, fixedBlockCount>(workingBuffer, xorSource, shuffleBuffer);
 }
+
+SKRYPTONITE_INSTANTIATE_BLOCK_KERNELS(ScryptAVX)
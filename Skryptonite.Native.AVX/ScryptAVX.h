@@ -16,8 +16,9 @@
 * along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 #pragma once
-#include "..\Skryptonite.Native\SalsaBlock.h"
-#include "..\Skryptonite.Native\ScryptElement.h"
+#include "../Skryptonite.Native/SalsaBlock.h"
+#include "../Skryptonite.Native/ScryptElement.h"
+#include "../Skryptonite.Native/CachePolicy.h"
 
 namespace Skryptonite
 {
@@ -26,14 +27,25 @@ namespace Skryptonite
 		class ScryptAVX
 		{
 		public:
-			static void PrepareData(ScryptElementPtr& workingBuffer, SalsaBlock* source);
+			template<CachePolicy policy, unsigned fixedBlockCount>
+			static void PrepareCopyAndMixBlocks(SalsaBlock* copyDestination, SalsaBlock* source, SalsaBlock* mixDestination, unsigned blockCount);
+			template<unsigned fixedBlockCount>
+			static void MixBlocksInto(SalsaBlock* destination, SalsaBlock* source, unsigned blockCount);
+			template<CachePolicy policy, unsigned fixedBlockCount>
 			static void CopyAndMixBlocks(SalsaBlock* copyDestination, ScryptElementPtr& workingBuffer, ScryptElementPtr& shuffleBuffer);
+			template<CachePolicy policy, unsigned fixedBlockCount>
 			static void XorAndMixBlocks(ScryptElementPtr& workingBuffer, SalsaBlock* xorSource, ScryptElementPtr& shuffleBuffer);
-			static void RestoreData(SalsaBlock* destination, ScryptElementPtr& workingBuffer);
+			template<CachePolicy policy, unsigned fixedBlockCount>
+			static void XorMixAndRestoreBlocks(SalsaBlock* destination, ScryptElementPtr& workingBuffer, SalsaBlock* xorSource);
 
 		private:
 			static __forceinline void PrepareBlock(SalsaBlock256x2& arrangedBlock, SalsaBlock256x2& block);
 			static __forceinline void RestoreBlock(SalsaBlock256x2& block, SalsaBlock256x2& arrangedBlock);
+			static __forceinline void PrepareBlock(SalsaBlock128x4& arrangedBlock, SalsaBlock128x4& block);
+			static __forceinline void RestoreBlock(SalsaBlock128x4& block, SalsaBlock128x4& arrangedBlock);
+			static __forceinline SalsaBlock256x2 Pack(const SalsaBlock128x4& block);
+			static __forceinline SalsaBlock128x4 Unpack(const SalsaBlock256x2& packedBlock);
+			static __forceinline __m256 SwapEvenElements(__m256 value);
 		};
 	}
 }
\ No newline at end of file
@@ -17,7 +17,7 @@
 */
 #include "pch.h"
 #include "ScryptAVX2.h"
-#include "..\Skryptonite.Native\ScryptCommon.h"
+#include "../Skryptonite.Native/ScryptCommon.h"
 
 #define _MM256_BLEND_ARG(i0, i1, i2, i3, i4, i5, i6, i7)	i0 | (i1 << 1) | (i2 << 2) | (i3 << 3) | (i4 << 4) | (i5 << 5) | (i6 << 6) | (i7 << 7)
 
@@ -26,9 +26,10 @@ using namespace Skryptonite::Native;
 const __m256i ElementPermuteArgs = _mm256_setr_epi32(4, 1, 6, 3, 0, 5, 2, 7);
 const int ElementBlendArg = _MM256_BLEND_ARG(1, 0, 0, 1, 0, 0, 1, 1);
 
-void ScryptAVX2::PrepareData(ScryptElementPtr& workingBuffer, SalsaBlock* source)
+template<CachePolicy policy, unsigned fixedBlockCount>
+void ScryptAVX2::PrepareCopyAndMixBlocks(SalsaBlock* copyDestination, SalsaBlock* source, SalsaBlock* mixDestination, unsigned blockCount)
 {
-	ScryptCommon::PrepareData<SalsaBlock256x2>(workingBuffer, source, PrepareBlock);
+	ScryptCommon::PrepareCopyAndMixBlocks<SalsaBlock256x2, policy, fixedBlockCount>(copyDestination, source, mixDestination, blockCount, PrepareBlock);
 }
 
 void ScryptAVX2::PrepareBlock(SalsaBlock256x2& arrangedBlock, SalsaBlock256x2& block)
@@ -40,9 +41,10 @@ void ScryptAVX2::PrepareBlock(SalsaBlock256x2& arrangedBlock, SalsaBlock256x2& b
 	arrangedBlock.rows23 = _mm256_blend_epi32(block.rows23, block.rows01, ElementBlendArg);
 }
 
-void ScryptAVX2::RestoreData(SalsaBlock* destination, ScryptElementPtr& workingBuffer)
+template<CachePolicy policy, unsigned fixedBlockCount>
+void ScryptAVX2::XorMixAndRestoreBlocks(SalsaBlock* destination, ScryptElementPtr& workingBuffer, SalsaBlock* xorSource)
 {
-	ScryptCommon::RestoreData<SalsaBlock256x2>(destination, workingBuffer, RestoreBlock);
+	ScryptCommon::XorMixAndRestoreBlocks<SalsaBlock256x2, policy, fixedBlockCount>(destination, workingBuffer, xorSource, RestoreBlock);
 }
 
 void ScryptAVX2::RestoreBlock(SalsaBlock256x2& block, SalsaBlock256x2& arrangedBlock)
@@ -54,12 +56,22 @@ void ScryptAVX2::RestoreBlock(SalsaBlock256x2& block, SalsaBlock256x2& arrangedB
 	block.rows23 = _mm256_permutevar8x32_epi32(block.rows23, ElementPermuteArgs);
 }
 
+template<unsigned fixedBlockCount>
+void ScryptAVX2::MixBlocksInto(SalsaBlock* destination, SalsaBlock* source, unsigned blockCount)
+{
+	ScryptCommon::MixBlocksInto<SalsaBlock256x2, fixedBlockCount>(destination, source, blockCount);
+}
+
+template<CachePolicy policy, unsigned fixedBlockCount>
 void ScryptAVX2::CopyAndMixBlocks(SalsaBlock* copyDestination, ScryptElementPtr& workingBuffer, ScryptElementPtr& shuffleBuffer)
 {
-	ScryptCommon::MixBlocks<SalsaBlock256x2>(workingBuffer, copyDestination, shuffleBuffer, MixBlocksMode::Copy);
+	ScryptCommon::MixBlocks<SalsaBlock256x2, policy, MixBlocksMode::Copy, fixedBlockCount>(workingBuffer, copyDestination, shuffleBuffer);
 }
 
+template<CachePolicy policy, unsigned fixedBlockCount>
 void ScryptAVX2::XorAndMixBlocks(ScryptElementPtr& workingBuffer, SalsaBlock* xorSource, ScryptElementPtr& shuffleBuffer)
 {
-	ScryptCommon::MixBlocks<SalsaBlock256x2>(workingBuffer, xorSource, shuffleBuffer, MixBlocksMode::Xor);
+	ScryptCommon::MixBlocks<SalsaBlock256x2, policy, MixBlocksMode::Xor, fixedBlockCount>(workingBuffer, xorSource, shuffleBuffer);
 }
+
+SKRYPTONITE_INSTANTIATE_BLOCK_KERNELS(ScryptAVX2)
@@ -0,0 +1,271 @@
+﻿/**
+* Skryptonite - Scrypt library for UWP
+* Copyright © 2016 Nicholas C. Bauer, Ph.D.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "pch.h"
+#include "ScryptAVX2x8.h"
+#include "../Skryptonite.Native/ScryptCommon.h"
+
+using namespace Skryptonite::Native;
+
+void ScryptAVX2x8::PrepareLanes(ScryptElementPtr& workingBuffer, SalsaBlock* const* sources)
+{
+	_ASSERT(workingBuffer != nullptr && workingBuffer->Data() != nullptr);
+	_ASSERT(workingBuffer->BlockCount() % LaneCount == 0);
+	_ASSERT(sources != nullptr);
+
+	SalsaBlock256x8* currentBlockPosition = reinterpret_cast<SalsaBlock256x8*>(workingBuffer->Data());
+	unsigned blockCount = workingBuffer->BlockCount() / LaneCount;
+
+	for (unsigned i = 0; i < blockCount; i++, currentBlockPosition++)
+		LoadFromLanes(*currentBlockPosition, sources, i);
+}
+
+void ScryptAVX2x8::RestoreLanes(SalsaBlock* const* destinations, ScryptElementPtr& workingBuffer)
+{
+	_ASSERT(workingBuffer != nullptr && workingBuffer->Data() != nullptr);
+	_ASSERT(workingBuffer->BlockCount() % LaneCount == 0);
+	_ASSERT(destinations != nullptr);
+
+	SalsaBlock256x8* currentBlockPosition = reinterpret_cast<SalsaBlock256x8*>(workingBuffer->Data());
+	unsigned blockCount = workingBuffer->BlockCount() / LaneCount;
+
+	for (unsigned i = 0; i < blockCount; i++, currentBlockPosition++)
+		StoreToLanes(destinations, i, *currentBlockPosition);
+}
+
+void ScryptAVX2x8::IntegerifyLanes(unsigned* indices, const ScryptElementPtr& workingBuffer)
+{
+	_ASSERT(indices != nullptr);
+	_ASSERT(workingBuffer != nullptr && workingBuffer->Data() != nullptr);
+
+	// word 0 of the last block of every lane sits in the first 32 bytes of the last lane-sliced block
+	unsigned* lastBlockWord0 = (workingBuffer->Data() + workingBuffer->BlockCount() - LaneCount)->integers;
+	unsigned divisor = workingBuffer->IntegerifyDivisor();
+
+	for (unsigned k = 0; k < LaneCount; k++)
+		indices[k] = lastBlockWord0[k] % divisor;
+}
+
+template<CachePolicy policy>
+void ScryptAVX2x8::CopyAndMixLanes(SalsaBlock* const* copyDestinations, ScryptElementPtr& workingBuffer, ScryptElementPtr& shuffleBuffer)
+{
+	_ASSERT(workingBuffer != nullptr && workingBuffer->Data() != nullptr);
+	_ASSERT(shuffleBuffer != nullptr && shuffleBuffer->Data() != nullptr);
+	_ASSERT(workingBuffer->BlockCount() == shuffleBuffer->BlockCount());
+	_ASSERT(copyDestinations != nullptr);
+
+	SalsaBlock256x8* currentBlockPosition = reinterpret_cast<SalsaBlock256x8*>(workingBuffer->Data());
+	SalsaBlock256x8* shuffleData = reinterpret_cast<SalsaBlock256x8*>(shuffleBuffer->Data());
+
+	unsigned blockCount = workingBuffer->BlockCount() / LaneCount;
+	unsigned halfBlockCount = blockCount / 2;
+
+	SalsaBlock256x8 lastBlock = currentBlockPosition[blockCount - 1];
+	StreamToLanes<policy>(copyDestinations, blockCount - 1, lastBlock);
+
+	SalsaBlock256x8 previousBlock = lastBlock;
+
+	for (unsigned i = 0; i < blockCount - 1; i++, currentBlockPosition++)
+	{
+		SalsaBlock256x8 currentBlock = *currentBlockPosition;
+		StreamToLanes<policy>(copyDestinations, i, currentBlock);
+
+		// sort evens to the left half and odds to the right half
+		SalsaBlock256x8* destination = shuffleData + i / 2;
+		destination += (i % 2 == 0) ? 0 : halfBlockCount;
+
+		MixBlock(destination, currentBlock, previousBlock);
+
+		previousBlock = currentBlock;
+	}
+
+	MixBlock(shuffleData + blockCount - 1, lastBlock, previousBlock);
+
+	workingBuffer.swap(shuffleBuffer);
+}
+
+template<CachePolicy policy>
+void ScryptAVX2x8::XorAndMixLanes(ScryptElementPtr& workingBuffer, SalsaBlock* const* xorSources, ScryptElementPtr& shuffleBuffer)
+{
+	_ASSERT(workingBuffer != nullptr && workingBuffer->Data() != nullptr);
+	_ASSERT(shuffleBuffer != nullptr && shuffleBuffer->Data() != nullptr);
+	_ASSERT(workingBuffer->BlockCount() == shuffleBuffer->BlockCount());
+	_ASSERT(xorSources != nullptr);
+
+	SalsaBlock256x8* currentBlockPosition = reinterpret_cast<SalsaBlock256x8*>(workingBuffer->Data());
+	SalsaBlock256x8* shuffleData = reinterpret_cast<SalsaBlock256x8*>(shuffleBuffer->Data());
+
+	unsigned blockCount = workingBuffer->BlockCount() / LaneCount;
+	unsigned halfBlockCount = blockCount / 2;
+
+	for (unsigned i = 0; i < halfBlockCount; i++)
+		for (unsigned k = 0; k < LaneCount; k++)
+			ScryptCommon::PrefetchFor<policy>(xorSources[k] + i);
+
+	SalsaBlock256x8 lastBlock = currentBlockPosition[blockCount - 1];
+	LoadXorFlushLanes<policy>(lastBlock, xorSources, blockCount - 1);
+
+	SalsaBlock256x8 previousBlock = lastBlock;
+
+	for (unsigned i = 0; i < blockCount - 1; i++, currentBlockPosition++)
+	{
+		if (i + halfBlockCount < blockCount - 1)
+			for (unsigned k = 0; k < LaneCount; k++)
+				ScryptCommon::PrefetchFor<policy>(xorSources[k] + i + halfBlockCount);
+
+		SalsaBlock256x8 currentBlock = *currentBlockPosition;
+		LoadXorFlushLanes<policy>(currentBlock, xorSources, i);
+
+		// sort evens to the left half and odds to the right half
+		SalsaBlock256x8* destination = shuffleData + i / 2;
+		destination += (i % 2 == 0) ? 0 : halfBlockCount;
+
+		MixBlock(destination, currentBlock, previousBlock);
+
+		previousBlock = currentBlock;
+	}
+
+	MixBlock(shuffleData + blockCount - 1, lastBlock, previousBlock);
+
+	workingBuffer.swap(shuffleBuffer);
+}
+
+void ScryptAVX2x8::Transpose(__m256i* rows)
+{
+	__m256i t0 = _mm256_unpacklo_epi32(rows[0], rows[1]);
+	__m256i t1 = _mm256_unpackhi_epi32(rows[0], rows[1]);
+	__m256i t2 = _mm256_unpacklo_epi32(rows[2], rows[3]);
+	__m256i t3 = _mm256_unpackhi_epi32(rows[2], rows[3]);
+	__m256i t4 = _mm256_unpacklo_epi32(rows[4], rows[5]);
+	__m256i t5 = _mm256_unpackhi_epi32(rows[4], rows[5]);
+	__m256i t6 = _mm256_unpacklo_epi32(rows[6], rows[7]);
+	__m256i t7 = _mm256_unpackhi_epi32(rows[6], rows[7]);
+
+	__m256i u0 = _mm256_unpacklo_epi64(t0, t2);
+	__m256i u1 = _mm256_unpackhi_epi64(t0, t2);
+	__m256i u2 = _mm256_unpacklo_epi64(t1, t3);
+	__m256i u3 = _mm256_unpackhi_epi64(t1, t3);
+	__m256i u4 = _mm256_unpacklo_epi64(t4, t6);
+	__m256i u5 = _mm256_unpackhi_epi64(t4, t6);
+	__m256i u6 = _mm256_unpacklo_epi64(t5, t7);
+	__m256i u7 = _mm256_unpackhi_epi64(t5, t7);
+
+	rows[0] = _mm256_permute2x128_si256(u0, u4, 0x20);
+	rows[1] = _mm256_permute2x128_si256(u1, u5, 0x20);
+	rows[2] = _mm256_permute2x128_si256(u2, u6, 0x20);
+	rows[3] = _mm256_permute2x128_si256(u3, u7, 0x20);
+	rows[4] = _mm256_permute2x128_si256(u0, u4, 0x31);
+	rows[5] = _mm256_permute2x128_si256(u1, u5, 0x31);
+	rows[6] = _mm256_permute2x128_si256(u2, u6, 0x31);
+	rows[7] = _mm256_permute2x128_si256(u3, u7, 0x31);
+}
+
+void ScryptAVX2x8::LoadFromLanes(SalsaBlock256x8& block, SalsaBlock* const* sources, unsigned blockIndex)
+{
+	for (unsigned k = 0; k < LaneCount; k++)
+	{
+		__m256i* source256 = reinterpret_cast<__m256i*>(sources[k] + blockIndex);
+
+		block.words[k] = _mm256_loadu_si256(source256);
+		block.words[k + LaneCount] = _mm256_loadu_si256(source256 + 1);
+	}
+
+	Transpose(block.words);
+	Transpose(block.words + LaneCount);
+}
+
+template<CachePolicy policy>
+void ScryptAVX2x8::LoadXorFlushLanes(SalsaBlock256x8& block, SalsaBlock* const* xorSources, unsigned blockIndex)
+{
+	SalsaBlock256x8 xorBlock;
+
+	for (unsigned k = 0; k < LaneCount; k++)
+	{
+		SalsaBlock* xorBlockPosition = xorSources[k] + blockIndex;
+		__m256i* source256 = reinterpret_cast<__m256i*>(xorBlockPosition);
+
+		xorBlock.words[k] = _mm256_load_si256(source256);
+		xorBlock.words[k + LaneCount] = _mm256_load_si256(source256 + 1);
+		ScryptCommon::FlushFor<policy>(xorBlockPosition);
+	}
+
+	Transpose(xorBlock.words);
+	Transpose(xorBlock.words + LaneCount);
+
+	for (unsigned w = 0; w < 16; w++)
+		block.words[w] = _mm256_xor_si256(block.words[w], xorBlock.words[w]);
+}
+
+void ScryptAVX2x8::StoreToLanes(SalsaBlock* const* destinations, unsigned blockIndex, const SalsaBlock256x8& block)
+{
+	SalsaBlock256x8 laneBlock = block;
+
+	Transpose(laneBlock.words);
+	Transpose(laneBlock.words + LaneCount);
+
+	for (unsigned k = 0; k < LaneCount; k++)
+	{
+		if (destinations[k] == nullptr)
+			continue;
+
+		__m256i* destination256 = reinterpret_cast<__m256i*>(destinations[k] + blockIndex);
+
+		_mm256_storeu_si256(destination256, laneBlock.words[k]);
+		_mm256_storeu_si256(destination256 + 1, laneBlock.words[k + LaneCount]);
+	}
+}
+
+template<CachePolicy policy>
+void ScryptAVX2x8::StreamToLanes(SalsaBlock* const* destinations, unsigned blockIndex, const SalsaBlock256x8& block)
+{
+	SalsaBlock256x8 laneBlock = block;
+
+	Transpose(laneBlock.words);
+	Transpose(laneBlock.words + LaneCount);
+
+	for (unsigned k = 0; k < LaneCount; k++)
+	{
+		__m256i* destination256 = reinterpret_cast<__m256i*>(destinations[k] + blockIndex);
+
+		if (policy == CachePolicy::Cached)
+		{
+			_mm256_store_si256(destination256, laneBlock.words[k]);
+			_mm256_store_si256(destination256 + 1, laneBlock.words[k + LaneCount]);
+		}
+		else
+		{
+			_mm256_stream_si256(destination256, laneBlock.words[k]);
+			_mm256_stream_si256(destination256 + 1, laneBlock.words[k + LaneCount]);
+		}
+	}
+}
+
+void ScryptAVX2x8::MixBlock(SalsaBlock256x8* destination, SalsaBlock256x8& currentBlock, const SalsaBlock256x8& previousBlock)
+{
+	for (unsigned w = 0; w < 16; w++)
+		currentBlock.words[w] = _mm256_xor_si256(currentBlock.words[w], previousBlock.words[w]);
+
+	Salsa20Core::Hash<8>(currentBlock);
+	*destination = currentBlock;
+}
+
+template void ScryptAVX2x8::CopyAndMixLanes<CachePolicy::StreamAndFlush>(SalsaBlock* const*, ScryptElementPtr&, ScryptElementPtr&);
+template void ScryptAVX2x8::CopyAndMixLanes<CachePolicy::StreamAndFlushOptimized>(SalsaBlock* const*, ScryptElementPtr&, ScryptElementPtr&);
+template void ScryptAVX2x8::CopyAndMixLanes<CachePolicy::Cached>(SalsaBlock* const*, ScryptElementPtr&, ScryptElementPtr&);
+template void ScryptAVX2x8::XorAndMixLanes<CachePolicy::StreamAndFlush>(ScryptElementPtr&, SalsaBlock* const*, ScryptElementPtr&);
+template void ScryptAVX2x8::XorAndMixLanes<CachePolicy::StreamAndFlushOptimized>(ScryptElementPtr&, SalsaBlock* const*, ScryptElementPtr&);
+template void ScryptAVX2x8::XorAndMixLanes<CachePolicy::Cached>(ScryptElementPtr&, SalsaBlock* const*, ScryptElementPtr&);
@@ -0,0 +1,59 @@
+﻿/**
+* Skryptonite - Scrypt library for UWP
+* Copyright © 2016 Nicholas C. Bauer, Ph.D.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#pragma once
+#include "../Skryptonite.Native/SalsaBlock.h"
+#include "../Skryptonite.Native/ScryptElement.h"
+#include "../Skryptonite.Native/CachePolicy.h"
+
+namespace Skryptonite
+{
+	namespace Native
+	{
+		/**
+		<summary>Multi-buffer Scrypt kernels which mix one element from each of 8 independent lanes at once.</summary>
+		<remarks>
+		Working buffers are lane-sliced: each 64-byte block of an element is stored as 16 256-bit words, each holding the same
+		32-bit word of all 8 lanes, so they must be allocated with 8 times the block count of a single element. Elements and
+		large memory blocks keep their original per-lane layout and are transposed on the way in and out.
+		</remarks>
+		*/
+		class ScryptAVX2x8
+		{
+		public:
+			static const unsigned LaneCount = 8;
+
+			static void PrepareLanes(ScryptElementPtr& workingBuffer, SalsaBlock* const* sources);
+			template<CachePolicy policy>
+			static void CopyAndMixLanes(SalsaBlock* const* copyDestinations, ScryptElementPtr& workingBuffer, ScryptElementPtr& shuffleBuffer);
+			template<CachePolicy policy>
+			static void XorAndMixLanes(ScryptElementPtr& workingBuffer, SalsaBlock* const* xorSources, ScryptElementPtr& shuffleBuffer);
+			static void IntegerifyLanes(unsigned* indices, const ScryptElementPtr& workingBuffer);
+			static void RestoreLanes(SalsaBlock* const* destinations, ScryptElementPtr& workingBuffer);
+
+		private:
+			static __forceinline void Transpose(__m256i* rows);
+			static __forceinline void LoadFromLanes(SalsaBlock256x8& block, SalsaBlock* const* sources, unsigned blockIndex);
+			template<CachePolicy policy>
+			static __forceinline void LoadXorFlushLanes(SalsaBlock256x8& block, SalsaBlock* const* xorSources, unsigned blockIndex);
+			static __forceinline void StoreToLanes(SalsaBlock* const* destinations, unsigned blockIndex, const SalsaBlock256x8& block);
+			template<CachePolicy policy>
+			static __forceinline void StreamToLanes(SalsaBlock* const* destinations, unsigned blockIndex, const SalsaBlock256x8& block);
+			static __forceinline void MixBlock(SalsaBlock256x8* destination, SalsaBlock256x8& currentBlock, const SalsaBlock256x8& previousBlock);
+		};
+	}
+}
@@ -0,0 +1,141 @@
+﻿/**
+* Skryptonite - Scrypt library for UWP
+* Copyright © 2016 Nicholas C. Bauer, Ph.D.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "pch.h"
+#include "Sha256AVX2x8.h"
+#include "../Skryptonite.Native/Sha256.h"
+
+using namespace Skryptonite::Native;
+
+// reverses the bytes of each 32-bit word, since SHA-256 is big-endian
+const __m256i ByteSwapMask = _mm256_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12,
+											  3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+
+void Sha256AVX2x8::TransformLanes(unsigned* const* states, const unsigned char* const* blocks, unsigned count)
+{
+	_ASSERT(count > 0 && count <= LaneCount);
+
+	// unused lanes repeat the first lane and are not stored
+	const unsigned* laneStates[LaneCount];
+	const unsigned char* laneBlocks[LaneCount];
+
+	for (unsigned k = 0; k < LaneCount; k++)
+	{
+		laneStates[k] = states[k < count ? k : 0];
+		laneBlocks[k] = blocks[k < count ? k : 0];
+	}
+
+	__m256i state[8];
+	__m256i w[16];
+
+	for (unsigned k = 0; k < LaneCount; k++)
+	{
+		state[k] = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(laneStates[k]));
+		w[k] = _mm256_shuffle_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(laneBlocks[k])), ByteSwapMask);
+		w[k + 8] = _mm256_shuffle_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(laneBlocks[k] + 32)), ByteSwapMask);
+	}
+
+	// one register per word, one lane per message
+	Transpose(state);
+	Transpose(w);
+	Transpose(w + 8);
+
+	__m256i a = state[0], b = state[1], c = state[2], d = state[3];
+	__m256i e = state[4], f = state[5], g = state[6], h = state[7];
+
+	for (unsigned i = 0; i < 64; i++)
+	{
+		__m256i& current = w[i % 16];
+
+		if (i >= 16)
+		{
+			__m256i w15 = w[(i - 15) % 16];
+			__m256i w2 = w[(i - 2) % 16];
+			__m256i s0 = _mm256_xor_si256(_mm256_xor_si256(RotateRight(w15, 7), RotateRight(w15, 18)), _mm256_srli_epi32(w15, 3));
+			__m256i s1 = _mm256_xor_si256(_mm256_xor_si256(RotateRight(w2, 17), RotateRight(w2, 19)), _mm256_srli_epi32(w2, 10));
+			current = _mm256_add_epi32(_mm256_add_epi32(current, s0), _mm256_add_epi32(w[(i - 7) % 16], s1));
+		}
+
+		__m256i s1 = _mm256_xor_si256(_mm256_xor_si256(RotateRight(e, 6), RotateRight(e, 11)), RotateRight(e, 25));
+		__m256i choice = _mm256_xor_si256(_mm256_and_si256(e, f), _mm256_andnot_si256(e, g));
+		__m256i temp1 = _mm256_add_epi32(_mm256_add_epi32(h, s1), _mm256_add_epi32(choice, current));
+		temp1 = _mm256_add_epi32(temp1, _mm256_set1_epi32(static_cast<int>(Sha256::RoundConstants[i])));
+		__m256i s0 = _mm256_xor_si256(_mm256_xor_si256(RotateRight(a, 2), RotateRight(a, 13)), RotateRight(a, 22));
+		__m256i majority = _mm256_xor_si256(_mm256_and_si256(a, b), _mm256_and_si256(c, _mm256_xor_si256(a, b)));
+		__m256i temp2 = _mm256_add_epi32(s0, majority);
+
+		h = g;
+		g = f;
+		f = e;
+		e = _mm256_add_epi32(d, temp1);
+		d = c;
+		c = b;
+		b = a;
+		a = _mm256_add_epi32(temp1, temp2);
+	}
+
+	state[0] = _mm256_add_epi32(state[0], a);
+	state[1] = _mm256_add_epi32(state[1], b);
+	state[2] = _mm256_add_epi32(state[2], c);
+	state[3] = _mm256_add_epi32(state[3], d);
+	state[4] = _mm256_add_epi32(state[4], e);
+	state[5] = _mm256_add_epi32(state[5], f);
+	state[6] = _mm256_add_epi32(state[6], g);
+	state[7] = _mm256_add_epi32(state[7], h);
+
+	Transpose(state);
+
+	for (unsigned k = 0; k < count; k++)
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(states[k]), state[k]);
+
+	SecureErase(w, sizeof(w));
+}
+
+void Sha256AVX2x8::Transpose(__m256i* rows)
+{
+	__m256i t0 = _mm256_unpacklo_epi32(rows[0], rows[1]);
+	__m256i t1 = _mm256_unpackhi_epi32(rows[0], rows[1]);
+	__m256i t2 = _mm256_unpacklo_epi32(rows[2], rows[3]);
+	__m256i t3 = _mm256_unpackhi_epi32(rows[2], rows[3]);
+	__m256i t4 = _mm256_unpacklo_epi32(rows[4], rows[5]);
+	__m256i t5 = _mm256_unpackhi_epi32(rows[4], rows[5]);
+	__m256i t6 = _mm256_unpacklo_epi32(rows[6], rows[7]);
+	__m256i t7 = _mm256_unpackhi_epi32(rows[6], rows[7]);
+
+	__m256i u0 = _mm256_unpacklo_epi64(t0, t2);
+	__m256i u1 = _mm256_unpackhi_epi64(t0, t2);
+	__m256i u2 = _mm256_unpacklo_epi64(t1, t3);
+	__m256i u3 = _mm256_unpackhi_epi64(t1, t3);
+	__m256i u4 = _mm256_unpacklo_epi64(t4, t6);
+	__m256i u5 = _mm256_unpackhi_epi64(t4, t6);
+	__m256i u6 = _mm256_unpacklo_epi64(t5, t7);
+	__m256i u7 = _mm256_unpackhi_epi64(t5, t7);
+
+	rows[0] = _mm256_permute2x128_si256(u0, u4, 0x20);
+	rows[1] = _mm256_permute2x128_si256(u1, u5, 0x20);
+	rows[2] = _mm256_permute2x128_si256(u2, u6, 0x20);
+	rows[3] = _mm256_permute2x128_si256(u3, u7, 0x20);
+	rows[4] = _mm256_permute2x128_si256(u0, u4, 0x31);
+	rows[5] = _mm256_permute2x128_si256(u1, u5, 0x31);
+	rows[6] = _mm256_permute2x128_si256(u2, u6, 0x31);
+	rows[7] = _mm256_permute2x128_si256(u3, u7, 0x31);
+}
+
+__m256i Sha256AVX2x8::RotateRight(__m256i value, int magnitude)
+{
+	return _mm256_or_si256(_mm256_srli_epi32(value, magnitude), _mm256_slli_epi32(value, 32 - magnitude));
+}
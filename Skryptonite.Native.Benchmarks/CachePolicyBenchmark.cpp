@@ -0,0 +1,110 @@
+/**
+* Skryptonite - Scrypt library for UWP
+* Copyright © 2016 Nicholas C. Bauer, Ph.D.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "CpuFeatures.h"
+#include "ScryptEngine.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <initializer_list>
+#include <vector>
+
+using namespace Skryptonite::Native;
+
+/**
+<summary>Returns a short name for a cache policy.</summary>
+*/
+static const char* PolicyName(CachePolicy policy)
+{
+	switch (policy)
+	{
+	case CachePolicy::StreamAndFlush:
+		return "StreamAndFlush";
+	case CachePolicy::StreamAndFlushOptimized:
+		return "StreamAndFlushOptimized";
+	case CachePolicy::Cached:
+		return "Cached";
+	default:
+		return "Automatic";
+	}
+}
+
+/**
+<summary>Returns the best of several timings of mixing one group of elements with the given policy, in milliseconds.</summary>
+*/
+static double TimeSMix(unsigned r, unsigned N, CachePolicy policy, unsigned repetitions)
+{
+	std::vector<unsigned char> data(128 * r);
+	ScryptEngine probe(data.data(), data.size(), 1, N);
+
+	// one element per lane or chain, so the large memory block is as large as in a real group
+	unsigned elementsCount = probe.LaneCount();
+	data.assign(static_cast<size_t>(128) * r * elementsCount, 0x5c);
+
+	ScryptEngine engine(data.data(), data.size(), elementsCount, N);
+	engine.SetCachePolicy(policy);
+
+	double best = 0;
+
+	// the first run also warms the scratch pool
+	for (unsigned i = 0; i <= repetitions; i++)
+	{
+		auto start = std::chrono::steady_clock::now();
+		engine.SMixRange(0, elementsCount);
+		std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+
+		if (i > 0 && (best == 0 || elapsed.count() < best))
+			best = elapsed.count();
+	}
+
+	return best;
+}
+
+/**
+<summary>Times SMix with every cache policy over a range of N, to check where <see cref="CachePolicy::Automatic"/> switches.</summary>
+<remarks>Usage: skryptonite_cache_policy_benchmark [r] [largest log2(N)] [repetitions]</remarks>
+*/
+int main(int argc, char** argv)
+{
+	unsigned r = argc > 1 ? static_cast<unsigned>(strtoul(argv[1], nullptr, 10)) : 8;
+	unsigned maxLogN = argc > 2 ? static_cast<unsigned>(strtoul(argv[2], nullptr, 10)) : 20;
+	unsigned repetitions = argc > 3 ? static_cast<unsigned>(strtoul(argv[3], nullptr, 10)) : 3;
+
+	if (r == 0 || maxLogN == 0 || maxLogN > 24 || repetitions == 0)
+	{
+		printf("usage: %s [r] [largest log2(N) <= 24] [repetitions]\n", argv[0]);
+		return 1;
+	}
+
+	CpuFeatures::Detect();
+	printf("last-level cache: %zu KiB, CLFLUSHOPT: %s\n", CpuFeatures::LastLevelCacheSize() / 1024, CpuFeatures::ClflushOpt() ? "yes" : "no");
+	printf("%8s %10s %16s %16s %16s %16s  %s\n", "N", "V (KiB)", "StreamAndFlush", "Optimized", "Cached", "Automatic", "chosen");
+
+	for (unsigned logN = 10; logN <= maxLogN; logN++)
+	{
+		unsigned N = 1u << logN;
+		std::vector<unsigned char> data(128 * r);
+		ScryptEngine probe(data.data(), data.size(), 1, N);
+
+		printf("%8u %10llu", N, 128ull * r * N * probe.LaneCount() / 1024);
+		for (CachePolicy policy : { CachePolicy::StreamAndFlush, CachePolicy::StreamAndFlushOptimized, CachePolicy::Cached, CachePolicy::Automatic })
+			printf(" %13.2f ms", TimeSMix(r, N, policy, repetitions));
+		printf("  %s\n", PolicyName(probe.ActiveCachePolicy()));
+	}
+
+	return 0;
+}
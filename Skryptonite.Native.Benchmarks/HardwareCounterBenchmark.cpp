@@ -0,0 +1,172 @@
+/**
+* Skryptonite - Scrypt library for UWP
+* Copyright © 2016 Nicholas C. Bauer, Ph.D.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "CpuFeatures.h"
+#include "HardwareCounters.h"
+#include "Metrics.h"
+#include "ScryptEngine.h"
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+using namespace Skryptonite::Native;
+
+/**
+<summary>Prints one event of a phase per byte of the large memory block, or a dash when the event is not available.</summary>
+*/
+static void PrintPerByte(const PhaseSnapshot& phase, HardwareEvent event, unsigned availableEvents, double scale)
+{
+	if ((availableEvents & (1u << static_cast<unsigned>(event))) == 0 || phase.bytes == 0)
+		printf(" %12s", "-");
+	else
+		printf(" %12.3f", scale * phase.hardwareEvents[static_cast<size_t>(event)] / phase.bytes);
+}
+
+/**
+<summary>Prints the events counted during one phase: cycles per byte, instructions per cycle, LLC and dTLB misses per KiB, and
+the share of cycles stalled.</summary>
+*/
+static void PrintPhase(const char* backend, const char* phaseName, unsigned r, unsigned N, const PhaseSnapshot& phase,
+	unsigned availableEvents)
+{
+	const unsigned long long cycles = phase.hardwareEvents[static_cast<size_t>(HardwareEvent::Cycles)];
+	const bool hasCycles = (availableEvents & (1u << static_cast<unsigned>(HardwareEvent::Cycles))) != 0 && cycles > 0;
+
+	printf("%-8s %-6s %4u %8u", backend, phaseName, r, N);
+	PrintPerByte(phase, HardwareEvent::Cycles, availableEvents, 1);
+
+	if (hasCycles && (availableEvents & (1u << static_cast<unsigned>(HardwareEvent::Instructions))) != 0)
+		printf(" %8.2f", static_cast<double>(phase.hardwareEvents[static_cast<size_t>(HardwareEvent::Instructions)]) / cycles);
+	else
+		printf(" %8s", "-");
+
+	PrintPerByte(phase, HardwareEvent::LastLevelCacheMisses, availableEvents, 1024);
+	PrintPerByte(phase, HardwareEvent::DataTlbMisses, availableEvents, 1024);
+
+	if (hasCycles && (availableEvents & (1u << static_cast<unsigned>(HardwareEvent::MemoryStallCycles))) != 0)
+		printf(" %8.1f\n", 100.0 * phase.hardwareEvents[static_cast<size_t>(HardwareEvent::MemoryStallCycles)] / cycles);
+	else
+		printf(" %8s\n", "-");
+}
+
+/**
+<summary>Mixes one group of <see cref="ScryptEngine::LaneCount"/> elements several times with the active instruction set, and
+prints the events counted during the fill and the mix.</summary>
+*/
+static void BenchmarkPhases(const char* backend, unsigned r, unsigned N, unsigned repetitions, unsigned availableEvents)
+{
+	std::vector<unsigned char> data(128 * r);
+	ScryptEngine probe(data.data(), data.size(), 1, N);
+	unsigned laneCount = probe.LaneCount();
+
+	data.assign(static_cast<size_t>(128) * r * laneCount, 0x5c);
+	ScryptEngine engine(data.data(), data.size(), laneCount, N);
+
+	// one untimed run faults in the scratch memory, which would otherwise be counted in the first fill
+	engine.SMixRange(0, laneCount);
+	Metrics::Reset();
+
+	for (unsigned i = 0; i < repetitions; i++)
+		engine.SMixRange(0, laneCount);
+
+	MetricsSnapshot snapshot = Metrics::Snapshot();
+	PrintPhase(backend, "Fill", r, N, snapshot.phases[static_cast<size_t>(MetricsPhase::FillScryptBlock)], availableEvents);
+	PrintPhase(backend, "Mix", r, N, snapshot.phases[static_cast<size_t>(MetricsPhase::MixWithScryptBlock)], availableEvents);
+}
+
+/**
+<summary>Reads the processor's performance counters around the fill and the mix of SMix for every backend the processor
+supports over a grid of r and N, to tell whether a change is bound by cache misses, TLB misses or the Salsa20/8 chain.</summary>
+<remarks>
+Usage: skryptonite_hardware_counter_benchmark [largest r] [largest log2(N)] [repetitions]
+r doubles from 1 and log2(N) steps by 2 from 10. Needs metrics recording (the SKRYPTONITE_ENABLE_METRICS CMake option) and
+the counters of perf_event_open on Linux; it says so and exits without measuring when either is missing. Events the processor
+does not expose are shown as dashes. Bytes count the large memory block of every element, and cycles are core cycles, not
+time-stamp counter ticks.
+</remarks>
+*/
+int main(int argc, char** argv)
+{
+	unsigned maxR = argc > 1 ? static_cast<unsigned>(strtoul(argv[1], nullptr, 10)) : 8;
+	unsigned maxLogN = argc > 2 ? static_cast<unsigned>(strtoul(argv[2], nullptr, 10)) : 16;
+	unsigned repetitions = argc > 3 ? static_cast<unsigned>(strtoul(argv[3], nullptr, 10)) : 3;
+
+	if (maxR == 0 || maxR > 1024 || maxLogN < 10 || maxLogN > 24 || repetitions == 0)
+	{
+		printf("usage: %s [largest r <= 1024] [largest log2(N), 10 to 24] [repetitions]\n", argv[0]);
+		return 1;
+	}
+
+	if (!Metrics::IsCompiledIn())
+	{
+		printf("skipped: metrics recording is not compiled in; configure with -DSKRYPTONITE_ENABLE_METRICS=ON\n");
+		return 0;
+	}
+
+	// the engine records its phases on the calling thread, which opens its counters here
+	unsigned availableEvents = HardwareCounters::AvailableEvents();
+	if (availableEvents == 0)
+	{
+		printf("skipped: no hardware counters; perf_event_open is unavailable, restricted by perf_event_paranoid, or has no PMU\n");
+		return 0;
+	}
+
+	for (unsigned i = 0; i < static_cast<unsigned>(HardwareEvent::Count); i++)
+		if ((availableEvents & (1u << i)) == 0)
+			printf("not counted: %s\n", HardwareCounters::EventName(static_cast<HardwareEvent>(i)));
+
+	CpuFeatures::Detect();
+	InstructionSet detected = CpuFeatures::MaxInstructionSet();
+
+	Metrics::SetEnabled(true);
+	Metrics::SetHardwareCountersEnabled(true);
+
+	printf("%-8s %-6s %4s %8s %12s %8s %12s %12s %8s\n", "backend", "phase", "r", "N", "cycles/byte", "IPC", "LLC miss/KiB",
+		"dTLB miss/KiB", "stall %");
+
+	// the instruction sets with a backend of their own; SSSE3 mixes with the SSE2 backend
+	const InstructionSet backends[] =
+	{
+		InstructionSet::Unknown,
+#if defined(SKRYPTONITE_X86)
+		InstructionSet::SSE2,
+		InstructionSet::SSE41,
+		InstructionSet::AVX,
+		InstructionSet::AVX2,
+#endif
+#if defined(SKRYPTONITE_ARM)
+		InstructionSet::NEON,
+#endif
+	};
+
+	for (InstructionSet instructionSet : backends)
+	{
+		if (instructionSet > detected)
+			continue;
+
+		// the engine selects its kernels from the active instruction set
+		CpuFeatures::SetMaxInstructionSet(instructionSet);
+
+		for (unsigned r = 1; r <= maxR; r *= 2)
+			for (unsigned logN = 10; logN <= maxLogN; logN += 2)
+				BenchmarkPhases(CpuFeatures::InstructionSetName(instructionSet), r, 1u << logN, repetitions, availableEvents);
+	}
+
+	Metrics::SetHardwareCountersEnabled(false);
+	CpuFeatures::SetMaxInstructionSet(detected);
+	return 0;
+}
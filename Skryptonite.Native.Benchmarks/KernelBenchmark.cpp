@@ -0,0 +1,293 @@
+/**
+* Skryptonite - Scrypt library for UWP
+* Copyright © 2016 Nicholas C. Bauer, Ph.D.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "CpuFeatures.h"
+#include "ScryptEngine.h"
+#include "ScryptElement.h"
+#include "ScryptScalar.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <vector>
+
+#if defined(SKRYPTONITE_X86)
+#include "../Skryptonite.Native.SSE2/ScryptSSE2.h"
+#include "../Skryptonite.Native.SSE2/ScryptSSE41.h"
+#include "../Skryptonite.Native.AVX/ScryptAVX.h"
+#include "../Skryptonite.Native.AVX2/ScryptAVX2.h"
+#endif
+
+#if defined(SKRYPTONITE_ARM)
+#include "../Skryptonite.Native.NEON/ScryptNEON.h"
+#endif
+
+using namespace Skryptonite::Native;
+
+// each timing mixes about this many bytes, so that short kernels are not dominated by reading the clock
+const unsigned long long BytesPerTiming = 4ull << 20;
+
+/**
+<summary>The block mixing kernels of one instruction-set backend for one element length, specialized for a cached large memory
+block so that only computation is timed.</summary>
+*/
+struct Kernels
+{
+	void(*mixBlocksInto)(SalsaBlock* destination, SalsaBlock* source, unsigned blockCount);
+	void(*copyAndMixBlocks)(SalsaBlock* copyDestination, ScryptElementPtr& workingBuffer, ScryptElementPtr& shuffleBuffer);
+	void(*xorAndMixBlocks)(ScryptElementPtr& workingBuffer, SalsaBlock* xorSource, ScryptElementPtr& shuffleBuffer);
+	void(*prepareCopyAndMixBlocks)(SalsaBlock* copyDestination, SalsaBlock* source, SalsaBlock* mixDestination, unsigned blockCount);
+	void(*xorMixAndRestoreBlocks)(SalsaBlock* destination, ScryptElementPtr& workingBuffer, SalsaBlock* xorSource);
+};
+
+template<class TBackend, unsigned fixedBlockCount>
+static Kernels MakeKernels()
+{
+	return { TBackend::template MixBlocksInto<fixedBlockCount>,
+		TBackend::template CopyAndMixBlocks<CachePolicy::Cached, fixedBlockCount>,
+		TBackend::template XorAndMixBlocks<CachePolicy::Cached, fixedBlockCount>,
+		TBackend::template PrepareCopyAndMixBlocks<CachePolicy::Cached, fixedBlockCount>,
+		TBackend::template XorMixAndRestoreBlocks<CachePolicy::Cached, fixedBlockCount> };
+}
+
+/**
+<summary>Selects the kernels the engine mixes an element of the given length with: specialized for r = 1, 2, 4, 8 and 16,
+otherwise the ones that take any length.</summary>
+*/
+template<class TBackend>
+static Kernels KernelsFor(unsigned blockCount)
+{
+	switch (blockCount)
+	{
+	case 2:
+		return MakeKernels<TBackend, 2>();
+	case 4:
+		return MakeKernels<TBackend, 4>();
+	case 8:
+		return MakeKernels<TBackend, 8>();
+	case 16:
+		return MakeKernels<TBackend, 16>();
+	case 32:
+		return MakeKernels<TBackend, 32>();
+	default:
+		return MakeKernels<TBackend, 0>();
+	}
+}
+
+/**
+<summary>An instruction-set backend and its kernels.</summary>
+*/
+struct Backend
+{
+	const char* name;
+	InstructionSet instructionSet;
+	Kernels(*kernelsFor)(unsigned blockCount);
+	Kernels anyLength;
+};
+
+template<class TBackend>
+static Backend MakeBackend(const char* name, InstructionSet instructionSet)
+{
+	return { name, instructionSet, KernelsFor<TBackend>, MakeKernels<TBackend, 0>() };
+}
+
+/**
+<summary>The cost of one call, as the best of several timings.</summary>
+*/
+struct Timing
+{
+	double nanoseconds;
+	double cycles;
+};
+
+/**
+<summary>Reads the time-stamp counter, or returns 0 where there is none.</summary>
+<remarks>The time-stamp counter ticks at a constant reference rate, which differs from the core clock under turbo or power saving.</remarks>
+*/
+static unsigned long long ReadCycleCounter()
+{
+#if defined(SKRYPTONITE_X86)
+	return __rdtsc();
+#else
+	return 0;
+#endif
+}
+
+/**
+<summary>Times a function called <paramref name="calls"/> times in a row.</summary>
+<returns>The best time per call of <paramref name="repetitions"/> runs, after one untimed run.</returns>
+*/
+template<class TFunction>
+static Timing TimeCalls(unsigned long long calls, unsigned repetitions, TFunction function)
+{
+	Timing best = { 0, 0 };
+
+	for (unsigned i = 0; i <= repetitions; i++)
+	{
+		auto start = std::chrono::steady_clock::now();
+		unsigned long long startCycles = ReadCycleCounter();
+
+		for (unsigned long long call = 0; call < calls; call++)
+			function();
+
+		unsigned long long cycles = ReadCycleCounter() - startCycles;
+		std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+
+		if (i > 0 && (best.nanoseconds == 0 || elapsed.count() / calls < best.nanoseconds))
+			best = { elapsed.count() / calls, static_cast<double>(cycles) / calls };
+	}
+
+	return best;
+}
+
+/**
+<summary>Prints one result line in ns/call and cycles/byte.</summary>
+*/
+static void PrintTiming(const char* backend, const char* kernel, unsigned r, unsigned N, Timing timing, unsigned long long bytes)
+{
+	char nColumn[16] = "-";
+	if (N > 0)
+		snprintf(nColumn, sizeof(nColumn), "%u", N);
+
+	printf("%-8s %-24s %4u %8s %14.1f %12.2f\n", backend, kernel, r, nColumn, timing.nanoseconds, timing.cycles / bytes);
+}
+
+/**
+<summary>Times every block mixing kernel of a backend for one element length, and the mix without the specialization for it.</summary>
+*/
+static void BenchmarkKernels(const Backend& backend, unsigned r, unsigned repetitions)
+{
+	const unsigned blockCount = 2 * r;
+	const unsigned long long elementLength = 128ull * r;
+	const unsigned long long calls = (BytesPerTiming + elementLength - 1) / elementLength;
+
+	ScryptElementPtr workingBuffer = std::make_unique<ScryptElement>(blockCount, 1);
+	ScryptElementPtr shuffleBuffer = std::make_unique<ScryptElement>(blockCount, 1);
+	ScryptElementPtr other = std::make_unique<ScryptElement>(blockCount, 1);
+	ScryptElementPtr original = std::make_unique<ScryptElement>(blockCount, 1);
+
+	for (unsigned i = 0; i < blockCount; i++)
+		for (unsigned j = 0; j < 16; j++)
+			workingBuffer->Data()[i].integers[j] = other->Data()[i].integers[j] = original->Data()[i].integers[j] = i * 16 + j;
+
+	SalsaBlock* working = workingBuffer->Data();
+	SalsaBlock* source = other->Data();
+	SalsaBlock* element = original->Data();
+	const Kernels kernels = backend.kernelsFor(blockCount);
+
+	// BlockMix runs Salsa20/8 once per 64-byte block, so a copy-free mix divided by 2r approximates one hash with its loads and stores
+	Timing mix = TimeCalls(calls, repetitions, [&]() { kernels.mixBlocksInto(source, working, blockCount); });
+	PrintTiming(backend.name, "Salsa20/8 (in BlockMix)", r, 0, { mix.nanoseconds / blockCount, mix.cycles / blockCount }, elementLength / blockCount);
+	PrintTiming(backend.name, "MixBlocksInto", r, 0, mix, elementLength);
+	if (kernels.mixBlocksInto != backend.anyLength.mixBlocksInto)
+		PrintTiming(backend.name, "MixBlocksInto (any r)", r, 0,
+			TimeCalls(calls, repetitions, [&]() { backend.anyLength.mixBlocksInto(source, working, blockCount); }), elementLength);
+
+	PrintTiming(backend.name, "CopyAndMixBlocks", r, 0,
+		TimeCalls(calls, repetitions, [&]() { kernels.copyAndMixBlocks(source, workingBuffer, shuffleBuffer); }), elementLength);
+	PrintTiming(backend.name, "XorAndMixBlocks", r, 0,
+		TimeCalls(calls, repetitions, [&]() { kernels.xorAndMixBlocks(workingBuffer, source, shuffleBuffer); }), elementLength);
+	PrintTiming(backend.name, "PrepareCopyAndMixBlocks", r, 0,
+		TimeCalls(calls, repetitions, [&]() { kernels.prepareCopyAndMixBlocks(source, element, workingBuffer->Data(), blockCount); }), elementLength);
+	PrintTiming(backend.name, "XorMixAndRestoreBlocks", r, 0,
+		TimeCalls(calls, repetitions, [&]() { kernels.xorMixAndRestoreBlocks(element, workingBuffer, source); }), elementLength);
+}
+
+/**
+<summary>Times a complete SMix of one element, and of one group of <see cref="ScryptEngine::LaneCount"/> elements, with the
+active instruction set.</summary>
+*/
+static void BenchmarkSMix(const Backend& backend, unsigned r, unsigned N, unsigned repetitions)
+{
+	std::vector<unsigned char> data(128 * r);
+	ScryptEngine probe(data.data(), data.size(), 1, N);
+	unsigned laneCount = probe.LaneCount();
+
+	data.assign(static_cast<size_t>(128) * r * laneCount, 0x5c);
+	ScryptEngine engine(data.data(), data.size(), laneCount, N);
+
+	// SMix reads and writes the element once and mixes it 2N times
+	const unsigned long long bytes = 128ull * r * 2 * N;
+
+	PrintTiming(backend.name, "SMix", r, N, TimeCalls(1, repetitions, [&]() { engine.SMix(0); }), bytes);
+
+	if (laneCount > 1)
+	{
+		Timing group = TimeCalls(1, repetitions, [&]() { engine.SMixRange(0, laneCount); });
+		PrintTiming(backend.name, "SMixRange (per element)", r, N, { group.nanoseconds / laneCount, group.cycles / laneCount }, bytes);
+	}
+}
+
+/**
+<summary>Times the kernels and SMix of every backend the processor supports over a grid of r and N, forcing each backend in
+turn with <see cref="CpuFeatures::SetMaxInstructionSet"/>.</summary>
+<remarks>
+Usage: skryptonite_kernel_benchmark [largest r] [largest log2(N)] [repetitions]
+r doubles from 1 and log2(N) steps by 2 from 10. Cycles are time-stamp counter ticks.
+</remarks>
+*/
+int main(int argc, char** argv)
+{
+	unsigned maxR = argc > 1 ? static_cast<unsigned>(strtoul(argv[1], nullptr, 10)) : 16;
+	unsigned maxLogN = argc > 2 ? static_cast<unsigned>(strtoul(argv[2], nullptr, 10)) : 14;
+	unsigned repetitions = argc > 3 ? static_cast<unsigned>(strtoul(argv[3], nullptr, 10)) : 3;
+
+	if (maxR == 0 || maxR > 1024 || maxLogN < 10 || maxLogN > 24 || repetitions == 0)
+	{
+		printf("usage: %s [largest r <= 1024] [largest log2(N), 10 to 24] [repetitions]\n", argv[0]);
+		return 1;
+	}
+
+	const Backend backends[] =
+	{
+		MakeBackend<ScryptScalar>("Scalar", InstructionSet::Unknown),
+#if defined(SKRYPTONITE_X86)
+		MakeBackend<ScryptSSE2>("SSE2", InstructionSet::SSE2),
+		MakeBackend<ScryptSSE41>("SSE4.1", InstructionSet::SSE41),
+		MakeBackend<ScryptAVX>("AVX", InstructionSet::AVX),
+		MakeBackend<ScryptAVX2>("AVX2", InstructionSet::AVX2),
+#endif
+#if defined(SKRYPTONITE_ARM)
+		MakeBackend<ScryptNEON>("NEON", InstructionSet::NEON),
+#endif
+	};
+
+	CpuFeatures::Detect();
+	InstructionSet detected = CpuFeatures::MaxInstructionSet();
+
+	printf("%-8s %-24s %4s %8s %14s %12s\n", "backend", "kernel", "r", "N", "ns/call", "cycles/byte");
+
+	for (const Backend& backend : backends)
+	{
+		if (backend.instructionSet > detected)
+			continue;
+
+		// the engine selects its kernels from the active instruction set, so SMix uses this backend too
+		CpuFeatures::SetMaxInstructionSet(backend.instructionSet);
+
+		for (unsigned r = 1; r <= maxR; r *= 2)
+		{
+			BenchmarkKernels(backend, r, repetitions);
+
+			for (unsigned logN = 10; logN <= maxLogN; logN += 2)
+				BenchmarkSMix(backend, r, 1u << logN, repetitions);
+		}
+	}
+
+	CpuFeatures::SetMaxInstructionSet(detected);
+	return 0;
+}
@@ -0,0 +1,115 @@
+/**
+* Skryptonite - Scrypt library for UWP
+* Copyright © 2016 Nicholas C. Bauer, Ph.D.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "ProcessorTopology.h"
+#include "ScryptEngine.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+using namespace Skryptonite::Native;
+
+/**
+<summary>Returns the best of several timings of mixing every element of a buffer on the thread pool, in seconds.</summary>
+*/
+static double TimeSMixAll(unsigned r, unsigned N, unsigned elementsCount, unsigned threadCount, unsigned repetitions)
+{
+	std::vector<unsigned char> data(static_cast<size_t>(128) * r * elementsCount, 0x5c);
+	ScryptEngine engine(data.data(), data.size(), elementsCount, N);
+
+	double best = 0;
+
+	// the first run also fills the scratch pools of the workers on their nodes
+	for (unsigned i = 0; i <= repetitions; i++)
+	{
+		auto start = std::chrono::steady_clock::now();
+		engine.SMixAll(threadCount);
+		std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+		if (i > 0 && (best == 0 || elapsed.count() < best))
+			best = elapsed.count();
+	}
+
+	return best;
+}
+
+/**
+<summary>Counts the NUMA nodes the first threads of the pool run on.</summary>
+*/
+static unsigned NodesInUse(const std::vector<unsigned>& order, unsigned threadCount)
+{
+	std::vector<unsigned> nodes;
+
+	for (unsigned t = 0; t < threadCount && t < order.size(); t++)
+		nodes.push_back(ProcessorTopology::NodeOfProcessor(order[t]));
+
+	std::sort(nodes.begin(), nodes.end());
+	return (std::max)(static_cast<unsigned>(std::unique(nodes.begin(), nodes.end()) - nodes.begin()), 1u);
+}
+
+/**
+<summary>Times SMix of many elements on the thread pool for a growing number of threads, with workers kept on their NUMA node
+and with placement left to the operating system.</summary>
+<remarks>Usage: skryptonite_numa_benchmark [r] [log2(N)] [repetitions]</remarks>
+*/
+int main(int argc, char** argv)
+{
+	unsigned r = argc > 1 ? static_cast<unsigned>(strtoul(argv[1], nullptr, 10)) : 8;
+	unsigned logN = argc > 2 ? static_cast<unsigned>(strtoul(argv[2], nullptr, 10)) : 14;
+	unsigned repetitions = argc > 3 ? static_cast<unsigned>(strtoul(argv[3], nullptr, 10)) : 3;
+
+	if (r == 0 || logN == 0 || logN > 24 || repetitions == 0)
+	{
+		printf("usage: %s [r] [log2(N) <= 24] [repetitions]\n", argv[0]);
+		return 1;
+	}
+
+	unsigned N = 1u << logN;
+	ThreadPool& pool = ThreadPool::Global();
+	std::vector<unsigned> order = ProcessorTopology::ProcessorOrder();
+
+	std::vector<unsigned char> probeData(128 * r);
+	ScryptEngine probe(probeData.data(), probeData.size(), 1, N);
+	unsigned laneCount = probe.LaneCount();
+
+	printf("NUMA nodes: %u, threads: %u, V per group: %llu KiB\n", ProcessorTopology::NodeCount(), pool.ThreadCount(),
+		128ull * r * N * laneCount / 1024);
+	printf("%8s %6s %18s %18s %18s %18s\n", "threads", "nodes", "placed (el/s)", "per node", "unplaced (el/s)", "per node");
+
+	for (unsigned threadCount = 1; ; threadCount = (std::min)(threadCount * 2, pool.ThreadCount()))
+	{
+		// several groups per thread, so stealing can even out the threads
+		unsigned elementsCount = threadCount * laneCount * 4;
+		unsigned nodes = NodesInUse(order, threadCount);
+
+		pool.SetNumaPlacement(true);
+		double placed = elementsCount / TimeSMixAll(r, N, elementsCount, threadCount, repetitions);
+		pool.SetNumaPlacement(false);
+		double unplaced = elementsCount / TimeSMixAll(r, N, elementsCount, threadCount, repetitions);
+
+		printf("%8u %6u %18.1f %18.1f %18.1f %18.1f\n", threadCount, nodes, placed, placed / nodes, unplaced, unplaced / nodes);
+
+		if (threadCount == pool.ThreadCount())
+			break;
+	}
+
+	pool.SetNumaPlacement(true);
+	return 0;
+}
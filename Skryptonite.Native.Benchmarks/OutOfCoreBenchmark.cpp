@@ -0,0 +1,96 @@
+/**
+* Skryptonite - Scrypt library for UWP
+* Copyright © 2016 Nicholas C. Bauer, Ph.D.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "MappedScratch.h"
+#include "ScryptEngine.h"
+#include "ThreadPool.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+using namespace Skryptonite::Native;
+
+/**
+<summary>Returns the time of mixing every element of a buffer on the thread pool with the large memory blocks in the given
+directory, or in RAM when it is empty, in seconds.</summary>
+*/
+static double TimeSMixAll(unsigned r, unsigned N, unsigned elementsCount, const std::string& directory)
+{
+	std::vector<unsigned char> data(static_cast<size_t>(128) * r * elementsCount, 0x5c);
+	ScryptEngine engine(data.data(), data.size(), elementsCount, N);
+	engine.SetStorageDirectory(directory);
+
+	auto start = std::chrono::steady_clock::now();
+	engine.SMixAll(0);
+	std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+	return elapsed.count();
+}
+
+/**
+<summary>Compares SMix with the large memory blocks in RAM and in memory-mapped files over a range of N.</summary>
+<remarks>
+Usage: skryptonite_out_of_core_benchmark directory [r] [smallest log2(N)] [largest log2(N)] [p]
+
+Throughput counts the large memory block written once and read once per element. The time in files includes creating,
+erasing and deleting them. Beyond the free memory of the machine, only the files can run at all.
+</remarks>
+*/
+int main(int argc, char** argv)
+{
+	if (argc < 2 || !MappedScratch::IsSupported())
+	{
+		printf("usage: %s directory [r] [smallest log2(N)] [largest log2(N) <= 31] [p]\n", argv[0]);
+		return 1;
+	}
+
+	std::string directory = argv[1];
+	unsigned r = argc > 2 ? static_cast<unsigned>(strtoul(argv[2], nullptr, 10)) : 8;
+	unsigned smallestLogN = argc > 3 ? static_cast<unsigned>(strtoul(argv[3], nullptr, 10)) : 14;
+	unsigned largestLogN = argc > 4 ? static_cast<unsigned>(strtoul(argv[4], nullptr, 10)) : 20;
+	unsigned p = argc > 5 ? static_cast<unsigned>(strtoul(argv[5], nullptr, 10)) : ThreadPool::Global().ThreadCount();
+
+	if (r == 0 || smallestLogN == 0 || largestLogN < smallestLogN || largestLogN > 31 || p == 0)
+	{
+		printf("usage: %s directory [r] [smallest log2(N)] [largest log2(N) <= 31] [p]\n", argv[0]);
+		return 1;
+	}
+
+	printf("threads: %u, p: %u, r: %u\n", ThreadPool::Global().ThreadCount(), p, r);
+	printf("%8s %14s %14s %14s %10s\n", "log2(N)", "V (MiB)", "RAM (MB/s)", "file (MB/s)", "file/RAM");
+
+	for (unsigned logN = smallestLogN; logN <= largestLogN; logN++)
+	{
+		unsigned N = 1u << logN;
+		double bytes = 2.0 * 128 * r * N * p;
+
+		// a large memory block that cannot be allocated is reported rather than ending the comparison
+		double inMemory = 0;
+		try { inMemory = bytes / TimeSMixAll(r, N, p, std::string()) / 1e6; } catch (const std::bad_alloc&) { }
+
+		double outOfCore = bytes / TimeSMixAll(r, N, p, directory) / 1e6;
+
+		if (inMemory > 0)
+			printf("%8u %14.1f %14.1f %14.1f %10.3f\n", logN, 128.0 * r * N / 1048576, inMemory, outOfCore, outOfCore / inMemory);
+		else
+			printf("%8u %14.1f %14s %14.1f %10s\n", logN, 128.0 * r * N / 1048576, "-", outOfCore, "-");
+	}
+
+	return 0;
+}
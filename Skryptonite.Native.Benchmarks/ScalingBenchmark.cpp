@@ -0,0 +1,639 @@
+/**
+* Skryptonite - Scrypt library for UWP
+* Copyright © 2016 Nicholas C. Bauer, Ph.D.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "ScryptEngine.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace Skryptonite::Native;
+
+/**
+A straightforward, byte-order independent Scrypt written from RFC 7914 and FIPS 180-4, sharing no code with the library, so
+that it can check the library's derived keys and show how much the library gains over a scalar implementation.
+*/
+namespace Reference
+{
+	static uint32_t Load32(const uint8_t* bytes)
+	{
+		return static_cast<uint32_t>(bytes[0]) | static_cast<uint32_t>(bytes[1]) << 8 | static_cast<uint32_t>(bytes[2]) << 16 |
+			static_cast<uint32_t>(bytes[3]) << 24;
+	}
+
+	static void Store32(uint8_t* bytes, uint32_t value)
+	{
+		bytes[0] = static_cast<uint8_t>(value);
+		bytes[1] = static_cast<uint8_t>(value >> 8);
+		bytes[2] = static_cast<uint8_t>(value >> 16);
+		bytes[3] = static_cast<uint8_t>(value >> 24);
+	}
+
+	static uint32_t RotateLeft(uint32_t value, unsigned count)
+	{
+		return (value << count) | (value >> (32 - count));
+	}
+
+	static uint32_t RotateRight(uint32_t value, unsigned count)
+	{
+		return (value >> count) | (value << (32 - count));
+	}
+
+	/**
+	<summary>SHA-256 over a complete message.</summary>
+	*/
+	class Sha256
+	{
+	public:
+		Sha256() : _length(0), _bufferLength(0)
+		{
+			static const uint32_t initial[8] =
+			{
+				0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+			};
+
+			memcpy(_state, initial, sizeof(_state));
+		}
+
+		void Update(const uint8_t* data, size_t length)
+		{
+			_length += length;
+
+			while (length > 0)
+			{
+				size_t count = (std::min)(length, sizeof(_buffer) - _bufferLength);
+				memcpy(_buffer + _bufferLength, data, count);
+				_bufferLength += count;
+				data += count;
+				length -= count;
+
+				if (_bufferLength == sizeof(_buffer))
+				{
+					Transform();
+					_bufferLength = 0;
+				}
+			}
+		}
+
+		void Final(uint8_t* hash)
+		{
+			uint64_t bitLength = _length * 8;
+			uint8_t padding[72] = { 0x80 };
+			size_t paddingLength = (_bufferLength < 56 ? 56 : 120) - _bufferLength;
+
+			for (unsigned i = 0; i < 8; i++)
+				padding[paddingLength + i] = static_cast<uint8_t>(bitLength >> (56 - 8 * i));
+
+			Update(padding, paddingLength + 8);
+
+			for (unsigned i = 0; i < 8; i++)
+				for (unsigned j = 0; j < 4; j++)
+					hash[4 * i + j] = static_cast<uint8_t>(_state[i] >> (24 - 8 * j));
+		}
+
+	private:
+		uint32_t _state[8];
+		uint8_t _buffer[64];
+		uint64_t _length;
+		size_t _bufferLength;
+
+		void Transform()
+		{
+			static const uint32_t k[64] =
+			{
+				0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+				0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+				0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+				0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+				0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+				0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+				0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+				0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+			};
+
+			uint32_t w[64];
+			for (unsigned i = 0; i < 16; i++)
+				w[i] = static_cast<uint32_t>(_buffer[4 * i]) << 24 | static_cast<uint32_t>(_buffer[4 * i + 1]) << 16 |
+					static_cast<uint32_t>(_buffer[4 * i + 2]) << 8 | _buffer[4 * i + 3];
+
+			for (unsigned i = 16; i < 64; i++)
+			{
+				uint32_t s0 = RotateRight(w[i - 15], 7) ^ RotateRight(w[i - 15], 18) ^ (w[i - 15] >> 3);
+				uint32_t s1 = RotateRight(w[i - 2], 17) ^ RotateRight(w[i - 2], 19) ^ (w[i - 2] >> 10);
+				w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+			}
+
+			uint32_t a = _state[0], b = _state[1], c = _state[2], d = _state[3];
+			uint32_t e = _state[4], f = _state[5], g = _state[6], h = _state[7];
+
+			for (unsigned i = 0; i < 64; i++)
+			{
+				uint32_t t1 = h + (RotateRight(e, 6) ^ RotateRight(e, 11) ^ RotateRight(e, 25)) + ((e & f) ^ (~e & g)) + k[i] + w[i];
+				uint32_t t2 = (RotateRight(a, 2) ^ RotateRight(a, 13) ^ RotateRight(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+				h = g;
+				g = f;
+				f = e;
+				e = d + t1;
+				d = c;
+				c = b;
+				b = a;
+				a = t1 + t2;
+			}
+
+			_state[0] += a;
+			_state[1] += b;
+			_state[2] += c;
+			_state[3] += d;
+			_state[4] += e;
+			_state[5] += f;
+			_state[6] += g;
+			_state[7] += h;
+		}
+	};
+
+	/**
+	<summary>PBKDF2-HMAC-SHA256 with one iteration, the only count Scrypt uses.</summary>
+	*/
+	static void Pbkdf2Sha256(const uint8_t* password, size_t passwordLength, const uint8_t* salt, size_t saltLength,
+		uint8_t* derivedKey, size_t derivedKeyLength)
+	{
+		uint8_t key[64] = {};
+		if (passwordLength > sizeof(key))
+		{
+			Sha256 hash;
+			hash.Update(password, passwordLength);
+			hash.Final(key);
+		}
+		else if (passwordLength > 0)
+		{
+			memcpy(key, password, passwordLength);
+		}
+
+		uint8_t innerPad[64];
+		uint8_t outerPad[64];
+		for (unsigned i = 0; i < 64; i++)
+		{
+			innerPad[i] = key[i] ^ 0x36;
+			outerPad[i] = key[i] ^ 0x5c;
+		}
+
+		for (uint32_t block = 1; derivedKeyLength > 0; block++)
+		{
+			uint8_t index[4] = { static_cast<uint8_t>(block >> 24), static_cast<uint8_t>(block >> 16), static_cast<uint8_t>(block >> 8),
+				static_cast<uint8_t>(block) };
+			uint8_t inner[32];
+			uint8_t outer[32];
+
+			Sha256 innerHash;
+			innerHash.Update(innerPad, sizeof(innerPad));
+			innerHash.Update(salt, saltLength);
+			innerHash.Update(index, sizeof(index));
+			innerHash.Final(inner);
+
+			Sha256 outerHash;
+			outerHash.Update(outerPad, sizeof(outerPad));
+			outerHash.Update(inner, sizeof(inner));
+			outerHash.Final(outer);
+
+			size_t count = (std::min)(derivedKeyLength, sizeof(outer));
+			memcpy(derivedKey, outer, count);
+			derivedKey += count;
+			derivedKeyLength -= count;
+		}
+	}
+
+	/**
+	<summary>Salsa20/8 applied to a 64-byte block in place.</summary>
+	*/
+	static void Salsa20_8(uint8_t* block)
+	{
+		uint32_t input[16];
+		uint32_t x[16];
+
+		for (unsigned i = 0; i < 16; i++)
+			x[i] = input[i] = Load32(block + 4 * i);
+
+		for (unsigned round = 0; round < 8; round += 2)
+		{
+			x[4] ^= RotateLeft(x[0] + x[12], 7);   x[8] ^= RotateLeft(x[4] + x[0], 9);
+			x[12] ^= RotateLeft(x[8] + x[4], 13);  x[0] ^= RotateLeft(x[12] + x[8], 18);
+			x[9] ^= RotateLeft(x[5] + x[1], 7);    x[13] ^= RotateLeft(x[9] + x[5], 9);
+			x[1] ^= RotateLeft(x[13] + x[9], 13);  x[5] ^= RotateLeft(x[1] + x[13], 18);
+			x[14] ^= RotateLeft(x[10] + x[6], 7);  x[2] ^= RotateLeft(x[14] + x[10], 9);
+			x[6] ^= RotateLeft(x[2] + x[14], 13);  x[10] ^= RotateLeft(x[6] + x[2], 18);
+			x[3] ^= RotateLeft(x[15] + x[11], 7);  x[7] ^= RotateLeft(x[3] + x[15], 9);
+			x[11] ^= RotateLeft(x[7] + x[3], 13);  x[15] ^= RotateLeft(x[11] + x[7], 18);
+			x[1] ^= RotateLeft(x[0] + x[3], 7);    x[2] ^= RotateLeft(x[1] + x[0], 9);
+			x[3] ^= RotateLeft(x[2] + x[1], 13);   x[0] ^= RotateLeft(x[3] + x[2], 18);
+			x[6] ^= RotateLeft(x[5] + x[4], 7);    x[7] ^= RotateLeft(x[6] + x[5], 9);
+			x[4] ^= RotateLeft(x[7] + x[6], 13);   x[5] ^= RotateLeft(x[4] + x[7], 18);
+			x[11] ^= RotateLeft(x[10] + x[9], 7);  x[8] ^= RotateLeft(x[11] + x[10], 9);
+			x[9] ^= RotateLeft(x[8] + x[11], 13);  x[10] ^= RotateLeft(x[9] + x[8], 18);
+			x[12] ^= RotateLeft(x[15] + x[14], 7); x[13] ^= RotateLeft(x[12] + x[15], 9);
+			x[14] ^= RotateLeft(x[13] + x[12], 13); x[15] ^= RotateLeft(x[14] + x[13], 18);
+		}
+
+		for (unsigned i = 0; i < 16; i++)
+			Store32(block + 4 * i, x[i] + input[i]);
+	}
+
+	/**
+	<summary>scryptBlockMix of one 128 * r byte block into <paramref name="output"/>.</summary>
+	*/
+	static void BlockMix(const uint8_t* input, uint8_t* output, unsigned r)
+	{
+		uint8_t x[64];
+		memcpy(x, input + (2 * r - 1) * 64, sizeof(x));
+
+		for (unsigned i = 0; i < 2 * r; i++)
+		{
+			for (unsigned j = 0; j < 64; j++)
+				x[j] ^= input[i * 64 + j];
+
+			Salsa20_8(x);
+
+			// even blocks go to the first half of the output, odd blocks to the second
+			memcpy(output + ((i % 2) * r + i / 2) * 64, x, sizeof(x));
+		}
+	}
+
+	/**
+	<summary>scryptROMix of one 128 * r byte block in place.</summary>
+	*/
+	static void ROMix(uint8_t* block, unsigned r, unsigned N)
+	{
+		const size_t length = 128 * static_cast<size_t>(r);
+		std::vector<uint8_t> v(length * N);
+		std::vector<uint8_t> x(block, block + length);
+		std::vector<uint8_t> y(length);
+
+		for (unsigned i = 0; i < N; i++)
+		{
+			memcpy(&v[length * i], x.data(), length);
+			BlockMix(x.data(), y.data(), r);
+			x.swap(y);
+		}
+
+		for (unsigned i = 0; i < N; i++)
+		{
+			// Integerify: the first 64 bits of the last 64-byte block, little-endian
+			const uint8_t* last = &x[length - 64];
+			uint64_t integer = Load32(last) | static_cast<uint64_t>(Load32(last + 4)) << 32;
+			const uint8_t* element = &v[length * (integer % N)];
+
+			for (size_t j = 0; j < length; j++)
+				x[j] ^= element[j];
+
+			BlockMix(x.data(), y.data(), r);
+			x.swap(y);
+		}
+
+		memcpy(block, x.data(), length);
+	}
+
+	static void Scrypt(const uint8_t* password, size_t passwordLength, const uint8_t* salt, size_t saltLength, unsigned r,
+		unsigned N, unsigned p, uint8_t* derivedKey, size_t derivedKeyLength)
+	{
+		std::vector<uint8_t> b(128 * static_cast<size_t>(r) * p);
+		Pbkdf2Sha256(password, passwordLength, salt, saltLength, b.data(), b.size());
+
+		for (unsigned i = 0; i < p; i++)
+			ROMix(&b[128 * static_cast<size_t>(r) * i], r, N);
+
+		Pbkdf2Sha256(password, passwordLength, b.data(), b.size(), derivedKey, derivedKeyLength);
+	}
+}
+
+// every derived key is this long
+const size_t KeyLength = 32;
+
+/**
+<summary>Checks the reference against the test vectors of RFC 7914.</summary>
+*/
+static bool ReferenceMatchesRfc7914()
+{
+	static const uint8_t empty[64] =
+	{
+		0x77, 0xd6, 0x57, 0x62, 0x38, 0x65, 0x7b, 0x20, 0x3b, 0x19, 0xca, 0x42, 0xc1, 0x8a, 0x04, 0x97,
+		0xf1, 0x6b, 0x48, 0x44, 0xe3, 0x07, 0x4a, 0xe8, 0xdf, 0xdf, 0xfa, 0x3f, 0xed, 0xe2, 0x14, 0x42,
+		0xfc, 0xd0, 0x06, 0x9d, 0xed, 0x09, 0x48, 0xf8, 0x32, 0x6a, 0x75, 0x3a, 0x0f, 0xc8, 0x1f, 0x17,
+		0xe8, 0xd3, 0xe0, 0xfb, 0x2e, 0x0d, 0x36, 0x28, 0xcf, 0x35, 0xe2, 0x0c, 0x38, 0xd1, 0x89, 0x06
+	};
+	static const uint8_t password[64] =
+	{
+		0xfd, 0xba, 0xbe, 0x1c, 0x9d, 0x34, 0x72, 0x00, 0x78, 0x56, 0xe7, 0x19, 0x0d, 0x01, 0xe9, 0xfe,
+		0x7c, 0x6a, 0xd7, 0xcb, 0xc8, 0x23, 0x78, 0x30, 0xe7, 0x73, 0x76, 0x63, 0x4b, 0x37, 0x31, 0x62,
+		0x2e, 0xaf, 0x30, 0xd9, 0x2e, 0x22, 0xa3, 0x88, 0x6f, 0xf1, 0x09, 0x27, 0x9d, 0x98, 0x30, 0xda,
+		0xc7, 0x27, 0xaf, 0xb9, 0x4a, 0x83, 0xee, 0x6d, 0x83, 0x60, 0xcb, 0xdf, 0xa2, 0xcc, 0x06, 0x40
+	};
+
+	uint8_t derivedKey[64];
+
+	Reference::Scrypt(nullptr, 0, nullptr, 0, 1, 16, 1, derivedKey, sizeof(derivedKey));
+	if (memcmp(derivedKey, empty, sizeof(empty)) != 0)
+		return false;
+
+	Reference::Scrypt(reinterpret_cast<const uint8_t*>("password"), 8, reinterpret_cast<const uint8_t*>("NaCl"), 4, 8, 1024, 16,
+		derivedKey, sizeof(derivedKey));
+	return memcmp(derivedKey, password, sizeof(password)) == 0;
+}
+
+/**
+<summary>The memory bandwidth of several threads together over buffers as large as their large memory blocks, in bytes per
+second.</summary>
+*/
+struct Bandwidth
+{
+	/**
+	<summary>Reading every buffer in order, as fast as the hardware prefetchers allow.</summary>
+	*/
+	double sequential;
+
+	/**
+	<summary>Reading element-sized chunks in a random order, each found from the one before, as the second loop of SMix
+	does.</summary>
+	*/
+	double random;
+};
+
+/**
+<summary>Starts a number of threads, runs a function on each once they all exist, and waits for them.</summary>
+*/
+template<class TFunction>
+static void RunTogether(unsigned threadCount, TFunction function)
+{
+	std::atomic<unsigned> ready(0);
+	std::vector<std::thread> threads;
+
+	for (unsigned t = 0; t < threadCount; t++)
+	{
+		threads.emplace_back([&, t]()
+		{
+			ready++;
+			while (ready < threadCount)
+				std::this_thread::yield();
+
+			function(t);
+		});
+	}
+
+	for (std::thread& thread : threads)
+		thread.join();
+}
+
+/**
+<summary>Measures the sequential and random-read bandwidth of every thread over a buffer of its own.</summary>
+<param name="length">The length of each thread's buffer in bytes.</param>
+<param name="chunkLength">The length read at each random position in bytes, a multiple of 8.</param>
+*/
+static Bandwidth MeasureBandwidth(size_t length, size_t chunkLength, unsigned threadCount)
+{
+	// every measurement reads at least this much, so that small buffers are read many times over
+	const unsigned long long MinBytes = 256ull << 20;
+
+	const size_t chunkCount = (std::max)(length / chunkLength, static_cast<size_t>(2));
+	const size_t wordsPerChunk = chunkLength / 8;
+	const unsigned passes = static_cast<unsigned>((MinBytes + chunkCount * chunkLength - 1) / (chunkCount * chunkLength));
+
+	std::vector<double> sequential(threadCount);
+	std::vector<double> random(threadCount);
+	std::atomic<unsigned long long> sink(0);
+
+	RunTogether(threadCount, [&](unsigned t)
+	{
+		std::vector<uint64_t> buffer(chunkCount * wordsPerChunk, 1);
+
+		// the first word of each chunk holds the next chunk in one random cycle through all of them
+		std::vector<uint64_t> order(chunkCount);
+		for (size_t i = 0; i < chunkCount; i++)
+			order[i] = i;
+		std::shuffle(order.begin() + 1, order.end(), std::mt19937_64(t + 1));
+		for (size_t i = 0; i < chunkCount; i++)
+			buffer[order[i] * wordsPerChunk] = order[(i + 1) % chunkCount];
+
+		uint64_t sum = 0;
+		auto start = std::chrono::steady_clock::now();
+
+		for (unsigned pass = 0; pass < passes; pass++)
+			for (uint64_t word : buffer)
+				sum += word;
+
+		std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+		sequential[t] = static_cast<double>(buffer.size()) * 8 * passes / elapsed.count();
+
+		uint64_t chunk = 0;
+		start = std::chrono::steady_clock::now();
+
+		for (unsigned long long step = 0; step < static_cast<unsigned long long>(chunkCount) * passes; step++)
+		{
+			const uint64_t* words = &buffer[chunk * wordsPerChunk];
+			for (size_t i = 1; i < wordsPerChunk; i++)
+				sum += words[i];
+
+			chunk = words[0];
+		}
+
+		elapsed = std::chrono::steady_clock::now() - start;
+		random[t] = static_cast<double>(chunkCount) * chunkLength * passes / elapsed.count();
+
+		sink += sum + chunk;
+	});
+
+	Bandwidth total = { 0, 0 };
+	for (unsigned t = 0; t < threadCount; t++)
+	{
+		total.sequential += sequential[t];
+		total.random += random[t];
+	}
+
+	return total;
+}
+
+/**
+<summary>The throughput and latency of derivations on several threads at once.</summary>
+*/
+struct Throughput
+{
+	double hashesPerSecond;
+	double p50Milliseconds;
+	double p99Milliseconds;
+	bool isCorrect;
+};
+
+/**
+<summary>Derives keys on several threads at once, each calling <see cref="ScryptEngine::DeriveKey"/> in a loop as a service's
+request threads would, and checks the first key each thread derives against the reference.</summary>
+*/
+static Throughput MeasureThroughput(unsigned r, unsigned N, unsigned p, unsigned threadCount, double seconds,
+	const std::vector<uint8_t>& expected)
+{
+	std::vector<std::vector<double>> latencies(threadCount);
+	std::atomic<bool> isCorrect(true);
+	std::chrono::steady_clock::time_point start;
+	std::chrono::steady_clock::time_point deadline;
+	std::atomic<unsigned> warmedUp(0);
+	std::atomic<bool> isStarted(false);
+
+	RunTogether(threadCount, [&](unsigned t)
+	{
+		uint8_t derivedKey[KeyLength];
+
+		// an untimed derivation faults in the thread's scratch memory
+		ScryptEngine::DeriveKey(reinterpret_cast<const uint8_t*>("password"), 8, reinterpret_cast<const uint8_t*>("NaCl"), 4, r, N, p,
+			derivedKey, sizeof(derivedKey));
+		if (memcmp(derivedKey, expected.data(), sizeof(derivedKey)) != 0)
+			isCorrect = false;
+
+		// the last thread to warm up starts the clock for all of them
+		if (++warmedUp == threadCount)
+		{
+			start = std::chrono::steady_clock::now();
+			deadline = start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(seconds));
+			isStarted = true;
+		}
+		while (!isStarted)
+			std::this_thread::yield();
+
+		// every thread finishes at least one timed derivation
+		std::string password = "password" + std::to_string(t);
+		do
+		{
+			auto begin = std::chrono::steady_clock::now();
+			ScryptEngine::DeriveKey(reinterpret_cast<const uint8_t*>(password.data()), password.size(),
+				reinterpret_cast<const uint8_t*>("NaCl"), 4, r, N, p, derivedKey, sizeof(derivedKey));
+			std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - begin;
+			latencies[t].push_back(elapsed.count());
+		} while (std::chrono::steady_clock::now() < deadline);
+	});
+
+	std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+	std::vector<double> all;
+	for (const std::vector<double>& thread : latencies)
+		all.insert(all.end(), thread.begin(), thread.end());
+	std::sort(all.begin(), all.end());
+
+	auto percentile = [&](double fraction) { return all[static_cast<size_t>(fraction * (all.size() - 1) + 0.5)]; };
+
+	return { all.size() / elapsed.count(), percentile(0.5), percentile(0.99), isCorrect };
+}
+
+/**
+<summary>Measures how derivations scale with threads, N, r and p, against the machine's memory bandwidth and a scalar
+reference implementation.</summary>
+<remarks>
+Usage: skryptonite_scaling_benchmark [largest r] [largest log2(N)] [largest p] [seconds per point] [largest thread count]
+
+r and p double from 1, log2(N) steps by 2 from 10, and the thread count doubles from 1 to the number of hardware threads.
+Each thread derives keys in a loop on its own, so hashes/s counts complete derivations of all threads together and the
+latency percentiles are those of single derivations.
+
+The reference column is the scalar RFC 7914 implementation on one thread, which also derives the key every derivation is
+checked against; any mismatch is reported and makes the exit code 1. The bandwidth columns read buffers as large as the
+threads' large memory blocks, in order and in element-sized chunks at random, on as many threads. SMix writes the large
+memory block in order and reads it at random, so its roofline is 1 / (V / sequential + V / random) hashes/s for V bytes
+per derivation, and the last column is the share of it achieved. Below the last-level cache the roofline is that of the
+cache rather than of memory.
+</remarks>
+*/
+int main(int argc, char** argv)
+{
+	unsigned maxR = argc > 1 ? static_cast<unsigned>(strtoul(argv[1], nullptr, 10)) : 8;
+	unsigned maxLogN = argc > 2 ? static_cast<unsigned>(strtoul(argv[2], nullptr, 10)) : 14;
+	unsigned maxP = argc > 3 ? static_cast<unsigned>(strtoul(argv[3], nullptr, 10)) : 2;
+	double seconds = argc > 4 ? strtod(argv[4], nullptr) : 0.5;
+	unsigned maxThreads = argc > 5 ? static_cast<unsigned>(strtoul(argv[5], nullptr, 10)) : std::thread::hardware_concurrency();
+
+	if (maxR == 0 || maxR > 1024 || maxLogN < 10 || maxLogN > 24 || maxP == 0 || maxP > 64 || !(seconds > 0))
+	{
+		printf("usage: %s [largest r <= 1024] [largest log2(N), 10 to 24] [largest p <= 64] [seconds per point] [largest thread count]\n",
+			argv[0]);
+		return 1;
+	}
+
+	maxThreads = (std::max)(maxThreads, 1u);
+
+	if (!ReferenceMatchesRfc7914())
+	{
+		printf("the reference implementation does not match RFC 7914\n");
+		return 1;
+	}
+
+	bool isCorrect = true;
+
+	printf("%4s %8s %3s %7s %12s %9s %9s %12s %8s %9s %9s %9s %8s\n", "r", "N", "p", "threads", "hashes/s", "p50 ms", "p99 ms",
+		"reference/s", "speedup", "seq GB/s", "rand GB/s", "SMix GB/s", "roofline");
+
+	for (unsigned r = 1; r <= maxR; r *= 2)
+	{
+		for (unsigned logN = 10; logN <= maxLogN; logN += 2)
+		{
+			for (unsigned p = 1; p <= maxP; p *= 2)
+			{
+				const unsigned N = 1u << logN;
+				const double largeMemoryBlockLength = 128.0 * r * N;
+
+				// the first run derives the expected key; short derivations are repeated for a steadier rate
+				std::vector<uint8_t> expected(KeyLength);
+				std::chrono::duration<double> referenceTime(0);
+				unsigned referenceRuns = 0;
+				do
+				{
+					auto start = std::chrono::steady_clock::now();
+					Reference::Scrypt(reinterpret_cast<const uint8_t*>("password"), 8, reinterpret_cast<const uint8_t*>("NaCl"), 4, r, N, p,
+						expected.data(), expected.size());
+					referenceTime += std::chrono::steady_clock::now() - start;
+					referenceRuns++;
+				} while (referenceTime.count() < seconds / 4);
+
+				const double referenceRate = referenceRuns / referenceTime.count();
+
+				for (unsigned threadCount = 1; ; threadCount = (std::min)(threadCount * 2, maxThreads))
+				{
+					Throughput throughput = MeasureThroughput(r, N, p, threadCount, seconds, expected);
+					Bandwidth bandwidth = MeasureBandwidth(static_cast<size_t>(largeMemoryBlockLength), 128 * static_cast<size_t>(r),
+						threadCount);
+
+					// every derivation writes and reads p large memory blocks
+					const double bytesPerHash = largeMemoryBlockLength * p;
+					const double roofline = 1 / (bytesPerHash / bandwidth.sequential + bytesPerHash / bandwidth.random);
+
+					printf("%4u %8u %3u %7u %12.1f %9.2f %9.2f %12.1f %8.1f %9.2f %9.2f %9.2f %7.0f%%%s\n", r, N, p, threadCount,
+						throughput.hashesPerSecond, throughput.p50Milliseconds, throughput.p99Milliseconds, referenceRate,
+						throughput.hashesPerSecond / referenceRate, bandwidth.sequential / 1e9, bandwidth.random / 1e9,
+						throughput.hashesPerSecond * 2 * bytesPerHash / 1e9, 100 * throughput.hashesPerSecond / roofline,
+						throughput.isCorrect ? "" : "  MISMATCH");
+					fflush(stdout);
+
+					isCorrect = isCorrect && throughput.isCorrect;
+
+					if (threadCount == maxThreads)
+						break;
+				}
+			}
+		}
+	}
+
+	return isCorrect ? 0 : 1;
+}
@@ -17,13 +17,14 @@
 */
 #include "pch.h"
 #include "ScryptNEON.h"
-#include "..\Skryptonite.Native\ScryptCommon.h"
+#include "../Skryptonite.Native/ScryptCommon.h"
 
 using namespace Skryptonite::Native;
 
-void ScryptNEON::PrepareData(ScryptElementPtr& workingBuffer, SalsaBlock* source)
+template<CachePolicy policy, unsigned fixedBlockCount>
+void ScryptNEON::PrepareCopyAndMixBlocks(SalsaBlock* copyDestination, SalsaBlock* source, SalsaBlock* mixDestination, unsigned blockCount)
 {
-	ScryptCommon::PrepareData<SalsaBlock128x4>(workingBuffer, source, PrepareBlock);
+	ScryptCommon::PrepareCopyAndMixBlocks<SalsaBlock128x4, policy, fixedBlockCount>(copyDestination, source, mixDestination, blockCount, PrepareBlock);
 }
 
 void ScryptNEON::PrepareBlock(SalsaBlock128x4& arrangedBlock, SalsaBlock128x4& block)
@@ -48,9 +49,10 @@ void ScryptNEON::PrepareBlock(SalsaBlock128x4& arrangedBlock, SalsaBlock128x4& b
 	arrangedBlock.row3.n128_u32[3] = block.row1.n128_u32[3];
 }
 
-void ScryptNEON::RestoreData(SalsaBlock* destination, ScryptElementPtr& workingBuffer)
+template<CachePolicy policy, unsigned fixedBlockCount>
+void ScryptNEON::XorMixAndRestoreBlocks(SalsaBlock* destination, ScryptElementPtr& workingBuffer, SalsaBlock* xorSource)
 {
-	ScryptCommon::RestoreData<SalsaBlock128x4>(destination, workingBuffer, RestoreBlock);
+	ScryptCommon::XorMixAndRestoreBlocks<SalsaBlock128x4, policy, fixedBlockCount>(destination, workingBuffer, xorSource, RestoreBlock);
 }
 
 void ScryptNEON::RestoreBlock(SalsaBlock128x4& block, SalsaBlock128x4& arrangedBlock)
@@ -75,14 +77,24 @@ void ScryptNEON::RestoreBlock(SalsaBlock128x4& block, SalsaBlock128x4& arrangedB
 	block.row3.n128_u32[3] = arrangedBlock.row1.n128_u32[3];
 }
 
+template<unsigned fixedBlockCount>
+void ScryptNEON::MixBlocksInto(SalsaBlock* destination, SalsaBlock* source, unsigned blockCount)
+{
+	ScryptCommon::MixBlocksInto<SalsaBlock128x4, fixedBlockCount>(destination, source, blockCount);
+}
+
+template<CachePolicy policy, unsigned fixedBlockCount>
 void ScryptNEON::CopyAndMixBlocks(SalsaBlock* copyDestination, ScryptElementPtr& workingBuffer, ScryptElementPtr& shuffleBuffer)
 {
-	ScryptCommon::MixBlocks<SalsaBlock128x4>(workingBuffer, copyDestination, shuffleBuffer, MixBlocksMode::Copy);
+	ScryptCommon::MixBlocks<SalsaBlock128x4, policy, MixBlocksMode::Copy, fixedBlockCount>(workingBuffer, copyDestination, shuffleBuffer);
 }
 
+template<CachePolicy policy, unsigned fixedBlockCount>
 void ScryptNEON::XorAndMixBlocks(ScryptElementPtr& workingBuffer, SalsaBlock* xorSource, ScryptElementPtr& shuffleBuffer)
 {
-	ScryptCommon::MixBlocks<SalsaBlock128x4>(workingBuffer, xorSource, shuffleBuffer, MixBlocksMode::Xor);
+	ScryptCommon::MixBlocks<SalsaBlock128x4, policy, MixBlocksMode::Xor, fixedBlockCount>(workingBuffer, xorSource, shuffleBuffer);
 }
 
+SKRYPTONITE_INSTANTIATE_BLOCK_KERNELS(ScryptNEON)
+
 
@@ -1,5 +1,6 @@
 ﻿#pragma once
 
+#if defined(_WIN32)
 #include "targetver.h"
 
 #ifndef WIN32_LEAN_AND_MEAN
@@ -7,3 +8,4 @@
 #endif
 
 #include <windows.h>
+#endif
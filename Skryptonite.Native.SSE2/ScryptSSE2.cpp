@@ -17,42 +17,67 @@
 */
 #include "pch.h"
 #include "ScryptSSE2.h"
-#include "..\Skryptonite.Native\ScryptCommon.h"
+#include "../Skryptonite.Native/ScryptCommon.h"
 
 using namespace Skryptonite::Native;
 
-void ScryptSSE2::PrepareData(ScryptElementPtr& workingBuffer, SalsaBlock* source)
+const __m128i Element0Mask = _mm_setr_epi32(-1, 0, 0, 0);
+const __m128i Element1Mask = _mm_setr_epi32(0, -1, 0, 0);
+const __m128i Element2Mask = _mm_setr_epi32(0, 0, -1, 0);
+const __m128i Element3Mask = _mm_setr_epi32(0, 0, 0, -1);
+
+template<CachePolicy policy, unsigned fixedBlockCount>
+void ScryptSSE2::PrepareCopyAndMixBlocks(SalsaBlock* copyDestination, SalsaBlock* source, SalsaBlock* mixDestination, unsigned blockCount)
 {
-	ScryptCommon::PrepareData<SalsaBlock128x4>(workingBuffer, source, PrepareBlock);
+	ScryptCommon::PrepareCopyAndMixBlocks<SalsaBlock128x4, policy, fixedBlockCount>(copyDestination, source, mixDestination, blockCount, PrepareBlock);
 }
 
 void ScryptSSE2::PrepareBlock(SalsaBlock128x4& arrangedBlock, SalsaBlock128x4& block)
 {
-	arrangedBlock.row0 = _mm_setr_epi32(block.row3.m128i_u32[0], block.row0.m128i_u32[1], block.row1.m128i_u32[2], block.row2.m128i_u32[3]);
-	arrangedBlock.row1 = _mm_setr_epi32(block.row0.m128i_u32[0], block.row1.m128i_u32[1], block.row2.m128i_u32[2], block.row3.m128i_u32[3]);
-	arrangedBlock.row2 = _mm_setr_epi32(block.row1.m128i_u32[0], block.row2.m128i_u32[1], block.row3.m128i_u32[2], block.row0.m128i_u32[3]);
-	arrangedBlock.row3 = _mm_setr_epi32(block.row2.m128i_u32[0], block.row3.m128i_u32[1], block.row0.m128i_u32[2], block.row1.m128i_u32[3]);
+	arrangedBlock.row0 = Combine(block.row3, block.row0, block.row1, block.row2);
+	arrangedBlock.row1 = Combine(block.row0, block.row1, block.row2, block.row3);
+	arrangedBlock.row2 = Combine(block.row1, block.row2, block.row3, block.row0);
+	arrangedBlock.row3 = Combine(block.row2, block.row3, block.row0, block.row1);
 }
 
-void ScryptSSE2::RestoreData(SalsaBlock* destination, ScryptElementPtr& workingBuffer)
+template<CachePolicy policy, unsigned fixedBlockCount>
+void ScryptSSE2::XorMixAndRestoreBlocks(SalsaBlock* destination, ScryptElementPtr& workingBuffer, SalsaBlock* xorSource)
 {
-	ScryptCommon::RestoreData<SalsaBlock128x4>(destination, workingBuffer, RestoreBlock);
+	ScryptCommon::XorMixAndRestoreBlocks<SalsaBlock128x4, policy, fixedBlockCount>(destination, workingBuffer, xorSource, RestoreBlock);
 }
 
 void ScryptSSE2::RestoreBlock(SalsaBlock128x4& block, SalsaBlock128x4& arrangedBlock)
 {
-	block.row0 = _mm_setr_epi32(arrangedBlock.row1.m128i_u32[0], arrangedBlock.row0.m128i_u32[1], arrangedBlock.row3.m128i_u32[2], arrangedBlock.row2.m128i_u32[3]);
-	block.row1 = _mm_setr_epi32(arrangedBlock.row2.m128i_u32[0], arrangedBlock.row1.m128i_u32[1], arrangedBlock.row0.m128i_u32[2], arrangedBlock.row3.m128i_u32[3]);
-	block.row2 = _mm_setr_epi32(arrangedBlock.row3.m128i_u32[0], arrangedBlock.row2.m128i_u32[1], arrangedBlock.row1.m128i_u32[2], arrangedBlock.row0.m128i_u32[3]);
-	block.row3 = _mm_setr_epi32(arrangedBlock.row0.m128i_u32[0], arrangedBlock.row3.m128i_u32[1], arrangedBlock.row2.m128i_u32[2], arrangedBlock.row1.m128i_u32[3]);
+	block.row0 = Combine(arrangedBlock.row1, arrangedBlock.row0, arrangedBlock.row3, arrangedBlock.row2);
+	block.row1 = Combine(arrangedBlock.row2, arrangedBlock.row1, arrangedBlock.row0, arrangedBlock.row3);
+	block.row2 = Combine(arrangedBlock.row3, arrangedBlock.row2, arrangedBlock.row1, arrangedBlock.row0);
+	block.row3 = Combine(arrangedBlock.row0, arrangedBlock.row3, arrangedBlock.row2, arrangedBlock.row1);
 }
 
+__m128i ScryptSSE2::Combine(__m128i source0, __m128i source1, __m128i source2, __m128i source3)
+{
+	__m128i result = _mm_and_si128(source0, Element0Mask);
+	result = _mm_or_si128(result, _mm_and_si128(source1, Element1Mask));
+	result = _mm_or_si128(result, _mm_and_si128(source2, Element2Mask));
+	return _mm_or_si128(result, _mm_and_si128(source3, Element3Mask));
+}
+
+template<unsigned fixedBlockCount>
+void ScryptSSE2::MixBlocksInto(SalsaBlock* destination, SalsaBlock* source, unsigned blockCount)
+{
+	ScryptCommon::MixBlocksInto<SalsaBlock128x4, fixedBlockCount>(destination, source, blockCount);
+}
+
+template<CachePolicy policy, unsigned fixedBlockCount>
 void ScryptSSE2::CopyAndMixBlocks(SalsaBlock* copyDestination, ScryptElementPtr& workingBuffer, ScryptElementPtr& shuffleBuffer)
 {
-	ScryptCommon::MixBlocks<SalsaBlock128x4>(workingBuffer, copyDestination, shuffleBuffer, MixBlocksMode::Copy);
+	ScryptCommon::MixBlocks<SalsaBlock128x4, policy, MixBlocksMode::Copy, fixedBlockCount>(workingBuffer, copyDestination, shuffleBuffer);
 }
 
+template<CachePolicy policy, unsigned fixedBlockCount>
 void ScryptSSE2::XorAndMixBlocks(ScryptElementPtr& workingBuffer, SalsaBlock* xorSource, ScryptElementPtr& shuffleBuffer)
 {
-	ScryptCommon::MixBlocks<SalsaBlock128x4>(workingBuffer, xorSource, shuffleBuffer, MixBlocksMode::Xor);
-}
\ No newline at end of file
+	ScryptCommon::MixBlocks<SalsaBlock128x4, policy, MixBlocksMode::Xor, fixedBlockCount>(workingBuffer, xorSource, shuffleBuffer);
+}
+
+SKRYPTONITE_INSTANTIATE_BLOCK_KERNELS(ScryptSSE2)
@@ -17,77 +17,62 @@
 */
 #include "pch.h"
 #include "ScryptSSE41.h"
-#include "..\Skryptonite.Native\ScryptCommon.h"
+#include "../Skryptonite.Native/ScryptCommon.h"
 
 using namespace Skryptonite::Native;
 
-void ScryptSSE41::PrepareData(ScryptElementPtr& workingBuffer, SalsaBlock* source)
+template<CachePolicy policy, unsigned fixedBlockCount>
+void ScryptSSE41::PrepareCopyAndMixBlocks(SalsaBlock* copyDestination, SalsaBlock* source, SalsaBlock* mixDestination, unsigned blockCount)
 {
-	ScryptCommon::PrepareData<SalsaBlock128x4>(workingBuffer, source, PrepareBlock);
+	ScryptCommon::PrepareCopyAndMixBlocks<SalsaBlock128x4, policy, fixedBlockCount>(copyDestination, source, mixDestination, blockCount, PrepareBlock);
 }
 
 void ScryptSSE41::PrepareBlock(SalsaBlock128x4& arrangedBlock, SalsaBlock128x4& block)
 {
-	arrangedBlock.row0 = _mm_setzero_si128();
-	arrangedBlock.row1 = _mm_setzero_si128();
-	arrangedBlock.row2 = _mm_setzero_si128();
-	arrangedBlock.row3 = _mm_setzero_si128();
-
-	arrangedBlock.row0 = _mm_insert_epi32(arrangedBlock.row0, _mm_extract_epi32(block.row3, 0), 0);
-	arrangedBlock.row0 = _mm_insert_epi32(arrangedBlock.row0, _mm_extract_epi32(block.row0, 1), 1);
-	arrangedBlock.row0 = _mm_insert_epi32(arrangedBlock.row0, _mm_extract_epi32(block.row1, 2), 2);
-	arrangedBlock.row0 = _mm_insert_epi32(arrangedBlock.row0, _mm_extract_epi32(block.row2, 3), 3);
-	arrangedBlock.row1 = _mm_insert_epi32(arrangedBlock.row1, _mm_extract_epi32(block.row0, 0), 0);
-	arrangedBlock.row1 = _mm_insert_epi32(arrangedBlock.row1, _mm_extract_epi32(block.row1, 1), 1);
-	arrangedBlock.row1 = _mm_insert_epi32(arrangedBlock.row1, _mm_extract_epi32(block.row2, 2), 2);
-	arrangedBlock.row1 = _mm_insert_epi32(arrangedBlock.row1, _mm_extract_epi32(block.row3, 3), 3);
-	arrangedBlock.row2 = _mm_insert_epi32(arrangedBlock.row2, _mm_extract_epi32(block.row1, 0), 0);
-	arrangedBlock.row2 = _mm_insert_epi32(arrangedBlock.row2, _mm_extract_epi32(block.row2, 1), 1);
-	arrangedBlock.row2 = _mm_insert_epi32(arrangedBlock.row2, _mm_extract_epi32(block.row3, 2), 2);
-	arrangedBlock.row2 = _mm_insert_epi32(arrangedBlock.row2, _mm_extract_epi32(block.row0, 3), 3);
-	arrangedBlock.row3 = _mm_insert_epi32(arrangedBlock.row3, _mm_extract_epi32(block.row2, 0), 0);
-	arrangedBlock.row3 = _mm_insert_epi32(arrangedBlock.row3, _mm_extract_epi32(block.row3, 1), 1);
-	arrangedBlock.row3 = _mm_insert_epi32(arrangedBlock.row3, _mm_extract_epi32(block.row0, 2), 2);
-	arrangedBlock.row3 = _mm_insert_epi32(arrangedBlock.row3, _mm_extract_epi32(block.row1, 3), 3);
+	arrangedBlock.row0 = SelectElements(block.row3, block.row0, block.row1, block.row2);
+	arrangedBlock.row1 = SelectElements(block.row0, block.row1, block.row2, block.row3);
+	arrangedBlock.row2 = SelectElements(block.row1, block.row2, block.row3, block.row0);
+	arrangedBlock.row3 = SelectElements(block.row2, block.row3, block.row0, block.row1);
 }
 
-void ScryptSSE41::RestoreData(SalsaBlock* destination, ScryptElementPtr& workingBuffer)
+template<CachePolicy policy, unsigned fixedBlockCount>
+void ScryptSSE41::XorMixAndRestoreBlocks(SalsaBlock* destination, ScryptElementPtr& workingBuffer, SalsaBlock* xorSource)
 {
-	ScryptCommon::RestoreData<SalsaBlock128x4>(destination, workingBuffer, RestoreBlock);
+	ScryptCommon::XorMixAndRestoreBlocks<SalsaBlock128x4, policy, fixedBlockCount>(destination, workingBuffer, xorSource, RestoreBlock);
 }
 
 void ScryptSSE41::RestoreBlock(SalsaBlock128x4& block, SalsaBlock128x4& arrangedBlock)
 {
-	block.row0 = _mm_setzero_si128();
-	block.row1 = _mm_setzero_si128();
-	block.row2 = _mm_setzero_si128();
-	block.row3 = _mm_setzero_si128();
+	block.row0 = SelectElements(arrangedBlock.row1, arrangedBlock.row0, arrangedBlock.row3, arrangedBlock.row2);
+	block.row1 = SelectElements(arrangedBlock.row2, arrangedBlock.row1, arrangedBlock.row0, arrangedBlock.row3);
+	block.row2 = SelectElements(arrangedBlock.row3, arrangedBlock.row2, arrangedBlock.row1, arrangedBlock.row0);
+	block.row3 = SelectElements(arrangedBlock.row0, arrangedBlock.row3, arrangedBlock.row2, arrangedBlock.row1);
+}
+
+__m128i ScryptSSE41::SelectElements(__m128i from0, __m128i from1, __m128i from2, __m128i from3)
+{
+	// element i of the result comes from element i of fromi; each 32-bit element spans two bits of the 16-bit blend mask
+	__m128i low = _mm_blend_epi16(from0, from1, 0x0c);
+	__m128i high = _mm_blend_epi16(from2, from3, 0xc0);
+	return _mm_blend_epi16(low, high, 0xf0);
+}
 
-	block.row0 = _mm_insert_epi32(block.row0, _mm_extract_epi32(arrangedBlock.row1, 0), 0);
-	block.row0 = _mm_insert_epi32(block.row0, _mm_extract_epi32(arrangedBlock.row0, 1), 1);
-	block.row0 = _mm_insert_epi32(block.row0, _mm_extract_epi32(arrangedBlock.row3, 2), 2);
-	block.row0 = _mm_insert_epi32(block.row0, _mm_extract_epi32(arrangedBlock.row2, 3), 3);
-	block.row1 = _mm_insert_epi32(block.row1, _mm_extract_epi32(arrangedBlock.row2, 0), 0);
-	block.row1 = _mm_insert_epi32(block.row1, _mm_extract_epi32(arrangedBlock.row1, 1), 1);
-	block.row1 = _mm_insert_epi32(block.row1, _mm_extract_epi32(arrangedBlock.row0, 2), 2);
-	block.row1 = _mm_insert_epi32(block.row1, _mm_extract_epi32(arrangedBlock.row3, 3), 3);
-	block.row2 = _mm_insert_epi32(block.row2, _mm_extract_epi32(arrangedBlock.row3, 0), 0);
-	block.row2 = _mm_insert_epi32(block.row2, _mm_extract_epi32(arrangedBlock.row2, 1), 1);
-	block.row2 = _mm_insert_epi32(block.row2, _mm_extract_epi32(arrangedBlock.row1, 2), 2);
-	block.row2 = _mm_insert_epi32(block.row2, _mm_extract_epi32(arrangedBlock.row0, 3), 3);
-	block.row3 = _mm_insert_epi32(block.row3, _mm_extract_epi32(arrangedBlock.row0, 0), 0);
-	block.row3 = _mm_insert_epi32(block.row3, _mm_extract_epi32(arrangedBlock.row3, 1), 1);
-	block.row3 = _mm_insert_epi32(block.row3, _mm_extract_epi32(arrangedBlock.row2, 2), 2);
-	block.row3 = _mm_insert_epi32(block.row3, _mm_extract_epi32(arrangedBlock.row1, 3), 3);
+template<unsigned fixedBlockCount>
+void ScryptSSE41::MixBlocksInto(SalsaBlock* destination, SalsaBlock* source, unsigned blockCount)
+{
+	ScryptCommon::MixBlocksInto<SalsaBlock128x4, fixedBlockCount>(destination, source, blockCount);
 }
 
+template<CachePolicy policy, unsigned fixedBlockCount>
 void ScryptSSE41::CopyAndMixBlocks(SalsaBlock* copyDestination, ScryptElementPtr& workingBuffer, ScryptElementPtr& shuffleBuffer)
 {
-	ScryptCommon::MixBlocks<SalsaBlock128x4>(workingBuffer, copyDestination, shuffleBuffer, MixBlocksMode::Copy);
+	ScryptCommon::MixBlocks<SalsaBlock128x4, policy, MixBlocksMode::Copy, fixedBlockCount>(workingBuffer, copyDestination, shuffleBuffer);
 }
 
+template<CachePolicy policy, unsigned fixedBlockCount>
 void ScryptSSE41::XorAndMixBlocks(ScryptElementPtr& workingBuffer, SalsaBlock* xorSource, ScryptElementPtr& shuffleBuffer)
 {
-	ScryptCommon::MixBlocks<SalsaBlock128x4>(workingBuffer, xorSource, shuffleBuffer, MixBlocksMode::Xor);
+	ScryptCommon::MixBlocks<SalsaBlock128x4, policy, MixBlocksMode::Xor, fixedBlockCount>(workingBuffer, xorSource, shuffleBuffer);
 }
 
+SKRYPTONITE_INSTANTIATE_BLOCK_KERNELS(ScryptSSE41)
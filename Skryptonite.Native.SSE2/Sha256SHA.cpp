@@ -0,0 +1,80 @@
+﻿/**
+* Skryptonite - Scrypt library for UWP
+* Copyright © 2016 Nicholas C. Bauer, Ph.D.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "pch.h"
+#include "Sha256SHA.h"
+#include "../Skryptonite.Native/Sha256.h"
+
+using namespace Skryptonite::Native;
+
+// reverses the bytes of each 32-bit word, since SHA-256 is big-endian
+const __m128i ByteSwapMask = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+
+void Sha256SHA::Transform(unsigned* state, const unsigned char* block)
+{
+	// the rounds instruction expects the state as ABEF and CDGH
+	__m128i dcba = _mm_loadu_si128(reinterpret_cast<const __m128i*>(state));
+	__m128i hgfe = _mm_loadu_si128(reinterpret_cast<const __m128i*>(state + 4));
+	__m128i cdab = _mm_shuffle_epi32(dcba, 0xB1);
+	__m128i efgh = _mm_shuffle_epi32(hgfe, 0x1B);
+	__m128i abef = _mm_alignr_epi8(cdab, efgh, 8);
+	__m128i cdgh = _mm_blend_epi16(efgh, cdab, 0xF0);
+
+	__m128i abefSaved = abef;
+	__m128i cdghSaved = cdgh;
+
+	// each message register holds 4 schedule words; entry i % 4 is overwritten by words 4i through 4i + 3
+	__m128i message[4];
+
+	for (unsigned i = 0; i < 16; i++)
+	{
+		__m128i& current = message[i % 4];
+
+		if (i < 4)
+		{
+			current = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(block + i * 16)), ByteSwapMask);
+		}
+		else
+		{
+			const __m128i& previous1 = message[(i - 1) % 4];
+			const __m128i& previous2 = message[(i - 2) % 4];
+			const __m128i& previous3 = message[(i - 3) % 4];
+
+			current = _mm_sha256msg1_epu32(current, previous3);
+			current = _mm_add_epi32(current, _mm_alignr_epi8(previous1, previous2, 4));
+			current = _mm_sha256msg2_epu32(current, previous1);
+		}
+
+		__m128i words = _mm_add_epi32(current, _mm_loadu_si128(reinterpret_cast<const __m128i*>(Sha256::RoundConstants + i * 4)));
+		cdgh = _mm_sha256rnds2_epu32(cdgh, abef, words);
+		abef = _mm_sha256rnds2_epu32(abef, cdgh, _mm_shuffle_epi32(words, 0x0E));
+	}
+
+	abef = _mm_add_epi32(abef, abefSaved);
+	cdgh = _mm_add_epi32(cdgh, cdghSaved);
+
+	__m128i feba = _mm_shuffle_epi32(abef, 0x1B);
+	__m128i dchg = _mm_shuffle_epi32(cdgh, 0xB1);
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(state), _mm_blend_epi16(feba, dchg, 0xF0));
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(state + 4), _mm_alignr_epi8(dchg, feba, 8));
+}
+
+void Sha256SHA::TransformLanes(unsigned* const* states, const unsigned char* const* blocks, unsigned count)
+{
+	for (unsigned k = 0; k < count; k++)
+		Transform(states[k], blocks[k]);
+}
@@ -0,0 +1,35 @@
+﻿/**
+* Skryptonite - Scrypt library for UWP
+* Copyright © 2016 Nicholas C. Bauer, Ph.D.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#pragma once
+#include "../Skryptonite.Native/Platform.h"
+
+namespace Skryptonite
+{
+	namespace Native
+	{
+		/**
+		<summary>SHA-256 compression using the SHA extensions (SHA-NI). Requires SSE4.1.</summary>
+		*/
+		class Sha256SHA
+		{
+		public:
+			static void Transform(unsigned* state, const unsigned char* block);
+			static void TransformLanes(unsigned* const* states, const unsigned char* const* blocks, unsigned count);
+		};
+	}
+}
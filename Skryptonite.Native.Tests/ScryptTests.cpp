@@ -0,0 +1,1419 @@
+/**
+* Skryptonite - Scrypt library for UWP
+* Copyright © 2016 Nicholas C. Bauer, Ph.D.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "Skryptonite.h"
+#include "Autotuner.h"
+#include "CostModel.h"
+#include "CpuFeatures.h"
+#include "DerivationCache.h"
+#include "DerivationQueue.h"
+#include "MappedScratch.h"
+#include "Pbkdf2Sha256.h"
+#include "ProcessorTopology.h"
+#include "ScryptEngine.h"
+#include "ScratchPool.h"
+#include "MemoryBudget.h"
+#include "Metrics.h"
+#include "SMixState.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <fstream>
+#include <future>
+#include <initializer_list>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace Skryptonite::Native;
+
+static int failures = 0;
+
+#define CHECK(condition) \
+	do { if (!(condition)) { printf("%s(%d): check failed: %s\n", __FILE__, __LINE__, #condition); failures++; } } while (0)
+
+static std::vector<unsigned char> FromString(const char* text)
+{
+	return std::vector<unsigned char>(text, text + strlen(text));
+}
+
+static std::string ToHex(const std::vector<unsigned char>& bytes)
+{
+	static const char digits[] = "0123456789abcdef";
+	std::string hex;
+
+	for (unsigned char b : bytes)
+	{
+		hex += digits[b >> 4];
+		hex += digits[b & 0xf];
+	}
+
+	return hex;
+}
+
+static std::string Scrypt(const char* password, const char* salt, unsigned r, unsigned N, unsigned p)
+{
+	std::vector<unsigned char> passwordBytes = FromString(password);
+	std::vector<unsigned char> saltBytes = FromString(salt);
+	std::vector<unsigned char> derivedKey(64);
+
+	ScryptEngine::DeriveKey(passwordBytes.data(), passwordBytes.size(), saltBytes.data(), saltBytes.size(), r, N, p, derivedKey.data(), derivedKey.size());
+
+	return ToHex(derivedKey);
+}
+
+static void Pbkdf2_Test_Vectors()
+{
+	std::vector<unsigned char> derivedKey(64);
+
+	std::vector<unsigned char> password = FromString("passwd");
+	std::vector<unsigned char> salt = FromString("salt");
+	Pbkdf2Sha256::DeriveKey(password.data(), password.size(), salt.data(), salt.size(), 1, derivedKey.data(), derivedKey.size());
+	CHECK(ToHex(derivedKey) == "55ac046e56e3089fec1691c22544b605f94185216dde0465e68b9d57c20dacbc49ca9cccf179b645991664b39d77ef317c71b845b1e30bd509112041d3a19783");
+
+	password = FromString("Password");
+	salt = FromString("NaCl");
+	Pbkdf2Sha256::DeriveKey(password.data(), password.size(), salt.data(), salt.size(), 80000, derivedKey.data(), derivedKey.size());
+	CHECK(ToHex(derivedKey) == "4ddcd8f60b98be21830cee5ef22701f9641a4418d04c0414aeff08876b34ab56a1d425a1225833549adb841b51c9b3176a272bdebba1d078478f62b397f33c8d");
+}
+
+static std::vector<unsigned char> Pbkdf2(size_t passwordLength, size_t saltLength, unsigned iterations, size_t derivedKeyLength)
+{
+	std::vector<unsigned char> password(passwordLength);
+	std::vector<unsigned char> salt(saltLength);
+	std::vector<unsigned char> derivedKey(derivedKeyLength);
+
+	for (size_t i = 0; i < passwordLength; i++)
+		password[i] = static_cast<unsigned char>(i * 13 + 1);
+	for (size_t i = 0; i < saltLength; i++)
+		salt[i] = static_cast<unsigned char>(i * 5 + 2);
+
+	Pbkdf2Sha256::DeriveKey(password.data(), password.size(), salt.data(), salt.size(), iterations, derivedKey.data(), derivedKey.size());
+
+	return derivedKey;
+}
+
+static void Pbkdf2_Matches_Scalar(InstructionSet instructionSet, bool shaExtensions)
+{
+	// salt and key lengths around the padding and block boundaries, and partial groups of lanes
+	const size_t lengths[] = { 0, 1, 51, 52, 55, 56, 64, 65, 119, 120, 200 };
+	const size_t derivedKeyLengths[] = { 1, 32, 33, 100, 256, 300 };
+
+	for (size_t saltLength : lengths)
+		for (size_t derivedKeyLength : derivedKeyLengths)
+			for (unsigned iterations = 1; iterations <= 3; iterations += 2)
+			{
+				size_t passwordLength = saltLength + derivedKeyLength % 70;
+
+				CpuFeatures::SetMaxInstructionSet(InstructionSet::Unknown);
+				CpuFeatures::SetShaExtensions(false);
+				std::vector<unsigned char> expected = Pbkdf2(passwordLength, saltLength, iterations, derivedKeyLength);
+
+				CpuFeatures::SetMaxInstructionSet(instructionSet);
+				CpuFeatures::SetShaExtensions(shaExtensions);
+				CHECK(Pbkdf2(passwordLength, saltLength, iterations, derivedKeyLength) == expected);
+			}
+}
+
+static void Scrypt_Test_Vectors(InstructionSet instructionSet)
+{
+	CpuFeatures::SetMaxInstructionSet(instructionSet);
+
+	CHECK(Scrypt("", "", 1, 16, 1) == "77d6576238657b203b19ca42c18a0497f16b4844e3074ae8dfdffa3fede21442fcd0069ded0948f8326a753a0fc81f17e8d3e0fb2e0d3628cf35e20c38d18906");
+	CHECK(Scrypt("password", "NaCl", 2, 32, 2) == "b034a96734ebdc650fca132f40ffde0823c2f780d675eb81c85ec337d3b1176017061beeb3ba18df59802b95a325f5f850b6fd9efb1a6314f835057c90702b19");
+	CHECK(Scrypt("password", "NaCl", 8, 1024, 16) == "fdbabe1c9d3472007856e7190d01e9fe7c6ad7cbc8237830e77376634b3731622eaf30d92e22a3886ff109279d9830dac727afb94a83ee6d8360cbdfa2cc0640");
+	CHECK(Scrypt("pleaseletmein", "SodiumChloride", 8, 16384, 1) == "7023bdcb3afd7348461c06cd81fd38ebfda8fbba904f8e3ea9b543f6545da1f2d5432955613f0fcf62d49705242a9af9e61e85dc0d651e40dfcf017b45575887");
+}
+
+static void Scrypt_Matches_Scalar_For_Every_Element_Length(InstructionSet instructionSet)
+{
+	// r = 1, 2, 4, 8 and 16 have specialized kernels; the others take the kernels for any length
+	for (unsigned r : { 1u, 2u, 3u, 4u, 5u, 8u, 16u, 17u })
+	{
+		CpuFeatures::SetMaxInstructionSet(InstructionSet::Unknown);
+		std::string expected = Scrypt("password", "salt", r, 16, 2);
+
+		CpuFeatures::SetMaxInstructionSet(instructionSet);
+		CHECK(Scrypt("password", "salt", r, 16, 2) == expected);
+	}
+}
+
+static void ScryptEngine_SMixLanes_Matches_SMix()
+{
+	std::vector<unsigned char> bytes(256 * 5);
+	for (size_t i = 0; i < bytes.size(); i++)
+		bytes[i] = static_cast<unsigned char>(i * 7 + 3);
+
+	std::vector<unsigned char> sequentialData = bytes;
+	ScryptEngine sequential(sequentialData.data(), sequentialData.size(), 5, 64);
+	for (unsigned i = 0; i < 5; i++)
+		sequential.SMix(i);
+
+	// a full group of lanes or chains followed by a remainder
+	std::vector<unsigned char> rangeData = bytes;
+	ScryptEngine range(rangeData.data(), rangeData.size(), 5, 64);
+	range.SMixRange(0, 5);
+	CHECK(rangeData == sequentialData);
+
+	std::vector<unsigned char> allData = bytes;
+	ScryptEngine all(allData.data(), allData.size(), 5, 64);
+	all.SMixAll(0);
+	CHECK(allData == sequentialData);
+
+	// two callers mixing at once share the workers
+	std::vector<unsigned char> concurrentData[2] = { bytes, bytes };
+	std::thread other([&]() { ScryptEngine(concurrentData[1].data(), concurrentData[1].size(), 5, 64).SMixAll(0); });
+	ScryptEngine(concurrentData[0].data(), concurrentData[0].size(), 5, 64).SMixAll(0);
+	other.join();
+	CHECK(concurrentData[0] == sequentialData && concurrentData[1] == sequentialData);
+
+	std::vector<unsigned char> data1 = bytes;
+	std::vector<unsigned char> data2 = bytes;
+	ScryptEngine engine1(data1.data(), data1.size(), 5, 64);
+	ScryptEngine engine2(data2.data(), data2.size(), 5, 64);
+
+	ScryptEngine* engines[] = { &engine1, &engine2, &engine1, &engine2, &engine1, &engine2, &engine1, &engine2, &engine1, &engine2 };
+	unsigned indices[] = { 0, 0, 1, 1, 2, 2, 3, 3, 4, 4 };
+
+	// as many lanes at once as the instruction set allows
+	for (unsigned i = 0; i < 10; i += engine1.LaneCount() > 1 ? 2 : 1)
+		ScryptEngine::SMixLanes(engines + i, indices + i, engine1.LaneCount() > 1 ? 2 : 1);
+
+	CHECK(data1 == sequentialData);
+	CHECK(data2 == sequentialData);
+}
+
+static void SMixState_Matches_SMix()
+{
+	std::vector<unsigned char> bytes(256 * 3);
+	for (size_t i = 0; i < bytes.size(); i++)
+		bytes[i] = static_cast<unsigned char>(i * 5 + 1);
+
+	std::vector<unsigned char> expected = bytes;
+	ScryptEngine reference(expected.data(), expected.size(), 3, 64);
+	reference.SMixRange(0, 3);
+
+	// bounded steps, with the progress reported after each slice
+	std::vector<unsigned char> data = bytes;
+	ScryptEngine engine(data.data(), data.size(), 3, 64);
+	SMixState stepped(engine, 0);
+	unsigned long long lastSteps = 0;
+
+	CHECK(stepped.TotalSteps() == 128);
+	while (!stepped.Advance(7))
+	{
+		CHECK(stepped.CompletedSteps() == lastSteps + 7);
+		lastSteps = stepped.CompletedSteps();
+	}
+
+	CHECK(stepped.IsCompleted() && !stepped.IsCancelled());
+	CHECK(stepped.CompletedSteps() == stepped.TotalSteps());
+	CHECK(stepped.Advance(1));
+
+	// time budgets, including one too short for more than the first steps
+	SMixState timed(engine, 1);
+	CHECK(!timed.AdvanceFor(std::chrono::steady_clock::duration::zero()));
+	while (!timed.AdvanceFor(std::chrono::microseconds(20)));
+	CHECK(timed.IsCompleted());
+
+	// a cancelled SMix leaves its element untouched
+	SMixState cancelled(engine, 2);
+	CHECK(!cancelled.Advance(100));
+	cancelled.Cancel();
+	CHECK(cancelled.Advance(1));
+	CHECK(cancelled.IsCancelled() && !cancelled.IsCompleted());
+	CHECK(cancelled.CompletedSteps() == 100);
+	CHECK(std::equal(data.begin() + 512, data.end(), bytes.begin() + 512));
+	CHECK(std::equal(data.begin(), data.begin() + 512, expected.begin()));
+
+	bool threw = false;
+	try
+	{
+		stepped.Advance(0);
+	}
+	catch (const std::invalid_argument&)
+	{
+		threw = true;
+	}
+	CHECK(threw);
+}
+
+static void ScryptEngine_SMix_With_Scratch_Matches_SMix()
+{
+	std::vector<unsigned char> bytes(256 * 3);
+	for (size_t i = 0; i < bytes.size(); i++)
+		bytes[i] = static_cast<unsigned char>(i * 7 + 3);
+
+	std::vector<unsigned char> expected = bytes;
+	ScryptEngine reference(expected.data(), expected.size(), 3, 64);
+	reference.SMixRange(0, 3);
+
+	std::vector<unsigned char> data = bytes;
+	ScryptEngine engine(data.data(), data.size(), 3, 64);
+	ScratchRequirements requirements = engine.ElementScratchRequirements();
+
+	CHECK(requirements.bufferLength == 256);
+	CHECK(requirements.bufferCount == (engine.TradeOffFactor() > 1 ? 4u : 2u));
+	CHECK(requirements.largeMemoryBlockLength == 256 * ((64 + engine.TradeOffFactor() - 1) / engine.TradeOffFactor()));
+	CHECK(requirements.totalLength == requirements.largeMemoryBlockLength + requirements.bufferCount * requirements.bufferLength);
+
+	// one misaligned region for every element in turn, which the library neither reserves nor allocates
+	std::vector<unsigned char> region(requirements.totalLength + requirements.alignment);
+	ScryptScratch scratch = ScryptEngine::PartitionScratch(region.data() + 1, region.size() - 1, requirements);
+	CHECK(reinterpret_cast<uintptr_t>(scratch.largeMemoryBlock) % requirements.alignment == 0);
+
+	unsigned long long admissions = MemoryBudget::Global().Statistics().admissions;
+	for (unsigned i = 0; i < 3; i++)
+		engine.SMix(i, scratch);
+
+	CHECK(MemoryBudget::Global().Statistics().admissions == admissions);
+	CHECK(data == expected);
+
+	bool threw = false;
+	try { ScryptEngine::PartitionScratch(region.data() + 1, requirements.totalLength, requirements); }
+	catch (const std::invalid_argument&) { threw = true; }
+	CHECK(threw);
+
+	ScryptScratch misaligned = scratch;
+	misaligned.workingBuffer = static_cast<unsigned char*>(scratch.workingBuffer) + 8;
+	threw = false;
+	try { engine.SMix(0, misaligned); } catch (const std::invalid_argument&) { threw = true; }
+	CHECK(threw);
+
+	// the portable API divides the region the same way
+	skryptonite_scratch_requirements portable;
+	CHECK(skryptonite_smix_scratch_requirements(2, 64, &portable) == SKRYPTONITE_OK);
+	CHECK(portable.totalBytes == requirements.totalLength);
+
+	skryptonite_scratch portableScratch;
+	CHECK(skryptonite_scratch_partition(region.data(), region.size(), &portable, &portableScratch) == SKRYPTONITE_OK);
+
+	data = bytes;
+	CHECK(skryptonite_smix_with_scratch(data.data(), data.size(), 3, 64, 2, &portableScratch) == SKRYPTONITE_OK);
+	CHECK(std::equal(data.begin() + 512, data.end(), expected.begin() + 512));
+	CHECK(skryptonite_smix_with_scratch(data.data(), data.size(), 3, 64, 3, &portableScratch) == SKRYPTONITE_INVALID_ARGUMENT);
+}
+
+static void ScryptEngine_Out_Of_Core_Matches_In_Memory()
+{
+	if (!MappedScratch::IsSupported())
+		return;
+
+	// r = 40 makes elements longer than a page, so each read is also prefetched
+	for (unsigned r : { 2u, 40u })
+	{
+		for (unsigned tradeOffFactor : { 1u, 3u })
+		{
+			std::vector<unsigned char> data(128 * r * 3);
+			for (size_t i = 0; i < data.size(); i++)
+				data[i] = static_cast<unsigned char>(i * 7 + r);
+
+			std::vector<unsigned char> expected = data;
+			ScryptEngine inMemory(expected.data(), expected.size(), 3, 1000);
+			inMemory.SetTradeOffFactor(tradeOffFactor);
+			inMemory.SMixAll(0);
+
+			ScryptEngine outOfCore(data.data(), data.size(), 3, 1000);
+			outOfCore.SetTradeOffFactor(tradeOffFactor);
+			outOfCore.SetStorageDirectory(".");
+			CHECK(outOfCore.LaneCount() == 1);
+
+			MemoryBudget::Global().ResetStatistics();
+			outOfCore.SMixAll(0);
+
+			CHECK(data == expected);
+			CHECK(MemoryBudget::Global().Statistics().admissions == 0);
+		}
+	}
+
+	// whole derivations follow the default, including through the portable API
+	unsigned char expected[64];
+	unsigned char derivedKey[64];
+	CHECK(skryptonite_scrypt(reinterpret_cast<const uint8_t*>("password"), 8, reinterpret_cast<const uint8_t*>("NaCl"), 4, 8, 1024, 2,
+		expected, sizeof(expected)) == SKRYPTONITE_OK);
+	CHECK(skryptonite_set_storage_directory(".") == SKRYPTONITE_OK);
+	CHECK(skryptonite_scrypt(reinterpret_cast<const uint8_t*>("password"), 8, reinterpret_cast<const uint8_t*>("NaCl"), 4, 8, 1024, 2,
+		derivedKey, sizeof(derivedKey)) == SKRYPTONITE_OK);
+	CHECK(std::equal(derivedKey, derivedKey + sizeof(derivedKey), expected));
+
+	CHECK(skryptonite_set_storage_directory("./does-not-exist") == SKRYPTONITE_OK);
+	CHECK(skryptonite_scrypt(reinterpret_cast<const uint8_t*>("password"), 8, reinterpret_cast<const uint8_t*>("NaCl"), 4, 8, 1024, 2,
+		derivedKey, sizeof(derivedKey)) == SKRYPTONITE_ERROR);
+	CHECK(skryptonite_set_storage_directory(nullptr) == SKRYPTONITE_OK);
+	CHECK(ScryptEngine::DefaultStorageDirectory().empty());
+}
+
+static void DerivationCache_Serves_Repeated_Derivations()
+{
+	DerivationCache cache(2, 64, std::chrono::milliseconds(60000));
+
+	std::vector<unsigned char> password = FromString("password");
+	std::vector<unsigned char> salt = FromString("NaCl");
+	std::vector<unsigned char> otherSalt = FromString("KCl");
+
+	std::vector<unsigned char> expected(32);
+	ScryptEngine::DeriveKey(password.data(), password.size(), salt.data(), salt.size(), 1, 16, 1, expected.data(), expected.size());
+
+	std::vector<unsigned char> derivedKey(32);
+	CHECK(!cache.TryGet(password.data(), password.size(), salt.data(), salt.size(), 1, 16, 1, derivedKey.data(), derivedKey.size()));
+	cache.DeriveKey(password.data(), password.size(), salt.data(), salt.size(), 1, 16, 1, derivedKey.data(), derivedKey.size());
+	CHECK(derivedKey == expected);
+
+	std::fill(derivedKey.begin(), derivedKey.end(), 0);
+	CHECK(cache.TryGet(password.data(), password.size(), salt.data(), salt.size(), 1, 16, 1, derivedKey.data(), derivedKey.size()));
+	CHECK(derivedKey == expected);
+
+	// any difference in the inputs, including the key length, is a different entry
+	CHECK(!cache.TryGet(password.data(), password.size(), otherSalt.data(), otherSalt.size(), 1, 16, 1, derivedKey.data(), 32));
+	CHECK(!cache.TryGet(password.data(), password.size(), salt.data(), salt.size(), 1, 16, 1, derivedKey.data(), 31));
+
+	DerivationCacheStatistics statistics = cache.Statistics();
+	CHECK(statistics.entries == 1);
+	CHECK(statistics.maxEntries == 2);
+	CHECK(statistics.hits == 1);
+	CHECK(statistics.misses == 4);
+
+	// the least recently used entry makes room, not the oldest
+	const unsigned char other[32] = {};
+	cache.Put(password.data(), password.size(), otherSalt.data(), otherSalt.size(), 1, 16, 1, other, sizeof(other));
+	CHECK(cache.TryGet(password.data(), password.size(), salt.data(), salt.size(), 1, 16, 1, derivedKey.data(), derivedKey.size()));
+	cache.Put(password.data(), password.size(), salt.data(), salt.size(), 1, 16, 2, other, sizeof(other));
+	CHECK(cache.TryGet(password.data(), password.size(), salt.data(), salt.size(), 1, 16, 1, derivedKey.data(), derivedKey.size()));
+	CHECK(!cache.TryGet(password.data(), password.size(), otherSalt.data(), otherSalt.size(), 1, 16, 1, derivedKey.data(), 32));
+	CHECK(cache.Statistics().evictions == 1);
+
+	std::vector<unsigned char> longKey(65);
+	cache.Put(password.data(), password.size(), salt.data(), salt.size(), 1, 16, 1, longKey.data(), longKey.size());
+	CHECK(cache.Statistics().bypasses == 1);
+	CHECK(!cache.TryGet(password.data(), password.size(), salt.data(), salt.size(), 1, 16, 1, longKey.data(), longKey.size()));
+
+	cache.Clear();
+	CHECK(cache.Statistics().entries == 0);
+	CHECK(!cache.TryGet(password.data(), password.size(), salt.data(), salt.size(), 1, 16, 1, derivedKey.data(), derivedKey.size()));
+
+	// entries expire however often they are used
+	cache.Configure(2, 64, std::chrono::milliseconds(30));
+	CHECK(cache.Statistics().hits == 3);
+	cache.DeriveKey(password.data(), password.size(), salt.data(), salt.size(), 1, 16, 1, derivedKey.data(), derivedKey.size());
+	std::this_thread::sleep_for(std::chrono::milliseconds(60));
+	CHECK(!cache.TryGet(password.data(), password.size(), salt.data(), salt.size(), 1, 16, 1, derivedKey.data(), derivedKey.size()));
+	CHECK(cache.Statistics().expirations == 1);
+	CHECK(cache.Statistics().entries == 0);
+
+	bool threw = false;
+	try { cache.Configure(2, 0, std::chrono::milliseconds(30)); } catch (const std::invalid_argument&) { threw = true; }
+	CHECK(threw);
+
+	// invalid derivations fail before the lookup
+	threw = false;
+	try
+	{
+		cache.DeriveKey(password.data(), password.size(), salt.data(), salt.size(), 1, 0, 1, derivedKey.data(), derivedKey.size());
+	}
+	catch (const std::invalid_argument&)
+	{
+		threw = true;
+	}
+	CHECK(threw);
+
+	cache.Configure(0, 0, std::chrono::milliseconds(0));
+	CHECK(!cache.IsEnabled());
+	cache.DeriveKey(password.data(), password.size(), salt.data(), salt.size(), 1, 16, 1, derivedKey.data(), derivedKey.size());
+	CHECK(derivedKey == expected);
+	CHECK(cache.Statistics().entries == 0);
+
+	// the portable API consults the process-wide cache once it is enabled
+	skryptonite_derivation_cache_statistics portable;
+	CHECK(skryptonite_derivation_cache_configure(4, 0, 60000) == SKRYPTONITE_OK);
+	CHECK(skryptonite_scrypt(password.data(), password.size(), salt.data(), salt.size(), 1, 16, 1, derivedKey.data(),
+		derivedKey.size()) == SKRYPTONITE_OK);
+	CHECK(skryptonite_scrypt(password.data(), password.size(), salt.data(), salt.size(), 1, 16, 1, derivedKey.data(),
+		derivedKey.size()) == SKRYPTONITE_OK);
+	CHECK(derivedKey == expected);
+	CHECK(skryptonite_derivation_cache_summary(&portable) == SKRYPTONITE_OK);
+	CHECK(portable.hits == 1);
+	CHECK(portable.misses == 1);
+	CHECK(portable.entries == 1);
+	CHECK(portable.maxEntries == 4);
+	CHECK(skryptonite_derivation_cache_summary(nullptr) == SKRYPTONITE_INVALID_ARGUMENT);
+	CHECK(skryptonite_derivation_cache_configure(4, 64, 0) == SKRYPTONITE_INVALID_ARGUMENT);
+	CHECK(skryptonite_derivation_cache_configure(0, 0, 0) == SKRYPTONITE_OK);
+	CHECK(!DerivationCache::Global().IsEnabled());
+}
+
+static void ScryptEngine_Resolves_Automatic_Cache_Policy()
+{
+	size_t detectedCacheSize = CpuFeatures::LastLevelCacheSize();
+	bool detectedClflushOpt = CpuFeatures::ClflushOpt();
+	std::vector<unsigned char> data(128);
+
+	// 16 elements of 128 bytes per lane or chain
+	ScryptEngine engine(data.data(), data.size(), 1, 16);
+	unsigned long long scryptBlockLength = 128ull * 16 * engine.LaneCount();
+
+	CpuFeatures::SetClflushOpt(true);
+	CpuFeatures::SetLastLevelCacheSize(static_cast<size_t>(scryptBlockLength * 2));
+	engine.SetCachePolicy(CachePolicy::Automatic);
+	CHECK(engine.ActiveCachePolicy() == CachePolicy::Cached);
+
+	CpuFeatures::SetLastLevelCacheSize(static_cast<size_t>(scryptBlockLength * 2 - 1));
+	engine.SetCachePolicy(CachePolicy::Automatic);
+	CHECK(engine.ActiveCachePolicy() == CachePolicy::StreamAndFlushOptimized);
+
+	// an unknown cache size never caches
+	CpuFeatures::SetLastLevelCacheSize(0);
+	engine.SetCachePolicy(CachePolicy::Automatic);
+	CHECK(engine.ActiveCachePolicy() == CachePolicy::StreamAndFlushOptimized);
+
+	CpuFeatures::SetClflushOpt(false);
+	engine.SetCachePolicy(CachePolicy::Automatic);
+	CHECK(engine.ActiveCachePolicy() == CachePolicy::StreamAndFlush);
+	engine.SetCachePolicy(CachePolicy::StreamAndFlushOptimized);
+	CHECK(engine.RequestedCachePolicy() == CachePolicy::StreamAndFlushOptimized);
+	CHECK(engine.ActiveCachePolicy() == CachePolicy::StreamAndFlush);
+
+	engine.SetCachePolicy(CachePolicy::Cached);
+	CHECK(engine.ActiveCachePolicy() == CachePolicy::Cached);
+
+	CpuFeatures::SetLastLevelCacheSize(detectedCacheSize);
+	CpuFeatures::SetClflushOpt(detectedClflushOpt);
+}
+
+static void ScryptEngine_Chooses_Trade_Off_Factor_For_Memory()
+{
+	std::vector<unsigned char> data(128);
+	ScryptEngine engine(data.data(), data.size(), 1, 16);
+
+	CHECK(engine.TradeOffFactor() == ScryptEngine::DefaultTradeOffFactor());
+	engine.SetTradeOffFactor(5);
+	CHECK(engine.TradeOffFactor() == 5);
+
+	CHECK(ScryptEngine::TradeOffFactorForMemory(1, 16, 128 * 16) == 1);
+	CHECK(ScryptEngine::TradeOffFactorForMemory(1, 16, 128 * 16 - 1) == 2);
+	CHECK(ScryptEngine::TradeOffFactorForMemory(1, 16, 128 * 5) == 4);
+	CHECK(ScryptEngine::TradeOffFactorForMemory(8, 1024, 1024 * 100) == 11);
+	CHECK(ScryptEngine::TradeOffFactorForMemory(1, 16, 128) == 16);
+	CHECK(ScryptEngine::TradeOffFactorForMemory(1, 0xffffffffu, 128) == 0xffffffffu);
+	CHECK(ScryptEngine::TradeOffFactorForMemory(1, 16, ~0ull) == 1);
+}
+
+static void Autotuner_Chooses_Fastest_Verified_Backend()
+{
+	Autotuner::Reset();
+
+	AutotuneResult result = Autotuner::Calibrate(1, 16, 8);
+	CHECK(result.calibrationCost == 16 && result.usesLanes);
+	CHECK(!result.measurements.empty() && result.measurements[0].instructionSet == InstructionSet::Unknown);
+	CHECK(result.measurements.back().instructionSet == CpuFeatures::SupportedInstructionSet() ||
+		(result.measurements.back().instructionSet == InstructionSet::SSE2 && CpuFeatures::SupportedInstructionSet() == InstructionSet::SSSE3));
+
+	// p = 1 times a single SMix and is kept apart from the lane path
+	AutotuneResult single = Autotuner::Calibrate(1, 16, 1);
+	CHECK(!single.usesLanes && single.measurements.size() == result.measurements.size());
+
+	for (const AutotuneResult* calibration : { &result, &single })
+	{
+		for (const BackendMeasurement& measurement : calibration->measurements)
+		{
+			CHECK(measurement.isVerified);
+			CHECK(measurement.nanosecondsPerElement > 0);
+			if (measurement.instructionSet == calibration->instructionSet)
+				CHECK(std::all_of(calibration->measurements.begin(), calibration->measurements.end(),
+					[&](const BackendMeasurement& other) { return other.nanosecondsPerElement >= measurement.nanosecondsPerElement; }));
+		}
+	}
+
+	// the choice is kept, applies only to the calibrated parameters, and never exceeds the active instruction set
+	AutotuneResult again;
+	CHECK(Autotuner::TryGetResult(1, 16, 3, again) && again.usesLanes && again.instructionSet == result.instructionSet);
+	CHECK(Autotuner::TryGetResult(1, 16, 1, again) && !again.usesLanes && again.instructionSet == single.instructionSet);
+	CHECK(Autotuner::Calibrate(1, 16, 8).measurements[0].nanosecondsPerElement == result.measurements[0].nanosecondsPerElement);
+	CHECK(Autotuner::Calibrate(1, 16, 1).measurements[0].nanosecondsPerElement == single.measurements[0].nanosecondsPerElement);
+	CHECK(!Autotuner::TryGetResult(1, 32, 8, again));
+	CHECK(Autotuner::InstructionSetFor(1, 16, 8) == result.instructionSet);
+	CHECK(Autotuner::InstructionSetFor(1, 16, 1) == single.instructionSet);
+	CHECK(Autotuner::InstructionSetFor(1, 32, 8) == CpuFeatures::MaxInstructionSet());
+
+	std::vector<unsigned char> bytes(128 * 8);
+	CHECK(ScryptEngine(bytes.data(), 128, 1, 16).ActiveInstructionSet() == single.instructionSet);
+	CHECK(ScryptEngine(bytes.data(), bytes.size(), 8, 16).ActiveInstructionSet() == result.instructionSet);
+	CHECK(Scrypt("", "", 1, 16, 1) == "77d6576238657b203b19ca42c18a0497f16b4844e3074ae8dfdffa3fede21442fcd0069ded0948f8326a753a0fc81f17e8d3e0fb2e0d3628cf35e20c38d18906");
+
+	InstructionSet detected = CpuFeatures::MaxInstructionSet();
+	CpuFeatures::SetMaxInstructionSet(InstructionSet::Unknown);
+	CHECK(Autotuner::InstructionSetFor(1, 16, 8) == InstructionSet::Unknown);
+	CpuFeatures::SetMaxInstructionSet(detected);
+
+	// a large memory block beyond the limit is timed with a smaller processing cost
+	AutotuneResult capped = Autotuner::Calibrate(1024, 256, 1);
+	CHECK(capped.processingCost == 256 && capped.calibrationCost == 128);
+
+	uint32_t instructionSet = 0xffffffff;
+	double nanoseconds = 0;
+	CHECK(skryptonite_autotune(1, 16, 8, &instructionSet) == SKRYPTONITE_OK && instructionSet == static_cast<uint32_t>(result.instructionSet));
+	CHECK(skryptonite_autotune_measurement(1, 16, 8, instructionSet, &nanoseconds) == SKRYPTONITE_OK && nanoseconds > 0);
+	CHECK(skryptonite_autotune_measurement(1, 32, 8, instructionSet, &nanoseconds) == SKRYPTONITE_INVALID_ARGUMENT);
+	CHECK(skryptonite_autotune_measurement(1, 16, 8, 1000, &nanoseconds) == SKRYPTONITE_INVALID_ARGUMENT);
+	CHECK(skryptonite_autotune_measurement(1, 16, 8, instructionSet, nullptr) == SKRYPTONITE_INVALID_ARGUMENT);
+	CHECK(skryptonite_autotune(0, 16, 8, nullptr) == SKRYPTONITE_INVALID_ARGUMENT);
+	CHECK(skryptonite_autotune(1, 16, 0, nullptr) == SKRYPTONITE_INVALID_ARGUMENT);
+	CHECK(std::string(skryptonite_instruction_set_name(0)) == "Scalar");
+
+	// calibrating p = 1 alone leaves the lane path on the default
+	skryptonite_autotune_reset();
+	CHECK(!Autotuner::TryGetResult(1, 16, 8, again));
+	Autotuner::Calibrate(1, 16, 1);
+	CHECK(!Autotuner::TryGetResult(1, 16, 8, again));
+	CHECK(Autotuner::InstructionSetFor(1, 16, 8) == CpuFeatures::MaxInstructionSet());
+
+	Autotuner::Reset();
+	CHECK(Autotuner::InstructionSetFor(1, 16, 1) == CpuFeatures::MaxInstructionSet());
+}
+
+static void ScryptEngine_DeriveKeys_Matches_DeriveKey(unsigned parallelization, unsigned threadCount,
+	CachePolicy cachePolicy = CachePolicy::Automatic, unsigned tradeOffFactor = 1)
+{
+	const unsigned RequestCount = 11;
+
+	std::vector<std::vector<unsigned char>> passwords(RequestCount);
+	std::vector<std::vector<unsigned char>> salts(RequestCount);
+	std::vector<std::vector<unsigned char>> derivedKeys(RequestCount);
+	std::vector<ScryptRequest> requests(RequestCount);
+
+	for (unsigned i = 0; i < RequestCount; i++)
+	{
+		passwords[i] = FromString(("password" + std::to_string(i)).c_str());
+		salts[i] = FromString(std::string(i, 's').c_str());
+		derivedKeys[i].resize(16 + i);
+		requests[i] = { passwords[i].data(), passwords[i].size(), salts[i].data(), salts[i].size(), derivedKeys[i].data(), derivedKeys[i].size() };
+	}
+
+	ScryptEngine::DeriveKeys(requests.data(), RequestCount, 2, 64, parallelization, threadCount, cachePolicy, tradeOffFactor);
+
+	for (unsigned i = 0; i < RequestCount; i++)
+	{
+		std::vector<unsigned char> expected(derivedKeys[i].size());
+		ScryptEngine::DeriveKey(passwords[i].data(), passwords[i].size(), salts[i].data(), salts[i].size(), 2, 64, parallelization,
+			expected.data(), expected.size());
+
+		CHECK(derivedKeys[i] == expected);
+	}
+}
+
+static void ThreadPool_Runs_Every_Index_Once()
+{
+	ThreadPool pool(4);
+	CHECK(pool.ThreadCount() == 4);
+
+	// more threads than indices, fewer threads than the pool has, and all of them
+	for (size_t count : { 3, 1000 })
+	{
+		for (unsigned threadCount : { 2, 0 })
+		{
+			std::vector<unsigned char> runs(count);
+			pool.Run(count, threadCount, [&](size_t i) { runs[i]++; });
+			CHECK(std::count(runs.begin(), runs.end(), 1) == static_cast<std::ptrdiff_t>(count));
+		}
+	}
+
+	// a loop started from inside a loop runs inline rather than waiting for the workers it is running on
+	std::vector<unsigned char> nestedRuns(8 * 3);
+	pool.Run(8, 0, [&](size_t i) { pool.Run(3, 0, [&](size_t j) { nestedRuns[i * 3 + j]++; }); });
+	CHECK(std::count(nestedRuns.begin(), nestedRuns.end(), 1) == 8 * 3);
+
+	// a loop started while another caller's loop has some of the workers runs on the caller and the free workers
+	std::promise<void> release;
+	std::shared_future<void> released = release.get_future().share();
+	std::atomic<bool> isHeld(false);
+	std::thread holder([&]() { pool.Run(2, 2, [&](size_t) { isHeld = true; released.wait(); }); });
+	while (!isHeld)
+		std::this_thread::yield();
+
+	std::vector<unsigned char> concurrentRuns(16);
+	pool.Run(concurrentRuns.size(), 0, [&](size_t i) { concurrentRuns[i]++; });
+	CHECK(std::count(concurrentRuns.begin(), concurrentRuns.end(), 1) == 16);
+	release.set_value();
+	holder.join();
+
+	// and the workers of the first loop join the second once theirs is done, so both run in parallel; the waits time out
+	// rather than hang when they do not
+	std::mutex parallelMutex;
+	std::condition_variable parallelChanged;
+	bool isSecondStarted = false;
+	unsigned runningInSecond = 0;
+	unsigned mostRunningInSecond = 0;
+	std::atomic<bool> isFirstRunning(false);
+
+	std::thread first([&]()
+	{
+		pool.Run(pool.ThreadCount(), 0, [&](size_t)
+		{
+			isFirstRunning = true;
+			std::unique_lock<std::mutex> lock(parallelMutex);
+			parallelChanged.wait_for(lock, std::chrono::seconds(10), [&]() { return isSecondStarted; });
+		});
+	});
+	while (!isFirstRunning)
+		std::this_thread::yield();
+
+	pool.Run(2 * pool.ThreadCount(), 0, [&](size_t)
+	{
+		std::unique_lock<std::mutex> lock(parallelMutex);
+		isSecondStarted = true;
+		mostRunningInSecond = (std::max)(mostRunningInSecond, ++runningInSecond);
+		parallelChanged.notify_all();
+		parallelChanged.wait_for(lock, std::chrono::seconds(10), [&]() { return mostRunningInSecond >= 2; });
+		runningInSecond--;
+	});
+	first.join();
+	CHECK(mostRunningInSecond >= 2);
+
+	bool threw = false;
+	try
+	{
+		pool.Run(100, 0, [](size_t i) { if (i == 37) throw std::runtime_error("index 37"); });
+	}
+	catch (const std::runtime_error&)
+	{
+		threw = true;
+	}
+	CHECK(threw);
+
+	// the workers stay usable after an exception, and bound or unbound
+	for (bool pin : { true, false })
+	{
+		for (bool numa : { true, false })
+		{
+			pool.SetPinThreads(pin);
+			pool.SetNumaPlacement(numa);
+			std::vector<unsigned char> runs(64);
+			pool.Run(runs.size(), 0, [&](size_t i) { runs[i]++; });
+			CHECK(std::count(runs.begin(), runs.end(), 1) == 64);
+		}
+	}
+
+	for (unsigned w = 0; w + 1 < pool.ThreadCount(); w++)
+		CHECK(pool.WorkerNode(w) < 1024);
+
+	pool.TrimScratch();
+}
+
+static void ProcessorTopology_Spreads_Threads()
+{
+	CHECK(ProcessorTopology::NodeCount() >= 1);
+
+	std::vector<unsigned> order = ProcessorTopology::ProcessorOrder();
+	CHECK(order.size() == ProcessorTopology::Processors().size());
+	std::sort(order.begin(), order.end());
+	CHECK(std::adjacent_find(order.begin(), order.end()) == order.end());
+
+	// two nodes of two cores with two hardware threads each, numbered the way Linux numbers them
+	std::vector<ProcessorInfo> processors =
+	{
+		{ 0, 0, 0 }, { 1, 0, 0 }, { 2, 0, 1 }, { 3, 0, 1 },
+		{ 4, 1, 0 }, { 5, 1, 0 }, { 6, 1, 1 }, { 7, 1, 1 }
+	};
+	CHECK((ProcessorTopology::OrderProcessors(processors) == std::vector<unsigned>{ 0, 2, 1, 3, 4, 6, 5, 7 }));
+
+	// a node with more cores than the other takes the remaining turns
+	processors = { { 0, 0, 0 }, { 1, 0, 0 }, { 2, 0, 0 }, { 3, 0, 1 } };
+	CHECK((ProcessorTopology::OrderProcessors(processors) == std::vector<unsigned>{ 0, 3, 1, 2 }));
+
+	// memory placed on a node stays usable whether or not the operating system honours the placement
+	ScratchPool pool;
+	pool.SetNode(0);
+	size_t length = ScratchPool::LargePageLength;
+	unsigned char* memory = static_cast<unsigned char*>(pool.Acquire(length));
+	memset(memory, 0x3c, length);
+	pool.Release(memory, length);
+	CHECK(pool.RetainedBytes() == length);
+
+	// buffers kept for another node are not handed out again
+	pool.SetNode(-1);
+	CHECK(pool.RetainedBytes() == 0);
+}
+
+static void MemoryBudget_Queues_Reservations()
+{
+	MemoryBudget budget;
+	budget.SetLimit(100);
+
+	budget.Reserve(60);
+	CHECK(!budget.TryReserve(50));
+
+	// a reservation that does not fit waits until enough is released
+	std::thread waiter([&]() { budget.Reserve(50); });
+	while (budget.Statistics().queueDepth == 0)
+		std::this_thread::yield();
+
+	CHECK(!budget.TryReserve(1));
+	budget.Release(60);
+	waiter.join();
+
+	MemoryBudgetStatistics statistics = budget.Statistics();
+	CHECK(statistics.reservedBytes == 50);
+	CHECK(statistics.peakReservedBytes == 60);
+	CHECK(statistics.admissions == 2);
+	CHECK(statistics.waits == 1);
+	CHECK(statistics.peakQueueDepth == 1);
+	CHECK(statistics.queueDepth == 0);
+	CHECK(statistics.totalWaitNanoseconds > 0);
+
+	// more than the whole limit, and longer than the longest wait
+	bool threw = false;
+	try { budget.Reserve(101); } catch (const std::bad_alloc&) { threw = true; }
+	CHECK(threw);
+
+	budget.SetMaxWait(std::chrono::milliseconds(10));
+	threw = false;
+	try { budget.Reserve(60); } catch (const std::bad_alloc&) { threw = true; }
+	CHECK(threw);
+	CHECK(budget.Statistics().rejections == 2);
+	CHECK(budget.Statistics().reservedBytes == 50);
+
+	budget.Release(50);
+	budget.ResetStatistics();
+	CHECK(budget.Statistics().admissions == 0);
+
+	// memory kept outside the reservations is trimmed to the room they leave
+	std::vector<unsigned long long> rooms;
+	MemoryBudget reclaiming([&](unsigned long long room) { rooms.push_back(room); });
+	reclaiming.Reserve(10);
+	CHECK(rooms.empty());
+	reclaiming.SetLimit(100);
+	CHECK(reclaiming.TryReserve(30));
+	reclaiming.Release(10);
+	CHECK((rooms == std::vector<unsigned long long>{ 90, 60, 70 }));
+	reclaiming.Release(30);
+
+	// the engines reserve the large memory block of every element they mix
+	std::vector<unsigned char> data(256 * 2);
+	ScryptEngine engine(data.data(), data.size(), 2, 64);
+	unsigned long long elementLength = 128ull * 2 * 64;
+
+	MemoryBudget::Global().ResetStatistics();
+	MemoryBudget::Global().SetLimit(elementLength * engine.LaneCount());
+	engine.SMixAll(0);
+	CHECK(MemoryBudget::Global().Statistics().admissions >= 1);
+	CHECK(MemoryBudget::Global().Statistics().peakReservedBytes <= elementLength * engine.LaneCount());
+	CHECK(MemoryBudget::Global().Statistics().reservedBytes == 0);
+
+	// the scratch memory kept once the elements are done counts against the limit
+	CHECK(ScratchPool::Global().SharedRetainedBytes() <= elementLength * engine.LaneCount());
+
+	// a paused SMix holds its reservation, so another one that does not fit fails rather than waiting
+	MemoryBudget::Global().SetLimit(elementLength);
+	CHECK(ScratchPool::Global().SharedRetainedBytes() <= elementLength);
+	{
+		SMixState first(engine, 0);
+		CHECK(ScratchPool::Global().SharedRetainedBytes() + MemoryBudget::Global().Statistics().reservedBytes <= elementLength);
+		threw = false;
+		try { SMixState second(engine, 1); } catch (const std::bad_alloc&) { threw = true; }
+		CHECK(threw);
+	}
+	CHECK(MemoryBudget::Global().Statistics().reservedBytes == 0);
+
+	MemoryBudget::Global().SetLimit(elementLength - 1);
+	threw = false;
+	try { engine.SMix(0); } catch (const std::bad_alloc&) { threw = true; }
+	CHECK(threw);
+
+	MemoryBudget::Global().SetLimit(0);
+}
+
+static void MemoryBudget_Splits_Groups_Above_The_Limit()
+{
+	std::vector<unsigned char> probe(128 * 2);
+	ScryptEngine probeEngine(probe.data(), probe.size(), 1, 1024);
+	const unsigned p = 2 * probeEngine.LaneCount() + 1;
+	const unsigned long long elementLength = 128ull * 1024;
+
+	std::string password = "password";
+	std::string salt = "NaCl";
+	std::vector<unsigned char> expected(64);
+	ScryptEngine::DeriveKey(reinterpret_cast<const unsigned char*>(password.data()), password.size(),
+		reinterpret_cast<const unsigned char*>(salt.data()), salt.size(), 1, 1024, p, expected.data(), expected.size());
+
+	// a limit below one group of lanes or interleaved chains makes the groups smaller instead of refusing them
+	for (unsigned tradeOffFactor : { 1u, 2u })
+	{
+		ScryptEngine::SetDefaultTradeOffFactor(tradeOffFactor);
+		ScryptEngine::SetInterleaveCount(tradeOffFactor == 1 ? 1 : 4);
+		unsigned long long reservedLength = tradeOffFactor == 1 ? elementLength : elementLength / 2;
+
+		for (unsigned long long limit : { reservedLength, 2 * reservedLength + 1 })
+		{
+			MemoryBudget::Global().SetLimit(limit);
+			MemoryBudget::Global().ResetStatistics();
+
+			std::vector<unsigned char> derivedKey(64);
+			ScryptEngine::DeriveKey(reinterpret_cast<const unsigned char*>(password.data()), password.size(),
+				reinterpret_cast<const unsigned char*>(salt.data()), salt.size(), 1, 1024, p, derivedKey.data(), derivedKey.size());
+			CHECK(derivedKey == expected);
+
+			std::vector<unsigned char> derivedKeys(2 * 64);
+			ScryptRequest requests[2];
+			for (unsigned i = 0; i < 2; i++)
+			{
+				requests[i] = { reinterpret_cast<const unsigned char*>(password.data()), password.size(),
+					reinterpret_cast<const unsigned char*>(salt.data()), salt.size(), &derivedKeys[64 * i], 64 };
+			}
+
+			ScryptEngine::DeriveKeys(requests, 2, 1, 1024, p, 0);
+			CHECK(std::equal(expected.begin(), expected.end(), derivedKeys.begin()));
+			CHECK(std::equal(expected.begin(), expected.end(), derivedKeys.begin() + 64));
+
+			MemoryBudgetStatistics statistics = MemoryBudget::Global().Statistics();
+			CHECK(statistics.rejections == 0);
+			CHECK(statistics.peakReservedBytes <= limit);
+		}
+	}
+
+	ScryptEngine::SetDefaultTradeOffFactor(1);
+	ScryptEngine::SetInterleaveCount(1);
+	MemoryBudget::Global().SetLimit(0);
+}
+
+static void CostModel_Predicts_From_Profile()
+{
+	HardwareProfile profile;
+	profile.processorName = "Test Processor";
+	profile.instructionSet = InstructionSet::Unknown;
+	profile.laneCount = 8;
+	profile.salsaBlocksPerSecond = 1e7;
+	profile.bands =
+	{
+		{ 256 * 1024, 2, 6, 1e10, 10 },
+		{ 16 * 1024 * 1024, 4, 12, 5e9, 90 }
+	};
+
+	// 4 * r * N block steps of one element on its own, below the smallest band
+	CostPrediction single = CostModel::Predict(profile, 8, 16, 1, 1);
+	CHECK(single.nanoseconds == 4 * 8 * 16 * 6);
+	CHECK(single.bytes == 128 * 8 * 16 + 128 * 8);
+
+	// 2 MiB is halfway between the bands in the logarithm of the footprint
+	CHECK(CostModel::Predict(profile, 8, 2048, 1, 1).nanoseconds == 4 * 8 * 2048 * 9.0);
+
+	CHECK(CostModel::Predict(profile, 8, 1024, 1, 1).nanoseconds > CostModel::Predict(profile, 8, 512, 1, 1).nanoseconds);
+	CHECK(CostModel::Predict(profile, 8, 1024, 17, 1).nanoseconds > CostModel::Predict(profile, 8, 1024, 16, 1).nanoseconds);
+
+	// two groups of lanes take as long on two threads as one group on one, and twice that on one thread
+	CostPrediction groups = CostModel::Predict(profile, 8, 1024, 16, 2);
+	CHECK(groups.nanoseconds == CostModel::Predict(profile, 8, 1024, 8, 1).nanoseconds);
+	CHECK(CostModel::Predict(profile, 8, 1024, 16, 1).nanoseconds == 2 * groups.nanoseconds);
+	CHECK(groups.bytes == 16 * 128ull * 8 * 1024 + 128 * 8 * 16);
+
+	// elements mixed one at a time take turns on the threads, however many there are
+	HardwareProfile oneLane = profile;
+	oneLane.laneCount = 1;
+	CHECK(CostModel::Predict(oneLane, 8, 16, 1u << 30, 3).nanoseconds == 357913942.0 * single.nanoseconds);
+
+	OptimalParameters parameters = CostModel::Optimal(profile, 16 * 1024 * 1024, 100, 4, 8);
+	CHECK(parameters.elementLengthMultiplier == 8);
+	CHECK(parameters.processingCost >= 16 && parameters.processingCost <= 16 * 1024);
+	CHECK((parameters.processingCost & (parameters.processingCost - 1)) == 0);
+	CHECK(parameters.parallelization >= 1);
+	CHECK(parameters.threadCount == (std::min)(4u, parameters.parallelization));
+	CHECK(CostModel::Predict(profile, 8, parameters.processingCost, 1, 1).bytes <= 16 * 1024 * 1024);
+
+	// a limit below the smallest element is refused rather than exceeded
+	CHECK(CostModel::Optimal(profile, 128 * 8 * 16 + 128 * 8, 100, 4, 8).processingCost == 16);
+	bool isRefused = false;
+	try { CostModel::Optimal(profile, 128 * 8 * 16 + 128 * 8 - 1, 100, 4, 8); } catch (const std::bad_alloc&) { isRefused = true; }
+	CHECK(isRefused);
+
+	bool threw = false;
+	try { CostModel::Predict(profile, 8, 0, 1, 1); } catch (const std::invalid_argument&) { threw = true; }
+	CHECK(threw);
+
+	// a profile file keeps the profiles of other processors next to this one's
+	const char* path = "skryptonite_cost_model_test.profile";
+	remove(path);
+	CostModel::SetProfile(profile);
+	CostModel::Save(path);
+	CHECK(!CostModel::Load(path));
+
+	HardwareProfile measured = CostModel::Calibrate(256 * 1024);
+	CHECK(!measured.processorName.empty());
+	CHECK(measured.laneCount >= 1);
+	CHECK(measured.bands.size() == 1);
+	CHECK(measured.salsaBlocksPerSecond > 0);
+	CHECK(measured.bands[0].laneNanosecondsPerBlock > 0 && measured.bands[0].nanosecondsPerBlock > 0);
+	CHECK(CostModel::Matches(measured));
+	CostModel::Save(path);
+
+	CostModel::Reset();
+	HardwareProfile loaded;
+	CHECK(!CostModel::TryGetProfile(loaded));
+	CHECK(CostModel::Load(path));
+	CHECK(CostModel::TryGetProfile(loaded));
+	CHECK(loaded.processorName == measured.processorName);
+	CHECK(loaded.bands.size() == 1 && loaded.bands[0].nanosecondsPerBlock == measured.bands[0].nanosecondsPerBlock);
+	CHECK(CostModel::Predict(8, 1024, 4, 2).nanoseconds == CostModel::Predict(measured, 8, 1024, 4, 2).nanoseconds);
+
+	std::ifstream file(path);
+	std::string text((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+	file.close();
+	CHECK(text.find("profile Test Processor\n") != std::string::npos);
+	CHECK(text.find("profile " + measured.processorName + "\n") != std::string::npos);
+
+	skryptonite_hardware_profile summary;
+	CHECK(skryptonite_cost_model_profile(&summary) == SKRYPTONITE_OK);
+	CHECK(summary.bandCount == 1);
+	skryptonite_cost_band band;
+	CHECK(skryptonite_cost_model_band(1, &band) == SKRYPTONITE_INVALID_ARGUMENT);
+	double nanoseconds = 0;
+	CHECK(skryptonite_cost_model_predict(8, 1024, 1, 1, &nanoseconds, nullptr) == SKRYPTONITE_OK && nanoseconds > 0);
+	CHECK(skryptonite_cost_model_predict(8, 1024, 0, 1, &nanoseconds, nullptr) == SKRYPTONITE_INVALID_ARGUMENT);
+
+	CostModel::Reset();
+	remove(path);
+}
+
+static void DerivationQueue_Runs_Submissions()
+{
+	DerivationQueue queue(2, 8);
+
+	std::vector<unsigned char> password = FromString("password");
+	std::vector<unsigned char> salt = FromString("NaCl");
+	DerivationRequest request = { password.data(), password.size(), salt.data(), salt.size(), 2, 64, 3, 32 };
+
+	std::vector<unsigned char> expected(32);
+	ScryptEngine::DeriveKey(password.data(), password.size(), salt.data(), salt.size(), 2, 64, 3, expected.data(), expected.size());
+
+	// the password is copied before the submission returns
+	unsigned long long ticket = 0;
+	std::future<DerivationResult> future = queue.SubmitFuture(request, &ticket);
+	password[0] ^= 1;
+
+	DerivationResult result = future.get();
+	CHECK(ticket != 0);
+	CHECK(result.ticket == ticket);
+	CHECK(result.status == DerivationStatus::Completed);
+	CHECK(result.derivedKey == expected);
+	password[0] ^= 1;
+
+	// a callback that does not return holds the dispatcher, so later submissions stay queued
+	std::promise<void> release;
+	std::shared_future<void> released = release.get_future().share();
+	std::atomic<bool> isHeld(false);
+	queue.Submit(request, [&](DerivationResult&) { isHeld = true; released.wait(); });
+	while (!isHeld)
+		std::this_thread::yield();
+
+	std::mutex resultsMutex;
+	std::vector<DerivationResult> results;
+	auto collect = [&](DerivationResult& finished)
+	{
+		std::lock_guard<std::mutex> lock(resultsMutex);
+		results.push_back(std::move(finished));
+	};
+
+	unsigned long long cancelled = queue.TrySubmit(request, collect);
+	unsigned long long first = queue.TrySubmit(request, collect);
+	CHECK(queue.TrySubmit(request, collect) == 0);
+
+	CHECK(queue.Cancel(cancelled));
+	CHECK(!queue.Cancel(cancelled));
+	CHECK(results.size() == 1);
+	CHECK(results[0].ticket == cancelled);
+	CHECK(results[0].status == DerivationStatus::Cancelled);
+	CHECK(results[0].derivedKey.empty());
+
+	unsigned long long second = queue.TrySubmit(request, collect);
+	CHECK(second != 0);
+
+	release.set_value();
+	queue.WaitIdle();
+
+	// both waited while the dispatcher was held, so they ran as one batch
+	CHECK(results.size() == 3);
+	for (size_t i = 1; i < results.size(); i++)
+	{
+		CHECK(results[i].ticket == first || results[i].ticket == second);
+		CHECK(results[i].status == DerivationStatus::Completed);
+		CHECK(results[i].derivedKey == expected);
+	}
+
+	DerivationQueueStatistics statistics = queue.Statistics();
+	CHECK(statistics.submitted == 5);
+	CHECK(statistics.rejected == 1);
+	CHECK(statistics.completed == 4);
+	CHECK(statistics.cancelled == 1);
+	CHECK(statistics.failed == 0);
+	CHECK(statistics.batches == 3);
+	CHECK(statistics.peakQueueDepth == 2);
+	CHECK(statistics.queueDepth == 0);
+
+	// an invalid derivation is refused when it is submitted rather than reported when it runs
+	DerivationRequest invalid = request;
+	invalid.processingCost = 0;
+	bool threw = false;
+	try { queue.TrySubmit(invalid, collect); } catch (const std::invalid_argument&) { threw = true; }
+	CHECK(threw);
+
+	// the portable API reports through a completion called on the dispatcher of the global queue
+	struct Completion
+	{
+		skryptonite_status status;
+		std::vector<unsigned char> derivedKey;
+	} completion = { SKRYPTONITE_ERROR, {} };
+
+	skryptonite_completion onCompleted = [](void* context, uint64_t, skryptonite_status status, const uint8_t* derivedKey,
+		size_t derivedKeyLength)
+	{
+		Completion* completion = static_cast<Completion*>(context);
+		completion->status = status;
+		completion->derivedKey.assign(derivedKey, derivedKey + derivedKeyLength);
+	};
+
+	uint64_t apiTicket = 0;
+	CHECK(skryptonite_scrypt_submit(password.data(), password.size(), salt.data(), salt.size(), 2, 64, 3, 32, onCompleted, &completion,
+		&apiTicket) == SKRYPTONITE_OK);
+	skryptonite_queue_wait_idle();
+
+	CHECK(apiTicket != 0);
+	CHECK(completion.status == SKRYPTONITE_OK);
+	CHECK(completion.derivedKey == expected);
+	CHECK(skryptonite_scrypt_cancel(apiTicket) == 0);
+	CHECK(skryptonite_scrypt_submit(password.data(), password.size(), salt.data(), salt.size(), 2, 64, 3, 32, nullptr, nullptr,
+		nullptr) == SKRYPTONITE_INVALID_ARGUMENT);
+	CHECK(skryptonite_queue_set_max_depth(0) == SKRYPTONITE_INVALID_ARGUMENT);
+
+	skryptonite_queue_statistics apiStatistics;
+	CHECK(skryptonite_queue_summary(&apiStatistics) == SKRYPTONITE_OK);
+	CHECK(apiStatistics.completed >= 1);
+	CHECK(apiStatistics.queueDepth == 0);
+}
+
+static void ScratchPool_Reuses_Released_Memory()
+{
+	ScratchPool pool;
+	size_t largeLength = ScratchPool::LargePageLength + 128;
+
+	unsigned char* small = static_cast<unsigned char*>(pool.Acquire(128));
+	unsigned char* large = static_cast<unsigned char*>(pool.Acquire(largeLength));
+	CHECK(reinterpret_cast<size_t>(small) % 64 == 0);
+	CHECK(reinterpret_cast<size_t>(large) % 64 == 0);
+
+	memset(large, 0xa5, largeLength);
+	pool.Release(large, largeLength);
+	pool.Release(small, 128);
+	CHECK(pool.RetainedBytes() == largeLength + 128);
+
+	// released memory is erased and handed back for the same length only
+	CHECK(pool.Acquire(largeLength) == large);
+	CHECK(large[0] == 0 && large[largeLength - 1] == 0);
+	CHECK(pool.RetainedBytes() == 128);
+
+	// a limit too small for a buffer frees it instead of keeping it
+	pool.SetMaxRetainedBytes(largeLength - 1);
+	pool.Release(large, largeLength);
+	CHECK(pool.RetainedBytes() == 128);
+
+	pool.Trim();
+	CHECK(pool.RetainedBytes() == 0);
+
+	// a pool sharing the limit of another keeps buffers only while both fit under it together
+	pool.SetMaxRetainedBytes(256);
+	{
+		ScratchPool sharer(pool);
+		CHECK(sharer.MaxRetainedBytes() == 256);
+
+		pool.Release(pool.Acquire(128), 128);
+		sharer.Release(sharer.Acquire(128), 128);
+		CHECK(pool.SharedRetainedBytes() == 256 && sharer.RetainedBytes() == 128);
+
+		// each pool makes room from its own buffers only, and frees a buffer that would not fit even then
+		sharer.Release(sharer.Acquire(64), 64);
+		CHECK(pool.SharedRetainedBytes() == 192 && sharer.RetainedBytes() == 64);
+		pool.Release(pool.Acquire(256), 256);
+		CHECK(pool.SharedRetainedBytes() == 192 && pool.RetainedBytes() == 128);
+
+		// lowering the limit trims every pool sharing it
+		pool.SetMaxRetainedBytes(32);
+		CHECK(pool.SharedRetainedBytes() == 0 && sharer.RetainedBytes() == 0);
+
+		sharer.SetMaxRetainedBytes(128);
+		sharer.Release(sharer.Acquire(128), 128);
+	}
+	CHECK(pool.MaxRetainedBytes() == 128 && pool.SharedRetainedBytes() == 0);
+}
+
+static void Metrics_Records_Phases()
+{
+	CHECK(HistogramSnapshot::BucketIndex(15) == 15);
+	CHECK(HistogramSnapshot::BucketIndex(32) == 32 && HistogramSnapshot::BucketIndex(33) == 32 && HistogramSnapshot::BucketIndex(34) == 33);
+	CHECK(HistogramSnapshot::BucketUpperBound(32) == 33);
+	CHECK(HistogramSnapshot::BucketIndex(~0ull) == HistogramSnapshot::BucketCount - 1);
+	CHECK(HistogramSnapshot::BucketUpperBound(HistogramSnapshot::BucketCount - 1) == ~0ull);
+
+	for (unsigned long long value : { 0ull, 17ull, 1000ull, 123456789ull, 1ull << 40 })
+	{
+		unsigned index = HistogramSnapshot::BucketIndex(value);
+		CHECK(HistogramSnapshot::BucketUpperBound(index) >= value);
+		CHECK(HistogramSnapshot::BucketUpperBound(index) - value <= value / 16);
+		CHECK(index == 0 || HistogramSnapshot::BucketUpperBound(index - 1) < value);
+	}
+
+	HistogramSnapshot histogram = { 4, 106, 1, 100, std::vector<unsigned long long>(HistogramSnapshot::BucketCount) };
+	for (unsigned long long value : { 1ull, 2ull, 3ull, 100ull })
+		histogram.buckets[HistogramSnapshot::BucketIndex(value)]++;
+
+	CHECK(histogram.ValueAtPercentile(0) == 1);
+	CHECK(histogram.ValueAtPercentile(50) == 2);
+	CHECK(histogram.ValueAtPercentile(100) == 100);
+
+	if (!Metrics::IsCompiledIn())
+	{
+		CHECK(!Metrics::IsEnabled());
+		CHECK(Metrics::Snapshot().phases[static_cast<size_t>(MetricsPhase::FillScryptBlock)].wallTime.count == 0);
+		CHECK(skryptonite_metrics_available() == 0);
+		return;
+	}
+
+	Metrics::Reset();
+	Scrypt("password", "NaCl", 2, 32, 2);
+
+	MetricsSnapshot snapshot = Metrics::Snapshot();
+	auto phase = [&](MetricsPhase p) -> const PhaseSnapshot& { return snapshot.phases[static_cast<size_t>(p)]; };
+	auto counter = [&](MetricsCounter c) { return snapshot.counters[static_cast<size_t>(c)]; };
+
+	CHECK(phase(MetricsPhase::Pbkdf2Expand).wallTime.count == 1);
+	CHECK(phase(MetricsPhase::Pbkdf2Compress).wallTime.count == 1);
+	CHECK(phase(MetricsPhase::Pbkdf2Compress).cpuTime.count == 1);
+	CHECK(phase(MetricsPhase::FillScryptBlock).wallTime.count >= 1);
+	CHECK(phase(MetricsPhase::FillScryptBlock).bytes == 256ull * 32 * 2);
+	CHECK(phase(MetricsPhase::MixWithScryptBlock).bytes == 256ull * 32 * 2);
+	CHECK(phase(MetricsPhase::ScratchAcquire).wallTime.count == counter(MetricsCounter::ScratchAllocations) + counter(MetricsCounter::ScratchReuses));
+	CHECK(phase(MetricsPhase::ScratchAcquire).cpuTime.count == 0);
+	CHECK(phase(MetricsPhase::ScratchRelease).wallTime.count == phase(MetricsPhase::ScratchAcquire).wallTime.count);
+	CHECK(counter(MetricsCounter::DerivationFailures) == 0);
+	CHECK(phase(MetricsPhase::MixWithScryptBlock).hardwareSamples == 0);
+
+	// the hardware counters are read around the long phases only, and only where the processor exposes them
+	Metrics::Reset();
+	skryptonite_metrics_set_hardware_counters_enabled(1);
+	Scrypt("password", "NaCl", 2, 32, 2);
+	skryptonite_metrics_set_hardware_counters_enabled(0);
+
+	snapshot = Metrics::Snapshot();
+	const bool hasCounters = HardwareCounters::AvailableEvents() != 0;
+	CHECK(skryptonite_hardware_events_available() == HardwareCounters::AvailableEvents());
+	CHECK(phase(MetricsPhase::FillScryptBlock).hardwareSamples == (hasCounters ? phase(MetricsPhase::FillScryptBlock).wallTime.count : 0));
+	CHECK(phase(MetricsPhase::MixWithScryptBlock).hardwareSamples == (hasCounters ? phase(MetricsPhase::MixWithScryptBlock).wallTime.count : 0));
+	CHECK(phase(MetricsPhase::ScratchAcquire).hardwareSamples == 0);
+	if (HardwareCounters::AvailableEvents() & (1u << static_cast<unsigned>(HardwareEvent::Instructions)))
+		CHECK(phase(MetricsPhase::MixWithScryptBlock).hardwareEvents[static_cast<size_t>(HardwareEvent::Instructions)] > 0);
+
+	skryptonite_phase_hardware_events events;
+	CHECK(skryptonite_metrics_phase_hardware_events(SKRYPTONITE_PHASE_FILL, &events) == SKRYPTONITE_OK);
+	CHECK(events.samples == phase(MetricsPhase::FillScryptBlock).hardwareSamples);
+	CHECK(skryptonite_metrics_phase_hardware_events(SKRYPTONITE_PHASE_SCRATCH_RELEASE + 1, &events) == SKRYPTONITE_INVALID_ARGUMENT);
+	CHECK(skryptonite_metrics_phase_hardware_events(SKRYPTONITE_PHASE_FILL, nullptr) == SKRYPTONITE_INVALID_ARGUMENT);
+
+	skryptonite_phase_metrics metrics;
+	uint64_t value = 0;
+	CHECK(skryptonite_metrics_available() == 1);
+	CHECK(skryptonite_metrics_phase_summary(SKRYPTONITE_PHASE_PBKDF2_EXPAND, &metrics) == SKRYPTONITE_OK && metrics.wallTime.count == 1);
+	CHECK(metrics.wallTime.min <= metrics.wallTime.p50 && metrics.wallTime.p50 <= metrics.wallTime.max);
+	CHECK(skryptonite_metrics_phase_summary(SKRYPTONITE_PHASE_SCRATCH_RELEASE + 1, &metrics) == SKRYPTONITE_INVALID_ARGUMENT);
+	CHECK(skryptonite_metrics_counter_value(SKRYPTONITE_COUNTER_DERIVATION_FAILURES + 1, &value) == SKRYPTONITE_INVALID_ARGUMENT);
+
+	CHECK(skryptonite_metrics_counter_value(SKRYPTONITE_COUNTER_DERIVATION_FAILURES, &value) == SKRYPTONITE_OK && value == 0);
+
+	// nothing is recorded while recording is off
+	skryptonite_metrics_set_enabled(0);
+	Scrypt("password", "NaCl", 2, 32, 2);
+	CHECK(Metrics::Snapshot().phases[static_cast<size_t>(MetricsPhase::Pbkdf2Expand)].wallTime.count == 1);
+	skryptonite_metrics_set_enabled(1);
+
+	skryptonite_metrics_reset();
+	CHECK(Metrics::Snapshot().phases[static_cast<size_t>(MetricsPhase::Pbkdf2Expand)].wallTime.count == 0);
+}
+
+static void Api_Returns_Status_On_Bad_Parameters()
+{
+	std::vector<unsigned char> data(128);
+	unsigned char derivedKey[64];
+
+	CHECK(skryptonite_smix(nullptr, 128, 1, 16, 0, 1) == SKRYPTONITE_INVALID_ARGUMENT);
+	CHECK(skryptonite_smix(data.data(), 0, 1, 16, 0, 1) == SKRYPTONITE_INVALID_ARGUMENT);
+	CHECK(skryptonite_smix(data.data(), 120, 1, 16, 0, 1) == SKRYPTONITE_INVALID_ARGUMENT);
+	CHECK(skryptonite_smix(data.data(), 128, 0, 16, 0, 1) == SKRYPTONITE_INVALID_ARGUMENT);
+	CHECK(skryptonite_smix(data.data(), 128, 1, 0, 0, 1) == SKRYPTONITE_INVALID_ARGUMENT);
+	CHECK(skryptonite_smix(data.data(), 128, 1, 16, 1, 1) == SKRYPTONITE_INVALID_ARGUMENT);
+	CHECK(skryptonite_smix(data.data(), 128, 1, 16, 0, 1) == SKRYPTONITE_OK);
+
+	CHECK(skryptonite_scrypt(nullptr, 1, nullptr, 0, 1, 16, 1, derivedKey, 64) == SKRYPTONITE_INVALID_ARGUMENT);
+	CHECK(skryptonite_scrypt(nullptr, 0, nullptr, 0, 0, 16, 1, derivedKey, 64) == SKRYPTONITE_INVALID_ARGUMENT);
+	CHECK(skryptonite_scrypt(nullptr, 0, nullptr, 0, 1, 0, 1, derivedKey, 64) == SKRYPTONITE_INVALID_ARGUMENT);
+	CHECK(skryptonite_scrypt(nullptr, 0, nullptr, 0, 1, 16, 0, derivedKey, 64) == SKRYPTONITE_INVALID_ARGUMENT);
+	CHECK(skryptonite_scrypt(nullptr, 0, nullptr, 0, 1, 16, 1, derivedKey, 0) == SKRYPTONITE_INVALID_ARGUMENT);
+	CHECK(skryptonite_scrypt(nullptr, 0, nullptr, 0, 16, 16, static_cast<unsigned>(0xffffffffull * 32 / (128 * 16) + 1), derivedKey, 64) == SKRYPTONITE_INVALID_ARGUMENT);
+	CHECK(skryptonite_scrypt(nullptr, 0, nullptr, 0, 1, 16, 1, derivedKey, 64) == SKRYPTONITE_OK);
+
+	CHECK(skryptonite_set_interleave_count(0) == SKRYPTONITE_INVALID_ARGUMENT);
+	CHECK(skryptonite_set_interleave_count(ScryptEngine::MaxInterleaveCount + 1) == SKRYPTONITE_INVALID_ARGUMENT);
+	CHECK(skryptonite_set_interleave_count(1) == SKRYPTONITE_OK);
+
+	CHECK(skryptonite_set_cache_policy(4) == SKRYPTONITE_INVALID_ARGUMENT);
+	CHECK(skryptonite_set_cache_policy(SKRYPTONITE_CACHE_CACHED) == SKRYPTONITE_OK);
+	CHECK(ScryptEngine::DefaultCachePolicy() == CachePolicy::Cached);
+	CHECK(skryptonite_set_cache_policy(SKRYPTONITE_CACHE_AUTOMATIC) == SKRYPTONITE_OK);
+
+	skryptonite_smix_state* state = nullptr;
+	uint64_t totalSteps = 0;
+	int isDone = 0;
+	CHECK(skryptonite_smix_begin(data.data(), 128, 1, 16, 1, &state) == SKRYPTONITE_INVALID_ARGUMENT);
+	CHECK(skryptonite_smix_begin(data.data(), 128, 1, 16, 0, nullptr) == SKRYPTONITE_INVALID_ARGUMENT);
+	CHECK(skryptonite_smix_begin(data.data(), 128, 1, 16, 0, &state) == SKRYPTONITE_OK);
+	CHECK(skryptonite_smix_advance(state, 0, &isDone) == SKRYPTONITE_INVALID_ARGUMENT);
+	CHECK(skryptonite_smix_advance(state, 5, &isDone) == SKRYPTONITE_OK && isDone == 0);
+	CHECK(skryptonite_smix_progress(state, &totalSteps) == 5 && totalSteps == 32);
+	CHECK(skryptonite_smix_advance_for(state, ~0ull, &isDone) == SKRYPTONITE_OK && isDone == 1);
+	CHECK(skryptonite_smix_progress(state, nullptr) == 32);
+	skryptonite_smix_free(state);
+	CHECK(skryptonite_smix_begin(data.data(), 128, 1, 16, 0, &state) == SKRYPTONITE_OK);
+	skryptonite_smix_cancel(state);
+	CHECK(skryptonite_smix_advance(state, 1, &isDone) == SKRYPTONITE_OK && isDone == 1);
+	CHECK(skryptonite_smix_progress(state, nullptr) == 0);
+	skryptonite_smix_free(state);
+	skryptonite_smix_free(nullptr);
+
+	uint32_t factor = 0;
+	CHECK(skryptonite_set_tradeoff_factor(0) == SKRYPTONITE_INVALID_ARGUMENT);
+	CHECK(skryptonite_set_tradeoff_factor(4) == SKRYPTONITE_OK);
+	CHECK(ScryptEngine::DefaultTradeOffFactor() == 4);
+	CHECK(skryptonite_set_tradeoff_factor(1) == SKRYPTONITE_OK);
+	CHECK(skryptonite_tradeoff_factor_for_memory(0, 16, 128, &factor) == SKRYPTONITE_INVALID_ARGUMENT);
+	CHECK(skryptonite_tradeoff_factor_for_memory(1, 0, 128, &factor) == SKRYPTONITE_INVALID_ARGUMENT);
+	CHECK(skryptonite_tradeoff_factor_for_memory(2, 16, 255, &factor) == SKRYPTONITE_INVALID_ARGUMENT);
+	CHECK(skryptonite_tradeoff_factor_for_memory(1, 16, 128, nullptr) == SKRYPTONITE_INVALID_ARGUMENT);
+	CHECK(skryptonite_tradeoff_factor_for_memory(1, 16, 128 * 8, &factor) == SKRYPTONITE_OK);
+	CHECK(factor == 2);
+
+	skryptonite_request request = { nullptr, 0, nullptr, 0, derivedKey, 64 };
+	skryptonite_request badRequest = { nullptr, 0, nullptr, 0, nullptr, 64 };
+
+	CHECK(skryptonite_scrypt_batch(nullptr, 1, 1, 16, 1, 0) == SKRYPTONITE_INVALID_ARGUMENT);
+	CHECK(skryptonite_scrypt_batch(&badRequest, 1, 1, 16, 1, 0) == SKRYPTONITE_INVALID_ARGUMENT);
+	CHECK(skryptonite_scrypt_batch(&request, 1, 1, 0, 1, 0) == SKRYPTONITE_INVALID_ARGUMENT);
+	CHECK(skryptonite_scrypt_batch(nullptr, 0, 1, 16, 1, 0) == SKRYPTONITE_OK);
+	CHECK(skryptonite_scrypt_batch(&request, 1, 1, 16, 1, 0) == SKRYPTONITE_OK);
+
+	// a derivation whose element can never fit in the budget fails instead of waiting
+	skryptonite_memory_budget_statistics budget;
+	skryptonite_memory_budget_set_limit(128 * 16 - 1, 0);
+	CHECK(skryptonite_scrypt(nullptr, 0, nullptr, 0, 1, 16, 1, derivedKey, 64) == SKRYPTONITE_OUT_OF_MEMORY);
+	CHECK(skryptonite_memory_budget_summary(nullptr) == SKRYPTONITE_INVALID_ARGUMENT);
+	CHECK(skryptonite_memory_budget_summary(&budget) == SKRYPTONITE_OK);
+	CHECK(budget.limitBytes == 128 * 16 - 1 && budget.rejections >= 1 && budget.reservedBytes == 0);
+	skryptonite_memory_budget_set_limit(0, 0);
+	skryptonite_memory_budget_reset_statistics();
+}
+
+int main()
+{
+	CpuFeatures::Detect();
+	InstructionSet detected = CpuFeatures::MaxInstructionSet();
+	bool detectedShaExtensions = CpuFeatures::ShaExtensions();
+
+	// every level up to the detected one, including the scalar implementation
+	for (int level = static_cast<int>(InstructionSet::Unknown); level <= static_cast<int>(detected); level++)
+	{
+		InstructionSet instructionSet = static_cast<InstructionSet>(level);
+
+		// with and without the SHA extensions, when present
+		for (int shaExtensions = detectedShaExtensions ? 1 : 0; shaExtensions >= 0; shaExtensions--)
+		{
+			Pbkdf2_Matches_Scalar(instructionSet, shaExtensions != 0);
+			Pbkdf2_Test_Vectors();
+		}
+
+		Scrypt_Test_Vectors(instructionSet);
+		CHECK(CpuFeatures::MaxInstructionSet() == instructionSet);
+		Scrypt_Matches_Scalar_For_Every_Element_Length(instructionSet);
+		CHECK(CpuFeatures::MaxInstructionSet() == instructionSet);
+
+		// every explicit cache policy; the ones the processor lacks fall back
+		for (CachePolicy policy : { CachePolicy::StreamAndFlush, CachePolicy::StreamAndFlushOptimized, CachePolicy::Cached })
+		{
+			ScryptEngine::SetDefaultCachePolicy(policy);
+			Scrypt_Test_Vectors(instructionSet);
+			ScryptEngine_SMixLanes_Matches_SMix();
+		}
+
+		ScryptEngine::SetDefaultCachePolicy(CachePolicy::Automatic);
+		SMixState_Matches_SMix();
+		ScryptEngine_SMix_With_Scratch_Matches_SMix();
+
+		// keeping every third element, and only the first one when the factor exceeds N
+		ScryptEngine::SetDefaultTradeOffFactor(3);
+		Scrypt_Test_Vectors(instructionSet);
+		ScryptEngine_SMixLanes_Matches_SMix();
+		SMixState_Matches_SMix();
+		ScryptEngine_SMix_With_Scratch_Matches_SMix();
+		ScryptEngine::SetInterleaveCount(3);
+		ScryptEngine_SMixLanes_Matches_SMix();
+		ScryptEngine::SetInterleaveCount(1);
+		ScryptEngine::SetDefaultTradeOffFactor(100);
+		ScryptEngine_SMixLanes_Matches_SMix();
+		ScryptEngine::SetDefaultTradeOffFactor(1);
+
+		ScryptEngine_Resolves_Automatic_Cache_Policy();
+		ScryptEngine_SMixLanes_Matches_SMix();
+		ScryptEngine::SetInterleaveCount(3);
+		ScryptEngine_SMixLanes_Matches_SMix();
+		ScryptEngine_DeriveKeys_Matches_DeriveKey(1, 3);
+		ScryptEngine::SetInterleaveCount(1);
+		ScryptEngine_DeriveKeys_Matches_DeriveKey(1, 3);
+		ScryptEngine_DeriveKeys_Matches_DeriveKey(3, 0);
+		ScryptEngine_DeriveKeys_Matches_DeriveKey(3, 0, CachePolicy::StreamAndFlush, 3);
+	}
+
+	CpuFeatures::SetMaxInstructionSet(detected);
+	CpuFeatures::SetShaExtensions(detectedShaExtensions);
+	ScryptEngine_Chooses_Trade_Off_Factor_For_Memory();
+	Autotuner_Chooses_Fastest_Verified_Backend();
+	Metrics_Records_Phases();
+	Api_Returns_Status_On_Bad_Parameters();
+	ScratchPool_Reuses_Released_Memory();
+	ThreadPool_Runs_Every_Index_Once();
+	ProcessorTopology_Spreads_Threads();
+	MemoryBudget_Queues_Reservations();
+	MemoryBudget_Splits_Groups_Above_The_Limit();
+	CostModel_Predicts_From_Profile();
+	DerivationQueue_Runs_Submissions();
+	ScryptEngine_Out_Of_Core_Matches_In_Memory();
+	DerivationCache_Serves_Repeated_Derivations();
+
+	if (failures > 0)
+	{
+		printf("%d check(s) failed.\n", failures);
+		return 1;
+	}
+
+	printf("All checks passed.\n");
+	return 0;
+}
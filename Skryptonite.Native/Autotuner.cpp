@@ -0,0 +1,252 @@
+/**
+* Skryptonite - Scrypt library for UWP
+* Copyright © 2016 Nicholas C. Bauer, Ph.D.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "pch.h"
+#include "Autotuner.h"
+#include "CpuFeatures.h"
+#include "ScryptEngine.h"
+#include <chrono>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+using namespace Skryptonite::Native;
+
+std::mutex Autotuner::_mutex;
+std::vector<AutotuneResult> Autotuner::_results;
+std::atomic<bool> Autotuner::_hasResults(false);
+
+// timed runs per backend after the warm-up, keeping the fastest
+const unsigned TimedRunCount = 3;
+
+// RFC 7914 section 7: scryptROMix with r = 1 and N = 16
+static const unsigned char KnownInput[128] =
+{
+	0xf7, 0xce, 0x0b, 0x65, 0x3d, 0x2d, 0x72, 0xa4, 0x10, 0x8c, 0xf5, 0xab, 0xe9, 0x12, 0xff, 0xdd,
+	0x77, 0x76, 0x16, 0xdb, 0xbb, 0x27, 0xa7, 0x0e, 0x82, 0x04, 0xf3, 0xae, 0x2d, 0x0f, 0x6f, 0xad,
+	0x89, 0xf6, 0x8f, 0x48, 0x11, 0xd1, 0xe8, 0x7b, 0xcc, 0x3b, 0xd7, 0x40, 0x0a, 0x9f, 0xfd, 0x29,
+	0x09, 0x4f, 0x01, 0x84, 0x63, 0x95, 0x74, 0xf3, 0x9a, 0xe5, 0xa1, 0x31, 0x52, 0x17, 0xbc, 0xd7,
+	0x89, 0x49, 0x91, 0x44, 0x72, 0x13, 0xbb, 0x22, 0x6c, 0x25, 0xb5, 0x4d, 0xa8, 0x63, 0x70, 0xfb,
+	0xcd, 0x98, 0x43, 0x80, 0x37, 0x46, 0x66, 0xbb, 0x8f, 0xfc, 0xb5, 0xbf, 0x40, 0xc2, 0x54, 0xb0,
+	0x67, 0xd2, 0x7c, 0x51, 0xce, 0x4a, 0xd5, 0xfe, 0xd8, 0x29, 0xc9, 0x0b, 0x50, 0x5a, 0x57, 0x1b,
+	0x7f, 0x4d, 0x1c, 0xad, 0x6a, 0x52, 0x3c, 0xda, 0x77, 0x0e, 0x67, 0xbc, 0xea, 0xaf, 0x7e, 0x89
+};
+
+static const unsigned char KnownOutput[128] =
+{
+	0x79, 0xcc, 0xc1, 0x93, 0x62, 0x9d, 0xeb, 0xca, 0x04, 0x7f, 0x0b, 0x70, 0x60, 0x4b, 0xf6, 0xb6,
+	0x2c, 0xe3, 0xdd, 0x4a, 0x96, 0x26, 0xe3, 0x55, 0xfa, 0xfc, 0x61, 0x98, 0xe6, 0xea, 0x2b, 0x46,
+	0xd5, 0x84, 0x13, 0x67, 0x3b, 0x99, 0xb0, 0x29, 0xd6, 0x65, 0xc3, 0x57, 0x60, 0x1f, 0xb4, 0x26,
+	0xa0, 0xb2, 0xf4, 0xbb, 0xa2, 0x00, 0xee, 0x9f, 0x0a, 0x43, 0xd1, 0x9b, 0x57, 0x1a, 0x9c, 0x71,
+	0xef, 0x11, 0x42, 0xe6, 0x5d, 0x5a, 0x26, 0x6f, 0xdd, 0xca, 0x83, 0x2c, 0xe5, 0x9f, 0xaa, 0x7c,
+	0xac, 0x0b, 0x9c, 0xf1, 0xbe, 0x2b, 0xff, 0xca, 0x30, 0x0d, 0x01, 0xee, 0x38, 0x76, 0x19, 0xc4,
+	0xae, 0x12, 0xfd, 0x44, 0x38, 0xf2, 0x03, 0xa0, 0xe4, 0xe1, 0xc4, 0x7e, 0xc3, 0x14, 0x86, 0x1f,
+	0x4e, 0x90, 0x87, 0xcb, 0x33, 0x39, 0x6a, 0x68, 0x73, 0xe8, 0xf9, 0xd2, 0x53, 0x9a, 0x4b, 0x8e
+};
+
+/**
+<summary>Lists the backends the processor supports, starting with the portable implementation. SSSE3 shares the SSE2 backend.</summary>
+*/
+static std::vector<InstructionSet> SupportedBackends()
+{
+	std::vector<InstructionSet> backends = { InstructionSet::Unknown };
+
+#if defined(SKRYPTONITE_X86)
+	for (InstructionSet instructionSet : { InstructionSet::SSE2, InstructionSet::SSE41, InstructionSet::AVX, InstructionSet::AVX2 })
+#elif defined(SKRYPTONITE_ARM)
+	for (InstructionSet instructionSet : { InstructionSet::NEON })
+#else
+	for (InstructionSet instructionSet : std::vector<InstructionSet>())
+#endif
+	{
+		if (static_cast<int>(instructionSet) <= static_cast<int>(CpuFeatures::SupportedInstructionSet()))
+			backends.push_back(instructionSet);
+	}
+
+	return backends;
+}
+
+AutotuneResult Autotuner::Calibrate(unsigned elementLengthMultiplier, unsigned processingCost, unsigned parallelization)
+{
+	if (elementLengthMultiplier == 0 || processingCost == 0 || parallelization == 0)
+		throw std::invalid_argument("elementLengthMultiplier, processingCost and parallelization must be greater than 0.");
+	if ((std::numeric_limits<unsigned>::max)() / elementLengthMultiplier < 2 * 64 * ScryptEngine::MaxInterleaveCount)
+		throw std::invalid_argument("elementLengthMultiplier is too large.");
+
+	AutotuneResult result;
+
+	if (TryGetResult(elementLengthMultiplier, processingCost, parallelization, result))
+		return result;
+
+	const unsigned long long elementLength = 128ull * elementLengthMultiplier;
+
+	unsigned calibrationCost = processingCost;
+	while (calibrationCost > 1 && elementLength * calibrationCost > MaxCalibrationLength)
+		calibrationCost /= 2;
+
+	result.elementLengthMultiplier = elementLengthMultiplier;
+	result.processingCost = processingCost;
+	result.calibrationCost = calibrationCost;
+	result.usesLanes = parallelization > 1;
+	result.instructionSet = InstructionSet::Unknown;
+
+	std::vector<unsigned char> reference;
+	double fastest = 0;
+
+	for (InstructionSet instructionSet : SupportedBackends())
+	{
+		BackendMeasurement measurement = { instructionSet, false, 0 };
+
+		// a backend that gets the known answer wrong is not worth timing
+		if (MatchesKnownAnswer(instructionSet))
+		{
+			std::vector<unsigned char> firstElement;
+			measurement.nanosecondsPerElement = Measure(instructionSet, elementLengthMultiplier, calibrationCost, result.usesLanes,
+				firstElement);
+
+			// the first verified backend, normally the portable one, is the reference for the rest
+			if (reference.empty())
+				reference = firstElement;
+
+			measurement.isVerified = firstElement == reference;
+		}
+
+		if (measurement.isVerified && (fastest == 0 || measurement.nanosecondsPerElement < fastest))
+		{
+			fastest = measurement.nanosecondsPerElement;
+			result.instructionSet = instructionSet;
+		}
+
+		result.measurements.push_back(measurement);
+	}
+
+	if (reference.empty())
+		throw std::runtime_error("No instruction set backend reproduced the scryptROMix test vector.");
+
+	std::lock_guard<std::mutex> lock(_mutex);
+
+	// another thread may have calibrated the same parameters meanwhile; keep the first result
+	if (const AutotuneResult* existing = Find(elementLengthMultiplier, processingCost, result.usesLanes))
+		return *existing;
+
+	_results.push_back(result);
+	_hasResults = true;
+
+	return result;
+}
+
+bool Autotuner::TryGetResult(unsigned elementLengthMultiplier, unsigned processingCost, unsigned parallelization,
+	AutotuneResult& result)
+{
+	if (!_hasResults)
+		return false;
+
+	std::lock_guard<std::mutex> lock(_mutex);
+
+	const AutotuneResult* existing = Find(elementLengthMultiplier, processingCost, parallelization > 1);
+	if (existing == nullptr)
+		return false;
+
+	result = *existing;
+	return true;
+}
+
+InstructionSet Autotuner::InstructionSetFor(unsigned elementLengthMultiplier, unsigned processingCost, unsigned parallelization)
+{
+	const InstructionSet maxInstructionSet = CpuFeatures::MaxInstructionSet();
+
+	if (!_hasResults)
+		return maxInstructionSet;
+
+	std::lock_guard<std::mutex> lock(_mutex);
+
+	const AutotuneResult* existing = Find(elementLengthMultiplier, processingCost, parallelization > 1);
+	if (existing == nullptr || static_cast<int>(existing->instructionSet) > static_cast<int>(maxInstructionSet))
+		return maxInstructionSet;
+
+	return existing->instructionSet;
+}
+
+void Autotuner::Reset()
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+
+	_results.clear();
+	_hasResults = false;
+}
+
+const AutotuneResult* Autotuner::Find(unsigned elementLengthMultiplier, unsigned processingCost, bool usesLanes)
+{
+	for (const AutotuneResult& result : _results)
+	{
+		if (result.elementLengthMultiplier == elementLengthMultiplier && result.processingCost == processingCost &&
+			result.usesLanes == usesLanes)
+			return &result;
+	}
+
+	return nullptr;
+}
+
+bool Autotuner::MatchesKnownAnswer(InstructionSet instructionSet)
+{
+	unsigned char data[sizeof(KnownInput)];
+	memcpy(data, KnownInput, sizeof(data));
+
+	ScryptEngine engine(data, sizeof(data), 1, 16);
+	engine.SetInstructionSet(instructionSet);
+	engine.SMix(0);
+
+	return memcmp(data, KnownOutput, sizeof(data)) == 0;
+}
+
+double Autotuner::Measure(InstructionSet instructionSet, unsigned elementLengthMultiplier, unsigned processingCost, bool usesLanes,
+	std::vector<unsigned char>& firstElement)
+{
+	const size_t elementLength = 128 * static_cast<size_t>(elementLengthMultiplier);
+
+	// room for the most elements any backend mixes at once: eight lanes or eight interleaved chains
+	const unsigned elementsCount = usesLanes ? ScryptEngine::MaxInterleaveCount : 1;
+	std::vector<unsigned char> data(elementLength * elementsCount);
+	ScryptEngine engine(data.data(), data.size(), elementsCount, processingCost);
+	engine.SetInstructionSet(instructionSet);
+
+	const unsigned count = usesLanes ? engine.LaneCount() : 1;
+	double fastest = 0;
+
+	// the warm-up run also faults in the large memory blocks, which stay in the scratch pool for the timed runs
+	for (unsigned run = 0; run <= TimedRunCount; run++)
+	{
+		for (size_t i = 0; i < data.size(); i++)
+			data[i] = static_cast<unsigned char>((i * 2654435761u) >> 24);
+
+		auto start = std::chrono::steady_clock::now();
+		if (usesLanes)
+			engine.SMixRange(0, count);
+		else
+			engine.SMix(0);
+		auto elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / count;
+
+		if (run == 0)
+			firstElement.assign(data.begin(), data.begin() + elementLength);
+		else if (fastest == 0 || elapsed < fastest)
+			fastest = elapsed;
+	}
+
+	engine.EraseBuffer();
+
+	return fastest;
+}
@@ -0,0 +1,167 @@
+/**
+* Skryptonite - Scrypt library for UWP
+* Copyright © 2016 Nicholas C. Bauer, Ph.D.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#pragma once
+#include "Platform.h"
+#include "DetectInstructionSet.h"
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+namespace Skryptonite
+{
+	namespace Native
+	{
+		/**
+		<summary>The measured speed of one instruction set backend.</summary>
+		*/
+		struct BackendMeasurement
+		{
+			InstructionSet instructionSet;
+
+			/**
+			<summary>Whether the backend reproduced the RFC 7914 scryptROMix test vector and the scalar result for the calibration
+			parameters. Backends that were not verified are never chosen.</summary>
+			*/
+			bool isVerified;
+
+			/**
+			<summary>The time to mix one element, taking the fastest of several runs and sharing the time of elements mixed together
+			by a multi-buffer or interleaved backend.</summary>
+			*/
+			double nanosecondsPerElement;
+		};
+
+		/**
+		<summary>The outcome of calibrating every backend for one set of parameters.</summary>
+		*/
+		struct AutotuneResult
+		{
+			unsigned elementLengthMultiplier;
+			unsigned processingCost;
+
+			/**
+			<summary>The processing cost the backends were timed with, reduced from <see cref="processingCost"/> when the large
+			memory block would exceed <see cref="Autotuner::MaxCalibrationLength"/>.</summary>
+			*/
+			unsigned calibrationCost;
+
+			/**
+			<summary>Whether the backends were timed mixing as many elements as they mix at once, as derivations with p &gt; 1 are.
+			Otherwise they were timed on single SMix calls, as derivations with p = 1 are.</summary>
+			*/
+			bool usesLanes;
+
+			/**
+			<summary>The fastest verified backend.</summary>
+			*/
+			InstructionSet instructionSet;
+
+			std::vector<BackendMeasurement> measurements;
+		};
+
+		/**
+		<summary>Chooses the instruction set backend by timing every supported one, rather than trusting that a later instruction set
+		is always faster.</summary>
+		<remarks>
+		Calibration is optional and runs once per element length, processing cost, and whether p is 1, since a single element and a
+		group of lanes are mixed by different kernels. Engines created afterwards with those parameters start with the chosen instruction set, unless it is above <see cref="CpuFeatures::MaxInstructionSet"/>; engines with other
+		parameters are unaffected.
+		</remarks>
+		*/
+		class Autotuner
+		{
+		public:
+			/**
+			<summary>The largest large memory block per element the backends are timed with, in bytes.</summary>
+			*/
+			static const unsigned long long MaxCalibrationLength = 16 * 1024 * 1024;
+
+			/**
+			<summary>Times every backend the processor supports on a short SMix with the given parameters and keeps the fastest one that
+			produces correct results.</summary>
+			<param name="elementLengthMultiplier">The block size parameter r.</param>
+			<param name="processingCost">The CPU/memory cost parameter N.</param>
+			<param name="parallelization">The parallelization parameter p. Only whether it is 1 matters.</param>
+			<returns>The measurements, or those of an earlier calibration with the same parameters.</returns>
+			<remarks>
+			Each backend first mixes the RFC 7914 scryptROMix test vector, then one warm-up and several timed runs of the path the
+			derivation takes: a single SMix when p is 1, otherwise as many elements as the backend mixes at once. Must not be called while other threads change <see cref="ScryptEngine::InterleaveCount"/> or the
+			default cache policy.
+			</remarks>
+			<exception cref="std::invalid_argument">Thrown when a parameter is 0 or too large.</exception>
+			<exception cref="std::runtime_error">Thrown when no backend produces correct results.</exception>
+			<exception cref="std::bad_alloc">Thrown when the working memory cannot be allocated.</exception>
+			*/
+			static AutotuneResult Calibrate(unsigned elementLengthMultiplier, unsigned processingCost, unsigned parallelization);
+
+			/**
+			<summary>Gets the measurements of an earlier calibration.</summary>
+			<param name="elementLengthMultiplier">The block size parameter r.</param>
+			<param name="processingCost">The CPU/memory cost parameter N.</param>
+			<param name="parallelization">The parallelization parameter p.</param>
+			<param name="result">Receives the measurements.</param>
+			<returns>True when the parameters have been calibrated.</returns>
+			*/
+			static bool TryGetResult(unsigned elementLengthMultiplier, unsigned processingCost, unsigned parallelization,
+				AutotuneResult& result);
+
+			/**
+			<summary>Gets the instruction set new engines with the given parameters start with.</summary>
+			<param name="elementLengthMultiplier">The block size parameter r.</param>
+			<param name="processingCost">The CPU/memory cost parameter N.</param>
+			<param name="parallelization">The number of elements mixed together, p for a single derivation.</param>
+			<returns>The calibrated choice when there is one and it does not exceed <see cref="CpuFeatures::MaxInstructionSet"/>,
+			otherwise <see cref="CpuFeatures::MaxInstructionSet"/>.</returns>
+			*/
+			static InstructionSet InstructionSetFor(unsigned elementLengthMultiplier, unsigned processingCost, unsigned parallelization);
+
+			/**
+			<summary>Forgets every calibration.</summary>
+			*/
+			static void Reset();
+
+		private:
+			static std::mutex _mutex;
+			static std::vector<AutotuneResult> _results;
+			static std::atomic<bool> _hasResults;
+
+			/**
+			<summary>Finds the calibration of the given parameters. The caller must hold the mutex.</summary>
+			<returns>The calibration, or null.</returns>
+			*/
+			static const AutotuneResult* Find(unsigned elementLengthMultiplier, unsigned processingCost, bool usesLanes);
+
+			/**
+			<summary>Checks that a backend reproduces the RFC 7914 scryptROMix test vector.</summary>
+			*/
+			static bool MatchesKnownAnswer(InstructionSet instructionSet);
+
+			/**
+			<summary>Times a backend mixing a single element, or as many elements as it mixes at once.</summary>
+			<param name="instructionSet">The backend.</param>
+			<param name="elementLengthMultiplier">The block size parameter r.</param>
+			<param name="processingCost">The processing cost to time with.</param>
+			<param name="usesLanes">Whether to time the lane path rather than a single SMix.</param>
+			<param name="firstElement">Receives the first mixed element, to compare backends with.</param>
+			<returns>The fastest time to mix one element in nanoseconds.</returns>
+			*/
+			static double Measure(InstructionSet instructionSet, unsigned elementLengthMultiplier, unsigned processingCost, bool usesLanes,
+				std::vector<unsigned char>& firstElement);
+		};
+	}
+}
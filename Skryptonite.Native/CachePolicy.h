@@ -0,0 +1,55 @@
+/**
+* Skryptonite - Scrypt library for UWP
+* Copyright © 2016 Nicholas C. Bauer, Ph.D.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#pragma once
+#include "Platform.h"
+
+namespace Skryptonite
+{
+	namespace Native
+	{
+		/**
+		<summary>Enumerates the ways SMix may treat the cache when writing and reading the large memory block.</summary>
+		*/
+		SKRYPTONITE_WINRT_PUBLIC enum class CachePolicy
+		{
+			/**
+			<summary>Caches the large memory block when it fits comfortably in the last-level cache, and otherwise streams it with
+			the fastest available flush.</summary>
+			*/
+			Automatic,
+
+			/**
+			<summary>Writes the large memory block with streaming stores and flushes each block with CLFLUSH after reading it. Keeps
+			the large memory block out of the cache, which also resists cache-timing attacks.</summary>
+			*/
+			StreamAndFlush,
+
+			/**
+			<summary>Like <see cref="StreamAndFlush"/>, but flushes with the weakly ordered CLFLUSHOPT, which does not serialize
+			consecutive flushes. Falls back to <see cref="StreamAndFlush"/> when the processor lacks CLFLUSHOPT.</summary>
+			*/
+			StreamAndFlushOptimized,
+
+			/**
+			<summary>Writes and reads the large memory block through the cache without flushing. Fastest when the large memory
+			block fits in the last-level cache.</summary>
+			*/
+			Cached
+		};
+	}
+}
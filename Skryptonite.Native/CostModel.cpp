@@ -0,0 +1,617 @@
+/**
+* Skryptonite - Scrypt library for UWP
+* Copyright © 2016 Nicholas C. Bauer, Ph.D.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "pch.h"
+#include "CostModel.h"
+#include "CpuFeatures.h"
+#include "SMixState.h"
+#include "ScryptEngine.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+#if defined(_WIN32)
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#endif
+
+using namespace Skryptonite::Native;
+
+std::mutex CostModel::_mutex;
+HardwareProfile CostModel::_profile;
+std::atomic<bool> CostModel::_hasProfile(false);
+
+// the block size parameter the profile is measured with
+const unsigned CalibrationMultiplier = 8;
+
+// the footprint of the first band; each further band is eight times larger
+const unsigned long long MinCalibrationLength = 256 * 1024;
+
+// timed runs per measurement, keeping the fastest; the first also faults in the scratch memory
+const unsigned CalibrationRunCount = 2;
+
+// the first line of every profile in a profile file, followed by the processor name
+static const char ProfileHeader[] = "profile";
+
+/**
+<summary>Gets the elements an engine with the current defaults mixes at once.</summary>
+*/
+static unsigned CurrentLaneCount()
+{
+	std::vector<unsigned char> data(128 * CalibrationMultiplier * ScryptEngine::MaxInterleaveCount);
+	ScryptEngine engine(data.data(), data.size(), ScryptEngine::MaxInterleaveCount, 16);
+
+	return engine.LaneCount();
+}
+
+/**
+<summary>Fills the data of a calibration engine with arbitrary bytes.</summary>
+*/
+static void FillCalibrationData(std::vector<unsigned char>& data)
+{
+	for (size_t i = 0; i < data.size(); i++)
+		data[i] = static_cast<unsigned char>((i * 2654435761u) >> 24);
+}
+
+/**
+<summary>Gets the seconds elapsed since a point in time.</summary>
+*/
+static double SecondsSince(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+/**
+<summary>Rounds down to a power of 2, and up to at least 2.</summary>
+*/
+static unsigned FloorPowerOfTwo(unsigned long long value)
+{
+	unsigned result = 2;
+	while (result <= value / 2 && result < 0x80000000u)
+		result *= 2;
+
+	return result;
+}
+
+#if defined(_WIN32)
+/**
+<summary>Converts a UTF-8 path to the UTF-16 the file functions of Windows take.</summary>
+*/
+static std::wstring NativePath(const std::string& path)
+{
+	int length = MultiByteToWideChar(CP_UTF8, 0, path.c_str(), -1, nullptr, 0);
+	if (length <= 0)
+		throw std::invalid_argument("path is not valid UTF-8.");
+
+	std::wstring result(length, L'\0');
+	MultiByteToWideChar(CP_UTF8, 0, path.c_str(), -1, &result[0], length);
+	result.resize(length - 1);
+
+	return result;
+}
+
+/**
+<summary>Replaces a file with another.</summary>
+*/
+static bool SwapInFile(const std::string& source, const std::string& destination)
+{
+	return MoveFileExW(NativePath(source).c_str(), NativePath(destination).c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+}
+#else
+static const std::string& NativePath(const std::string& path)
+{
+	return path;
+}
+
+static bool SwapInFile(const std::string& source, const std::string& destination)
+{
+	return std::rename(source.c_str(), destination.c_str()) == 0;
+}
+#endif
+
+/**
+<summary>Gets the key that tells profiles apart in a profile file: the processor, instruction set and lane count.</summary>
+*/
+static std::string ProfileKey(const std::string& processorName, int instructionSet, unsigned laneCount)
+{
+	std::ostringstream key;
+	key << processorName << '\n' << instructionSet << '\n' << laneCount;
+	return key.str();
+}
+
+/**
+<summary>Writes a profile in the text form of profile files.</summary>
+*/
+static void WriteProfile(std::ostream& output, const HardwareProfile& profile)
+{
+	output.precision(17);
+	output << ProfileHeader << ' ' << profile.processorName << '\n';
+	output << "instructionSet " << static_cast<int>(profile.instructionSet) << '\n';
+	output << "laneCount " << profile.laneCount << '\n';
+	output << "salsaBlocksPerSecond " << profile.salsaBlocksPerSecond << '\n';
+
+	for (const CostBand& band : profile.bands)
+	{
+		output << "band " << band.footprintBytes << ' ' << band.laneNanosecondsPerBlock << ' ' << band.nanosecondsPerBlock << ' '
+			<< band.fillBytesPerSecond << ' ' << band.readNanoseconds << '\n';
+	}
+
+	output << "end\n";
+}
+
+/**
+<summary>Reads the profiles of a profile file, each with the lines it was read from. Profiles that are cut short or malformed are
+skipped.</summary>
+*/
+static void ReadProfiles(std::istream& input, std::vector<HardwareProfile>& profiles, std::vector<std::string>& texts)
+{
+	std::string line;
+	HardwareProfile profile;
+	std::string text;
+	bool isInProfile = false;
+	bool isValid = false;
+
+	while (std::getline(input, line))
+	{
+		if (line.compare(0, sizeof(ProfileHeader) - 1, ProfileHeader) == 0 && line.size() > sizeof(ProfileHeader))
+		{
+			profile = HardwareProfile();
+			profile.processorName = line.substr(sizeof(ProfileHeader));
+			profile.instructionSet = InstructionSet::Unknown;
+			profile.laneCount = 0;
+			profile.salsaBlocksPerSecond = 0;
+			text = line + '\n';
+			isInProfile = true;
+			isValid = true;
+			continue;
+		}
+
+		if (!isInProfile)
+			continue;
+
+		text += line + '\n';
+
+		std::istringstream fields(line);
+		std::string name;
+		fields >> name;
+
+		if (name == "instructionSet")
+		{
+			int value = 0;
+			fields >> value;
+			profile.instructionSet = static_cast<InstructionSet>(value);
+		}
+		else if (name == "laneCount")
+		{
+			fields >> profile.laneCount;
+		}
+		else if (name == "salsaBlocksPerSecond")
+		{
+			fields >> profile.salsaBlocksPerSecond;
+		}
+		else if (name == "band")
+		{
+			CostBand band = {};
+			fields >> band.footprintBytes >> band.laneNanosecondsPerBlock >> band.nanosecondsPerBlock >> band.fillBytesPerSecond
+				>> band.readNanoseconds;
+
+			// bands must be written smallest first
+			if (!profile.bands.empty() && band.footprintBytes <= profile.bands.back().footprintBytes)
+				isValid = false;
+
+			profile.bands.push_back(band);
+		}
+		else if (name == "end")
+		{
+			if (isValid && profile.laneCount > 0 && !profile.bands.empty())
+			{
+				profiles.push_back(profile);
+				texts.push_back(text);
+			}
+
+			isInProfile = false;
+			continue;
+		}
+
+		if (fields.fail())
+			isValid = false;
+	}
+}
+
+HardwareProfile CostModel::Calibrate(unsigned long long maxFootprint)
+{
+	HardwareProfile profile;
+	profile.processorName = CpuFeatures::ProcessorName();
+	profile.instructionSet = CpuFeatures::MaxInstructionSet();
+	profile.laneCount = CurrentLaneCount();
+	profile.salsaBlocksPerSecond = 0;
+
+	for (unsigned long long footprint = MinCalibrationLength; footprint <= (std::max)(maxFootprint, MinCalibrationLength); footprint *= 8)
+	{
+		profile.bands.push_back(MeasureBand(footprint, profile.laneCount));
+
+		// the fill of the smallest band runs from the fastest cache, so it is bounded by Salsa20/8 itself
+		if (profile.bands.size() == 1)
+		{
+			const CostBand& band = profile.bands.front();
+			profile.salsaBlocksPerSecond = band.fillBytesPerSecond / sizeof(SalsaBlock);
+		}
+	}
+
+	// the largest footprint is measured even when it falls between two bands
+	if (maxFootprint > profile.bands.back().footprintBytes)
+		profile.bands.push_back(MeasureBand(maxFootprint, profile.laneCount));
+
+	SetProfile(profile);
+
+	return profile;
+}
+
+CostBand CostModel::MeasureBand(unsigned long long footprint, unsigned& laneCount)
+{
+	const size_t elementLength = 128 * CalibrationMultiplier;
+	CostBand band = {};
+	band.footprintBytes = footprint;
+
+	{
+		// a group of as many elements as the engine mixes at once, sharing the footprint
+		std::vector<unsigned char> data(elementLength * ScryptEngine::MaxInterleaveCount);
+		ScryptEngine probe(data.data(), data.size(), ScryptEngine::MaxInterleaveCount, 16);
+		laneCount = probe.LaneCount();
+
+		const unsigned processingCost = FloorPowerOfTwo(footprint / (elementLength * laneCount));
+		data.resize(elementLength * laneCount);
+		ScryptEngine engine(data.data(), data.size(), laneCount, processingCost);
+
+		double fastest = 0;
+		for (unsigned run = 0; run < CalibrationRunCount; run++)
+		{
+			FillCalibrationData(data);
+
+			auto start = std::chrono::steady_clock::now();
+			engine.SMixRange(0, laneCount);
+			double elapsed = SecondsSince(start);
+
+			if (fastest == 0 || elapsed < fastest)
+				fastest = elapsed;
+		}
+
+		engine.EraseBuffer();
+
+		const double blockSteps = 4.0 * CalibrationMultiplier * processingCost * laneCount;
+		band.laneNanosecondsPerBlock = fastest * 1e9 / blockSteps;
+	}
+
+	{
+		// one element on its own, timing the fill and mix halves separately
+		std::vector<unsigned char> data(elementLength);
+		const unsigned processingCost = FloorPowerOfTwo(footprint / elementLength);
+		ScryptEngine engine(data.data(), data.size(), 1, processingCost);
+
+		double fastestFill = 0;
+		double fastestMix = 0;
+		for (unsigned run = 0; run < CalibrationRunCount; run++)
+		{
+			FillCalibrationData(data);
+			SMixState state(engine, 0);
+
+			auto start = std::chrono::steady_clock::now();
+			state.Advance(processingCost);
+			double fill = SecondsSince(start);
+
+			start = std::chrono::steady_clock::now();
+			state.Advance(processingCost);
+			double mix = SecondsSince(start);
+
+			if (fastestFill == 0 || fill < fastestFill)
+				fastestFill = fill;
+			if (fastestMix == 0 || mix < fastestMix)
+				fastestMix = mix;
+		}
+
+		engine.EraseBuffer();
+
+		const double blockSteps = 4.0 * CalibrationMultiplier * processingCost;
+		band.nanosecondsPerBlock = (fastestFill + fastestMix) * 1e9 / blockSteps;
+		band.fillBytesPerSecond = static_cast<double>(elementLength) * processingCost / fastestFill;
+		band.readNanoseconds = (std::max)(fastestMix - fastestFill, 0.0) * 1e9 / processingCost;
+	}
+
+	return band;
+}
+
+bool CostModel::Load(const std::string& path)
+{
+	std::ifstream input(NativePath(path));
+	if (!input)
+		return false;
+
+	std::vector<HardwareProfile> profiles;
+	std::vector<std::string> texts;
+	ReadProfiles(input, profiles, texts);
+
+	for (const HardwareProfile& profile : profiles)
+	{
+		if (Matches(profile))
+		{
+			SetProfile(profile);
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void CostModel::Save(const std::string& path)
+{
+	HardwareProfile profile;
+	if (!TryGetProfile(profile))
+		throw std::logic_error("There is no profile to save.");
+
+	const std::string key = ProfileKey(profile.processorName, static_cast<int>(profile.instructionSet), profile.laneCount);
+
+	std::ostringstream output;
+
+	// keep the profiles of other processors, so that one file can follow a user between machines
+	{
+		std::ifstream input(NativePath(path));
+		std::vector<HardwareProfile> profiles;
+		std::vector<std::string> texts;
+		ReadProfiles(input, profiles, texts);
+
+		for (size_t i = 0; i < profiles.size(); i++)
+		{
+			const HardwareProfile& existing = profiles[i];
+			if (ProfileKey(existing.processorName, static_cast<int>(existing.instructionSet), existing.laneCount) != key)
+				output << texts[i];
+		}
+	}
+
+	WriteProfile(output, profile);
+
+	// write a new file and swap it in, so that a reader never sees half a profile
+	const std::string temporaryPath = path + ".tmp";
+	{
+		std::ofstream file(NativePath(temporaryPath), std::ios::trunc);
+		file << output.str();
+		file.close();
+
+		if (!file)
+			throw std::runtime_error("The profile file could not be written.");
+	}
+
+	if (!SwapInFile(temporaryPath, path))
+		throw std::runtime_error("The profile file could not be replaced.");
+}
+
+HardwareProfile CostModel::EnsureProfile(const std::string& path)
+{
+	HardwareProfile profile;
+	if (TryGetProfile(profile) && Matches(profile))
+		return profile;
+
+	if (!path.empty() && Load(path) && TryGetProfile(profile))
+		return profile;
+
+	profile = Calibrate();
+
+	if (!path.empty())
+		Save(path);
+
+	return profile;
+}
+
+bool CostModel::TryGetProfile(HardwareProfile& profile)
+{
+	if (!_hasProfile)
+		return false;
+
+	std::lock_guard<std::mutex> lock(_mutex);
+
+	profile = _profile;
+	return true;
+}
+
+void CostModel::SetProfile(const HardwareProfile& profile)
+{
+	if (profile.bands.empty() || profile.laneCount == 0)
+		throw std::invalid_argument("profile must have bands and a lane count greater than 0.");
+
+	std::lock_guard<std::mutex> lock(_mutex);
+
+	_profile = profile;
+	_hasProfile = true;
+}
+
+void CostModel::Reset()
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+
+	_profile = HardwareProfile();
+	_hasProfile = false;
+}
+
+bool CostModel::Matches(const HardwareProfile& profile)
+{
+	return profile.processorName == CpuFeatures::ProcessorName() && profile.instructionSet == CpuFeatures::MaxInstructionSet()
+		&& profile.laneCount == CurrentLaneCount();
+}
+
+HardwareProfile CostModel::CurrentProfile()
+{
+	HardwareProfile profile;
+	if (TryGetProfile(profile))
+		return profile;
+
+	return Calibrate();
+}
+
+CostBand CostModel::BandFor(const HardwareProfile& profile, unsigned long long footprint)
+{
+	const std::vector<CostBand>& bands = profile.bands;
+
+	if (footprint <= bands.front().footprintBytes)
+		return bands.front();
+	if (footprint >= bands.back().footprintBytes)
+		return bands.back();
+
+	size_t upper = 1;
+	while (bands[upper].footprintBytes < footprint)
+		upper++;
+
+	const CostBand& low = bands[upper - 1];
+	const CostBand& high = bands[upper];
+	const double t = std::log2(static_cast<double>(footprint) / low.footprintBytes)
+		/ std::log2(static_cast<double>(high.footprintBytes) / low.footprintBytes);
+
+	auto mix = [t](double a, double b) { return a + (b - a) * t; };
+
+	CostBand band;
+	band.footprintBytes = footprint;
+	band.laneNanosecondsPerBlock = mix(low.laneNanosecondsPerBlock, high.laneNanosecondsPerBlock);
+	band.nanosecondsPerBlock = mix(low.nanosecondsPerBlock, high.nanosecondsPerBlock);
+	band.fillBytesPerSecond = mix(low.fillBytesPerSecond, high.fillBytesPerSecond);
+	band.readNanoseconds = mix(low.readNanoseconds, high.readNanoseconds);
+
+	return band;
+}
+
+CostPrediction CostModel::Predict(const HardwareProfile& profile, unsigned elementLengthMultiplier, unsigned processingCost,
+	unsigned parallelization, unsigned threadCount)
+{
+	if (elementLengthMultiplier == 0 || processingCost == 0 || parallelization == 0 || threadCount == 0)
+		throw std::invalid_argument("elementLengthMultiplier, processingCost, parallelization and threadCount must be greater than 0.");
+	if (profile.bands.empty() || profile.laneCount == 0)
+		throw std::invalid_argument("profile must have bands and a lane count greater than 0.");
+
+	const unsigned laneCount = profile.laneCount;
+	const double blockSteps = 4.0 * elementLengthMultiplier * processingCost;
+	const unsigned long long elementBytes = 128ull * elementLengthMultiplier * processingCost;
+
+	// SMixAll mixes whole groups of lanes and then the remaining elements one at a time
+	const unsigned groups = laneCount > 1 ? parallelization / laneCount : 0;
+	const unsigned singles = parallelization - groups * laneCount;
+	const unsigned units = groups + singles;
+	const unsigned threads = (std::min)(threadCount, units);
+
+	const double groupNanoseconds = laneCount * blockSteps * BandFor(profile, laneCount * elementBytes).laneNanosecondsPerBlock;
+	const double singleNanoseconds = blockSteps * BandFor(profile, elementBytes).nanosecondsPerBlock;
+
+	// groups spread evenly, so the lighter threads carry one load and the rest one more group
+	const double lightThreads = threads - groups % threads;
+	const double heavyThreads = groups % threads;
+	const double lightNanoseconds = (groups / threads) * groupNanoseconds;
+	const double heavyNanoseconds = lightNanoseconds + (heavyThreads > 0 ? groupNanoseconds : 0);
+
+	CostPrediction prediction;
+	prediction.nanoseconds = heavyNanoseconds;
+
+	// each single then goes to the least loaded thread: the lighter threads take turns until they catch up with the heavier
+	// ones, after which all of them take turns, the heavier ones first since they are now behind
+	if (singles > 0 && singleNanoseconds > 0)
+	{
+		double catchUpRounds = heavyThreads > 0 ? (std::ceil)((heavyNanoseconds - lightNanoseconds) / singleNanoseconds) : 0;
+
+		// the division may round across a whole number, where a lighter thread exactly catches up
+		if (catchUpRounds > 0 && lightNanoseconds + (catchUpRounds - 1) * singleNanoseconds >= heavyNanoseconds)
+			catchUpRounds--;
+
+		if (singles <= lightThreads * catchUpRounds)
+		{
+			prediction.nanoseconds = (std::max)(heavyNanoseconds,
+				lightNanoseconds + (std::ceil)(singles / lightThreads) * singleNanoseconds);
+		}
+		else
+		{
+			const double caughtUpNanoseconds = lightNanoseconds + catchUpRounds * singleNanoseconds;
+			const double remaining = singles - lightThreads * catchUpRounds;
+			const double rounds = (std::floor)(remaining / threads);
+			const double extra = remaining - rounds * threads;
+
+			prediction.nanoseconds = caughtUpNanoseconds + (extra > heavyThreads ? rounds + 1 : rounds) * singleNanoseconds;
+			if (extra > 0 && extra <= heavyThreads)
+				prediction.nanoseconds = (std::max)(prediction.nanoseconds, heavyNanoseconds + (rounds + 1) * singleNanoseconds);
+		}
+	}
+
+	// the first unit of every thread starts at once, groups first
+	const unsigned startedGroups = (std::min)(threads, groups);
+	const unsigned startedSingles = (std::min)(threads - startedGroups, singles);
+	prediction.bytes = (static_cast<unsigned long long>(startedGroups) * laneCount + startedSingles) * elementBytes
+		+ 128ull * elementLengthMultiplier * parallelization;
+
+	return prediction;
+}
+
+CostPrediction CostModel::Predict(unsigned elementLengthMultiplier, unsigned processingCost, unsigned parallelization,
+	unsigned threadCount)
+{
+	return Predict(CurrentProfile(), elementLengthMultiplier, processingCost, parallelization, threadCount);
+}
+
+OptimalParameters CostModel::Optimal(const HardwareProfile& profile, unsigned long long maxMemoryBytes, unsigned targetMilliseconds,
+	unsigned threadCount, unsigned elementLengthMultiplier)
+{
+	if (maxMemoryBytes == 0 || targetMilliseconds == 0 || threadCount == 0 || elementLengthMultiplier == 0)
+		throw std::invalid_argument("maxMemoryBytes, targetMilliseconds, threadCount and elementLengthMultiplier must be greater than 0.");
+
+	const double targetNanoseconds = targetMilliseconds * 1e6;
+	const unsigned long long minProcessingCost = 16;
+	const unsigned long long maxProcessingCost = 0x80000000ull;
+
+	OptimalParameters parameters;
+	parameters.elementLengthMultiplier = elementLengthMultiplier;
+	parameters.processingCost = 0;
+
+	for (unsigned long long i = minProcessingCost; i <= maxProcessingCost; i *= 2)
+	{
+		CostPrediction prediction = Predict(profile, elementLengthMultiplier, static_cast<unsigned>(i), 1, 1);
+
+		// an element that would not fit is never chosen, not even the smallest
+		if (prediction.bytes > maxMemoryBytes)
+			break;
+
+		parameters.processingCost = static_cast<unsigned>(i);
+
+		if (prediction.nanoseconds > targetNanoseconds)
+			break;
+	}
+
+	if (parameters.processingCost == 0)
+		throw std::bad_alloc();
+
+	const double threadedNanoseconds = Predict(profile, elementLengthMultiplier, parameters.processingCost, threadCount,
+		threadCount).nanoseconds;
+	const double parallelization = (std::floor)(threadCount * targetNanoseconds / threadedNanoseconds);
+
+	parameters.parallelization = static_cast<unsigned>((std::min)((std::max)(parallelization, 1.0), 0x3fffffff * 1.0));
+	parameters.threadCount = (std::min)(threadCount, parameters.parallelization);
+
+	return parameters;
+}
+
+OptimalParameters CostModel::Optimal(unsigned long long maxMemoryBytes, unsigned targetMilliseconds, unsigned threadCount,
+	unsigned elementLengthMultiplier)
+{
+	return Optimal(CurrentProfile(), maxMemoryBytes, targetMilliseconds, threadCount, elementLengthMultiplier);
+}
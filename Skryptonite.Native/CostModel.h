@@ -0,0 +1,255 @@
+/**
+* Skryptonite - Scrypt library for UWP
+* Copyright © 2016 Nicholas C. Bauer, Ph.D.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#pragma once
+#include "Platform.h"
+#include "DetectInstructionSet.h"
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace Skryptonite
+{
+	namespace Native
+	{
+		/**
+		<summary>The measured costs of mixing while the large memory blocks a thread works on at once total a given size.</summary>
+		<remarks>A block step is one 64-byte Salsa20/8 block of one SMix step, so an element takes 4 * r * N of them.</remarks>
+		*/
+		struct CostBand
+		{
+			/**
+			<summary>The bytes of large memory block one thread mixes in at once.</summary>
+			*/
+			unsigned long long footprintBytes;
+
+			/**
+			<summary>The time per block step of an element mixed with the others of a group of <see cref="HardwareProfile::laneCount"/>.</summary>
+			*/
+			double laneNanosecondsPerBlock;
+
+			/**
+			<summary>The time per block step of an element mixed on its own.</summary>
+			*/
+			double nanosecondsPerBlock;
+
+			/**
+			<summary>The bytes per second the first half of SMix writes to the large memory block.</summary>
+			*/
+			double fillBytesPerSecond;
+
+			/**
+			<summary>The time each random read of the second half of SMix adds to a step of the first half.</summary>
+			*/
+			double readNanoseconds;
+		};
+
+		/**
+		<summary>The costs that predict the time and memory of a derivation on one kind of processor.</summary>
+		*/
+		struct HardwareProfile
+		{
+			/**
+			<summary>The <see cref="CpuFeatures::ProcessorName"/> of the processor that was measured.</summary>
+			*/
+			std::string processorName;
+
+			/**
+			<summary>The <see cref="CpuFeatures::MaxInstructionSet"/> at the time of measurement.</summary>
+			*/
+			InstructionSet instructionSet;
+
+			/**
+			<summary>The <see cref="ScryptEngine::LaneCount"/> of the engines that were measured.</summary>
+			*/
+			unsigned laneCount;
+
+			/**
+			<summary>The Salsa20/8 blocks per second of the fill phase while the large memory block fits in the fastest cache.</summary>
+			*/
+			double salsaBlocksPerSecond;
+
+			/**
+			<summary>The costs for several footprints, smallest first.</summary>
+			*/
+			std::vector<CostBand> bands;
+		};
+
+		/**
+		<summary>The predicted cost of a derivation.</summary>
+		*/
+		struct CostPrediction
+		{
+			double nanoseconds;
+
+			/**
+			<summary>The large memory blocks of the elements that start at once, plus the data.</summary>
+			*/
+			unsigned long long bytes;
+		};
+
+		/**
+		<summary>Scrypt parameters chosen by <see cref="CostModel::Optimal"/>.</summary>
+		*/
+		struct OptimalParameters
+		{
+			unsigned processingCost;
+			unsigned elementLengthMultiplier;
+			unsigned parallelization;
+			unsigned threadCount;
+		};
+
+		/**
+		<summary>Predicts the time and memory of a derivation from a profile of short measurements, so that parameters can be chosen
+		without running the derivations they describe.</summary>
+		<remarks>
+		The profile is measured once with r = 8 and the engine defaults, and can be saved to a file that holds one profile per
+		processor and instruction set. Predictions for other r assume the cost per block is the same; predictions under a time-memory
+		trade-off or another interleave count are not meaningful.
+		</remarks>
+		*/
+		class CostModel
+		{
+		public:
+			/**
+			<summary>The largest footprint measured by default, in bytes. Larger footprints use the costs of the largest band.</summary>
+			*/
+			static const unsigned long long MaxCalibrationLength = 64 * 1024 * 1024;
+
+			/**
+			<summary>Measures this processor and makes the result the current profile.</summary>
+			<param name="maxFootprint">The largest footprint to measure, in bytes. The smallest band of 256 KiB is always measured.</param>
+			<returns>The new profile.</returns>
+			<remarks>Takes about a second with the default footprint. Must not be called while other threads change the engine
+			defaults.</remarks>
+			<exception cref="std::bad_alloc">Thrown when the working memory cannot be allocated.</exception>
+			*/
+			static HardwareProfile Calibrate(unsigned long long maxFootprint = MaxCalibrationLength);
+
+			/**
+			<summary>Makes the profile of this processor stored in a file the current profile.</summary>
+			<param name="path">The profile file, in UTF-8.</param>
+			<returns>True when the file exists and holds a profile that <see cref="Matches"/> this processor.</returns>
+			*/
+			static bool Load(const std::string& path);
+
+			/**
+			<summary>Stores the current profile in a file, replacing any earlier profile of the same processor and keeping the rest.</summary>
+			<param name="path">The profile file, in UTF-8, which is created when missing.</param>
+			<exception cref="std::logic_error">Thrown when there is no current profile.</exception>
+			<exception cref="std::runtime_error">Thrown when the file cannot be written.</exception>
+			*/
+			static void Save(const std::string& path);
+
+			/**
+			<summary>Gets the current profile, loading it from a file or else calibrating and saving it.</summary>
+			<param name="path">The profile file, in UTF-8, or empty to calibrate without saving.</param>
+			<returns>The current profile.</returns>
+			<exception cref="std::bad_alloc">Thrown when calibration cannot allocate its working memory.</exception>
+			<exception cref="std::runtime_error">Thrown when the file cannot be written.</exception>
+			*/
+			static HardwareProfile EnsureProfile(const std::string& path);
+
+			/**
+			<summary>Gets the current profile.</summary>
+			<param name="profile">Receives the profile.</param>
+			<returns>True when there is a current profile.</returns>
+			*/
+			static bool TryGetProfile(HardwareProfile& profile);
+
+			/**
+			<summary>Makes a profile the current one, such as one measured on another machine of the same kind.</summary>
+			<exception cref="std::invalid_argument">Thrown when the profile has no bands or a lane count of 0.</exception>
+			*/
+			static void SetProfile(const HardwareProfile& profile);
+
+			/**
+			<summary>Forgets the current profile.</summary>
+			*/
+			static void Reset();
+
+			/**
+			<summary>Gets whether a profile was measured on this kind of processor with the instruction set and lanes in use now.</summary>
+			*/
+			static bool Matches(const HardwareProfile& profile);
+
+			/**
+			<summary>Predicts the cost of a derivation.</summary>
+			<param name="profile">The profile to predict with.</param>
+			<param name="elementLengthMultiplier">The block size parameter r.</param>
+			<param name="processingCost">The CPU/memory cost parameter N.</param>
+			<param name="parallelization">The parallelization parameter p.</param>
+			<param name="threadCount">The threads the elements are spread over.</param>
+			<returns>The predicted wall time and memory.</returns>
+			<exception cref="std::invalid_argument">Thrown when a parameter is 0 or the profile has no bands.</exception>
+			*/
+			static CostPrediction Predict(const HardwareProfile& profile, unsigned elementLengthMultiplier, unsigned processingCost,
+				unsigned parallelization, unsigned threadCount);
+
+			/**
+			<summary>Predicts the cost of a derivation with the current profile, calibrating one without saving it when there is none.</summary>
+			*/
+			static CostPrediction Predict(unsigned elementLengthMultiplier, unsigned processingCost, unsigned parallelization,
+				unsigned threadCount);
+
+			/**
+			<summary>Chooses parameters by the rule Scrypt.CreateOptimal applied to measured derivations: N doubles from 16 until one
+			element takes longer than the target or the next N would not fit in the memory limit, then p is as many elements as the
+			threads finish in the target time.</summary>
+			<param name="profile">The profile to predict with.</param>
+			<param name="maxMemoryBytes">The most memory one element may use, its large memory block and its data, in bytes.</param>
+			<param name="targetMilliseconds">The time one derivation should take.</param>
+			<param name="threadCount">The threads the elements may be spread over.</param>
+			<param name="elementLengthMultiplier">The block size parameter r.</param>
+			<returns>The parameters, with N at least 16 and p at least 1.</returns>
+			<exception cref="std::invalid_argument">Thrown when a parameter is 0 or the profile has no bands.</exception>
+			<exception cref="std::bad_alloc">Thrown when the memory limit is too small for an element with N = 16.</exception>
+			*/
+			static OptimalParameters Optimal(const HardwareProfile& profile, unsigned long long maxMemoryBytes, unsigned targetMilliseconds,
+				unsigned threadCount, unsigned elementLengthMultiplier);
+
+			/**
+			<summary>Chooses parameters with the current profile, calibrating one without saving it when there is none.</summary>
+			*/
+			static OptimalParameters Optimal(unsigned long long maxMemoryBytes, unsigned targetMilliseconds, unsigned threadCount,
+				unsigned elementLengthMultiplier);
+
+		private:
+			static std::mutex _mutex;
+			static HardwareProfile _profile;
+			static std::atomic<bool> _hasProfile;
+
+			/**
+			<summary>Gets the current profile, calibrating one when there is none.</summary>
+			*/
+			static HardwareProfile CurrentProfile();
+
+			/**
+			<summary>Measures one band.</summary>
+			<param name="footprint">The bytes of large memory block one thread mixes in at once.</param>
+			<param name="laneCount">Receives the lane count of the engine that was measured.</param>
+			*/
+			static CostBand MeasureBand(unsigned long long footprint, unsigned& laneCount);
+
+			/**
+			<summary>Interpolates the costs of a footprint between the bands around it, linearly in the logarithm of the footprint.</summary>
+			*/
+			static CostBand BandFor(const HardwareProfile& profile, unsigned long long footprint);
+		};
+	}
+}
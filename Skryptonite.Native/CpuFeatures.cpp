@@ -0,0 +1,363 @@
+/**
+* Skryptonite - Scrypt library for UWP
+* Copyright © 2016 Nicholas C. Bauer, Ph.D.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "pch.h"
+#include "CpuFeatures.h"
+
+using namespace Skryptonite::Native;
+
+// for future: determine cache line size in case it changes from 64 bytes
+
+std::atomic<InstructionSet> CpuFeatures::_maxLevel(InstructionSet::Unknown);
+std::atomic<InstructionSet> CpuFeatures::_supportedLevel(InstructionSet::Unknown);
+std::atomic<bool> CpuFeatures::_shaExtensions(false);
+std::atomic<bool> CpuFeatures::_clflushOpt(false);
+std::atomic<size_t> CpuFeatures::_lastLevelCacheSize(0);
+std::atomic<bool> CpuFeatures::_isDetected(false);
+
+InstructionSet CpuFeatures::MaxInstructionSet()
+{
+	EnsureDetected();
+	return _maxLevel;
+}
+
+void CpuFeatures::SetMaxInstructionSet(InstructionSet value)
+{
+	EnsureDetected();
+	_maxLevel = value;
+}
+
+InstructionSet CpuFeatures::SupportedInstructionSet()
+{
+	EnsureDetected();
+	return _supportedLevel;
+}
+
+const char* CpuFeatures::InstructionSetName(InstructionSet value)
+{
+	switch (value)
+	{
+#if defined(SKRYPTONITE_X86)
+	case InstructionSet::SSE2:
+		return "SSE2";
+	case InstructionSet::SSSE3:
+		return "SSSE3";
+	case InstructionSet::SSE41:
+		return "SSE4.1";
+	case InstructionSet::AVX:
+		return "AVX";
+	case InstructionSet::AVX2:
+		return "AVX2";
+#endif
+#if defined(SKRYPTONITE_ARM)
+	case InstructionSet::NEON:
+		return "NEON";
+#endif
+	default:
+		return "Scalar";
+	}
+}
+
+bool CpuFeatures::ShaExtensions()
+{
+	EnsureDetected();
+	return _shaExtensions;
+}
+
+void CpuFeatures::SetShaExtensions(bool value)
+{
+	EnsureDetected();
+	_shaExtensions = value;
+}
+
+bool CpuFeatures::ClflushOpt()
+{
+	EnsureDetected();
+	return _clflushOpt;
+}
+
+void CpuFeatures::SetClflushOpt(bool value)
+{
+	EnsureDetected();
+	_clflushOpt = value;
+}
+
+size_t CpuFeatures::LastLevelCacheSize()
+{
+	EnsureDetected();
+	return _lastLevelCacheSize;
+}
+
+void CpuFeatures::SetLastLevelCacheSize(size_t value)
+{
+	EnsureDetected();
+	_lastLevelCacheSize = value;
+}
+
+void CpuFeatures::Detect()
+{
+	_supportedLevel = Query();
+	_maxLevel = _supportedLevel.load();
+	_shaExtensions = QueryShaExtensions();
+	_clflushOpt = QueryClflushOpt();
+	_lastLevelCacheSize = QueryLastLevelCacheSize();
+	_isDetected = true;
+}
+
+std::string CpuFeatures::ProcessorName()
+{
+	std::string name = QueryProcessorName();
+
+	// brand strings are padded with spaces
+	size_t first = name.find_first_not_of(' ');
+	size_t last = name.find_last_not_of(' ');
+
+	return first == std::string::npos ? "Unknown" : name.substr(first, last - first + 1);
+}
+
+void CpuFeatures::EnsureDetected()
+{
+	if (!_isDetected)
+		Detect();
+}
+
+#if defined(SKRYPTONITE_X86)
+union Registers
+{
+	int registers[4];
+	struct
+	{
+		unsigned eax;
+		unsigned ebx;
+		unsigned ecx;
+		unsigned edx;
+	};
+};
+
+static void CpuId(Registers& reg, unsigned leaf, unsigned subleaf)
+{
+#if defined(_MSC_VER)
+	__cpuidex(reg.registers, leaf, subleaf);
+#else
+	if (!__get_cpuid_count(leaf, subleaf, &reg.eax, &reg.ebx, &reg.ecx, &reg.edx))
+		reg.eax = reg.ebx = reg.ecx = reg.edx = 0;
+#endif
+}
+
+static unsigned long long GetExtendedControlRegister(unsigned index)
+{
+#if defined(_MSC_VER)
+	return _xgetbv(index);
+#else
+	unsigned eax, edx;
+	__asm__ __volatile__("xgetbv" : "=a"(eax), "=d"(edx) : "c"(index));
+	return (static_cast<unsigned long long>(edx) << 32) | eax;
+#endif
+}
+
+InstructionSet CpuFeatures::Query()
+{
+	Registers reg;
+
+	CpuId(reg, 1, 0);
+
+	// in ECX
+	unsigned ssse3_mask = (1 << 9);
+	unsigned sse41_mask = (1 << 19);
+	unsigned avx_mask = (1 << 26) | (1 << 27) | (1 << 28);
+	
+	bool is_ssse3_supported = (reg.ecx & ssse3_mask) == ssse3_mask;
+	if (!is_ssse3_supported)
+		return InstructionSet::SSE2;
+
+	bool is_sse41_supported = (reg.ecx & sse41_mask) == sse41_mask;
+	if (!is_sse41_supported)
+		return InstructionSet::SSSE3;
+
+	bool is_avx_supported = (reg.ecx & avx_mask) == avx_mask;
+	if (!is_avx_supported)
+		return InstructionSet::SSE41;
+
+	// check the control register
+	// the OS must save both the xmm and ymm states on context switches, otherwise AVX cannot be used at all
+	unsigned long long xcr0 = GetExtendedControlRegister(0);
+	if ((xcr0 & 6) != 6)
+		return InstructionSet::SSE41;
+
+	CpuId(reg, 7, 0);
+
+	// in EBX
+	unsigned avx2_mask = (1 << 5); // Required for enabling AVX2 generally, 256-bit intrinsics
+
+	bool is_avx2_supported = (reg.ebx & avx2_mask) == avx2_mask;
+	if (!is_avx2_supported)
+		return InstructionSet::AVX;
+	
+	return InstructionSet::AVX2;
+}
+
+bool CpuFeatures::QueryShaExtensions()
+{
+	Registers reg;
+
+	CpuId(reg, 0, 0);
+	if (reg.eax < 7)
+		return false;
+
+	CpuId(reg, 7, 0);
+
+	// in EBX
+	unsigned sha_mask = (1 << 29);
+
+	return (reg.ebx & sha_mask) == sha_mask;
+}
+
+bool CpuFeatures::QueryClflushOpt()
+{
+	Registers reg;
+
+	CpuId(reg, 0, 0);
+	if (reg.eax < 7)
+		return false;
+
+	CpuId(reg, 7, 0);
+
+	// in EBX
+	unsigned clflushopt_mask = (1 << 23);
+
+	return (reg.ebx & clflushopt_mask) == clflushopt_mask;
+}
+
+/**
+<summary>Finds the largest cache described by a deterministic cache parameters leaf, whose subleaves each describe one cache.</summary>
+*/
+static size_t QueryLargestCache(unsigned leaf)
+{
+	size_t largest = 0;
+
+	for (unsigned subleaf = 0; subleaf < 16; subleaf++)
+	{
+		Registers reg;
+		CpuId(reg, leaf, subleaf);
+
+		// cache type 0 ends the list; type 2 is the instruction cache
+		unsigned type = reg.eax & 0x1f;
+		if (type == 0)
+			break;
+		if (type == 2)
+			continue;
+
+		size_t ways = ((reg.ebx >> 22) & 0x3ff) + 1;
+		size_t partitions = ((reg.ebx >> 12) & 0x3ff) + 1;
+		size_t lineSize = (reg.ebx & 0xfff) + 1;
+		size_t sets = static_cast<size_t>(reg.ecx) + 1;
+		size_t size = ways * partitions * lineSize * sets;
+
+		if (size > largest)
+			largest = size;
+	}
+
+	return largest;
+}
+
+size_t CpuFeatures::QueryLastLevelCacheSize()
+{
+	Registers reg;
+
+	// Intel describes its caches in leaf 4, AMD in leaf 0x8000001D with the same layout
+	CpuId(reg, 0, 0);
+	size_t size = reg.eax >= 4 ? QueryLargestCache(4) : 0;
+
+	if (size == 0)
+	{
+		CpuId(reg, 0x80000000, 0);
+		if (reg.eax >= 0x8000001D)
+			size = QueryLargestCache(0x8000001D);
+	}
+
+	return size;
+}
+
+std::string CpuFeatures::QueryProcessorName()
+{
+	Registers reg;
+
+	CpuId(reg, 0x80000000, 0);
+	if (reg.eax < 0x80000004)
+		return std::string();
+
+	// 48 characters in the registers of three leaves, zero-padded
+	char brand[49] = {};
+	for (unsigned i = 0; i < 3; i++)
+	{
+		CpuId(reg, 0x80000002 + i, 0);
+		memcpy(brand + 16 * i, reg.registers, 16);
+	}
+
+	return std::string(brand);
+}
+#elif defined(SKRYPTONITE_ARM)
+InstructionSet CpuFeatures::Query()
+{
+	return InstructionSet::NEON;
+}
+
+bool CpuFeatures::QueryShaExtensions()
+{
+	return false;
+}
+
+bool CpuFeatures::QueryClflushOpt()
+{
+	return false;
+}
+
+size_t CpuFeatures::QueryLastLevelCacheSize()
+{
+	return 0;
+}
+
+std::string CpuFeatures::QueryProcessorName()
+{
+	return std::string();
+}
+#else
+InstructionSet CpuFeatures::Query()
+{
+	return InstructionSet::Unknown;
+}
+
+bool CpuFeatures::QueryShaExtensions()
+{
+	return false;
+}
+
+bool CpuFeatures::QueryClflushOpt()
+{
+	return false;
+}
+
+size_t CpuFeatures::QueryLastLevelCacheSize()
+{
+	return 0;
+}
+
+std::string CpuFeatures::QueryProcessorName()
+{
+	return std::string();
+}
+#endif
@@ -0,0 +1,162 @@
+/**
+* Skryptonite - Scrypt library for UWP
+* Copyright © 2016 Nicholas C. Bauer, Ph.D.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#pragma once
+#include "Platform.h"
+#include "DetectInstructionSet.h"
+#include <atomic>
+#include <string>
+
+namespace Skryptonite
+{
+	namespace Native
+	{
+		/**
+		<summary>Detects CPU instruction capabilities and holds the instruction set used by the native core.</summary>
+		<remarks>
+		Shared by the Windows Runtime <see cref="DetectInstructionSet"/> class and the portable API.
+		</remarks>
+		*/
+		class CpuFeatures
+		{
+		public:
+			/**
+			<summary>Gets the active instruction set.</summary>
+			<returns>The instruction set.</returns>
+			<remarks>
+			Reading this for the first time invokes <see cref="Detect"/>, unless a level has already been set.
+			</remarks>
+			*/
+			static InstructionSet MaxInstructionSet();
+
+			/**
+			<summary>Sets the active instruction set.</summary>
+			<param name="value">The instruction set. <see cref="InstructionSet::Unknown"/> selects the portable scalar implementation.</param>
+			<remarks>
+			Setting this value to a level not supported by the current system may result in exceptions in dependent code.
+			</remarks>
+			*/
+			static void SetMaxInstructionSet(InstructionSet value);
+
+			/**
+			<summary>Gets the highest instruction set the processor supports, regardless of <see cref="MaxInstructionSet"/>.</summary>
+			<remarks>
+			Reading this for the first time invokes <see cref="Detect"/>.
+			</remarks>
+			*/
+			static InstructionSet SupportedInstructionSet();
+
+			/**
+			<summary>Gets a short display name for an instruction set, such as "SSE4.1", or "Scalar" for the portable implementation.</summary>
+			*/
+			static const char* InstructionSetName(InstructionSet value);
+
+			/**
+			<summary>Gets whether the SHA extensions (SHA-NI) may be used for SHA-256.</summary>
+			<remarks>
+			Reading this for the first time invokes <see cref="Detect"/>, unless a value has already been set.
+			</remarks>
+			*/
+			static bool ShaExtensions();
+
+			/**
+			<summary>Sets whether the SHA extensions (SHA-NI) may be used for SHA-256.</summary>
+			<param name="value">True to allow the SHA extensions. Setting true on a system without them may result in exceptions in dependent code.</param>
+			*/
+			static void SetShaExtensions(bool value);
+
+			/**
+			<summary>Gets whether the weakly ordered cache line flush CLFLUSHOPT may be used.</summary>
+			<remarks>
+			Reading this for the first time invokes <see cref="Detect"/>, unless a value has already been set.
+			</remarks>
+			*/
+			static bool ClflushOpt();
+
+			/**
+			<summary>Sets whether the weakly ordered cache line flush CLFLUSHOPT may be used.</summary>
+			<param name="value">True to allow CLFLUSHOPT. Setting true on a system without it may result in exceptions in dependent code.</param>
+			*/
+			static void SetClflushOpt(bool value);
+
+			/**
+			<summary>Gets the size of the largest cache in bytes, or 0 when it is unknown.</summary>
+			<remarks>
+			Reading this for the first time invokes <see cref="Detect"/>, unless a value has already been set.
+			</remarks>
+			*/
+			static size_t LastLevelCacheSize();
+
+			/**
+			<summary>Sets the size of the largest cache in bytes used when choosing a cache policy automatically.</summary>
+			<param name="value">The size in bytes, or 0 when it is unknown.</param>
+			*/
+			static void SetLastLevelCacheSize(size_t value);
+
+			/**
+			<summary>Gets the name the processor reports for itself, such as its brand string on x86, or "Unknown".</summary>
+			*/
+			static std::string ProcessorName();
+
+			/**
+			<summary>Detects the supported instruction set and extensions and makes them active.</summary>
+			<remarks>
+			Assumes a minimum level of SSE2 for x86-64 and NEON for ARM. Other architectures use the scalar implementation.
+			</remarks>
+			*/
+			static void Detect();
+
+		private:
+			static std::atomic<InstructionSet> _maxLevel;
+			static std::atomic<InstructionSet> _supportedLevel;
+			static std::atomic<bool> _shaExtensions;
+			static std::atomic<bool> _clflushOpt;
+			static std::atomic<size_t> _lastLevelCacheSize;
+			static std::atomic<bool> _isDetected;
+
+			/**
+			<summary>Runs <see cref="Detect"/> if it has not run yet.</summary>
+			*/
+			static void EnsureDetected();
+
+			/**
+			<summary>Queries the CPU for the highest supported instruction set.</summary>
+			*/
+			static InstructionSet Query();
+
+			/**
+			<summary>Queries the CPU for the SHA extensions.</summary>
+			*/
+			static bool QueryShaExtensions();
+
+			/**
+			<summary>Queries the CPU for CLFLUSHOPT.</summary>
+			*/
+			static bool QueryClflushOpt();
+
+			/**
+			<summary>Queries the CPU for the size of its largest cache in bytes. Returns 0 when it cannot be determined.</summary>
+			*/
+			static size_t QueryLastLevelCacheSize();
+
+			/**
+			<summary>Queries the CPU for its name. Returns an empty string when it has none.</summary>
+			*/
+			static std::string QueryProcessorName();
+		};
+	}
+}
@@ -0,0 +1,365 @@
+/**
+* Skryptonite - Scrypt library for UWP
+* Copyright © 2016 Nicholas C. Bauer, Ph.D.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "pch.h"
+#include "DerivationCache.h"
+#include "ScryptEngine.h"
+#include <cstring>
+#include <limits>
+#include <new>
+#include <random>
+#include <stdexcept>
+
+#if defined(_WIN32) && !defined(__cplusplus_winrt)
+#define SKRYPTONITE_VIRTUAL_ALLOC
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#elif defined(__unix__) || defined(__APPLE__)
+#define SKRYPTONITE_MMAP
+#include <sys/mman.h>
+#endif
+
+using namespace Skryptonite::Native;
+
+/**
+<summary>Allocates memory and locks it in physical memory when the operating system allows.</summary>
+<param name="isLocked">Receives whether the memory is locked.</param>
+*/
+static unsigned char* AllocateLocked(size_t length, bool& isLocked)
+{
+#if defined(SKRYPTONITE_VIRTUAL_ALLOC)
+	void* memory = VirtualAlloc(nullptr, length, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+	if (memory == nullptr)
+		throw std::bad_alloc();
+
+	isLocked = VirtualLock(memory, length) != 0;
+#elif defined(SKRYPTONITE_MMAP)
+	void* memory = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (memory == MAP_FAILED)
+		throw std::bad_alloc();
+
+#if defined(MADV_DONTDUMP)
+	madvise(memory, length, MADV_DONTDUMP);
+#endif
+
+	// the limit on locked memory is often small, so a cache that cannot be locked still works
+	isLocked = mlock(memory, length) == 0;
+#else
+	void* memory = new unsigned char[length];
+	isLocked = false;
+#endif
+
+	return static_cast<unsigned char*>(memory);
+}
+
+/**
+<summary>Erases, unlocks and frees memory from <see cref="AllocateLocked"/>.</summary>
+*/
+static void FreeLocked(unsigned char* memory, size_t length, bool isLocked)
+{
+	SecureErase(memory, length);
+
+#if defined(SKRYPTONITE_VIRTUAL_ALLOC)
+	if (isLocked)
+		VirtualUnlock(memory, length);
+
+	VirtualFree(memory, 0, MEM_RELEASE);
+#elif defined(SKRYPTONITE_MMAP)
+	if (isLocked)
+		munlock(memory, length);
+
+	munmap(memory, length);
+#else
+	(void)isLocked;
+	delete[] memory;
+#endif
+}
+
+/**
+<summary>Adds a length to a hash as 8 little-endian bytes.</summary>
+*/
+static void UpdateWithLength(Sha256& hash, unsigned long long length)
+{
+	unsigned char bytes[8];
+
+	for (unsigned i = 0; i < 8; i++)
+		bytes[i] = static_cast<unsigned char>(length >> (8 * i));
+
+	hash.Update(bytes, sizeof(bytes));
+}
+
+size_t DerivationCache::DigestHash::operator()(const Digest& digest) const
+{
+	size_t value;
+	memcpy(&value, digest.data(), sizeof(value));
+
+	return value;
+}
+
+DerivationCache& DerivationCache::Global()
+{
+	// never destroyed, like the other process-wide state, so no derivation can outlive it
+	static DerivationCache* cache = new DerivationCache();
+	return *cache;
+}
+
+DerivationCache::DerivationCache() :
+	_memory(nullptr),
+	_memoryLength(0),
+	_isLocked(false),
+	_maxEntries(0),
+	_maxKeyLength(0),
+	_timeToLive(),
+	_statistics()
+{
+}
+
+DerivationCache::DerivationCache(size_t maxEntries, size_t maxKeyLength, std::chrono::milliseconds timeToLive) :
+	DerivationCache()
+{
+	Configure(maxEntries, maxKeyLength, timeToLive);
+}
+
+DerivationCache::~DerivationCache()
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	Free();
+}
+
+void DerivationCache::Configure(size_t maxEntries, size_t maxKeyLength, std::chrono::milliseconds timeToLive)
+{
+	if (maxEntries > 0 && (maxKeyLength == 0 || timeToLive.count() <= 0))
+		throw std::invalid_argument("maxKeyLength and timeToLive must be greater than 0.");
+	if (maxEntries > 0 && ((std::numeric_limits<size_t>::max)() - Sha256::HashLength) / maxEntries < maxKeyLength)
+		throw std::invalid_argument("maxEntries * maxKeyLength must be less than addressable memory.");
+
+	unsigned char* memory = nullptr;
+	size_t memoryLength = 0;
+	bool isLocked = false;
+
+	if (maxEntries > 0)
+	{
+		memoryLength = Sha256::HashLength + maxEntries * maxKeyLength;
+		memory = AllocateLocked(memoryLength, isLocked);
+
+		// a new secret also makes the digests of any earlier configuration meaningless
+		std::random_device random;
+		for (unsigned i = 0; i < Sha256::HashLength; i++)
+			memory[i] = static_cast<unsigned char>(random());
+	}
+
+	std::lock_guard<std::mutex> lock(_mutex);
+
+	Free();
+
+	_memory = memory;
+	_memoryLength = memoryLength;
+	_isLocked = isLocked;
+	_maxEntries = maxEntries;
+	_maxKeyLength = maxKeyLength;
+	_timeToLive = timeToLive;
+
+	_freeSlots.clear();
+	for (size_t slot = maxEntries; slot > 0; slot--)
+		_freeSlots.push_back(slot - 1);
+}
+
+bool DerivationCache::IsEnabled()
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	return _maxEntries > 0;
+}
+
+bool DerivationCache::TryGet(const unsigned char* password, size_t passwordLength, const unsigned char* salt, size_t saltLength,
+	unsigned elementLengthMultiplier, unsigned processingCost, unsigned parallelization,
+	unsigned char* derivedKey, size_t derivedKeyLength)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+
+	if (_maxEntries == 0)
+		return false;
+
+	Digest digest = KeyOf(password, passwordLength, salt, saltLength, elementLengthMultiplier, processingCost, parallelization,
+		derivedKeyLength);
+
+	auto found = _index.find(digest);
+	if (found == _index.end())
+	{
+		_statistics.misses++;
+		return false;
+	}
+
+	if (std::chrono::steady_clock::now() >= found->second->expiry)
+	{
+		Remove(found->second);
+		_statistics.expirations++;
+		_statistics.misses++;
+		return false;
+	}
+
+	_entries.splice(_entries.begin(), _entries, found->second);
+	memcpy(derivedKey, SlotData(found->second->slot), derivedKeyLength);
+	_statistics.hits++;
+
+	return true;
+}
+
+void DerivationCache::Put(const unsigned char* password, size_t passwordLength, const unsigned char* salt, size_t saltLength,
+	unsigned elementLengthMultiplier, unsigned processingCost, unsigned parallelization,
+	const unsigned char* derivedKey, size_t derivedKeyLength)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+
+	if (_maxEntries == 0)
+		return;
+
+	if (derivedKeyLength > _maxKeyLength)
+	{
+		_statistics.bypasses++;
+		return;
+	}
+
+	Digest digest = KeyOf(password, passwordLength, salt, saltLength, elementLengthMultiplier, processingCost, parallelization,
+		derivedKeyLength);
+
+	auto found = _index.find(digest);
+	if (found != _index.end())
+		Remove(found->second);
+
+	if (_freeSlots.empty())
+	{
+		Remove(std::prev(_entries.end()));
+		_statistics.evictions++;
+	}
+
+	Entry entry;
+	entry.digest = digest;
+	entry.slot = _freeSlots.back();
+	entry.length = derivedKeyLength;
+	entry.expiry = std::chrono::steady_clock::now() + _timeToLive;
+
+	_entries.push_front(entry);
+	_index[digest] = _entries.begin();
+	_freeSlots.pop_back();
+
+	memcpy(SlotData(entry.slot), derivedKey, derivedKeyLength);
+}
+
+void DerivationCache::DeriveKey(const unsigned char* password, size_t passwordLength, const unsigned char* salt, size_t saltLength,
+	unsigned elementLengthMultiplier, unsigned processingCost, unsigned parallelization,
+	unsigned char* derivedKey, size_t derivedKeyLength)
+{
+	// an invalid derivation must fail whether or not it was cached
+	ScryptEngine::ValidateParameters(elementLengthMultiplier, processingCost, parallelization);
+	ScryptEngine::ValidateRequest({ password, passwordLength, salt, saltLength, derivedKey, derivedKeyLength });
+
+	if (TryGet(password, passwordLength, salt, saltLength, elementLengthMultiplier, processingCost, parallelization, derivedKey,
+		derivedKeyLength))
+		return;
+
+	ScryptEngine::DeriveKey(password, passwordLength, salt, saltLength, elementLengthMultiplier, processingCost, parallelization,
+		derivedKey, derivedKeyLength);
+
+	Put(password, passwordLength, salt, saltLength, elementLengthMultiplier, processingCost, parallelization, derivedKey,
+		derivedKeyLength);
+}
+
+void DerivationCache::Clear()
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+
+	while (!_entries.empty())
+		Remove(_entries.begin());
+}
+
+DerivationCacheStatistics DerivationCache::Statistics()
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+
+	DerivationCacheStatistics statistics = _statistics;
+	statistics.entries = _entries.size();
+	statistics.maxEntries = _maxEntries;
+	statistics.lockedBytes = _isLocked ? _memoryLength : 0;
+
+	return statistics;
+}
+
+DerivationCache::Digest DerivationCache::KeyOf(const unsigned char* password, size_t passwordLength, const unsigned char* salt,
+	size_t saltLength, unsigned elementLengthMultiplier, unsigned processingCost, unsigned parallelization, size_t derivedKeyLength) const
+{
+	// HMAC-SHA256 keyed with the secret; every variable-length input is preceded by its length, so no two inputs hash alike
+	unsigned char pad[Sha256::BlockLength];
+	unsigned char inner[Sha256::HashLength];
+	Sha256 hash;
+	Digest digest;
+
+	memset(pad, 0x36, sizeof(pad));
+	for (unsigned i = 0; i < Sha256::HashLength; i++)
+		pad[i] ^= _memory[i];
+
+	hash.Initialize();
+	hash.Update(pad, sizeof(pad));
+	UpdateWithLength(hash, passwordLength);
+	hash.Update(password, passwordLength);
+	UpdateWithLength(hash, saltLength);
+	hash.Update(salt, saltLength);
+	UpdateWithLength(hash, elementLengthMultiplier);
+	UpdateWithLength(hash, processingCost);
+	UpdateWithLength(hash, parallelization);
+	UpdateWithLength(hash, derivedKeyLength);
+	hash.Final(inner);
+
+	memset(pad, 0x5c, sizeof(pad));
+	for (unsigned i = 0; i < Sha256::HashLength; i++)
+		pad[i] ^= _memory[i];
+
+	hash.Initialize();
+	hash.Update(pad, sizeof(pad));
+	hash.Update(inner, sizeof(inner));
+	hash.Final(digest.data());
+
+	SecureErase(pad, sizeof(pad));
+	SecureErase(inner, sizeof(inner));
+
+	return digest;
+}
+
+void DerivationCache::Remove(std::list<Entry>::iterator entry)
+{
+	SecureErase(SlotData(entry->slot), _maxKeyLength);
+
+	_freeSlots.push_back(entry->slot);
+	_index.erase(entry->digest);
+	_entries.erase(entry);
+}
+
+void DerivationCache::Free()
+{
+	_entries.clear();
+	_index.clear();
+	_freeSlots.clear();
+
+	if (_memory != nullptr)
+		FreeLocked(_memory, _memoryLength, _isLocked);
+
+	_memory = nullptr;
+	_memoryLength = 0;
+	_isLocked = false;
+	_maxEntries = 0;
+}
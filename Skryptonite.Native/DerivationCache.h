@@ -0,0 +1,224 @@
+/**
+* Skryptonite - Scrypt library for UWP
+* Copyright © 2016 Nicholas C. Bauer, Ph.D.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#pragma once
+#include "Platform.h"
+#include "Sha256.h"
+#include <array>
+#include <chrono>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace Skryptonite
+{
+	namespace Native
+	{
+		/**
+		<summary>A snapshot of how a <see cref="DerivationCache"/> has been used.</summary>
+		*/
+		struct DerivationCacheStatistics
+		{
+			unsigned long long entries;
+			unsigned long long maxEntries;
+			unsigned long long hits;
+			unsigned long long misses;
+
+			/**
+			<summary>The least recently used entries removed to make room for new ones.</summary>
+			*/
+			unsigned long long evictions;
+
+			/**
+			<summary>The entries removed because they outlived the time to live.</summary>
+			*/
+			unsigned long long expirations;
+
+			/**
+			<summary>The derived keys not cached because they are longer than the longest the cache holds.</summary>
+			*/
+			unsigned long long bypasses;
+
+			/**
+			<summary>The bytes of the cache locked in physical memory, 0 when the operating system refused to lock them.</summary>
+			*/
+			unsigned long long lockedBytes;
+		};
+
+		/**
+		<summary>Keeps recently derived keys so that repeated derivations with the same inputs, such as credentials verified
+		again and again, are answered without running Scrypt.</summary>
+		<remarks>
+		Entries are found by an HMAC-SHA256 of the password, salt, parameters and derived key length under a secret drawn when
+		the cache is configured, so the cache holds neither the passwords nor anything that could be matched against them
+		without the secret. The derived keys and the secret live in memory that is locked against paging where the operating
+		system allows, kept out of core dumps on Linux, and erased as soon as an entry leaves the cache. Entries leave the
+		cache when they are the least recently used one and room is needed, or when they are older than the time to live,
+		however often they are used. Concurrent misses for the same inputs each run Scrypt.
+		</remarks>
+		*/
+		class DerivationCache
+		{
+		public:
+			/**
+			<summary>The longest derived key <see cref="Global"/> holds when configured without a length.</summary>
+			*/
+			static const size_t DefaultMaxKeyLength = 64;
+
+			/**
+			<summary>Gets the cache the portable API and the Windows Runtime component consult. It holds nothing until configured.</summary>
+			*/
+			static DerivationCache& Global();
+
+			/**
+			<summary>Creates a cache that holds nothing until configured.</summary>
+			*/
+			DerivationCache();
+
+			/**
+			<summary>Creates and configures a cache.</summary>
+			<exception cref="std::invalid_argument">Thrown when a parameter is invalid as for <see cref="Configure"/>.</exception>
+			<exception cref="std::bad_alloc">Thrown when the memory for the derived keys cannot be allocated.</exception>
+			*/
+			DerivationCache(size_t maxEntries, size_t maxKeyLength, std::chrono::milliseconds timeToLive);
+
+			/**
+			<summary>Erases and frees every entry.</summary>
+			*/
+			~DerivationCache();
+
+			DerivationCache(const DerivationCache&) = delete;
+			DerivationCache& operator=(const DerivationCache&) = delete;
+
+			/**
+			<summary>Erases every entry, draws a new secret and sets the limits of the cache.</summary>
+			<param name="maxEntries">The most derived keys to hold, or 0 to hold none.</param>
+			<param name="maxKeyLength">The longest derived key to hold, in bytes. Every entry takes this much locked memory.</param>
+			<param name="timeToLive">How long a derived key is held after it is added.</param>
+			<exception cref="std::invalid_argument">Thrown when <paramref name="maxEntries"/> is not 0 and
+			<paramref name="maxKeyLength"/> or <paramref name="timeToLive"/> is not positive, or when the memory would be larger
+			than addressable memory.</exception>
+			<exception cref="std::bad_alloc">Thrown when the memory for the derived keys cannot be allocated.</exception>
+			*/
+			void Configure(size_t maxEntries, size_t maxKeyLength, std::chrono::milliseconds timeToLive);
+
+			/**
+			<summary>Gets whether the cache can hold any derived keys.</summary>
+			*/
+			bool IsEnabled();
+
+			/**
+			<summary>Looks up a derived key.</summary>
+			<param name="derivedKey">Receives the derived key on a hit, and is left unchanged otherwise.</param>
+			<returns>True on a hit. Always false when the cache is not enabled, which is not counted as a miss.</returns>
+			*/
+			bool TryGet(const unsigned char* password, size_t passwordLength, const unsigned char* salt, size_t saltLength,
+				unsigned elementLengthMultiplier, unsigned processingCost, unsigned parallelization,
+				unsigned char* derivedKey, size_t derivedKeyLength);
+
+			/**
+			<summary>Adds or refreshes a derived key, evicting the least recently used one when the cache is full.</summary>
+			<remarks>Does nothing when the cache is not enabled, and only counts a bypass when the key is too long.</remarks>
+			*/
+			void Put(const unsigned char* password, size_t passwordLength, const unsigned char* salt, size_t saltLength,
+				unsigned elementLengthMultiplier, unsigned processingCost, unsigned parallelization,
+				const unsigned char* derivedKey, size_t derivedKeyLength);
+
+			/**
+			<summary>Computes a derivation with <see cref="ScryptEngine::DeriveKey"/> unless the cache holds it, and caches the
+			result.</summary>
+			<exception cref="std::invalid_argument">Thrown as for <see cref="ScryptEngine::DeriveKey"/>, before the cache is
+			consulted.</exception>
+			<exception cref="std::bad_alloc">Thrown when the working memory cannot be allocated.</exception>
+			*/
+			void DeriveKey(const unsigned char* password, size_t passwordLength, const unsigned char* salt, size_t saltLength,
+				unsigned elementLengthMultiplier, unsigned processingCost, unsigned parallelization,
+				unsigned char* derivedKey, size_t derivedKeyLength);
+
+			/**
+			<summary>Erases every entry, keeping the limits and the counters.</summary>
+			*/
+			void Clear();
+
+			/**
+			<summary>Gets a snapshot of the cache.</summary>
+			*/
+			DerivationCacheStatistics Statistics();
+
+		private:
+			typedef std::array<unsigned char, Sha256::HashLength> Digest;
+
+			/**
+			<summary>Hashes a digest for the index. The digest is already uniformly distributed.</summary>
+			*/
+			struct DigestHash
+			{
+				size_t operator()(const Digest& digest) const;
+			};
+
+			/**
+			<summary>A cached derived key, whose bytes are in a slot of the locked memory.</summary>
+			*/
+			struct Entry
+			{
+				Digest digest;
+				size_t slot;
+				size_t length;
+				std::chrono::steady_clock::time_point expiry;
+			};
+
+			std::mutex _mutex;
+
+			// most recently used first
+			std::list<Entry> _entries;
+			std::unordered_map<Digest, std::list<Entry>::iterator, DigestHash> _index;
+			std::vector<size_t> _freeSlots;
+
+			// the secret followed by one slot of maxKeyLength bytes per entry
+			unsigned char* _memory;
+			size_t _memoryLength;
+			bool _isLocked;
+
+			size_t _maxEntries;
+			size_t _maxKeyLength;
+			std::chrono::steady_clock::duration _timeToLive;
+			DerivationCacheStatistics _statistics;
+
+			/**
+			<summary>Computes the keyed hash that identifies a derivation. Must be called with the lock held.</summary>
+			*/
+			Digest KeyOf(const unsigned char* password, size_t passwordLength, const unsigned char* salt, size_t saltLength,
+				unsigned elementLengthMultiplier, unsigned processingCost, unsigned parallelization, size_t derivedKeyLength) const;
+
+			/**
+			<summary>Gets the bytes of a slot.</summary>
+			*/
+			unsigned char* SlotData(size_t slot) const { return _memory + Sha256::HashLength + slot * _maxKeyLength; }
+
+			/**
+			<summary>Erases an entry and returns its slot. Must be called with the lock held.</summary>
+			*/
+			void Remove(std::list<Entry>::iterator entry);
+
+			/**
+			<summary>Erases every entry and frees the locked memory. Must be called with the lock held.</summary>
+			*/
+			void Free();
+		};
+	}
+}
@@ -0,0 +1,339 @@
+/**
+* Skryptonite - Scrypt library for UWP
+* Copyright © 2016 Nicholas C. Bauer, Ph.D.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "pch.h"
+#include "DerivationQueue.h"
+#include "ScryptEngine.h"
+#include <algorithm>
+#include <memory>
+#include <new>
+#include <stdexcept>
+
+using namespace Skryptonite::Native;
+
+DerivationQueue& DerivationQueue::Global()
+{
+	// never destroyed: joining threads while the process or library is unloading can deadlock
+	static DerivationQueue* queue = new DerivationQueue(DefaultMaxDepth, DefaultMaxBatch);
+	return *queue;
+}
+
+DerivationQueue::DerivationQueue(unsigned maxDepth, unsigned maxBatch) :
+	_maxDepth(maxDepth),
+	_maxBatch(maxBatch),
+	_nextTicket(1),
+	_isRunningBatch(false),
+	_isStopping(false),
+	_statistics()
+{
+	if (maxDepth == 0 || maxBatch == 0)
+		throw std::invalid_argument("maxDepth and maxBatch must be greater than 0.");
+
+	_dispatcher = std::thread([this]() { DispatcherMain(); });
+}
+
+DerivationQueue::~DerivationQueue()
+{
+	std::deque<Job> queued;
+
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+
+		_isStopping = true;
+		queued.swap(_jobs);
+		_statistics.queueDepth = 0;
+	}
+
+	_work.notify_all();
+	_room.notify_all();
+
+	for (Job& job : queued)
+		Finish(job, DerivationStatus::Cancelled);
+
+	_dispatcher.join();
+}
+
+unsigned long long DerivationQueue::Submit(const DerivationRequest& request, DerivationCallback callback)
+{
+	return Enqueue(request, std::move(callback), true);
+}
+
+unsigned long long DerivationQueue::TrySubmit(const DerivationRequest& request, DerivationCallback callback)
+{
+	return Enqueue(request, std::move(callback), false);
+}
+
+std::future<DerivationResult> DerivationQueue::SubmitFuture(const DerivationRequest& request, unsigned long long* ticket)
+{
+	auto promise = std::make_shared<std::promise<DerivationResult>>();
+	std::future<DerivationResult> future = promise->get_future();
+
+	unsigned long long submitted = Submit(request, [promise](DerivationResult& result) { promise->set_value(std::move(result)); });
+
+	if (ticket != nullptr)
+		*ticket = submitted;
+
+	return future;
+}
+
+unsigned long long DerivationQueue::Enqueue(const DerivationRequest& request, DerivationCallback callback, bool wait)
+{
+	if (!callback)
+		throw std::invalid_argument("callback must not be empty.");
+
+	// a queued derivation must not fail for reasons the caller could have been told about now
+	ScryptEngine::ValidateParameters(request.elementLengthMultiplier, request.processingCost, request.parallelization);
+
+	// the derived key is allocated below, so only its length is checked here
+	unsigned char placeholder = 0;
+	ScryptEngine::ValidateRequest({ request.password, request.passwordLength, request.salt, request.saltLength, &placeholder,
+		request.derivedKeyLength });
+
+	Job job;
+	job.password.assign(request.password, request.password + (request.password != nullptr ? request.passwordLength : 0));
+	job.salt.assign(request.salt, request.salt + (request.salt != nullptr ? request.saltLength : 0));
+	job.elementLengthMultiplier = request.elementLengthMultiplier;
+	job.processingCost = request.processingCost;
+	job.parallelization = request.parallelization;
+	job.derivedKey.resize(request.derivedKeyLength);
+	job.callback = std::move(callback);
+
+	bool wakeDispatcher;
+
+	{
+		std::unique_lock<std::mutex> lock(_mutex);
+
+		if (wait)
+			_room.wait(lock, [this]() { return _jobs.size() < _maxDepth || _isStopping; });
+
+		if (_isStopping)
+		{
+			lock.unlock();
+			SecureErase(job.password.data(), job.password.size());
+			throw std::logic_error("The queue is stopping.");
+		}
+
+		if (_jobs.size() >= _maxDepth)
+		{
+			_statistics.rejected++;
+			lock.unlock();
+			SecureErase(job.password.data(), job.password.size());
+			return 0;
+		}
+
+		job.ticket = _nextTicket++;
+
+		// the dispatcher only sleeps on an empty queue, so later submissions need not wake it again
+		wakeDispatcher = _jobs.empty() && !_isRunningBatch;
+
+		_jobs.push_back(std::move(job));
+		_statistics.submitted++;
+		_statistics.queueDepth = static_cast<unsigned>(_jobs.size());
+		_statistics.peakQueueDepth = (std::max)(_statistics.peakQueueDepth, _statistics.queueDepth);
+
+		if (wakeDispatcher)
+			_work.notify_one();
+
+		return _jobs.back().ticket;
+	}
+}
+
+bool DerivationQueue::Cancel(unsigned long long ticket)
+{
+	Job job;
+
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+
+		auto found = std::find_if(_jobs.begin(), _jobs.end(), [ticket](const Job& queued) { return queued.ticket == ticket; });
+		if (found == _jobs.end())
+			return false;
+
+		job = std::move(*found);
+		_jobs.erase(found);
+		_statistics.queueDepth = static_cast<unsigned>(_jobs.size());
+	}
+
+	_room.notify_one();
+	Finish(job, DerivationStatus::Cancelled);
+
+	std::lock_guard<std::mutex> lock(_mutex);
+	if (_jobs.empty() && !_isRunningBatch)
+		_idle.notify_all();
+
+	return true;
+}
+
+unsigned DerivationQueue::MaxDepth()
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	return _maxDepth;
+}
+
+void DerivationQueue::SetMaxDepth(unsigned value)
+{
+	if (value == 0)
+		throw std::invalid_argument("value must be greater than 0.");
+
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_maxDepth = value;
+	}
+
+	_room.notify_all();
+}
+
+DerivationQueueStatistics DerivationQueue::Statistics()
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	return _statistics;
+}
+
+void DerivationQueue::WaitIdle()
+{
+	std::unique_lock<std::mutex> lock(_mutex);
+	_idle.wait(lock, [this]() { return _jobs.empty() && !_isRunningBatch; });
+}
+
+void DerivationQueue::DispatcherMain()
+{
+	std::unique_lock<std::mutex> lock(_mutex);
+
+	for (;;)
+	{
+		_work.wait(lock, [this]() { return _isStopping || !_jobs.empty(); });
+
+		if (_isStopping)
+			break;
+
+		// everything queued since the last wakeup, up to a batch, is taken at once
+		std::vector<Job> batch;
+		while (!_jobs.empty() && batch.size() < _maxBatch)
+		{
+			batch.push_back(std::move(_jobs.front()));
+			_jobs.pop_front();
+		}
+
+		_isRunningBatch = true;
+		_statistics.batches++;
+		_statistics.queueDepth = static_cast<unsigned>(_jobs.size());
+
+		lock.unlock();
+		_room.notify_all();
+		RunBatch(batch);
+		lock.lock();
+
+		_isRunningBatch = false;
+		if (_jobs.empty())
+			_idle.notify_all();
+	}
+
+	_isRunningBatch = false;
+	_idle.notify_all();
+}
+
+void DerivationQueue::RunBatch(std::vector<Job>& batch)
+{
+	std::vector<bool> isDone(batch.size(), false);
+
+	for (size_t first = 0; first < batch.size(); first++)
+	{
+		if (isDone[first])
+			continue;
+
+		const Job& leader = batch[first];
+
+		// derivations with the same parameters share one call, so their elements fill the lanes of every thread together
+		std::vector<size_t> members;
+		std::vector<ScryptRequest> requests;
+		for (size_t i = first; i < batch.size(); i++)
+		{
+			Job& job = batch[i];
+			if (isDone[i] || job.elementLengthMultiplier != leader.elementLengthMultiplier
+				|| job.processingCost != leader.processingCost || job.parallelization != leader.parallelization)
+				continue;
+
+			members.push_back(i);
+			requests.push_back({ job.password.data(), job.password.size(), job.salt.data(), job.salt.size(),
+				job.derivedKey.data(), job.derivedKey.size() });
+			isDone[i] = true;
+		}
+
+		DerivationStatus status = DerivationStatus::Completed;
+
+		try
+		{
+			ScryptEngine::DeriveKeys(requests.data(), static_cast<unsigned>(requests.size()), leader.elementLengthMultiplier,
+				leader.processingCost, leader.parallelization, 0);
+		}
+		catch (const std::bad_alloc&)
+		{
+			status = DerivationStatus::OutOfMemory;
+		}
+		catch (...)
+		{
+			status = DerivationStatus::Failed;
+		}
+
+		for (size_t i : members)
+			Finish(batch[i], status);
+	}
+}
+
+void DerivationQueue::Finish(Job& job, DerivationStatus status)
+{
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+
+		switch (status)
+		{
+		case DerivationStatus::Completed:
+			_statistics.completed++;
+			break;
+		case DerivationStatus::Cancelled:
+			_statistics.cancelled++;
+			break;
+		default:
+			_statistics.failed++;
+			break;
+		}
+	}
+
+	SecureErase(job.password.data(), job.password.size());
+
+	DerivationResult result;
+	result.ticket = job.ticket;
+	result.status = status;
+
+	if (status == DerivationStatus::Completed)
+	{
+		result.derivedKey = std::move(job.derivedKey);
+	}
+	else
+	{
+		SecureErase(job.derivedKey.data(), job.derivedKey.size());
+	}
+
+	try
+	{
+		job.callback(result);
+	}
+	catch (...)
+	{
+		// the dispatcher must survive a misbehaving callback
+	}
+}
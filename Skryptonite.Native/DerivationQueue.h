@@ -0,0 +1,263 @@
+/**
+* Skryptonite - Scrypt library for UWP
+* Copyright © 2016 Nicholas C. Bauer, Ph.D.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#pragma once
+#include "Platform.h"
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Skryptonite
+{
+	namespace Native
+	{
+		/**
+		<summary>A derivation to run asynchronously. The queue copies everything it needs at submission.</summary>
+		*/
+		struct DerivationRequest
+		{
+			const unsigned char* password;
+			size_t passwordLength;
+			const unsigned char* salt;
+			size_t saltLength;
+			unsigned elementLengthMultiplier;
+			unsigned processingCost;
+			unsigned parallelization;
+			size_t derivedKeyLength;
+		};
+
+		/**
+		<summary>How a submitted derivation ended.</summary>
+		*/
+		enum class DerivationStatus
+		{
+			Completed,
+
+			/**
+			<summary>Removed from the queue by <see cref="DerivationQueue::Cancel"/> before it started.</summary>
+			*/
+			Cancelled,
+
+			/**
+			<summary>The working memory could not be allocated or reserved.</summary>
+			*/
+			OutOfMemory,
+
+			Failed
+		};
+
+		/**
+		<summary>The outcome of a submitted derivation.</summary>
+		*/
+		struct DerivationResult
+		{
+			unsigned long long ticket;
+			DerivationStatus status;
+
+			/**
+			<summary>The derived key when <see cref="status"/> is <see cref="DerivationStatus::Completed"/>, otherwise empty.</summary>
+			*/
+			std::vector<unsigned char> derivedKey;
+		};
+
+		/**
+		<summary>Receives the outcome of a submitted derivation. It may move the derived key out of the result.</summary>
+		*/
+		typedef std::function<void(DerivationResult& result)> DerivationCallback;
+
+		/**
+		<summary>A snapshot of how a <see cref="DerivationQueue"/> has been used.</summary>
+		*/
+		struct DerivationQueueStatistics
+		{
+			/**
+			<summary>The derivations waiting to start.</summary>
+			*/
+			unsigned queueDepth;
+
+			unsigned peakQueueDepth;
+			unsigned long long submitted;
+
+			/**
+			<summary>The submissions refused because the queue was full.</summary>
+			*/
+			unsigned long long rejected;
+
+			unsigned long long completed;
+			unsigned long long cancelled;
+			unsigned long long failed;
+
+			/**
+			<summary>The times the dispatcher woke and took derivations from the queue.</summary>
+			*/
+			unsigned long long batches;
+		};
+
+		/**
+		<summary>Runs derivations submitted from any thread on a dispatcher thread, so that the submitting threads do not wait for
+		them, and reports each outcome through a callback or a future.</summary>
+		<remarks>
+		The dispatcher is woken once for every run of submissions that finds it idle, takes up to the maximum batch of derivations
+		from the queue at once, and runs those that share parameters together with <see cref="ScryptEngine::DeriveKeys"/>, so every
+		thread of <see cref="ThreadPool::Global"/> and every lane stays busy even when each derivation has p = 1. Callbacks run on the
+		dispatcher thread once their batch finishes, so they should be short, and must not call the blocking <see cref="Submit"/>,
+		which could wait for the dispatcher itself. Exceptions they throw are ignored. Derivations can be cancelled until they
+		start; running derivations finish.
+		</remarks>
+		*/
+		class DerivationQueue
+		{
+		public:
+			/**
+			<summary>The queue depth of <see cref="Global"/>.</summary>
+			*/
+			static const unsigned DefaultMaxDepth = 1024;
+
+			/**
+			<summary>The most derivations the dispatcher of <see cref="Global"/> takes from the queue at once.</summary>
+			*/
+			static const unsigned DefaultMaxBatch = 64;
+
+			/**
+			<summary>Gets the queue shared by every caller.</summary>
+			*/
+			static DerivationQueue& Global();
+
+			/**
+			<summary>Creates a queue and starts its dispatcher thread.</summary>
+			<param name="maxDepth">The most derivations that may wait to start.</param>
+			<param name="maxBatch">The most derivations the dispatcher takes from the queue at once.</param>
+			<exception cref="std::invalid_argument">Thrown when a parameter is 0.</exception>
+			*/
+			DerivationQueue(unsigned maxDepth, unsigned maxBatch);
+
+			/**
+			<summary>Cancels the queued derivations, waits for the running ones and stops the dispatcher.</summary>
+			*/
+			~DerivationQueue();
+
+			DerivationQueue(const DerivationQueue&) = delete;
+			DerivationQueue& operator=(const DerivationQueue&) = delete;
+
+			/**
+			<summary>Queues a derivation, waiting while the queue is full.</summary>
+			<param name="request">The derivation. The password and salt are copied.</param>
+			<param name="callback">Receives the outcome on the dispatcher thread, or on the thread that cancels the derivation.</param>
+			<returns>The ticket that identifies the derivation, never 0.</returns>
+			<exception cref="std::invalid_argument">Thrown when the request is invalid as for <see cref="ScryptEngine::DeriveKey"/>
+			or the callback is empty.</exception>
+			*/
+			unsigned long long Submit(const DerivationRequest& request, DerivationCallback callback);
+
+			/**
+			<summary>Queues a derivation unless the queue is full.</summary>
+			<returns>The ticket that identifies the derivation, or 0 when the queue is full.</returns>
+			<exception cref="std::invalid_argument">Thrown when the request is invalid or the callback is empty.</exception>
+			*/
+			unsigned long long TrySubmit(const DerivationRequest& request, DerivationCallback callback);
+
+			/**
+			<summary>Queues a derivation, waiting while the queue is full, and returns a future of its outcome.</summary>
+			<param name="request">The derivation. The password and salt are copied.</param>
+			<param name="ticket">Receives the ticket that identifies the derivation, or may be null.</param>
+			<exception cref="std::invalid_argument">Thrown when the request is invalid.</exception>
+			*/
+			std::future<DerivationResult> SubmitFuture(const DerivationRequest& request, unsigned long long* ticket = nullptr);
+
+			/**
+			<summary>Removes a derivation from the queue and reports it cancelled through its callback on the calling thread.</summary>
+			<returns>True when the derivation was still queued; false when it has started, finished, or was never submitted.</returns>
+			*/
+			bool Cancel(unsigned long long ticket);
+
+			/**
+			<summary>Gets the most derivations that may wait to start.</summary>
+			*/
+			unsigned MaxDepth();
+
+			/**
+			<summary>Sets the most derivations that may wait to start. Derivations already queued beyond it stay queued.</summary>
+			<exception cref="std::invalid_argument">Thrown when <paramref name="value"/> is 0.</exception>
+			*/
+			void SetMaxDepth(unsigned value);
+
+			/**
+			<summary>Gets a snapshot of the queue.</summary>
+			*/
+			DerivationQueueStatistics Statistics();
+
+			/**
+			<summary>Waits until no derivation is queued or running.</summary>
+			*/
+			void WaitIdle();
+
+		private:
+			/**
+			<summary>A queued derivation with its own copies of the secrets.</summary>
+			*/
+			struct Job
+			{
+				unsigned long long ticket;
+				std::vector<unsigned char> password;
+				std::vector<unsigned char> salt;
+				unsigned elementLengthMultiplier;
+				unsigned processingCost;
+				unsigned parallelization;
+				std::vector<unsigned char> derivedKey;
+				DerivationCallback callback;
+			};
+
+			std::mutex _mutex;
+			std::condition_variable _work;
+			std::condition_variable _room;
+			std::condition_variable _idle;
+			std::deque<Job> _jobs;
+			unsigned _maxDepth;
+			unsigned _maxBatch;
+			unsigned long long _nextTicket;
+			bool _isRunningBatch;
+			bool _isStopping;
+			DerivationQueueStatistics _statistics;
+			std::thread _dispatcher;
+
+			/**
+			<summary>Copies and validates a request, and queues it when there is room.</summary>
+			<param name="wait">Whether to wait for room rather than return 0.</param>
+			*/
+			unsigned long long Enqueue(const DerivationRequest& request, DerivationCallback callback, bool wait);
+
+			/**
+			<summary>Takes batches of derivations from the queue and runs them until the queue stops.</summary>
+			*/
+			void DispatcherMain();
+
+			/**
+			<summary>Runs a batch of derivations, those sharing parameters together, and reports their outcomes.</summary>
+			*/
+			void RunBatch(std::vector<Job>& batch);
+
+			/**
+			<summary>Counts the outcome of a derivation, erases its secrets and reports the outcome.</summary>
+			*/
+			void Finish(Job& job, DerivationStatus status);
+		};
+	}
+}
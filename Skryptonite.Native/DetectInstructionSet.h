@@ -16,6 +16,7 @@
 * along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 #pragma once
+#include "Platform.h"
 
 namespace Skryptonite
 {
@@ -24,21 +25,22 @@ namespace Skryptonite
 		/**
 		<summary>Enumerates possible supported instruction set architectures.</summary>
 		*/
-		public enum class InstructionSet
+		SKRYPTONITE_WINRT_PUBLIC enum class InstructionSet
 		{
 			Unknown,
-#if defined(_M_IX86) || defined(_M_X64)
+#if defined(SKRYPTONITE_X86)
 			SSE2,
 			SSSE3,
 			SSE41,
 			AVX,
 			AVX2
 #endif
-#if defined(_M_ARM)
+#if defined(SKRYPTONITE_ARM)
 			NEON
 #endif
 		};
 
+#if defined(__cplusplus_winrt)
 		/**
 		<summary>Encapsulates routines to detect CPU instruction capabilities.</summary>
 		*/
@@ -56,17 +58,8 @@ namespace Skryptonite
 			*/
 			static property InstructionSet MaxInstructionSet
 			{
-				InstructionSet get()
-				{
-					if (_maxLevel == InstructionSet::Unknown)
-						Detect();
-
-					return _maxLevel;
-				}
-				void set(InstructionSet value)
-				{
-					_maxLevel = value;
-				}
+				InstructionSet get();
+				void set(InstructionSet value);
 			}
 
 			/**
@@ -77,10 +70,8 @@ namespace Skryptonite
 			</remarks>
 			*/
 			static void Detect();
-
-		private:
-			static InstructionSet _maxLevel;
 		};
+#endif
 	}
 }
 
@@ -0,0 +1,166 @@
+/**
+* Skryptonite - Scrypt library for UWP
+* Copyright © 2016 Nicholas C. Bauer, Ph.D.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "pch.h"
+#include "HardwareCounters.h"
+
+#if defined(__linux__)
+#define SKRYPTONITE_PERF_EVENT
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+using namespace Skryptonite::Native;
+
+#if defined(SKRYPTONITE_PERF_EVENT)
+/**
+<summary>The perf_event type and configuration of each <see cref="HardwareEvent"/>.</summary>
+*/
+static const struct
+{
+	unsigned type;
+	unsigned long long config;
+} EventTypes[] =
+{
+	{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+	{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+	{ PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_LL | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16) },
+	{ PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16) },
+	{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_STALLED_CYCLES_BACKEND },
+};
+
+static_assert(sizeof(EventTypes) / sizeof(EventTypes[0]) == static_cast<size_t>(HardwareEvent::Count),
+	"EventTypes must list every HardwareEvent.");
+
+/**
+<summary>The counters of one thread, open for as long as the thread runs.</summary>
+*/
+class ThreadCounters
+{
+public:
+	ThreadCounters() : _availableEvents(0)
+	{
+		for (unsigned i = 0; i < static_cast<unsigned>(HardwareEvent::Count); i++)
+		{
+			perf_event_attr attributes = {};
+			attributes.size = sizeof(attributes);
+			attributes.type = EventTypes[i].type;
+			attributes.config = EventTypes[i].config;
+			attributes.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+			attributes.exclude_kernel = 1;
+			attributes.exclude_hv = 1;
+
+			// this thread on whichever processor it runs
+			_descriptors[i] = static_cast<int>(syscall(__NR_perf_event_open, &attributes, 0, -1, -1, PERF_FLAG_FD_CLOEXEC));
+			if (_descriptors[i] >= 0)
+				_availableEvents |= 1u << i;
+		}
+	}
+
+	~ThreadCounters()
+	{
+		for (int descriptor : _descriptors)
+			if (descriptor >= 0)
+				close(descriptor);
+	}
+
+	ThreadCounters(const ThreadCounters&) = delete;
+	ThreadCounters& operator=(const ThreadCounters&) = delete;
+
+	unsigned AvailableEvents() const
+	{
+		return _availableEvents;
+	}
+
+	bool Read(unsigned long long* values) const
+	{
+		if (_availableEvents == 0)
+			return false;
+
+		unsigned long long totals[static_cast<size_t>(HardwareEvent::Count)] = {};
+
+		for (unsigned i = 0; i < static_cast<unsigned>(HardwareEvent::Count); i++)
+		{
+			// the count, then the time the event was enabled and the time it was actually counted
+			unsigned long long data[3];
+			if (_descriptors[i] < 0 || read(_descriptors[i], data, sizeof(data)) != static_cast<ssize_t>(sizeof(data)))
+				continue;
+
+			totals[i] = data[0];
+			if (data[2] > 0 && data[2] < data[1])
+				totals[i] = static_cast<unsigned long long>(static_cast<double>(data[0]) * data[1] / data[2]);
+		}
+
+		for (unsigned i = 0; i < static_cast<unsigned>(HardwareEvent::Count); i++)
+			values[i] = totals[i];
+
+		return true;
+	}
+
+private:
+	int _descriptors[static_cast<size_t>(HardwareEvent::Count)];
+	unsigned _availableEvents;
+};
+
+/**
+<summary>Gets the counters of the calling thread, opening them on first use.</summary>
+*/
+static ThreadCounters& CurrentCounters()
+{
+	static thread_local ThreadCounters counters;
+	return counters;
+}
+#endif
+
+unsigned HardwareCounters::AvailableEvents()
+{
+#if defined(SKRYPTONITE_PERF_EVENT)
+	return CurrentCounters().AvailableEvents();
+#else
+	return 0;
+#endif
+}
+
+bool HardwareCounters::Read(unsigned long long* values)
+{
+#if defined(SKRYPTONITE_PERF_EVENT)
+	return CurrentCounters().Read(values);
+#else
+	(void)values;
+	return false;
+#endif
+}
+
+const char* HardwareCounters::EventName(HardwareEvent event)
+{
+	switch (event)
+	{
+	case HardwareEvent::Cycles:
+		return "cycles";
+	case HardwareEvent::Instructions:
+		return "instructions";
+	case HardwareEvent::LastLevelCacheMisses:
+		return "LLC misses";
+	case HardwareEvent::DataTlbMisses:
+		return "dTLB misses";
+	case HardwareEvent::MemoryStallCycles:
+		return "memory stall cycles";
+	default:
+		return "unknown";
+	}
+}
@@ -0,0 +1,91 @@
+/**
+* Skryptonite - Scrypt library for UWP
+* Copyright © 2016 Nicholas C. Bauer, Ph.D.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#pragma once
+#include "Platform.h"
+
+namespace Skryptonite
+{
+	namespace Native
+	{
+		/**
+		<summary>The processor events counted around the phases of a derivation.</summary>
+		*/
+		enum class HardwareEvent
+		{
+			/**
+			<summary>Core clock cycles, which unlike the time-stamp counter follow turbo and power saving.</summary>
+			*/
+			Cycles,
+
+			/**
+			<summary>Instructions retired.</summary>
+			*/
+			Instructions,
+
+			/**
+			<summary>Reads that missed the last-level cache and went to memory.</summary>
+			*/
+			LastLevelCacheMisses,
+
+			/**
+			<summary>Reads that missed the data translation lookaside buffer and walked the page table.</summary>
+			*/
+			DataTlbMisses,
+
+			/**
+			<summary>Cycles in which the back end stalled, mostly waiting for memory in SMix. Many Intel processors do not
+			expose this event generically, in which case it is not counted.</summary>
+			*/
+			MemoryStallCycles,
+			Count
+		};
+
+		/**
+		<summary>Reads the processor's performance counters for the calling thread, through perf_event_open on Linux.</summary>
+		<remarks>
+		Each thread opens its counters the first time it reads them and closes them when it exits. Only user-mode events are
+		counted, which the default perf_event_paranoid setting allows. Counters are unavailable on other systems, in virtual
+		machines without a virtual PMU, and where the events are restricted; each event is opened on its own so that one the
+		processor lacks does not hide the others. When the kernel multiplexes the counters, the values are scaled to the time
+		they were enabled.
+		</remarks>
+		*/
+		class HardwareCounters
+		{
+		public:
+			/**
+			<summary>Gets the events the calling thread can count, one bit per <see cref="HardwareEvent"/>, or 0 when none
+			can.</summary>
+			*/
+			static unsigned AvailableEvents();
+
+			/**
+			<summary>Reads the running totals of the calling thread.</summary>
+			<param name="values">Receives <see cref="HardwareEvent::Count"/> totals, 0 for the events that are not
+			available.</param>
+			<returns>False, leaving <paramref name="values"/> unchanged, when no event is available.</returns>
+			*/
+			static bool Read(unsigned long long* values);
+
+			/**
+			<summary>Gets a short name for an event.</summary>
+			*/
+			static const char* EventName(HardwareEvent event);
+		};
+	}
+}
@@ -0,0 +1,341 @@
+/**
+* Skryptonite - Scrypt library for UWP
+* Copyright © 2016 Nicholas C. Bauer, Ph.D.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "pch.h"
+#include "MappedScratch.h"
+#include "ScratchPool.h"
+#include <algorithm>
+#include <new>
+#include <stdexcept>
+#include <system_error>
+#include <vector>
+
+#if defined(_WIN32) && !defined(__cplusplus_winrt)
+#define SKRYPTONITE_FILE_MAPPING
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#elif defined(__unix__) || defined(__APPLE__)
+#define SKRYPTONITE_MMAP
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace Skryptonite::Native;
+
+// the zeros that erase the file are written in runs of this length
+const size_t EraseRunLength = 1024 * 1024;
+
+#if defined(SKRYPTONITE_FILE_MAPPING)
+/**
+<summary>Converts a UTF-8 path to the UTF-16 the file functions of Windows take.</summary>
+*/
+static std::wstring NativePath(const std::string& path)
+{
+	int length = MultiByteToWideChar(CP_UTF8, 0, path.c_str(), -1, nullptr, 0);
+	if (length <= 0)
+		throw std::invalid_argument("directory is not valid UTF-8.");
+
+	std::wstring result(length, L'\0');
+	MultiByteToWideChar(CP_UTF8, 0, path.c_str(), -1, &result[0], length);
+	result.resize(length - 1);
+
+	return result;
+}
+#endif
+
+bool MappedScratch::IsSupported()
+{
+#if defined(SKRYPTONITE_FILE_MAPPING) || defined(SKRYPTONITE_MMAP)
+	return true;
+#else
+	return false;
+#endif
+}
+
+MappedScratch::MappedScratch(const std::string& directory, const ScratchRequirements& requirements) :
+	_scratch(),
+	_largeMemoryBlockLength(requirements.largeMemoryBlockLength),
+	_buffersLength(requirements.bufferLength * requirements.bufferCount),
+	_pageLength(4096),
+	_pool(nullptr),
+	_file(-1),
+	_section(nullptr)
+{
+	if (directory.empty())
+		throw std::invalid_argument("directory must not be empty.");
+	if (!IsSupported())
+		throw std::runtime_error("Large memory blocks cannot be kept in files on this platform.");
+
+	try
+	{
+		Open(directory);
+
+		ScratchPool& pool = ScratchPool::Current();
+		unsigned char* buffers = static_cast<unsigned char*>(pool.Acquire(_buffersLength));
+		_pool = &pool;
+
+		_scratch.workingBuffer = buffers;
+		_scratch.shuffleBuffer = buffers + requirements.bufferLength;
+
+		if (requirements.bufferCount > 2)
+		{
+			_scratch.rebuildBuffer = buffers + 2 * requirements.bufferLength;
+			_scratch.rebuildShuffleBuffer = buffers + 3 * requirements.bufferLength;
+		}
+	}
+	catch (...)
+	{
+		Close();
+		throw;
+	}
+}
+
+MappedScratch::~MappedScratch()
+{
+	Close();
+}
+
+void MappedScratch::Open(const std::string& directory)
+{
+#if defined(SKRYPTONITE_FILE_MAPPING)
+	std::wstring path = NativePath(directory);
+	wchar_t name[MAX_PATH];
+
+	if (GetTempFileNameW(path.c_str(), L"sky", 0, name) == 0)
+		throw std::system_error(GetLastError(), std::system_category(), "Unable to create a file in " + directory);
+
+	// a temporary file is kept in the cache where possible, and deleted however the process ends
+	HANDLE file = CreateFileW(name, GENERIC_READ | GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS,
+		FILE_ATTRIBUTE_TEMPORARY | FILE_FLAG_DELETE_ON_CLOSE, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+	{
+		DWORD error = GetLastError();
+		DeleteFileW(name);
+		throw std::system_error(error, std::system_category(), "Unable to create a file in " + directory);
+	}
+
+	_file = reinterpret_cast<intptr_t>(file);
+
+	LARGE_INTEGER length;
+	length.QuadPart = static_cast<LONGLONG>(_largeMemoryBlockLength);
+	if (!SetFilePointerEx(file, length, nullptr, FILE_BEGIN) || !SetEndOfFile(file))
+	{
+		DWORD error = GetLastError();
+		if (error == ERROR_DISK_FULL)
+			throw std::bad_alloc();
+
+		throw std::system_error(error, std::system_category(), "Unable to size the file.");
+	}
+
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	_pageLength = info.dwPageSize;
+
+	_section = CreateFileMappingW(file, nullptr, PAGE_READWRITE, 0, 0, nullptr);
+	if (_section == nullptr)
+		throw std::system_error(GetLastError(), std::system_category(), "Unable to map the file.");
+
+	_scratch.largeMemoryBlock = MapViewOfFile(_section, FILE_MAP_ALL_ACCESS, 0, 0, _largeMemoryBlockLength);
+	if (_scratch.largeMemoryBlock == nullptr)
+		throw std::system_error(GetLastError(), std::system_category(), "Unable to map the file.");
+#elif defined(SKRYPTONITE_MMAP)
+	int file = -1;
+
+#if defined(O_TMPFILE)
+	// a file without a name cannot be left behind, even if the process is killed
+	file = open(directory.c_str(), O_TMPFILE | O_RDWR | O_CLOEXEC, S_IRUSR | S_IWUSR);
+#endif
+
+	if (file < 0)
+	{
+		std::string path = directory + "/skryptonite-XXXXXX";
+
+		file = mkstemp(&path[0]);
+		if (file < 0)
+			throw std::system_error(errno, std::generic_category(), "Unable to create a file in " + directory);
+
+		unlink(path.c_str());
+	}
+
+	_file = file;
+
+	// writing to a page of a sparse file that the storage cannot hold raises a signal, so every block is allocated now
+#if defined(__linux__)
+	int error = posix_fallocate(file, 0, static_cast<off_t>(_largeMemoryBlockLength));
+#else
+	int error = ftruncate(file, static_cast<off_t>(_largeMemoryBlockLength)) == 0 ? 0 : errno;
+#endif
+
+	if (error == ENOSPC || error == EFBIG)
+		throw std::bad_alloc();
+	if (error != 0)
+		throw std::system_error(error, std::generic_category(), "Unable to size the file.");
+
+	_pageLength = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+
+	void* mapping = mmap(nullptr, _largeMemoryBlockLength, PROT_READ | PROT_WRITE, MAP_SHARED, file, 0);
+	if (mapping == MAP_FAILED)
+		throw std::system_error(errno, std::generic_category(), "Unable to map the file.");
+
+	_scratch.largeMemoryBlock = mapping;
+#else
+	(void)directory;
+#endif
+}
+
+void MappedScratch::AdviseSequential()
+{
+#if defined(SKRYPTONITE_MMAP)
+	// only a hint, so failure does not matter
+	madvise(_scratch.largeMemoryBlock, _largeMemoryBlockLength, MADV_SEQUENTIAL);
+#endif
+}
+
+void MappedScratch::AdviseRandom()
+{
+#if defined(SKRYPTONITE_MMAP)
+	madvise(_scratch.largeMemoryBlock, _largeMemoryBlockLength, MADV_RANDOM);
+#endif
+}
+
+void MappedScratch::Prefetch(size_t offset, size_t length)
+{
+	// the hints take whole pages
+	size_t start = offset - offset % _pageLength;
+	unsigned char* address = static_cast<unsigned char*>(_scratch.largeMemoryBlock) + start;
+	length = (std::min)(offset + length, _largeMemoryBlockLength) - start;
+
+#if defined(SKRYPTONITE_FILE_MAPPING)
+	WIN32_MEMORY_RANGE_ENTRY range = { address, length };
+	PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+#elif defined(SKRYPTONITE_MMAP)
+	madvise(address, length, MADV_WILLNEED);
+#else
+	(void)address;
+#endif
+}
+
+void MappedScratch::WriteBack(size_t offset, size_t length)
+{
+	size_t start = offset - offset % _pageLength;
+	unsigned char* address = static_cast<unsigned char*>(_scratch.largeMemoryBlock) + start;
+	length = (std::min)(offset + length, _largeMemoryBlockLength) - start;
+
+#if defined(SKRYPTONITE_FILE_MAPPING)
+	FlushViewOfFile(address, length);
+#elif defined(SKRYPTONITE_MMAP) && defined(__linux__)
+	// starts the writes without waiting for them or touching the mapping
+	(void)address;
+	sync_file_range(static_cast<int>(_file), static_cast<off_t>(start), static_cast<off_t>(length), SYNC_FILE_RANGE_WRITE);
+#elif defined(SKRYPTONITE_MMAP)
+	msync(address, length, MS_ASYNC);
+#else
+	(void)address;
+#endif
+}
+
+void MappedScratch::EraseFile()
+{
+	std::vector<unsigned char> zeros((std::min)(EraseRunLength, _largeMemoryBlockLength), 0);
+
+#if defined(SKRYPTONITE_FILE_MAPPING)
+	HANDLE file = reinterpret_cast<HANDLE>(_file);
+	LARGE_INTEGER start = {};
+
+	if (!SetFilePointerEx(file, start, nullptr, FILE_BEGIN))
+		return;
+
+	for (size_t offset = 0; offset < _largeMemoryBlockLength; )
+	{
+		DWORD written = 0;
+		DWORD length = static_cast<DWORD>((std::min)(zeros.size(), _largeMemoryBlockLength - offset));
+
+		if (!WriteFile(file, zeros.data(), length, &written, nullptr) || written == 0)
+			return;
+
+		offset += written;
+	}
+
+	FlushFileBuffers(file);
+#elif defined(SKRYPTONITE_MMAP)
+	int file = static_cast<int>(_file);
+
+	for (size_t offset = 0; offset < _largeMemoryBlockLength; )
+	{
+		ssize_t written = pwrite(file, zeros.data(), (std::min)(zeros.size(), _largeMemoryBlockLength - offset), static_cast<off_t>(offset));
+
+		if (written < 0 && errno == EINTR)
+			continue;
+		if (written <= 0)
+			return;
+
+		offset += static_cast<size_t>(written);
+	}
+
+	// the pages of a deleted file are dropped rather than written when it is closed, so the zeros must be written now
+#if defined(__linux__)
+	fdatasync(file);
+#else
+	fsync(file);
+#endif
+#endif
+}
+
+void MappedScratch::Close()
+{
+	if (_pool != nullptr)
+	{
+		_pool->Release(_scratch.workingBuffer, _buffersLength);
+		_pool = nullptr;
+	}
+
+	// nothing is written to the file except through the mapping
+	const bool isWritten = _scratch.largeMemoryBlock != nullptr;
+
+#if defined(SKRYPTONITE_FILE_MAPPING)
+	if (_scratch.largeMemoryBlock != nullptr)
+		UnmapViewOfFile(_scratch.largeMemoryBlock);
+	if (_section != nullptr)
+		CloseHandle(_section);
+	if (_file != -1)
+	{
+		if (isWritten)
+			EraseFile();
+		CloseHandle(reinterpret_cast<HANDLE>(_file));
+	}
+#elif defined(SKRYPTONITE_MMAP)
+	if (_scratch.largeMemoryBlock != nullptr)
+		munmap(_scratch.largeMemoryBlock, _largeMemoryBlockLength);
+	if (_file != -1)
+	{
+		if (isWritten)
+			EraseFile();
+		close(static_cast<int>(_file));
+	}
+#else
+	(void)isWritten;
+#endif
+
+	_scratch = ScryptScratch();
+	_section = nullptr;
+	_file = -1;
+}
@@ -0,0 +1,136 @@
+/**
+* Skryptonite - Scrypt library for UWP
+* Copyright © 2016 Nicholas C. Bauer, Ph.D.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#pragma once
+#include "ScryptEngine.h"
+#include <string>
+
+namespace Skryptonite
+{
+	namespace Native
+	{
+		/**
+		<summary>Scratch memory for one SMix whose large memory block is a memory-mapped temporary file rather than RAM, for
+		derivations whose large memory blocks do not fit in memory.</summary>
+		<remarks>
+		The file is created in the given directory, preallocated so that running out of storage fails here rather than inside
+		SMix, and deleted when it is closed. The large memory block would let a password be checked far more cheaply than with
+		Scrypt, so the file is overwritten with zeros and flushed to storage before it is closed. The working buffers are small,
+		and are taken from <see cref="ScratchPool::Current"/> as usual.
+		</remarks>
+		*/
+		class MappedScratch
+		{
+		public:
+			/**
+			<summary>The length of the runs in which <see cref="ScryptEngine"/> hands the filled part of the large memory block to
+			storage.</summary>
+			*/
+			static const size_t WriteBackLength = 8 * 1024 * 1024;
+
+			/**
+			<summary>Gets whether large memory blocks can be kept in files on this platform.</summary>
+			*/
+			static bool IsSupported();
+
+			/**
+			<summary>Creates and maps the file and takes the working buffers.</summary>
+			<param name="directory">The directory to create the file in, as UTF-8. Should be on fast local storage.</param>
+			<param name="requirements">The lengths of the regions, from <see cref="ScryptEngine::ScratchRequirementsFor"/>.</param>
+			<exception cref="std::invalid_argument">Thrown when <paramref name="directory"/> is empty.</exception>
+			<exception cref="std::runtime_error">Thrown when the file cannot be created or mapped, or when the platform does not
+			support it.</exception>
+			<exception cref="std::bad_alloc">Thrown when there is not enough storage for the file or memory for the working
+			buffers.</exception>
+			*/
+			MappedScratch(const std::string& directory, const ScratchRequirements& requirements);
+
+			/**
+			<summary>Erases and closes the file, and releases the working buffers.</summary>
+			*/
+			~MappedScratch();
+
+			MappedScratch(const MappedScratch&) = delete;
+			MappedScratch& operator=(const MappedScratch&) = delete;
+
+			/**
+			<summary>Gets the regions to mix in.</summary>
+			*/
+			const ScryptScratch& Scratch() const { return _scratch; }
+
+			/**
+			<summary>Gets the length of the pages the file is mapped in.</summary>
+			*/
+			size_t PageLength() const { return _pageLength; }
+
+			/**
+			<summary>Tells the operating system the large memory block is about to be written from start to end.</summary>
+			*/
+			void AdviseSequential();
+
+			/**
+			<summary>Tells the operating system the large memory block is about to be read in random order, so reading ahead of
+			each read would waste storage bandwidth.</summary>
+			*/
+			void AdviseRandom();
+
+			/**
+			<summary>Starts reading part of the large memory block from storage without waiting for it.</summary>
+			<param name="offset">The offset of the part in bytes.</param>
+			<param name="length">The length of the part in bytes.</param>
+			*/
+			void Prefetch(size_t offset, size_t length);
+
+			/**
+			<summary>Starts writing part of the large memory block to storage without waiting for it, so that dirty pages do not
+			accumulate until the operating system stalls the writer.</summary>
+			<param name="offset">The offset of the part in bytes.</param>
+			<param name="length">The length of the part in bytes.</param>
+			*/
+			void WriteBack(size_t offset, size_t length);
+
+		private:
+			ScryptScratch _scratch;
+			size_t _largeMemoryBlockLength;
+			size_t _buffersLength;
+			size_t _pageLength;
+			ScratchPool* _pool;
+
+			// a file descriptor, or a file handle on Windows
+			intptr_t _file;
+
+			// the file mapping object on Windows
+			void* _section;
+
+			/**
+			<summary>Opens the file, reserves its storage and maps it.</summary>
+			*/
+			void Open(const std::string& directory);
+
+			/**
+			<summary>Overwrites the file with zeros through the file rather than the mapping, so pages that were evicted are not
+			read back only to be erased, and waits until the zeros reach storage.</summary>
+			*/
+			void EraseFile();
+
+			/**
+			<summary>Unmaps, erases and closes the file and releases the working buffers, as far as they were acquired.</summary>
+			*/
+			void Close();
+		};
+	}
+}
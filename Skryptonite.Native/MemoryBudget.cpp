@@ -0,0 +1,284 @@
+/**
+* Skryptonite - Scrypt library for UWP
+* Copyright © 2016 Nicholas C. Bauer, Ph.D.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "pch.h"
+#include "MemoryBudget.h"
+#include "ScratchPool.h"
+#include <algorithm>
+#include <limits>
+#include <new>
+
+using namespace Skryptonite::Native;
+
+MemoryBudget& MemoryBudget::Global()
+{
+	static MemoryBudget budget([](unsigned long long room)
+	{
+		ScratchPool::Global().TrimShared(static_cast<size_t>((std::min)(room,
+			static_cast<unsigned long long>((std::numeric_limits<size_t>::max)()))));
+	});
+
+	return budget;
+}
+
+MemoryBudget::MemoryBudget() :
+	MemoryBudget(nullptr)
+{
+}
+
+MemoryBudget::MemoryBudget(std::function<void(unsigned long long)> reclaim) :
+	_reclaim(std::move(reclaim)),
+	_limit(0),
+	_reserved(0),
+	_maxWait(0),
+	_nextTicket(0),
+	_statistics()
+{
+}
+
+unsigned long long MemoryBudget::Limit()
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	return _limit;
+}
+
+void MemoryBudget::SetLimit(unsigned long long value)
+{
+	unsigned long long room;
+
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_limit = value;
+		room = Room();
+	}
+
+	Reclaim(room);
+	_released.notify_all();
+}
+
+std::chrono::milliseconds MemoryBudget::MaxWait()
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	return _maxWait;
+}
+
+void MemoryBudget::SetMaxWait(std::chrono::milliseconds value)
+{
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_maxWait = value;
+	}
+
+	_released.notify_all();
+}
+
+void MemoryBudget::Reserve(unsigned long long bytes)
+{
+	std::unique_lock<std::mutex> lock(_mutex);
+
+	if (_queue.empty() && Fits(bytes))
+	{
+		Admit(bytes);
+		unsigned long long room = Room();
+		lock.unlock();
+
+		Reclaim(room);
+		return;
+	}
+
+	if (_limit > 0 && bytes > _limit)
+	{
+		_statistics.rejections++;
+		throw std::bad_alloc();
+	}
+
+	unsigned long long ticket = _nextTicket++;
+	auto position = _queue.insert(_queue.end(), ticket);
+	_statistics.peakQueueDepth = (std::max)(_statistics.peakQueueDepth, static_cast<unsigned>(_queue.size()));
+
+	auto start = std::chrono::steady_clock::now();
+	bool isRefused = false;
+
+	for (;;)
+	{
+		// a lowered limit may have made the reservation impossible
+		if (_limit > 0 && bytes > _limit)
+		{
+			isRefused = true;
+			break;
+		}
+
+		if (_queue.front() == ticket && Fits(bytes))
+			break;
+
+		if (_maxWait.count() == 0)
+			_released.wait(lock);
+		else if (_released.wait_until(lock, start + _maxWait) == std::cv_status::timeout && !(_queue.front() == ticket && Fits(bytes)))
+		{
+			isRefused = true;
+			break;
+		}
+	}
+
+	_queue.erase(position);
+
+	unsigned long long waited = static_cast<unsigned long long>(
+		std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+	_statistics.totalWaitNanoseconds += waited;
+	_statistics.maxWaitNanoseconds = (std::max)(_statistics.maxWaitNanoseconds, waited);
+
+	if (isRefused)
+	{
+		_statistics.rejections++;
+		lock.unlock();
+
+		// the next reservation in line may fit where this one did not
+		_released.notify_all();
+		throw std::bad_alloc();
+	}
+
+	_statistics.waits++;
+	Admit(bytes);
+	unsigned long long room = Room();
+	lock.unlock();
+
+	Reclaim(room);
+
+	// later reservations may fit in what is left
+	_released.notify_all();
+}
+
+bool MemoryBudget::TryReserve(unsigned long long bytes)
+{
+	unsigned long long room;
+
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+
+		if (!_queue.empty() || !Fits(bytes))
+			return false;
+
+		Admit(bytes);
+		room = Room();
+	}
+
+	Reclaim(room);
+	return true;
+}
+
+void MemoryBudget::Release(unsigned long long bytes)
+{
+	unsigned long long room;
+
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_ASSERT(bytes <= _reserved);
+		_reserved -= bytes;
+		room = Room();
+	}
+
+	// the memory being released was usually just kept, without the room for it having been checked
+	Reclaim(room);
+	_released.notify_all();
+}
+
+MemoryBudgetStatistics MemoryBudget::Statistics()
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+
+	MemoryBudgetStatistics statistics = _statistics;
+	statistics.limitBytes = _limit;
+	statistics.reservedBytes = _reserved;
+	statistics.queueDepth = static_cast<unsigned>(_queue.size());
+
+	return statistics;
+}
+
+void MemoryBudget::ResetStatistics()
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+
+	_statistics = MemoryBudgetStatistics();
+	_statistics.peakReservedBytes = _reserved;
+	_statistics.peakQueueDepth = static_cast<unsigned>(_queue.size());
+}
+
+bool MemoryBudget::Fits(unsigned long long bytes) const
+{
+	return _limit == 0 || (_reserved <= _limit && bytes <= _limit - _reserved);
+}
+
+void MemoryBudget::Admit(unsigned long long bytes)
+{
+	_reserved += bytes;
+	_statistics.admissions++;
+	_statistics.peakReservedBytes = (std::max)(_statistics.peakReservedBytes, _reserved);
+}
+
+unsigned long long MemoryBudget::Room() const
+{
+	if (_limit == 0)
+		return (std::numeric_limits<unsigned long long>::max)();
+
+	return _reserved < _limit ? _limit - _reserved : 0;
+}
+
+void MemoryBudget::Reclaim(unsigned long long room)
+{
+	if (_reclaim && room != (std::numeric_limits<unsigned long long>::max)())
+		_reclaim(room);
+}
+
+MemoryReservation::MemoryReservation() :
+	_budget(nullptr),
+	_bytes(0)
+{
+}
+
+MemoryReservation::MemoryReservation(MemoryBudget& budget, unsigned long long bytes) :
+	_budget(nullptr),
+	_bytes(0)
+{
+	budget.Reserve(bytes);
+	_budget = &budget;
+	_bytes = bytes;
+}
+
+MemoryReservation::~MemoryReservation()
+{
+	Release();
+}
+
+void MemoryReservation::ReserveNow(MemoryBudget& budget, unsigned long long bytes)
+{
+	Release();
+
+	if (!budget.TryReserve(bytes))
+		throw std::bad_alloc();
+
+	_budget = &budget;
+	_bytes = bytes;
+}
+
+void MemoryReservation::Release()
+{
+	if (_budget != nullptr)
+		_budget->Release(_bytes);
+
+	_budget = nullptr;
+	_bytes = 0;
+}
@@ -0,0 +1,234 @@
+/**
+* Skryptonite - Scrypt library for UWP
+* Copyright © 2016 Nicholas C. Bauer, Ph.D.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#pragma once
+#include "Platform.h"
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <list>
+#include <mutex>
+
+namespace Skryptonite
+{
+	namespace Native
+	{
+		/**
+		<summary>A snapshot of how a <see cref="MemoryBudget"/> has been used.</summary>
+		*/
+		struct MemoryBudgetStatistics
+		{
+			/**
+			<summary>The limit in bytes, or 0 when there is none.</summary>
+			*/
+			unsigned long long limitBytes;
+
+			unsigned long long reservedBytes;
+			unsigned long long peakReservedBytes;
+
+			/**
+			<summary>The number of reservations waiting for memory to be released.</summary>
+			*/
+			unsigned queueDepth;
+
+			unsigned peakQueueDepth;
+
+			/**
+			<summary>The number of reservations granted, with or without waiting.</summary>
+			*/
+			unsigned long long admissions;
+
+			/**
+			<summary>The number of granted reservations that had to wait.</summary>
+			*/
+			unsigned long long waits;
+
+			/**
+			<summary>The number of reservations refused because they could never fit or waited longer than the maximum wait.</summary>
+			*/
+			unsigned long long rejections;
+
+			unsigned long long totalWaitNanoseconds;
+			unsigned long long maxWaitNanoseconds;
+		};
+
+		/**
+		<summary>Limits the memory that SMix elements running at the same time may use, making further elements wait their turn
+		instead of failing to allocate.</summary>
+		<remarks>
+		Every SMix reserves the large memory blocks of the elements it mixes before allocating anything, and releases them when it
+		returns. Reservations that do not fit wait in first-come, first-served order, so a burst of derivations runs at the
+		memory ceiling rather than some of them failing with half of their elements already mixed. There is no limit until one
+		is set. Memory kept between elements, such as the buffers of a <see cref="ScratchPool"/>, counts against the limit
+		through a reclaim function. The budget calls it with the room left whenever that room shrinks, or memory may have
+		been kept since the last call, so what is kept plus what is reserved stays within the limit.
+		</remarks>
+		*/
+		class MemoryBudget
+		{
+		public:
+			/**
+			<summary>Gets the budget every engine reserves from. It reclaims from <see cref="ScratchPool::Global"/> and the pools
+			sharing its limit.</summary>
+			*/
+			static MemoryBudget& Global();
+
+			/**
+			<summary>Creates a budget with no memory kept outside the reservations.</summary>
+			*/
+			MemoryBudget();
+
+			/**
+			<summary>Creates a budget that counts memory kept outside the reservations against its limit.</summary>
+			<param name="reclaim">Frees kept memory until no more than the given number of bytes is kept. It is called without the
+			budget's lock held, and must not reserve from the budget.</param>
+			*/
+			explicit MemoryBudget(std::function<void(unsigned long long)> reclaim);
+
+			MemoryBudget(const MemoryBudget&) = delete;
+			MemoryBudget& operator=(const MemoryBudget&) = delete;
+
+			/**
+			<summary>Gets the most bytes that may be reserved at once, or 0 when there is no limit.</summary>
+			*/
+			unsigned long long Limit();
+
+			/**
+			<summary>Sets the most bytes that may be reserved at once. Reservations already granted are kept even when they exceed a
+			lower limit; waiting ones are reconsidered.</summary>
+			<param name="value">The limit in bytes, or 0 for none.</param>
+			*/
+			void SetLimit(unsigned long long value);
+
+			/**
+			<summary>Gets the longest a reservation waits before it is refused, or 0 to wait as long as it takes.</summary>
+			*/
+			std::chrono::milliseconds MaxWait();
+
+			/**
+			<summary>Sets the longest a reservation waits before it is refused.</summary>
+			<param name="value">The time, or 0 to wait as long as it takes.</param>
+			*/
+			void SetMaxWait(std::chrono::milliseconds value);
+
+			/**
+			<summary>Reserves memory, waiting behind earlier reservations until it fits.</summary>
+			<param name="bytes">The number of bytes.</param>
+			<exception cref="std::bad_alloc">Thrown when <paramref name="bytes"/> exceeds the limit, or when the reservation waits
+			longer than <see cref="MaxWait"/>.</exception>
+			*/
+			void Reserve(unsigned long long bytes);
+
+			/**
+			<summary>Reserves memory only if it fits now and nothing is waiting.</summary>
+			<param name="bytes">The number of bytes.</param>
+			<returns>True when the memory was reserved.</returns>
+			*/
+			bool TryReserve(unsigned long long bytes);
+
+			/**
+			<summary>Returns memory obtained from <see cref="Reserve"/> or <see cref="TryReserve"/>.</summary>
+			*/
+			void Release(unsigned long long bytes);
+
+			/**
+			<summary>Gets how the budget has been used.</summary>
+			*/
+			MemoryBudgetStatistics Statistics();
+
+			/**
+			<summary>Clears the counters and peaks, keeping the limit and the current reservations and queue.</summary>
+			*/
+			void ResetStatistics();
+
+		private:
+			const std::function<void(unsigned long long)> _reclaim;
+
+			std::mutex _mutex;
+			std::condition_variable _released;
+			unsigned long long _limit;
+			unsigned long long _reserved;
+			std::chrono::milliseconds _maxWait;
+
+			// the tickets of waiting reservations, oldest first
+			std::list<unsigned long long> _queue;
+			unsigned long long _nextTicket;
+
+			MemoryBudgetStatistics _statistics;
+
+			/**
+			<summary>Gets whether a reservation fits under the limit. The caller must hold the mutex.</summary>
+			*/
+			bool Fits(unsigned long long bytes) const;
+
+			/**
+			<summary>Records a granted reservation. The caller must hold the mutex.</summary>
+			*/
+			void Admit(unsigned long long bytes);
+
+			/**
+			<summary>Gets the bytes that memory kept outside the reservations may take, or the largest value when there is no
+			limit. The caller must hold the mutex.</summary>
+			*/
+			unsigned long long Room() const;
+
+			/**
+			<summary>Trims the memory kept outside the reservations to the room read by <see cref="Room"/>. The caller must not
+			hold the mutex.</summary>
+			*/
+			void Reclaim(unsigned long long room);
+		};
+
+		/**
+		<summary>Holds memory reserved from a <see cref="MemoryBudget"/> until it is destroyed or released.</summary>
+		*/
+		class MemoryReservation
+		{
+		public:
+			/**
+			<summary>Creates a reservation that holds nothing.</summary>
+			*/
+			MemoryReservation();
+
+			/**
+			<summary>Reserves memory, waiting as <see cref="MemoryBudget::Reserve"/> does.</summary>
+			<exception cref="std::bad_alloc">Thrown when the memory cannot be reserved.</exception>
+			*/
+			MemoryReservation(MemoryBudget& budget, unsigned long long bytes);
+
+			~MemoryReservation();
+
+			MemoryReservation(const MemoryReservation&) = delete;
+			MemoryReservation& operator=(const MemoryReservation&) = delete;
+
+			/**
+			<summary>Reserves memory only if it fits without waiting, replacing what the reservation held.</summary>
+			<exception cref="std::bad_alloc">Thrown when the memory does not fit now.</exception>
+			*/
+			void ReserveNow(MemoryBudget& budget, unsigned long long bytes);
+
+			/**
+			<summary>Returns the memory to the budget early.</summary>
+			*/
+			void Release();
+
+		private:
+			MemoryBudget* _budget;
+			unsigned long long _bytes;
+		};
+	}
+}
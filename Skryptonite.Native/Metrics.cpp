@@ -0,0 +1,313 @@
+/**
+* Skryptonite - Scrypt library for UWP
+* Copyright © 2016 Nicholas C. Bauer, Ph.D.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "pch.h"
+#include "Metrics.h"
+#include <algorithm>
+#include <limits>
+
+#if defined(SKRYPTONITE_METRICS)
+#if defined(_WIN32)
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+#endif
+
+using namespace Skryptonite::Native;
+
+// values below 2^SubBucketBits have a bucket each; every higher power of 2 is split into 2^SubBucketBits buckets
+const unsigned SubBucketBits = 4;
+const unsigned SubBucketCount = 1u << SubBucketBits;
+
+static_assert(HistogramSnapshot::BucketCount == (64 - SubBucketBits + 1) * SubBucketCount, "BucketCount must cover every 64-bit value.");
+
+unsigned HistogramSnapshot::BucketIndex(unsigned long long value)
+{
+	if (value < SubBucketCount)
+		return static_cast<unsigned>(value);
+
+	unsigned highestBit = 63;
+	while ((value >> highestBit) == 0)
+		highestBit--;
+
+	// keep the highest SubBucketBits + 1 bits, the first of which is always set
+	unsigned shift = highestBit - SubBucketBits;
+	return (shift + 1) * SubBucketCount + static_cast<unsigned>((value >> shift) - SubBucketCount);
+}
+
+unsigned long long HistogramSnapshot::BucketUpperBound(unsigned index)
+{
+	if (index < SubBucketCount)
+		return index;
+
+	unsigned shift = index / SubBucketCount - 1;
+	unsigned long long lowerBound = static_cast<unsigned long long>(SubBucketCount + index % SubBucketCount) << shift;
+
+	return lowerBound + ((1ull << shift) - 1);
+}
+
+unsigned long long HistogramSnapshot::ValueAtPercentile(double percentile) const
+{
+	if (count == 0 || buckets.empty())
+		return 0;
+
+	double clamped = (std::min)((std::max)(percentile, 0.0), 100.0);
+	unsigned long long rank = static_cast<unsigned long long>(clamped / 100 * count + 0.5);
+	if (rank == 0)
+		rank = 1;
+
+	unsigned long long seen = 0;
+
+	for (unsigned i = 0; i < buckets.size(); i++)
+	{
+		seen += buckets[i];
+
+		if (seen >= rank)
+			return (std::min)(BucketUpperBound(i), max);
+	}
+
+	return max;
+}
+
+#if defined(SKRYPTONITE_METRICS)
+/**
+<summary>A histogram that any number of threads may record into at once.</summary>
+*/
+class ConcurrentHistogram
+{
+public:
+	void Record(unsigned long long value)
+	{
+		_buckets[HistogramSnapshot::BucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+		_count.fetch_add(1, std::memory_order_relaxed);
+		_sum.fetch_add(value, std::memory_order_relaxed);
+
+		unsigned long long current = _min.load(std::memory_order_relaxed);
+		while (value < current && !_min.compare_exchange_weak(current, value, std::memory_order_relaxed));
+
+		current = _max.load(std::memory_order_relaxed);
+		while (value > current && !_max.compare_exchange_weak(current, value, std::memory_order_relaxed));
+	}
+
+	HistogramSnapshot Snapshot() const
+	{
+		HistogramSnapshot snapshot = { _count.load(std::memory_order_relaxed), _sum.load(std::memory_order_relaxed), 0, 0, {} };
+
+		if (snapshot.count == 0)
+			return snapshot;
+
+		snapshot.min = _min.load(std::memory_order_relaxed);
+		snapshot.max = _max.load(std::memory_order_relaxed);
+		snapshot.buckets.resize(HistogramSnapshot::BucketCount);
+
+		for (unsigned i = 0; i < HistogramSnapshot::BucketCount; i++)
+			snapshot.buckets[i] = _buckets[i].load(std::memory_order_relaxed);
+
+		return snapshot;
+	}
+
+	void Reset()
+	{
+		for (auto& bucket : _buckets)
+			bucket.store(0, std::memory_order_relaxed);
+
+		_count.store(0, std::memory_order_relaxed);
+		_sum.store(0, std::memory_order_relaxed);
+		_min.store((std::numeric_limits<unsigned long long>::max)(), std::memory_order_relaxed);
+		_max.store(0, std::memory_order_relaxed);
+	}
+
+private:
+	std::atomic<unsigned long long> _buckets[HistogramSnapshot::BucketCount] = {};
+	std::atomic<unsigned long long> _count{ 0 };
+	std::atomic<unsigned long long> _sum{ 0 };
+	std::atomic<unsigned long long> _min{ (std::numeric_limits<unsigned long long>::max)() };
+	std::atomic<unsigned long long> _max{ 0 };
+};
+
+/**
+<summary>The recorded durations of one phase.</summary>
+*/
+struct PhaseMetrics
+{
+	ConcurrentHistogram wallTime;
+	ConcurrentHistogram cpuTime;
+	std::atomic<unsigned long long> bytes{ 0 };
+	std::atomic<unsigned long long> hardwareEvents[static_cast<size_t>(HardwareEvent::Count)] = {};
+	std::atomic<unsigned long long> hardwareSamples{ 0 };
+};
+
+static std::atomic<bool> _isEnabled(true);
+static std::atomic<bool> _areHardwareCountersEnabled(false);
+static PhaseMetrics _phases[static_cast<size_t>(MetricsPhase::Count)];
+static std::atomic<unsigned long long> _counters[static_cast<size_t>(MetricsCounter::Count)];
+#endif
+
+bool Metrics::IsCompiledIn()
+{
+#if defined(SKRYPTONITE_METRICS)
+	return true;
+#else
+	return false;
+#endif
+}
+
+bool Metrics::IsEnabled()
+{
+#if defined(SKRYPTONITE_METRICS)
+	return _isEnabled.load(std::memory_order_relaxed);
+#else
+	return false;
+#endif
+}
+
+void Metrics::SetEnabled(bool value)
+{
+#if defined(SKRYPTONITE_METRICS)
+	_isEnabled = value;
+#else
+	(void)value;
+#endif
+}
+
+bool Metrics::AreHardwareCountersEnabled()
+{
+#if defined(SKRYPTONITE_METRICS)
+	return _areHardwareCountersEnabled.load(std::memory_order_relaxed);
+#else
+	return false;
+#endif
+}
+
+void Metrics::SetHardwareCountersEnabled(bool value)
+{
+#if defined(SKRYPTONITE_METRICS)
+	_areHardwareCountersEnabled = value;
+#else
+	(void)value;
+#endif
+}
+
+MetricsSnapshot Metrics::Snapshot()
+{
+	MetricsSnapshot snapshot = {};
+
+#if defined(SKRYPTONITE_METRICS)
+	for (size_t i = 0; i < static_cast<size_t>(MetricsPhase::Count); i++)
+	{
+		snapshot.phases[i].wallTime = _phases[i].wallTime.Snapshot();
+		snapshot.phases[i].cpuTime = _phases[i].cpuTime.Snapshot();
+		snapshot.phases[i].bytes = _phases[i].bytes.load(std::memory_order_relaxed);
+		snapshot.phases[i].hardwareSamples = _phases[i].hardwareSamples.load(std::memory_order_relaxed);
+
+		for (size_t j = 0; j < static_cast<size_t>(HardwareEvent::Count); j++)
+			snapshot.phases[i].hardwareEvents[j] = _phases[i].hardwareEvents[j].load(std::memory_order_relaxed);
+	}
+
+	for (size_t i = 0; i < static_cast<size_t>(MetricsCounter::Count); i++)
+		snapshot.counters[i] = _counters[i].load(std::memory_order_relaxed);
+#endif
+
+	return snapshot;
+}
+
+void Metrics::Reset()
+{
+#if defined(SKRYPTONITE_METRICS)
+	for (PhaseMetrics& phase : _phases)
+	{
+		phase.wallTime.Reset();
+		phase.cpuTime.Reset();
+		phase.bytes.store(0, std::memory_order_relaxed);
+		phase.hardwareSamples.store(0, std::memory_order_relaxed);
+
+		for (auto& events : phase.hardwareEvents)
+			events.store(0, std::memory_order_relaxed);
+	}
+
+	for (auto& counter : _counters)
+		counter.store(0, std::memory_order_relaxed);
+#endif
+}
+
+void Metrics::RecordPhase(MetricsPhase phase, unsigned long long wallTime, unsigned long long cpuTime, bool hasCpuTime, unsigned long long bytes)
+{
+#if defined(SKRYPTONITE_METRICS)
+	PhaseMetrics& metrics = _phases[static_cast<size_t>(phase)];
+
+	metrics.wallTime.Record(wallTime);
+	if (hasCpuTime)
+		metrics.cpuTime.Record(cpuTime);
+	metrics.bytes.fetch_add(bytes, std::memory_order_relaxed);
+#else
+	(void)phase;
+	(void)wallTime;
+	(void)cpuTime;
+	(void)hasCpuTime;
+	(void)bytes;
+#endif
+}
+
+void Metrics::RecordHardwareEvents(MetricsPhase phase, const unsigned long long* events)
+{
+#if defined(SKRYPTONITE_METRICS)
+	PhaseMetrics& metrics = _phases[static_cast<size_t>(phase)];
+
+	for (size_t i = 0; i < static_cast<size_t>(HardwareEvent::Count); i++)
+		metrics.hardwareEvents[i].fetch_add(events[i], std::memory_order_relaxed);
+	metrics.hardwareSamples.fetch_add(1, std::memory_order_relaxed);
+#else
+	(void)phase;
+	(void)events;
+#endif
+}
+
+void Metrics::Add(MetricsCounter counter, unsigned long long value)
+{
+#if defined(SKRYPTONITE_METRICS)
+	_counters[static_cast<size_t>(counter)].fetch_add(value, std::memory_order_relaxed);
+#else
+	(void)counter;
+	(void)value;
+#endif
+}
+
+unsigned long long Metrics::ThreadCpuTime()
+{
+#if defined(SKRYPTONITE_METRICS) && defined(_WIN32)
+	FILETIME creation, exit, kernel, user;
+	if (!GetThreadTimes(GetCurrentThread(), &creation, &exit, &kernel, &user))
+		return 0;
+
+	// FILETIME counts 100-nanosecond ticks
+	unsigned long long ticks = (static_cast<unsigned long long>(kernel.dwHighDateTime) << 32 | kernel.dwLowDateTime) +
+		(static_cast<unsigned long long>(user.dwHighDateTime) << 32 | user.dwLowDateTime);
+	return ticks * 100;
+#elif defined(SKRYPTONITE_METRICS)
+	timespec time;
+	if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &time) != 0)
+		return 0;
+
+	return static_cast<unsigned long long>(time.tv_sec) * 1000000000ull + static_cast<unsigned long long>(time.tv_nsec);
+#else
+	return 0;
+#endif
+}
@@ -0,0 +1,332 @@
+/**
+* Skryptonite - Scrypt library for UWP
+* Copyright © 2016 Nicholas C. Bauer, Ph.D.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#pragma once
+#include "Platform.h"
+#include "HardwareCounters.h"
+#include <atomic>
+#include <chrono>
+#include <vector>
+
+/**
+Optional instrumentation of the native core. Recording is compiled in only when SKRYPTONITE_METRICS is defined (the
+SKRYPTONITE_ENABLE_METRICS CMake option); otherwise the recording macros expand to nothing and every snapshot is empty.
+*/
+
+namespace Skryptonite
+{
+	namespace Native
+	{
+		/**
+		<summary>The phases of a derivation whose durations are recorded.</summary>
+		<remarks>Arranging and restoring the element are fused into the first and last BlockMix, so they are part of
+		<see cref="FillScryptBlock"/> and <see cref="MixWithScryptBlock"/>.</remarks>
+		*/
+		enum class MetricsPhase
+		{
+			/**
+			<summary>The first PBKDF2 stage, expanding the password and salt into the data.</summary>
+			*/
+			Pbkdf2Expand,
+
+			/**
+			<summary>Filling the large memory block. One sample per fill of the elements mixed at once.</summary>
+			*/
+			FillScryptBlock,
+
+			/**
+			<summary>The random jumps through the large memory block. One sample per mix of the elements mixed at once.</summary>
+			*/
+			MixWithScryptBlock,
+
+			/**
+			<summary>The final PBKDF2 stage, compressing the mixed data into the derived key.</summary>
+			*/
+			Pbkdf2Compress,
+
+			/**
+			<summary>Taking scratch memory from the pool or the operating system.</summary>
+			*/
+			ScratchAcquire,
+
+			/**
+			<summary>Erasing scratch memory and returning it to the pool or the operating system.</summary>
+			*/
+			ScratchRelease,
+			Count
+		};
+
+		/**
+		<summary>The events that are counted.</summary>
+		*/
+		enum class MetricsCounter
+		{
+			/**
+			<summary>Scratch buffers allocated from the operating system or the heap.</summary>
+			*/
+			ScratchAllocations,
+
+			/**
+			<summary>Bytes of scratch memory allocated from the operating system or the heap.</summary>
+			*/
+			ScratchAllocatedBytes,
+
+			/**
+			<summary>Scratch buffers reused from the pool.</summary>
+			*/
+			ScratchReuses,
+
+			/**
+			<summary>Scratch buffers that could not be allocated.</summary>
+			*/
+			ScratchAllocationFailures,
+
+			/**
+			<summary>Derivations that ended with an exception.</summary>
+			*/
+			DerivationFailures,
+			Count
+		};
+
+		/**
+		<summary>A copy of a histogram of nanosecond durations with a bounded relative error.</summary>
+		<remarks>
+		Values below 16 have a bucket each. Above that, every power of 2 is split into 16 buckets, so a value is known to within
+		1/16 of itself, as in an HdrHistogram with one significant hexadecimal digit.
+		</remarks>
+		*/
+		struct HistogramSnapshot
+		{
+			/**
+			<summary>The number of buckets, enough for any 64-bit value.</summary>
+			*/
+			static const unsigned BucketCount = 976;
+
+			unsigned long long count;
+			unsigned long long sum;
+			unsigned long long min;
+			unsigned long long max;
+
+			/**
+			<summary>The number of values in each bucket. Empty when nothing was recorded.</summary>
+			*/
+			std::vector<unsigned long long> buckets;
+
+			/**
+			<summary>Gets the smallest recorded value that is at least as large as the given fraction of all values, to within
+			the bucket resolution.</summary>
+			<param name="percentile">The percentile, from 0 to 100.</param>
+			<returns>The largest value in the bucket holding the percentile, clamped to <see cref="max"/>, or 0 when empty.</returns>
+			*/
+			unsigned long long ValueAtPercentile(double percentile) const;
+
+			/**
+			<summary>Gets the bucket holding a value.</summary>
+			*/
+			static unsigned BucketIndex(unsigned long long value);
+
+			/**
+			<summary>Gets the largest value held by a bucket.</summary>
+			*/
+			static unsigned long long BucketUpperBound(unsigned index);
+		};
+
+		/**
+		<summary>The recorded durations of one phase.</summary>
+		*/
+		struct PhaseSnapshot
+		{
+			/**
+			<summary>The elapsed time of each sample in nanoseconds.</summary>
+			*/
+			HistogramSnapshot wallTime;
+
+			/**
+			<summary>The CPU time of the recording thread during each sample in nanoseconds. Not recorded for scratch memory,
+			whose samples are too short to read the thread clock without adding noticeable overhead.</summary>
+			*/
+			HistogramSnapshot cpuTime;
+
+			/**
+			<summary>The bytes of data and large memory block read or written by all samples.</summary>
+			*/
+			unsigned long long bytes;
+
+			/**
+			<summary>The processor events counted on the recording threads during the samples that read the hardware counters,
+			indexed by <see cref="HardwareEvent"/>.</summary>
+			*/
+			unsigned long long hardwareEvents[static_cast<size_t>(HardwareEvent::Count)];
+
+			/**
+			<summary>The samples that read the hardware counters. Only samples that record CPU time do, and only while
+			<see cref="Metrics::SetHardwareCountersEnabled"/> has them on and the thread can count at least one event.</summary>
+			*/
+			unsigned long long hardwareSamples;
+		};
+
+		/**
+		<summary>A copy of every metric at one point in time.</summary>
+		*/
+		struct MetricsSnapshot
+		{
+			PhaseSnapshot phases[static_cast<size_t>(MetricsPhase::Count)];
+			unsigned long long counters[static_cast<size_t>(MetricsCounter::Count)];
+		};
+
+		/**
+		<summary>Records and reports the process-wide metrics of the native core.</summary>
+		*/
+		class Metrics
+		{
+		public:
+			/**
+			<summary>Gets whether recording was compiled in.</summary>
+			*/
+			static bool IsCompiledIn();
+
+			/**
+			<summary>Gets whether recording is on. Always false when not compiled in.</summary>
+			*/
+			static bool IsEnabled();
+
+			/**
+			<summary>Turns recording on or off. Recording starts on when compiled in.</summary>
+			*/
+			static void SetEnabled(bool value);
+
+			/**
+			<summary>Gets whether the phases that record CPU time also read the hardware counters.</summary>
+			*/
+			static bool AreHardwareCountersEnabled();
+
+			/**
+			<summary>Turns reading the hardware counters around the phases that record CPU time on or off. Off by default, since
+			every sample then makes several system calls and every recording thread keeps the counters open.</summary>
+			*/
+			static void SetHardwareCountersEnabled(bool value);
+
+			/**
+			<summary>Copies every metric. Samples recorded concurrently may be partially included.</summary>
+			*/
+			static MetricsSnapshot Snapshot();
+
+			/**
+			<summary>Clears every metric.</summary>
+			*/
+			static void Reset();
+
+			/**
+			<summary>Records one sample of a phase.</summary>
+			<param name="phase">The phase.</param>
+			<param name="wallTime">The elapsed time in nanoseconds.</param>
+			<param name="cpuTime">The CPU time of the thread in nanoseconds.</param>
+			<param name="hasCpuTime">Whether <paramref name="cpuTime"/> was measured.</param>
+			<param name="bytes">The bytes read or written.</param>
+			*/
+			static void RecordPhase(MetricsPhase phase, unsigned long long wallTime, unsigned long long cpuTime, bool hasCpuTime, unsigned long long bytes);
+
+			/**
+			<summary>Records the hardware events counted during one sample of a phase.</summary>
+			<param name="phase">The phase.</param>
+			<param name="events">The number of each <see cref="HardwareEvent"/>.</param>
+			*/
+			static void RecordHardwareEvents(MetricsPhase phase, const unsigned long long* events);
+
+			/**
+			<summary>Adds to a counter.</summary>
+			*/
+			static void Add(MetricsCounter counter, unsigned long long value);
+
+			/**
+			<summary>Gets the CPU time the calling thread has used in nanoseconds.</summary>
+			*/
+			static unsigned long long ThreadCpuTime();
+		};
+
+#if defined(SKRYPTONITE_METRICS)
+		/**
+		<summary>Records the duration of a phase from its construction to its destruction.</summary>
+		*/
+		class PhaseTimer
+		{
+		public:
+			PhaseTimer(MetricsPhase phase, unsigned long long bytes, bool measureCpuTime) :
+				_phase(phase), _bytes(bytes), _isEnabled(Metrics::IsEnabled()), _measureCpuTime(measureCpuTime), _hasHardwareStart(false)
+			{
+				if (!_isEnabled)
+					return;
+
+				_cpuStart = _measureCpuTime ? Metrics::ThreadCpuTime() : 0;
+				if (_measureCpuTime && Metrics::AreHardwareCountersEnabled())
+					_hasHardwareStart = HardwareCounters::Read(_hardwareStart);
+				_start = std::chrono::steady_clock::now();
+			}
+
+			~PhaseTimer()
+			{
+				if (!_isEnabled)
+					return;
+
+				auto wallTime = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - _start).count();
+
+				unsigned long long hardwareEnd[static_cast<size_t>(HardwareEvent::Count)];
+				if (_hasHardwareStart && HardwareCounters::Read(hardwareEnd))
+				{
+					// totals scaled for multiplexing can shrink slightly between two reads
+					for (size_t i = 0; i < static_cast<size_t>(HardwareEvent::Count); i++)
+						hardwareEnd[i] = hardwareEnd[i] > _hardwareStart[i] ? hardwareEnd[i] - _hardwareStart[i] : 0;
+
+					Metrics::RecordHardwareEvents(_phase, hardwareEnd);
+				}
+
+				unsigned long long cpuTime = _measureCpuTime ? Metrics::ThreadCpuTime() - _cpuStart : 0;
+
+				Metrics::RecordPhase(_phase, static_cast<unsigned long long>(wallTime), cpuTime, _measureCpuTime, _bytes);
+			}
+
+			PhaseTimer(const PhaseTimer&) = delete;
+			PhaseTimer& operator=(const PhaseTimer&) = delete;
+
+		private:
+			MetricsPhase _phase;
+			unsigned long long _bytes;
+			bool _isEnabled;
+			bool _measureCpuTime;
+			bool _hasHardwareStart;
+			unsigned long long _cpuStart;
+			unsigned long long _hardwareStart[static_cast<size_t>(HardwareEvent::Count)];
+			std::chrono::steady_clock::time_point _start;
+		};
+
+// times the rest of the enclosing scope as one sample of a phase, with the thread's CPU time
+#define SKRYPTONITE_METRICS_PHASE(phase, bytes) \
+	::Skryptonite::Native::PhaseTimer skryptoniteMetricsPhaseTimer(::Skryptonite::Native::MetricsPhase::phase, (bytes), true)
+
+// times the rest of the enclosing scope as one sample of a phase too short to read the thread's CPU time
+#define SKRYPTONITE_METRICS_SHORT_PHASE(phase, bytes) \
+	::Skryptonite::Native::PhaseTimer skryptoniteMetricsPhaseTimer(::Skryptonite::Native::MetricsPhase::phase, (bytes), false)
+
+#define SKRYPTONITE_METRICS_COUNT(counter, value) \
+	(::Skryptonite::Native::Metrics::IsEnabled() ? ::Skryptonite::Native::Metrics::Add(::Skryptonite::Native::MetricsCounter::counter, (value)) : (void)0)
+#else
+#define SKRYPTONITE_METRICS_PHASE(phase, bytes) ((void)0)
+#define SKRYPTONITE_METRICS_SHORT_PHASE(phase, bytes) ((void)0)
+#define SKRYPTONITE_METRICS_COUNT(counter, value) ((void)0)
+#endif
+	}
+}
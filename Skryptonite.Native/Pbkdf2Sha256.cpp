@@ -0,0 +1,249 @@
+/**
+* Skryptonite - Scrypt library for UWP
+* Copyright © 2016 Nicholas C. Bauer, Ph.D.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "pch.h"
+#include "Pbkdf2Sha256.h"
+#include "Sha256.h"
+#include "CpuFeatures.h"
+
+#if defined(SKRYPTONITE_X86)
+#include "../Skryptonite.Native.SSE2/Sha256SHA.h"
+#include "../Skryptonite.Native.AVX2/Sha256AVX2x8.h"
+#endif
+
+using namespace Skryptonite::Native;
+
+static __forceinline void StoreBigEndian(unsigned char* destination, unsigned value)
+{
+	destination[0] = static_cast<unsigned char>(value >> 24);
+	destination[1] = static_cast<unsigned char>(value >> 16);
+	destination[2] = static_cast<unsigned char>(value >> 8);
+	destination[3] = static_cast<unsigned char>(value);
+}
+
+/**
+<summary>Appends the SHA-256 padding and message length to the end of a message.</summary>
+<param name="blocks">The message blocks, containing the final <paramref name="tailLength"/> bytes of the message at the start.</param>
+<param name="tailLength">The number of message bytes in <paramref name="blocks"/>.</param>
+<param name="messageLength">The total length of the message in bytes.</param>
+<returns>The number of 64-byte blocks to hash, 1 or 2.</returns>
+*/
+static unsigned Pad(unsigned char* blocks, size_t tailLength, unsigned long long messageLength)
+{
+	unsigned blockCount = tailLength + 9 <= Sha256::BlockLength ? 1 : 2;
+	unsigned long long messageBits = messageLength * 8;
+	unsigned char* end = blocks + blockCount * Sha256::BlockLength;
+
+	blocks[tailLength] = 0x80;
+	memset(blocks + tailLength + 1, 0, end - 8 - (blocks + tailLength + 1));
+	StoreBigEndian(end - 8, static_cast<unsigned>(messageBits >> 32));
+	StoreBigEndian(end - 4, static_cast<unsigned>(messageBits));
+
+	return blockCount;
+}
+
+Pbkdf2Sha256::Pbkdf2Sha256(const unsigned char* password, size_t passwordLength)
+{
+	_ASSERT(password != nullptr || passwordLength == 0);
+
+	SetFunctions();
+
+	unsigned char pad[Sha256::BlockLength];
+
+	// keys longer than a block are hashed first
+	memset(pad, 0, sizeof(pad));
+	if (passwordLength > Sha256::BlockLength)
+	{
+		Sha256 sha;
+		sha.Update(password, passwordLength);
+		sha.Final(pad);
+	}
+	else if (passwordLength > 0)
+	{
+		memcpy(pad, password, passwordLength);
+	}
+
+	for (unsigned i = 0; i < sizeof(pad); i++)
+		pad[i] ^= 0x36;
+
+	memcpy(_innerState, Sha256::InitialState, sizeof(_innerState));
+	Sha256::Transform(_innerState, pad);
+
+	// turn the inner pad into the outer pad
+	for (unsigned i = 0; i < sizeof(pad); i++)
+		pad[i] ^= 0x36 ^ 0x5c;
+
+	memcpy(_outerState, Sha256::InitialState, sizeof(_outerState));
+	Sha256::Transform(_outerState, pad);
+
+	SecureErase(pad, sizeof(pad));
+}
+
+Pbkdf2Sha256::~Pbkdf2Sha256()
+{
+	SecureErase(_innerState, sizeof(_innerState));
+	SecureErase(_outerState, sizeof(_outerState));
+}
+
+void Pbkdf2Sha256::SetFunctions()
+{
+	TransformLanes = Sha256::TransformLanes;
+
+#if defined(SKRYPTONITE_X86)
+	InstructionSet instructionSet = CpuFeatures::MaxInstructionSet();
+
+	if (CpuFeatures::ShaExtensions() && instructionSet >= InstructionSet::SSE41)
+		TransformLanes = Sha256SHA::TransformLanes;
+	else if (instructionSet == InstructionSet::AVX2)
+	{
+		static_assert(Sha256AVX2x8::LaneCount == MaxLaneCount, "MaxLaneCount must match the AVX2 multi-buffer SHA-256.");
+		TransformLanes = Sha256AVX2x8::TransformLanes;
+	}
+#endif
+}
+
+void Pbkdf2Sha256::DeriveKey(const unsigned char* password, size_t passwordLength, const unsigned char* salt, size_t saltLength,
+	unsigned iterations, unsigned char* derivedKey, size_t derivedKeyLength)
+{
+	Pbkdf2Sha256(password, passwordLength).DeriveKey(salt, saltLength, iterations, derivedKey, derivedKeyLength);
+}
+
+void Pbkdf2Sha256::DeriveKey(const unsigned char* salt, size_t saltLength, unsigned iterations, unsigned char* derivedKey, size_t derivedKeyLength) const
+{
+	_ASSERT(salt != nullptr || saltLength == 0);
+	_ASSERT(iterations > 0);
+	_ASSERT(derivedKey != nullptr || derivedKeyLength == 0);
+
+	// every block hashes the same salt, so only the partial block at its end differs between blocks
+	unsigned saltState[8];
+	memcpy(saltState, _innerState, sizeof(saltState));
+
+	size_t fullSaltLength = saltLength - saltLength % Sha256::BlockLength;
+	for (size_t i = 0; i < fullSaltLength; i += Sha256::BlockLength)
+	{
+		unsigned* state = saltState;
+		const unsigned char* block = salt + i;
+		TransformLanes(&state, &block, 1);
+	}
+
+	size_t tailLength = saltLength - fullSaltLength;
+	unsigned long long messageLength = Sha256::BlockLength + saltLength + 4;
+
+	unsigned char blocks[MaxLaneCount][2 * Sha256::BlockLength];
+	unsigned states[MaxLaneCount][8];
+	unsigned results[MaxLaneCount][8];
+	unsigned* statePointers[MaxLaneCount];
+	const unsigned char* blockPointers[MaxLaneCount];
+
+	for (unsigned k = 0; k < MaxLaneCount; k++)
+		statePointers[k] = states[k];
+
+	unsigned blockIndex = 1;
+
+	while (derivedKeyLength > 0)
+	{
+		size_t remainingBlocks = (derivedKeyLength + Sha256::HashLength - 1) / Sha256::HashLength;
+		unsigned count = remainingBlocks < MaxLaneCount ? static_cast<unsigned>(remainingBlocks) : MaxLaneCount;
+		unsigned blockCount = 0;
+
+		// U1 = HMAC(password, salt || INT(i))
+		for (unsigned k = 0; k < count; k++)
+		{
+			if (tailLength > 0)
+				memcpy(blocks[k], salt + fullSaltLength, tailLength);
+			StoreBigEndian(blocks[k] + tailLength, blockIndex + k);
+			blockCount = Pad(blocks[k], tailLength + 4, messageLength);
+
+			memcpy(states[k], saltState, sizeof(saltState));
+		}
+
+		for (unsigned b = 0; b < blockCount; b++)
+		{
+			for (unsigned k = 0; k < count; k++)
+				blockPointers[k] = blocks[k] + b * Sha256::BlockLength;
+
+			TransformLanes(statePointers, blockPointers, count);
+		}
+
+		OuterHashLanes(states, count);
+		memcpy(results, states, sizeof(results));
+
+		// Uj = HMAC(password, Uj-1)
+		for (unsigned i = 1; i < iterations; i++)
+		{
+			HmacOfHashLanes(states, count);
+
+			for (unsigned k = 0; k < count; k++)
+				for (unsigned j = 0; j < 8; j++)
+					results[k][j] ^= states[k][j];
+		}
+
+		for (unsigned k = 0; k < count; k++)
+		{
+			unsigned char block[Sha256::HashLength];
+			for (unsigned j = 0; j < 8; j++)
+				StoreBigEndian(block + j * 4, results[k][j]);
+
+			size_t length = derivedKeyLength < sizeof(block) ? derivedKeyLength : sizeof(block);
+			memcpy(derivedKey, block, length);
+			derivedKey += length;
+			derivedKeyLength -= length;
+
+			SecureErase(block, sizeof(block));
+		}
+
+		blockIndex += count;
+	}
+
+	SecureErase(saltState, sizeof(saltState));
+	SecureErase(blocks, sizeof(blocks));
+	SecureErase(states, sizeof(states));
+	SecureErase(results, sizeof(results));
+}
+
+void Pbkdf2Sha256::OuterHashLanes(unsigned (*states)[8], unsigned count) const
+{
+	HashAfterPadLanes(states, _outerState, count);
+}
+
+void Pbkdf2Sha256::HmacOfHashLanes(unsigned (*states)[8], unsigned count) const
+{
+	HashAfterPadLanes(states, _innerState, count);
+	HashAfterPadLanes(states, _outerState, count);
+}
+
+void Pbkdf2Sha256::HashAfterPadLanes(unsigned (*states)[8], const unsigned* padState, unsigned count) const
+{
+	unsigned char blocks[MaxLaneCount][Sha256::BlockLength];
+	unsigned* statePointers[MaxLaneCount];
+	const unsigned char* blockPointers[MaxLaneCount];
+
+	for (unsigned k = 0; k < count; k++)
+	{
+		for (unsigned j = 0; j < 8; j++)
+			StoreBigEndian(blocks[k] + j * 4, states[k][j]);
+		Pad(blocks[k], Sha256::HashLength, Sha256::BlockLength + Sha256::HashLength);
+
+		memcpy(states[k], padState, 8 * sizeof(unsigned));
+		statePointers[k] = states[k];
+		blockPointers[k] = blocks[k];
+	}
+
+	TransformLanes(statePointers, blockPointers, count);
+
+	SecureErase(blocks, sizeof(blocks));
+}
@@ -0,0 +1,113 @@
+/**
+* Skryptonite - Scrypt library for UWP
+* Copyright © 2016 Nicholas C. Bauer, Ph.D.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#pragma once
+#include "Platform.h"
+
+namespace Skryptonite
+{
+	namespace Native
+	{
+		/**
+		<summary>Derives keys with PBKDF2 using HMAC-SHA256 as the pseudorandom function, as described in RFC 2898.</summary>
+		<remarks>
+		The HMAC inner and outer pad states are computed once per password, and so are the full blocks of the salt. Output
+		blocks are independent, so up to <see cref="MaxLaneCount"/> of them are computed together: with the SHA extensions one
+		after the other, otherwise with the 8-lane AVX2 compression function when available.
+		</remarks>
+		*/
+		class Pbkdf2Sha256
+		{
+		public:
+			/**
+			<summary>Prepares the HMAC state for a password.</summary>
+			<param name="password">The password. May be null when <paramref name="passwordLength"/> is 0.</param>
+			<param name="passwordLength">The length of the password in bytes.</param>
+			*/
+			Pbkdf2Sha256(const unsigned char* password, size_t passwordLength);
+
+			~Pbkdf2Sha256();
+
+			/**
+			<summary>Derives a key from the password this object was created with.</summary>
+			<param name="salt">The salt. May be null when <paramref name="saltLength"/> is 0.</param>
+			<param name="saltLength">The length of the salt in bytes.</param>
+			<param name="iterations">The number of iterations. Must be greater than 0.</param>
+			<param name="derivedKey">Receives the derived key.</param>
+			<param name="derivedKeyLength">The length of the derived key in bytes. Must be no more than (2^32 - 1) * 32.</param>
+			*/
+			void DeriveKey(const unsigned char* salt, size_t saltLength, unsigned iterations, unsigned char* derivedKey, size_t derivedKeyLength) const;
+
+			/**
+			<summary>Derives a key.</summary>
+			<param name="password">The password. May be null when <paramref name="passwordLength"/> is 0.</param>
+			<param name="passwordLength">The length of the password in bytes.</param>
+			<param name="salt">The salt. May be null when <paramref name="saltLength"/> is 0.</param>
+			<param name="saltLength">The length of the salt in bytes.</param>
+			<param name="iterations">The number of iterations. Must be greater than 0.</param>
+			<param name="derivedKey">Receives the derived key.</param>
+			<param name="derivedKeyLength">The length of the derived key in bytes. Must be no more than (2^32 - 1) * 32.</param>
+			*/
+			static void DeriveKey(const unsigned char* password, size_t passwordLength, const unsigned char* salt, size_t saltLength,
+				unsigned iterations, unsigned char* derivedKey, size_t derivedKeyLength);
+
+		private:
+			/**
+			<summary>The number of output blocks computed together.</summary>
+			*/
+			static const unsigned MaxLaneCount = 8;
+
+			unsigned _innerState[8];
+			unsigned _outerState[8];
+
+			/**
+			<summary>Assigns the compression function based on instruction set.</summary>
+			*/
+			void SetFunctions();
+
+			/**
+			<summary>Completes the HMAC of each lane: hashes its inner hash with the outer pad state.</summary>
+			<param name="states">The inner hash state of each lane. Receives the HMAC.</param>
+			<param name="count">The number of lanes.</param>
+			*/
+			void OuterHashLanes(unsigned (*states)[8], unsigned count) const;
+
+			/**
+			<summary>Computes the HMAC of each lane's previous HMAC, as needed by iterations after the first.</summary>
+			<param name="states">The previous HMAC of each lane. Receives the new HMAC.</param>
+			<param name="count">The number of lanes.</param>
+			*/
+			void HmacOfHashLanes(unsigned (*states)[8], unsigned count) const;
+
+			/**
+			<summary>Hashes a 32-byte message following an already hashed 64-byte pad block for each lane.</summary>
+			<param name="states">The message of each lane, as hash words. Receives the hash.</param>
+			<param name="padState">The state after hashing the pad block.</param>
+			<param name="count">The number of lanes.</param>
+			*/
+			void HashAfterPadLanes(unsigned (*states)[8], const unsigned* padState, unsigned count) const;
+
+			/**
+			<summary>Runs the SHA-256 compression function over one message block for each of several independent hashes.</summary>
+			<param name="states">The hash state of each lane.</param>
+			<param name="blocks">The message block of each lane.</param>
+			<param name="count">The number of lanes. No more than <see cref="MaxLaneCount"/>.</param>
+			*/
+			void(*TransformLanes)(unsigned* const* states, const unsigned char* const* blocks, unsigned count);
+		};
+	}
+}
@@ -0,0 +1,106 @@
+/**
+* Skryptonite - Scrypt library for UWP
+* Copyright © 2016 Nicholas C. Bauer, Ph.D.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#pragma once
+#include <cstddef>
+#include <cstring>
+
+/**
+Compiler and architecture portability definitions, allowing the native core to be built by MSVC for the Windows Runtime
+and by GCC or Clang as a standalone library.
+*/
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+#define SKRYPTONITE_X86
+#endif
+
+#if defined(_M_ARM)
+#define SKRYPTONITE_ARM
+#endif
+
+#if defined(__cplusplus_winrt)
+#define SKRYPTONITE_WINRT_PUBLIC public
+#else
+#define SKRYPTONITE_WINRT_PUBLIC
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#include <crtdbg.h>
+#include <malloc.h>
+#else
+#include <cassert>
+#include <cstdlib>
+#if defined(SKRYPTONITE_X86)
+#include <immintrin.h>
+#include <cpuid.h>
+#endif
+
+#define __forceinline inline __attribute__((always_inline))
+#define __vectorcall
+#define _ASSERT(expression) assert(expression)
+#endif
+
+namespace Skryptonite
+{
+	namespace Native
+	{
+		/**
+		<summary>Allocates memory aligned to the given boundary.</summary>
+		<param name="length">The number of bytes to allocate.</param>
+		<param name="alignment">The alignment in bytes. Must be a power of 2 and a multiple of the pointer size.</param>
+		<returns>A pointer to the memory, or null if the allocation failed.</returns>
+		*/
+		inline void* AlignedAlloc(size_t length, size_t alignment)
+		{
+#if defined(_MSC_VER)
+			return _aligned_malloc(length, alignment);
+#else
+			void* memory;
+			return posix_memalign(&memory, alignment, length) == 0 ? memory : nullptr;
+#endif
+		}
+
+		/**
+		<summary>Frees memory allocated with <see cref="AlignedAlloc"/>.</summary>
+		<param name="memory">The memory to free. May be null.</param>
+		*/
+		inline void AlignedFree(void* memory)
+		{
+#if defined(_MSC_VER)
+			_aligned_free(memory);
+#else
+			free(memory);
+#endif
+		}
+
+		/**
+		<summary>Zeroes memory in a way the compiler cannot remove, even when the memory is freed right after.</summary>
+		<param name="memory">The memory to erase.</param>
+		<param name="length">The number of bytes to erase.</param>
+		*/
+		inline void SecureErase(void* memory, size_t length)
+		{
+			memset(memory, 0, length);
+#if defined(_MSC_VER)
+			_ReadWriteBarrier();
+#else
+			__asm__ __volatile__("" : : "r"(memory) : "memory");
+#endif
+		}
+	}
+}
@@ -0,0 +1,249 @@
+/**
+* Skryptonite - Scrypt library for UWP
+* Copyright © 2016 Nicholas C. Bauer, Ph.D.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "pch.h"
+#include "ProcessorTopology.h"
+#include <algorithm>
+#include <tuple>
+
+#if defined(_WIN32) && !defined(__cplusplus_winrt)
+#define SKRYPTONITE_WIN32_TOPOLOGY
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#elif defined(__linux__)
+#define SKRYPTONITE_LINUX_TOPOLOGY
+#include <cstdio>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+using namespace Skryptonite::Native;
+
+std::mutex ProcessorTopology::_mutex;
+std::vector<ProcessorInfo> ProcessorTopology::_processors;
+unsigned ProcessorTopology::_nodeCount = 1;
+bool ProcessorTopology::_isDetected = false;
+
+#if defined(SKRYPTONITE_LINUX_TOPOLOGY)
+// the largest node number mbind is given a mask for
+const unsigned MaxNodeCount = 1024;
+
+/**
+<summary>Reads a processor or node list such as "0-3,8" from a sysfs file.</summary>
+<returns>The numbers, or an empty list when the file cannot be read.</returns>
+*/
+static std::vector<unsigned> ReadList(const char* path)
+{
+	std::vector<unsigned> numbers;
+	FILE* file = fopen(path, "r");
+
+	if (file == nullptr)
+		return numbers;
+
+	unsigned first;
+	while (fscanf(file, "%u", &first) == 1)
+	{
+		unsigned last = first;
+		int separator = fgetc(file);
+
+		if (separator == '-')
+		{
+			if (fscanf(file, "%u", &last) != 1)
+				break;
+			separator = fgetc(file);
+		}
+
+		for (unsigned n = first; n <= last; n++)
+			numbers.push_back(n);
+
+		if (separator != ',')
+			break;
+	}
+
+	fclose(file);
+	return numbers;
+}
+#endif
+
+unsigned ProcessorTopology::NodeCount()
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	EnsureDetected();
+	return _nodeCount;
+}
+
+std::vector<ProcessorInfo> ProcessorTopology::Processors()
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	EnsureDetected();
+	return _processors;
+}
+
+std::vector<unsigned> ProcessorTopology::ProcessorOrder()
+{
+	return OrderProcessors(Processors());
+}
+
+std::vector<unsigned> ProcessorTopology::OrderProcessors(std::vector<ProcessorInfo> processors)
+{
+	std::sort(processors.begin(), processors.end(), [](const ProcessorInfo& a, const ProcessorInfo& b)
+	{
+		return std::tie(a.coreRank, a.node, a.number) < std::tie(b.coreRank, b.node, b.number);
+	});
+
+	// the position of each processor among those of its node with the same rank, so the nodes can take turns
+	std::vector<unsigned> turns(processors.size());
+	for (size_t i = 0; i < processors.size(); i++)
+	{
+		bool continuesGroup = i > 0 && processors[i - 1].coreRank == processors[i].coreRank && processors[i - 1].node == processors[i].node;
+		turns[i] = continuesGroup ? turns[i - 1] + 1 : 0;
+	}
+
+	std::vector<size_t> positions(processors.size());
+	for (size_t i = 0; i < positions.size(); i++)
+		positions[i] = i;
+
+	std::stable_sort(positions.begin(), positions.end(), [&](size_t a, size_t b)
+	{
+		return std::tie(processors[a].coreRank, turns[a]) < std::tie(processors[b].coreRank, turns[b]);
+	});
+
+	std::vector<unsigned> order;
+	for (size_t position : positions)
+		order.push_back(processors[position].number);
+
+	return order;
+}
+
+unsigned ProcessorTopology::NodeOfProcessor(unsigned processor)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	EnsureDetected();
+
+	for (const ProcessorInfo& info : _processors)
+		if (info.number == processor)
+			return info.node;
+
+	return 0;
+}
+
+bool ProcessorTopology::PreferNode(void* memory, size_t length, unsigned node)
+{
+#if defined(SKRYPTONITE_LINUX_TOPOLOGY) && defined(SYS_mbind)
+	const int PreferredPolicy = 1; // MPOL_PREFERRED
+	const unsigned BitsPerWord = sizeof(unsigned long) * 8;
+
+	if (node >= MaxNodeCount)
+		return false;
+
+	unsigned long mask[MaxNodeCount / BitsPerWord] = {};
+	mask[node / BitsPerWord] = 1ul << (node % BitsPerWord);
+
+	// the kernel reads one bit fewer than it is told
+	return syscall(SYS_mbind, memory, length, PreferredPolicy, mask, static_cast<unsigned long>(MaxNodeCount + 1), 0u) == 0;
+#else
+	(void)memory;
+	(void)length;
+	(void)node;
+	return false;
+#endif
+}
+
+void ProcessorTopology::EnsureDetected()
+{
+	if (_isDetected)
+		return;
+
+	_isDetected = true;
+
+#if defined(SKRYPTONITE_LINUX_TOPOLOGY)
+	// the affinity of the main thread, which threads bound by the thread pool do not change
+	cpu_set_t allowed;
+	CPU_ZERO(&allowed);
+
+	if (sched_getaffinity(getpid(), sizeof(allowed), &allowed) != 0)
+		return;
+
+	std::vector<unsigned> nodeOfProcessor(CPU_SETSIZE, 0);
+	for (unsigned node : ReadList("/sys/devices/system/node/online"))
+	{
+		char path[64];
+		snprintf(path, sizeof(path), "/sys/devices/system/node/node%u/cpulist", node);
+
+		for (unsigned p : ReadList(path))
+			if (p < CPU_SETSIZE)
+				nodeOfProcessor[p] = node;
+	}
+
+	for (unsigned p = 0; p < CPU_SETSIZE; p++)
+	{
+		if (!CPU_ISSET(p, &allowed))
+			continue;
+
+		char path[96];
+		snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%u/topology/thread_siblings_list", p);
+		std::vector<unsigned> siblings = ReadList(path);
+
+		unsigned coreRank = static_cast<unsigned>(std::count_if(siblings.begin(), siblings.end(), [&](unsigned s) { return s < p; }));
+		_processors.push_back({ p, coreRank, nodeOfProcessor[p] });
+	}
+#elif defined(SKRYPTONITE_WIN32_TOPOLOGY)
+	DWORD_PTR processMask;
+	DWORD_PTR systemMask;
+	DWORD length = 0;
+
+	if (!GetProcessAffinityMask(GetCurrentProcess(), &processMask, &systemMask))
+		return;
+
+	GetLogicalProcessorInformation(nullptr, &length);
+	std::vector<SYSTEM_LOGICAL_PROCESSOR_INFORMATION> information(length / sizeof(SYSTEM_LOGICAL_PROCESSOR_INFORMATION));
+
+	if (information.empty() || !GetLogicalProcessorInformation(information.data(), &length))
+		return;
+
+	for (const auto& entry : information)
+	{
+		if (entry.Relationship != RelationProcessorCore)
+			continue;
+
+		unsigned coreRank = 0;
+		for (unsigned p = 0; p < sizeof(ULONG_PTR) * 8; p++)
+		{
+			ULONG_PTR bit = static_cast<ULONG_PTR>(1) << p;
+			if ((entry.ProcessorMask & bit) == 0)
+				continue;
+
+			UCHAR node = 0;
+			GetNumaProcessorNode(static_cast<UCHAR>(p), &node);
+
+			if (processMask & bit)
+				_processors.push_back({ p, coreRank, node });
+			coreRank++;
+		}
+	}
+#endif
+
+	std::vector<unsigned> nodes;
+	for (const ProcessorInfo& info : _processors)
+		nodes.push_back(info.node);
+
+	std::sort(nodes.begin(), nodes.end());
+	_nodeCount = (std::max)(static_cast<unsigned>(std::unique(nodes.begin(), nodes.end()) - nodes.begin()), 1u);
+}
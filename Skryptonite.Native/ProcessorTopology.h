@@ -0,0 +1,114 @@
+/**
+* Skryptonite - Scrypt library for UWP
+* Copyright © 2016 Nicholas C. Bauer, Ph.D.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#pragma once
+#include "Platform.h"
+#include <mutex>
+#include <vector>
+
+namespace Skryptonite
+{
+	namespace Native
+	{
+		/**
+		<summary>A processor the process may run on and where it sits in the machine.</summary>
+		*/
+		struct ProcessorInfo
+		{
+			unsigned number;
+
+			/**
+			<summary>The position of the processor among the hardware threads of its core; 0 for the first SMT sibling.</summary>
+			*/
+			unsigned coreRank;
+
+			/**
+			<summary>The NUMA node whose memory is local to the processor.</summary>
+			*/
+			unsigned node;
+		};
+
+		/**
+		<summary>Describes the cores, SMT siblings and NUMA nodes of the machine, and places memory on a node.</summary>
+		<remarks>
+		The topology is read once, from sysfs on Linux and from the logical processor information on Windows. Elsewhere, and
+		in the Windows Runtime, the machine appears as a single node without processor numbers.
+		</remarks>
+		*/
+		class ProcessorTopology
+		{
+		public:
+			/**
+			<summary>Gets the number of NUMA nodes with processors the process may run on. At least 1.</summary>
+			*/
+			static unsigned NodeCount();
+
+			/**
+			<summary>Gets the processors the process may run on.</summary>
+			*/
+			static std::vector<ProcessorInfo> Processors();
+
+			/**
+			<summary>Gets the processors the process may run on, in the order threads should be spread over them.</summary>
+			<returns>Processor numbers, or an empty list when the platform does not expose them.</returns>
+			<remarks>See <see cref="OrderProcessors"/>.</remarks>
+			*/
+			static std::vector<unsigned> ProcessorOrder();
+
+			/**
+			<summary>Orders processors so that every core runs one thread before any core runs two, and consecutive threads
+			alternate between NUMA nodes.</summary>
+			<param name="processors">The processors to order.</param>
+			<returns>The processor numbers in order.</returns>
+			<remarks>
+			Alternating nodes gives every node's memory controller an equal share of any number of threads, so concurrent SMix
+			elements divide the memory bandwidth of all sockets instead of saturating the first one.
+			</remarks>
+			*/
+			static std::vector<unsigned> OrderProcessors(std::vector<ProcessorInfo> processors);
+
+			/**
+			<summary>Gets the node whose memory is local to a processor, or 0 when the processor is unknown.</summary>
+			*/
+			static unsigned NodeOfProcessor(unsigned processor);
+
+			/**
+			<summary>Asks the operating system to back pages not yet touched with memory of a node.</summary>
+			<param name="memory">The start of the pages, aligned to a page.</param>
+			<param name="length">The length of the pages in bytes.</param>
+			<param name="node">The node.</param>
+			<returns>True when the request was accepted. The pages are still usable when it was not.</returns>
+			<remarks>
+			The node is preferred rather than required, so allocation falls back to other nodes when it runs out of memory.
+			Only supported on Linux; Windows places memory on a node when it is allocated instead.
+			</remarks>
+			*/
+			static bool PreferNode(void* memory, size_t length, unsigned node);
+
+		private:
+			static std::mutex _mutex;
+			static std::vector<ProcessorInfo> _processors;
+			static unsigned _nodeCount;
+			static bool _isDetected;
+
+			/**
+			<summary>Reads the topology, once. The caller must hold the mutex.</summary>
+			*/
+			static void EnsureDetected();
+		};
+	}
+}
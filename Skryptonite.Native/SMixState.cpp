@@ -0,0 +1,124 @@
+/**
+* Skryptonite - Scrypt library for UWP
+* Copyright © 2016 Nicholas C. Bauer, Ph.D.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "pch.h"
+#include "SMixState.h"
+#include <algorithm>
+#include <stdexcept>
+
+using namespace Skryptonite::Native;
+
+// the clock is read once per this many 64-byte blocks mixed, so short steps do not pay for it every time
+const unsigned BlocksPerClockCheck = 64;
+
+SMixState::SMixState(ScryptEngine& engine, unsigned elementIndex) :
+	_engine(engine), _completedSteps(0), _isCancelRequested(false), _isCancelled(false)
+{
+	if (elementIndex >= engine._elementsCount)
+		throw std::invalid_argument("elementIndex is out of range.");
+
+	const unsigned blockCount = engine._salsaBlockCountPerElement;
+
+	_element = engine._data + static_cast<size_t>(elementIndex) * blockCount;
+	_totalSteps = 2ull * engine._processingCost;
+
+	// a paused SMix holds its memory, so waiting here could wait on the caller's own paused states
+	_reservation.ReserveNow(MemoryBudget::Global(), engine.ReservationLength(1));
+
+	_workingBuffer = std::make_unique<ScryptElement>(blockCount, engine._processingCost);
+	_shuffleBuffer = std::make_unique<ScryptElement>(blockCount, engine._processingCost);
+	_scryptBlock = std::make_unique<ScryptBlock>(blockCount, engine.StoredElementCount());
+
+	if (engine._tradeOffFactor > 1)
+	{
+		_rebuildBuffer = std::make_unique<ScryptElement>(blockCount, engine._processingCost);
+		_rebuildShuffleBuffer = std::make_unique<ScryptElement>(blockCount, engine._processingCost);
+	}
+}
+
+bool SMixState::Advance(unsigned long long maxSteps)
+{
+	if (maxSteps == 0)
+		throw std::invalid_argument("maxSteps must be greater than 0.");
+
+	for (unsigned long long i = 0; i < maxSteps && !IsDone(); i++)
+		Step();
+
+	return IsDone();
+}
+
+bool SMixState::AdvanceFor(std::chrono::steady_clock::duration budget)
+{
+	const auto start = std::chrono::steady_clock::now();
+	const unsigned stepsPerCheck = (std::max)(BlocksPerClockCheck / _engine._salsaBlockCountPerElement, 1u);
+
+	do
+	{
+		for (unsigned i = 0; i < stepsPerCheck && !IsDone(); i++)
+			Step();
+	} while (!IsDone() && std::chrono::steady_clock::now() - start < budget);
+
+	return IsDone();
+}
+
+void SMixState::Step()
+{
+	const unsigned long long step = _completedSteps;
+	const unsigned processingCost = _engine._processingCost;
+
+	if (step < processingCost)
+	{
+		_engine.FillScryptBlockStep(static_cast<unsigned>(step), _element, _workingBuffer, _scryptBlock, _shuffleBuffer);
+	}
+	else
+	{
+		unsigned j = _workingBuffer->Integerify();
+		SalsaBlock* xorSource = _engine.LoadScryptBlockElement(j, _scryptBlock, _rebuildBuffer, _rebuildShuffleBuffer);
+		_engine.MixWithScryptBlockStep(static_cast<unsigned>(step - processingCost), _element, _workingBuffer, xorSource,
+			j % _engine._tradeOffFactor > 0, _shuffleBuffer);
+	}
+
+	_completedSteps = step + 1;
+
+	if (IsCompleted())
+		Release();
+}
+
+bool SMixState::IsDone()
+{
+	if (IsCompleted() || _isCancelled)
+		return true;
+
+	if (_isCancelRequested)
+	{
+		_isCancelled = true;
+		Release();
+		return true;
+	}
+
+	return false;
+}
+
+void SMixState::Release()
+{
+	_workingBuffer.reset();
+	_shuffleBuffer.reset();
+	_rebuildBuffer.reset();
+	_rebuildShuffleBuffer.reset();
+	_scryptBlock.reset();
+	_reservation.Release();
+}
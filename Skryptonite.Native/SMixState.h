@@ -0,0 +1,134 @@
+/**
+* Skryptonite - Scrypt library for UWP
+* Copyright © 2016 Nicholas C. Bauer, Ph.D.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#pragma once
+#include "ScryptEngine.h"
+#include "ScryptElement.h"
+#include "ScryptBlock.h"
+#include "MemoryBudget.h"
+#include <atomic>
+#include <chrono>
+
+namespace Skryptonite
+{
+	namespace Native
+	{
+		/**
+		<summary>Performs SMix on one element of an engine's data a bounded number of steps at a time, so that it can be paused,
+		resumed, and cancelled.</summary>
+		<remarks>
+		SMix takes 2 * processingCost steps: one per element of the large memory block filled, then one per random jump. Under the
+		time-memory trade-off a jump may also rebuild a dropped element. The element of the data is only written by the last step,
+		so a cancelled or abandoned state leaves it unchanged. The engine must outlive the state, and its cache policy and trade-off
+		factor must not change while the state is in progress.
+		<see cref="Advance"/> and <see cref="AdvanceFor"/> may be called from different threads, but not at the same time. Every
+		other member may be called from any thread at any time.
+		</remarks>
+		*/
+		class SMixState
+		{
+		public:
+			/**
+			<summary>Prepares to mix an element, allocating its working memory.</summary>
+			<param name="engine">The engine whose data contains the element.</param>
+			<param name="elementIndex">The element index to mix.</param>
+			<exception cref="std::invalid_argument">Thrown when <paramref name="elementIndex"/> is greater than or equal to the
+			engine's ElementsCount.</exception>
+			<exception cref="std::bad_alloc">Thrown when the working memory cannot be allocated, or does not fit in
+			<see cref="MemoryBudget::Global"/> without waiting.</exception>
+			*/
+			SMixState(ScryptEngine& engine, unsigned elementIndex);
+
+			SMixState(const SMixState&) = delete;
+			SMixState& operator=(const SMixState&) = delete;
+
+			/**
+			<summary>Performs up to the given number of steps.</summary>
+			<param name="maxSteps">The largest number of steps to perform.</param>
+			<returns>True when no work remains because the SMix has completed or been cancelled.</returns>
+			<exception cref="std::invalid_argument">Thrown when <paramref name="maxSteps"/> is 0.</exception>
+			*/
+			bool Advance(unsigned long long maxSteps);
+
+			/**
+			<summary>Performs steps until the time budget is spent or no work remains.</summary>
+			<param name="budget">The time to spend. At least one step is performed, and the budget may be exceeded by a few steps of
+			fewer than 64 Salsa20/8 blocks in all.</param>
+			<returns>True when no work remains because the SMix has completed or been cancelled.</returns>
+			*/
+			bool AdvanceFor(std::chrono::steady_clock::duration budget);
+
+			/**
+			<summary>Requests that the SMix stop. The working memory is released by the next call to <see cref="Advance"/> or
+			<see cref="AdvanceFor"/>, or as soon as the step in progress finishes. Has no effect once the SMix has completed.</summary>
+			*/
+			void Cancel() { _isCancelRequested = true; }
+
+			/**
+			<summary>Gets whether every step has been performed and the element of the data holds the result.</summary>
+			*/
+			bool IsCompleted() const { return _completedSteps == _totalSteps; }
+
+			/**
+			<summary>Gets whether the SMix was stopped by <see cref="Cancel"/> before it completed.</summary>
+			*/
+			bool IsCancelled() const { return _isCancelled; }
+
+			/**
+			<summary>Gets the number of steps performed so far.</summary>
+			*/
+			unsigned long long CompletedSteps() const { return _completedSteps; }
+
+			/**
+			<summary>Gets the number of steps SMix takes, 2 * processingCost.</summary>
+			*/
+			unsigned long long TotalSteps() const { return _totalSteps; }
+
+		private:
+			ScryptEngine& _engine;
+			SalsaBlock* _element;
+			unsigned long long _totalSteps;
+			std::atomic<unsigned long long> _completedSteps;
+			std::atomic<bool> _isCancelRequested;
+			std::atomic<bool> _isCancelled;
+
+			// declared before the buffers so it is released after them
+			MemoryReservation _reservation;
+			ScryptElementPtr _workingBuffer;
+			ScryptElementPtr _shuffleBuffer;
+			ScryptElementPtr _rebuildBuffer;
+			ScryptElementPtr _rebuildShuffleBuffer;
+			ScryptBlockPtr _scryptBlock;
+
+			/**
+			<summary>Performs the next step.</summary>
+			*/
+			void Step();
+
+			/**
+			<summary>Stops the SMix if cancellation was requested.</summary>
+			<returns>True when no work remains.</returns>
+			*/
+			bool IsDone();
+
+			/**
+			<summary>Returns the working memory to the scratch pool.</summary>
+			*/
+			void Release();
+		};
+	}
+}
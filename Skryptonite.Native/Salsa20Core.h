@@ -17,9 +17,9 @@
 */
 #pragma once
 #include "SalsaBlock.h"
-#include <intrin.h>
+#include "Platform.h"
 
-#if defined(_M_IX86) || defined(_M_X64)
+#if defined(SKRYPTONITE_X86)
 #define _MM_SHUFFLE_ARG(i0, i1, i2, i3)		_MM_SHUFFLE(i3, i2, i1, i0)
 #endif
 
@@ -49,39 +49,112 @@ namespace Skryptonite
 			/**
 			<summary>Hashes a 64-byte block from 128-bit registers using the Salsa20 algorithm with the given number of iterations.</summary>
 			<param name="block">The 64-byte block to hash. Contains the result.</param>
-			<param name="iterations">The number of iterations.</param>
+			<typeparam name="iterations">The number of iterations.</typeparam>
 			<remarks>
 			Requires that the block be organized so that the diagonal is stored as row 1, and the other elements be arranged accordingly.
 			</remarks>
 			*/
-			static __forceinline void __vectorcall Hash(SalsaBlock128x4& block, unsigned iterations)
+			template<unsigned iterations>
+			static __forceinline void __vectorcall Hash(SalsaBlock128x4& block)
 			{
 				SalsaBlock128x4 inputBlock = block;
 
-				SalsaIterations(block, iterations);
+				SalsaIterations<iterations>(block);
 				AddBlock(block, inputBlock);
 			}
 
-#if defined(_M_IX86) || defined(_M_X64)
+			/**
+			<summary>Hashes a 64-byte block from 32-bit registers using the Salsa20 algorithm with the given number of iterations.</summary>
+			<param name="block">The 64-byte block to hash. Contains the result.</param>
+			<typeparam name="iterations">The number of iterations. Must be even.</typeparam>
+			<remarks>
+			Requires the same arrangement as the vector versions. Rather than transposing, the quarter rounds address the
+			arranged positions of each column and row directly, alternating a column iteration and a row iteration.
+			</remarks>
+			*/
+			template<unsigned iterations>
+			static __forceinline void __vectorcall Hash(SalsaBlock32x16& block)
+			{
+				static_assert(iterations % 2 == 0, "The scalar kernel applies iterations in pairs.");
+
+				SalsaBlock32x16 inputBlock = block;
+				unsigned* x = block.integers;
+
+				for (unsigned j = 0; j < iterations; j += 2)
+				{
+					// columns
+					QuarterRound(x[4], x[8], x[12], x[0]);
+					QuarterRound(x[5], x[9], x[13], x[1]);
+					QuarterRound(x[6], x[10], x[14], x[2]);
+					QuarterRound(x[7], x[11], x[15], x[3]);
+
+					// rows
+					QuarterRound(x[4], x[1], x[14], x[11]);
+					QuarterRound(x[5], x[2], x[15], x[8]);
+					QuarterRound(x[6], x[3], x[12], x[9]);
+					QuarterRound(x[7], x[0], x[13], x[10]);
+				}
+
+				for (unsigned i = 0; i < 16; i++)
+					block.integers[i] += inputBlock.integers[i];
+			}
+
+#if defined(SKRYPTONITE_X86)
 			/**
 			<summary>Hashes a 64-byte block from 256-bit registers using the Salsa20 algorithm with the given number of iterations.</summary>
 			<param name="block">The 64-byte block to hash. Contains the result.</param>
-			<param name="iterations">The number of iterations.</param>
+			<typeparam name="iterations">The number of iterations.</typeparam>
 			<remarks>
 			Requires that the block be organized so that the diagonal is stored as row 1, and the other elements be arranged accordingly.
 			</remarks>
 			*/
-			static __forceinline void __vectorcall Hash(SalsaBlock256x2& block, unsigned iterations)
+			template<unsigned iterations>
+			static __forceinline void __vectorcall Hash(SalsaBlock256x2& block)
 			{
 				SalsaBlock256x2 inputBlock = block;
 				SalsaBlock128x4 block128;
 
 				Unpack256To128(block128, inputBlock);
-				SalsaIterations(block128, iterations);
+				SalsaIterations<iterations>(block128);
 				Pack128To256(inputBlock, block128);
 				AddBlock(block, inputBlock);
 			}
 
+			/**
+			<summary>Hashes a 64-byte block from each of 8 lanes at once using the Salsa20 algorithm with the given number of iterations.</summary>
+			<param name="block">The lane-sliced blocks to hash. Contains the result.</param>
+			<typeparam name="iterations">The number of iterations. Must be even.</typeparam>
+			<remarks>
+			Each register holds the same word of every lane, so the block is used in its original word order and no
+			transposition is needed between iterations; a column iteration and a row iteration are applied alternately.
+			</remarks>
+			*/
+			template<unsigned iterations>
+			static __forceinline void __vectorcall Hash(SalsaBlock256x8& block)
+			{
+				static_assert(iterations % 2 == 0, "The multi-buffer kernel applies iterations in pairs.");
+
+				SalsaBlock256x8 inputBlock = block;
+				__m256i* x = block.words;
+
+				for (unsigned j = 0; j < iterations; j += 2)
+				{
+					// columns
+					QuarterRound(x[0], x[4], x[8], x[12]);
+					QuarterRound(x[5], x[9], x[13], x[1]);
+					QuarterRound(x[10], x[14], x[2], x[6]);
+					QuarterRound(x[15], x[3], x[7], x[11]);
+
+					// rows
+					QuarterRound(x[0], x[1], x[2], x[3]);
+					QuarterRound(x[5], x[6], x[7], x[4]);
+					QuarterRound(x[10], x[11], x[8], x[9]);
+					QuarterRound(x[15], x[12], x[13], x[14]);
+				}
+
+				AddBlock(block, inputBlock);
+			}
+
 			/**
 			<summary>Converts a 64-byte block stored in 256-bit registers to 128-bit registers.</summary>
 			<param name="unpackedBlock">The 128-bit unpacked block.</param>
@@ -111,9 +184,10 @@ namespace Skryptonite
 			/**
 			<summary>Perform the requested number of Salsa20 iterations.</summary>
 			<param name="block">The 64-byte block to hash. Contains the result.</param>
-			<param name="iterations">The number of iterations.</param>
+			<typeparam name="iterations">The number of iterations.</typeparam>
 			*/
-			static __forceinline void __vectorcall SalsaIterations(SalsaBlock128x4& block, unsigned iterations)
+			template<unsigned iterations>
+			static __forceinline void __vectorcall SalsaIterations(SalsaBlock128x4& block)
 			{
 				for (unsigned j = 0; j < iterations; j++)
 				{
@@ -126,7 +200,33 @@ namespace Skryptonite
 				}
 			}
 
-#if defined(_M_IX86) || defined(_M_X64)
+			/**
+			<summary>Performs a Salsa20 quarter round on four 32-bit words.</summary>
+			<param name="a">The diagonal word of the column or row.</param>
+			<param name="b">The word following <paramref name="a"/>.</param>
+			<param name="c">The word following <paramref name="b"/>.</param>
+			<param name="d">The word preceding <paramref name="a"/>.</param>
+			*/
+			static __forceinline void __vectorcall QuarterRound(unsigned& a, unsigned& b, unsigned& c, unsigned& d)
+			{
+				b ^= RotateLeft(a + d, 7);
+				c ^= RotateLeft(b + a, 9);
+				d ^= RotateLeft(c + b, 13);
+				a ^= RotateLeft(d + c, 18);
+			}
+
+			/**
+			<summary>Left-rotates a 32-bit word.</summary>
+			<param name="value">The word to rotate.</param>
+			<param name="rotateMagnitude">The number of bits to rotate by. Must be between 1 and 31.</param>
+			<returns>The rotated word.</returns>
+			*/
+			static __forceinline unsigned __vectorcall RotateLeft(unsigned value, unsigned char rotateMagnitude)
+			{
+				return (value << rotateMagnitude) | (value >> (sizeof(unsigned) * 8 - rotateMagnitude));
+			}
+
+#if defined(SKRYPTONITE_X86)
 			/**
 			<summary>Perform a single Salsa20 operation.</summary>
 			<param name="addend1">The first addend.</param>
@@ -177,9 +277,50 @@ namespace Skryptonite
 				destinationBlock.rows01 = _mm256_add_epi32(destinationBlock.rows01, sourceBlock.rows01);
 				destinationBlock.rows23 = _mm256_add_epi32(destinationBlock.rows23, sourceBlock.rows23);
 			}
+
+			/**
+			<summary>Perform a single Salsa20 operation on 8 lanes at once.</summary>
+			<param name="addend1">The first addend.</param>
+			<param name="addend2">The second addend.</param>
+			<param name="xorOperand">The destination to be xored.</param>
+			<param name="rotateMagnitude">The number of bits to rotate by.</param>
+			<returns>The result of the operation.</returns>
+			*/
+			static __forceinline __m256i __vectorcall SalsaOperation(__m256i addend1, __m256i addend2, __m256i xorOperand, unsigned char rotateMagnitude)
+			{
+				__m256i sum = _mm256_add_epi32(addend1, addend2);
+				__m256i rot = _mm256_or_si256(_mm256_slli_epi32(sum, rotateMagnitude), _mm256_srli_epi32(sum, sizeof(unsigned) * 8 - rotateMagnitude));
+				return _mm256_xor_si256(xorOperand, rot);
+			}
+
+			/**
+			<summary>Performs the four Salsa20 operations of one column or row on 8 lanes at once.</summary>
+			<param name="a">The diagonal element, changed last.</param>
+			<param name="b">The element following the diagonal.</param>
+			<param name="c">The second element following the diagonal.</param>
+			<param name="d">The element preceding the diagonal.</param>
+			*/
+			static __forceinline void __vectorcall QuarterRound(__m256i& a, __m256i& b, __m256i& c, __m256i& d)
+			{
+				b = SalsaOperation(a, d, b, 7);
+				c = SalsaOperation(b, a, c, 9);
+				d = SalsaOperation(c, b, d, 13);
+				a = SalsaOperation(d, c, a, 18);
+			}
+
+			/**
+			<summary>Adds one lane-sliced block into the other using 256-bit registers.</summary>
+			<param name="destinationBlock">The block to add into.</param>
+			<param name="sourceBlock">The block to add.</param>
+			*/
+			static __forceinline void __vectorcall AddBlock(SalsaBlock256x8& destinationBlock, const SalsaBlock256x8& sourceBlock)
+			{
+				for (unsigned i = 0; i < 16; i++)
+					destinationBlock.words[i] = _mm256_add_epi32(destinationBlock.words[i], sourceBlock.words[i]);
+			}
 #endif
 
-#if defined(_M_ARM)
+#if defined(SKRYPTONITE_ARM)
 			/**
 			<summary>Perform a single Salsa20 operation.</summary>
 			<param name="addend1">The first addend.</param>
@@ -16,13 +16,13 @@
 * along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 #pragma once
-#include <intrin.h>
+#include "Platform.h"
 
 namespace Skryptonite
 {
 	namespace Native
 	{
-#if defined(_M_IX86) || defined(_M_X64)
+#if defined(SKRYPTONITE_X86)
 		/**
 		<summary>A 64-byte Salsa20 block stored in 256-bit registers.</summary>
 		*/
@@ -42,9 +42,17 @@ namespace Skryptonite
 			__m128i row2;
 			__m128i row3;
 		} SalsaBlock128x4;
+
+		/**
+		<summary>One 64-byte Salsa20 block from each of 8 independent lanes, stored one 32-bit word of all lanes per 256-bit register.</summary>
+		*/
+		typedef struct
+		{
+			__m256i words[16];
+		} SalsaBlock256x8;
 #endif
 
-#if defined(_M_ARM)
+#if defined(SKRYPTONITE_ARM)
 		/**
 		<summary>A 64-byte Salsa20 block stored in 128-bit registers.</summary>
 		*/
@@ -57,6 +65,14 @@ namespace Skryptonite
 		} SalsaBlock128x4;
 #endif
 
+		/**
+		<summary>A 64-byte Salsa20 block stored in 32-bit general purpose registers.</summary>
+		*/
+		typedef struct
+		{
+			unsigned integers[16];
+		} SalsaBlock32x16;
+
 		/**
 		<summary>A 64-byte Salsa20 block stored in memory.</summary>
 		*/
@@ -0,0 +1,464 @@
+/**
+* Skryptonite - Scrypt library for UWP
+* Copyright © 2016 Nicholas C. Bauer, Ph.D.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "pch.h"
+#include "ScratchPool.h"
+#include "Metrics.h"
+#include "ProcessorTopology.h"
+#include <algorithm>
+#include <new>
+
+#if defined(_WIN32) && !defined(__cplusplus_winrt)
+#define SKRYPTONITE_VIRTUAL_ALLOC
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#elif defined(__linux__)
+#define SKRYPTONITE_MMAP
+#include <sys/mman.h>
+#endif
+
+using namespace Skryptonite::Native;
+
+// buffers below a large page come from the heap; the working buffers are at most a few megabytes
+const size_t HeapAlignment = 64;
+const size_t SmallPageLength = 4096;
+const size_t DefaultMaxRetainedBytes = 512 * 1024 * 1024;
+
+/**
+<summary>Rounds a length up to a multiple of a power of 2.</summary>
+*/
+static size_t RoundUp(size_t length, size_t multiple)
+{
+	return (length + multiple - 1) & ~(multiple - 1);
+}
+
+/**
+<summary>Gets whether a buffer of the given length is mapped from the operating system rather than taken from the heap.</summary>
+*/
+static bool IsMapped(size_t length)
+{
+#if defined(SKRYPTONITE_VIRTUAL_ALLOC) || defined(SKRYPTONITE_MMAP)
+	return length >= ScratchPool::LargePageLength;
+#else
+	return false;
+#endif
+}
+
+/**
+<summary>Writes to every page of a buffer so the page faults happen now rather than inside SMix.</summary>
+*/
+static void Prefault(void* memory, size_t length)
+{
+	volatile unsigned char* bytes = static_cast<unsigned char*>(memory);
+
+	for (size_t i = 0; i < length; i += SmallPageLength)
+		bytes[i] = 0;
+}
+
+#if defined(SKRYPTONITE_VIRTUAL_ALLOC)
+/**
+<summary>Allocates read-write memory, on the given NUMA node unless it is negative.</summary>
+*/
+static void* VirtualAllocOnNode(size_t length, DWORD allocationType, int node)
+{
+	if (node < 0)
+		return VirtualAlloc(nullptr, length, allocationType, PAGE_READWRITE);
+
+	return VirtualAllocExNuma(GetCurrentProcess(), nullptr, length, allocationType, PAGE_READWRITE, static_cast<DWORD>(node));
+}
+#endif
+
+// the pool of a thread pool worker; null on every other thread
+static thread_local ScratchPool* CurrentPool = nullptr;
+
+ScratchPool& ScratchPool::Global()
+{
+	static ScratchPool pool;
+	return pool;
+}
+
+ScratchPool& ScratchPool::Current()
+{
+	return CurrentPool != nullptr ? *CurrentPool : Global();
+}
+
+void ScratchPool::SetCurrent(ScratchPool* pool)
+{
+	CurrentPool = pool;
+}
+
+ScratchPool::ScratchPool() :
+	_retainedBytes(0),
+	_eraseOnRelease(true),
+	_node(-1),
+	_owner(this),
+	_maxRetainedBytes(DefaultMaxRetainedBytes),
+	_sharedRetainedBytes(0)
+{
+}
+
+ScratchPool::ScratchPool(ScratchPool& owner) :
+	_retainedBytes(0),
+	_eraseOnRelease(true),
+	_node(-1),
+	_owner(&owner),
+	_maxRetainedBytes(0),
+	_sharedRetainedBytes(0)
+{
+	_ASSERT(owner._owner == &owner);
+
+	std::lock_guard<std::mutex> lock(owner._sharersMutex);
+	owner._sharers.push_back(this);
+}
+
+ScratchPool::~ScratchPool()
+{
+	if (_owner != this)
+	{
+		std::lock_guard<std::mutex> lock(_owner->_sharersMutex);
+		_owner->_sharers.erase(std::find(_owner->_sharers.begin(), _owner->_sharers.end(), this));
+	}
+
+	Trim();
+}
+
+void* ScratchPool::Acquire(size_t length)
+{
+	_ASSERT(length > 0);
+	SKRYPTONITE_METRICS_SHORT_PHASE(ScratchAcquire, length);
+
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+
+		for (size_t i = _regions.size(); i-- > 0;)
+		{
+			if (_regions[i].length == length)
+			{
+				void* memory = _regions[i].memory;
+				_regions.erase(_regions.begin() + i);
+				_retainedBytes -= length;
+				_owner->_sharedRetainedBytes -= length;
+
+				SKRYPTONITE_METRICS_COUNT(ScratchReuses, 1);
+				return memory;
+			}
+		}
+	}
+
+	int node = Node();
+	void* memory = Allocate(length, node);
+
+	if (memory == nullptr)
+	{
+		// kept buffers of other lengths may be what is exhausting memory
+		Trim();
+		memory = Allocate(length, node);
+	}
+
+	if (memory == nullptr)
+	{
+		SKRYPTONITE_METRICS_COUNT(ScratchAllocationFailures, 1);
+		throw std::bad_alloc();
+	}
+
+	SKRYPTONITE_METRICS_COUNT(ScratchAllocations, 1);
+	SKRYPTONITE_METRICS_COUNT(ScratchAllocatedBytes, length);
+	return memory;
+}
+
+void ScratchPool::Release(void* memory, size_t length)
+{
+	if (memory == nullptr)
+		return;
+
+	SKRYPTONITE_METRICS_SHORT_PHASE(ScratchRelease, length);
+
+	// erasing and unmapping take long enough to stall every other thread releasing or acquiring, so the lock is only held to
+	// look at and change the list
+	if (EraseOnRelease())
+		SecureErase(memory, length);
+
+	size_t maxRetainedBytes = _owner->_maxRetainedBytes;
+	std::vector<Region> evicted;
+	bool isKept = false;
+
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+
+		// the buffers of the other pools sharing the limit stay, so only trim when that leaves room
+		size_t otherBytes = _owner->_sharedRetainedBytes - _retainedBytes;
+		if (length <= maxRetainedBytes && otherBytes <= maxRetainedBytes - length)
+		{
+			evicted = TrimTo(maxRetainedBytes - length);
+
+			try
+			{
+				_regions.reserve(_regions.size() + 1);
+
+				// the pools sharing the limit may have kept buffers of their own since this one trimmed
+				isKept = Charge(length, maxRetainedBytes);
+				if (isKept)
+				{
+					_regions.push_back({ memory, length });
+					_retainedBytes += length;
+				}
+			}
+			catch (const std::bad_alloc&)
+			{
+			}
+		}
+	}
+
+	FreeRegions(evicted);
+
+	if (!isKept)
+		Free(memory, length);
+}
+
+void ScratchPool::Trim()
+{
+	std::vector<Region> evicted;
+
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		evicted = TrimTo(0);
+	}
+
+	FreeRegions(evicted);
+}
+
+size_t ScratchPool::RetainedBytes()
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	return _retainedBytes;
+}
+
+size_t ScratchPool::SharedRetainedBytes()
+{
+	return _owner->_sharedRetainedBytes;
+}
+
+size_t ScratchPool::MaxRetainedBytes()
+{
+	return _owner->_maxRetainedBytes;
+}
+
+void ScratchPool::SetMaxRetainedBytes(size_t value)
+{
+	_owner->_maxRetainedBytes = value;
+	_owner->TrimShared(value);
+}
+
+void ScratchPool::TrimShared(size_t limit)
+{
+	if (_owner != this)
+	{
+		_owner->TrimShared(limit);
+		return;
+	}
+
+	// the memory budget calls this whenever memory is reserved or released
+	if (_sharedRetainedBytes <= limit)
+		return;
+
+	std::lock_guard<std::mutex> sharersLock(_sharersMutex);
+
+	for (size_t i = 0; i <= _sharers.size() && _sharedRetainedBytes > limit; i++)
+	{
+		ScratchPool* pool = i == 0 ? this : _sharers[i - 1];
+		std::vector<Region> evicted;
+
+		{
+			std::lock_guard<std::mutex> lock(pool->_mutex);
+			evicted = pool->TrimTo(limit);
+		}
+
+		FreeRegions(evicted);
+	}
+}
+
+bool ScratchPool::EraseOnRelease()
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	return _eraseOnRelease;
+}
+
+void ScratchPool::SetEraseOnRelease(bool value)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	_eraseOnRelease = value;
+}
+
+int ScratchPool::Node()
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	return _node;
+}
+
+void ScratchPool::SetNode(int value)
+{
+	std::vector<Region> evicted;
+
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+
+		// kept buffers live on the old node
+		if (value != _node)
+			evicted = TrimTo(0);
+
+		_node = value;
+	}
+
+	FreeRegions(evicted);
+}
+
+std::vector<ScratchPool::Region> ScratchPool::TrimTo(size_t limit)
+{
+	std::vector<Region> evicted;
+	size_t count = 0;
+
+	while (count < _regions.size() && _owner->_sharedRetainedBytes > limit)
+	{
+		_retainedBytes -= _regions[count].length;
+		_owner->_sharedRetainedBytes -= _regions[count].length;
+		count++;
+	}
+
+	if (count == _regions.size())
+	{
+		evicted.swap(_regions);
+		return evicted;
+	}
+
+	try
+	{
+		evicted.assign(_regions.begin(), _regions.begin() + count);
+	}
+	catch (const std::bad_alloc&)
+	{
+		// with no room to hand them back, they are freed under the lock after all
+		for (size_t i = 0; i < count; i++)
+			Free(_regions[i].memory, _regions[i].length);
+	}
+
+	_regions.erase(_regions.begin(), _regions.begin() + count);
+	return evicted;
+}
+
+bool ScratchPool::Charge(size_t length, size_t limit)
+{
+	size_t shared = _owner->_sharedRetainedBytes;
+
+	do
+	{
+		if (shared > limit || length > limit - shared)
+			return false;
+	}
+	while (!_owner->_sharedRetainedBytes.compare_exchange_weak(shared, shared + length));
+
+	return true;
+}
+
+void ScratchPool::FreeRegions(const std::vector<Region>& regions)
+{
+	for (const Region& region : regions)
+		Free(region.memory, region.length);
+}
+
+void* ScratchPool::Allocate(size_t length, int node)
+{
+	if (!IsMapped(length))
+		return AlignedAlloc(length, HeapAlignment);
+
+#if defined(SKRYPTONITE_VIRTUAL_ALLOC)
+	size_t largePageMinimum = GetLargePageMinimum();
+
+	if (largePageMinimum > 0)
+	{
+		// only succeeds when the process holds the lock pages in memory privilege; large pages are always resident
+		void* memory = VirtualAllocOnNode(RoundUp(length, largePageMinimum), MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, node);
+		if (memory != nullptr)
+			return memory;
+	}
+
+	void* memory = VirtualAllocOnNode(length, MEM_RESERVE | MEM_COMMIT, node);
+	if (memory != nullptr)
+		Prefault(memory, length);
+
+	return memory;
+#elif defined(SKRYPTONITE_MMAP)
+	size_t mappedLength = RoundUp(length, LargePageLength);
+
+#if defined(MAP_HUGETLB)
+	// only succeeds when huge pages have been reserved by the administrator; placing the pages on a node means faulting
+	// them in after the mapping exists
+	void* memory = mmap(nullptr, mappedLength, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | (node >= 0 ? 0 : MAP_POPULATE), -1, 0);
+	if (memory != MAP_FAILED)
+	{
+		if (node >= 0)
+		{
+			ProcessorTopology::PreferNode(memory, mappedLength, static_cast<unsigned>(node));
+			Prefault(memory, mappedLength);
+		}
+
+		return memory;
+	}
+#endif
+
+	// transparent huge pages need 2 MB aligned addresses, so map an extra large page and unmap the misaligned ends
+	unsigned char* reserved = static_cast<unsigned char*>(mmap(nullptr, mappedLength + LargePageLength, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+	if (reserved == MAP_FAILED)
+		return nullptr;
+
+	unsigned char* aligned = reinterpret_cast<unsigned char*>(RoundUp(reinterpret_cast<size_t>(reserved), LargePageLength));
+	size_t head = aligned - reserved;
+
+	if (head > 0)
+		munmap(reserved, head);
+	munmap(aligned + mappedLength, LargePageLength - head);
+
+#if defined(MADV_HUGEPAGE)
+	madvise(aligned, mappedLength, MADV_HUGEPAGE);
+#endif
+	if (node >= 0)
+		ProcessorTopology::PreferNode(aligned, mappedLength, static_cast<unsigned>(node));
+	Prefault(aligned, mappedLength);
+
+	return aligned;
+#else
+	return nullptr;
+#endif
+}
+
+void ScratchPool::Free(void* memory, size_t length)
+{
+	if (!IsMapped(length))
+	{
+		AlignedFree(memory);
+		return;
+	}
+
+#if defined(SKRYPTONITE_VIRTUAL_ALLOC)
+	VirtualFree(memory, 0, MEM_RELEASE);
+#elif defined(SKRYPTONITE_MMAP)
+	munmap(memory, RoundUp(length, LargePageLength));
+#endif
+}
@@ -0,0 +1,218 @@
+/**
+* Skryptonite - Scrypt library for UWP
+* Copyright © 2016 Nicholas C. Bauer, Ph.D.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#pragma once
+#include "Platform.h"
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+namespace Skryptonite
+{
+	namespace Native
+	{
+		/**
+		<summary>Keeps the working buffers and large memory blocks of SMix between calls so repeated derivations with the same
+		parameters do not allocate, fault in, and free memory every time.</summary>
+		<remarks>
+		Buffers are kept by length, which depends only on the element length and processing cost. A pool may share the limit of
+		another, so the buffers kept by both count against one <see cref="MaxRetainedBytes"/>. Buffers of at least
+		<see cref="LargePageLength"/> bytes are mapped directly from the operating system, using large pages when it grants them
+		and asking for transparent huge pages otherwise, and every page is faulted in before first use. Fewer TLB misses make
+		the random reads of the second SMix loop cheaper. Smaller buffers come from the aligned heap.
+		</remarks>
+		*/
+		class ScratchPool
+		{
+		public:
+			/**
+			<summary>The length of a large page on the platforms that support them.</summary>
+			*/
+			static const size_t LargePageLength = 2 * 1024 * 1024;
+
+			/**
+			<summary>Gets the pool shared by every engine.</summary>
+			*/
+			static ScratchPool& Global();
+
+			/**
+			<summary>Gets the pool the calling thread takes its buffers from: its own when it is a worker of a
+			<see cref="ThreadPool"/>, otherwise <see cref="Global"/>.</summary>
+			*/
+			static ScratchPool& Current();
+
+			/**
+			<summary>Sets the pool the calling thread takes its buffers from.</summary>
+			<param name="pool">The pool, which must outlive every buffer taken from it, or null for <see cref="Global"/>.</param>
+			*/
+			static void SetCurrent(ScratchPool* pool);
+
+			/**
+			<summary>Creates a pool with its own limit.</summary>
+			*/
+			ScratchPool();
+
+			/**
+			<summary>Creates a pool whose kept buffers count against the limit of another.</summary>
+			<param name="owner">The pool whose limit is shared, which must outlive this one and not share the limit of a third.</param>
+			*/
+			explicit ScratchPool(ScratchPool& owner);
+
+			~ScratchPool();
+
+			ScratchPool(const ScratchPool&) = delete;
+			ScratchPool& operator=(const ScratchPool&) = delete;
+
+			/**
+			<summary>Obtains a buffer, reusing a released one of the same length when available.</summary>
+			<param name="length">The length of the buffer in bytes. Must be greater than 0.</param>
+			<returns>Memory aligned to at least 64 bytes. Its contents are unspecified.</returns>
+			<exception cref="std::bad_alloc">Thrown when the memory cannot be allocated.</exception>
+			*/
+			void* Acquire(size_t length);
+
+			/**
+			<summary>Returns a buffer obtained from <see cref="Acquire"/> to the pool.</summary>
+			<param name="memory">The buffer. May be null.</param>
+			<param name="length">The length the buffer was acquired with.</param>
+			<remarks>
+			The buffer is erased first when <see cref="EraseOnRelease"/> is set. It is freed instead of kept when keeping it would
+			exceed <see cref="MaxRetainedBytes"/> even after freeing every other buffer kept by this pool, in which case the others
+			are kept.
+			</remarks>
+			*/
+			void Release(void* memory, size_t length);
+
+			/**
+			<summary>Frees every buffer kept by the pool.</summary>
+			*/
+			void Trim();
+
+			/**
+			<summary>Gets the number of bytes kept by the pool and not in use.</summary>
+			*/
+			size_t RetainedBytes();
+
+			/**
+			<summary>Gets the number of bytes kept and not in use by the pool and every pool sharing its limit.</summary>
+			*/
+			size_t SharedRetainedBytes();
+
+			/**
+			<summary>Gets the largest number of bytes the pool, together with every pool sharing its limit, keeps while not in use.
+			0 disables pooling.</summary>
+			*/
+			size_t MaxRetainedBytes();
+
+			/**
+			<summary>Sets the largest number of bytes the pool, together with every pool sharing its limit, keeps while not in use,
+			freeing kept buffers beyond it.</summary>
+			*/
+			void SetMaxRetainedBytes(size_t value);
+
+			/**
+			<summary>Frees the oldest buffers kept by the pool, then by the pools sharing its limit, until they keep no more than
+			<paramref name="limit"/> bytes together.</summary>
+			*/
+			void TrimShared(size_t limit);
+
+			/**
+			<summary>Gets whether buffers are erased when released. True by default, since they hold data derived from passwords.</summary>
+			*/
+			bool EraseOnRelease();
+
+			/**
+			<summary>Sets whether buffers are erased when released.</summary>
+			<remarks>
+			Every buffer is completely overwritten by SMix before being read, so skipping the erasure only affects how long
+			derived data stays in memory, not the results.
+			</remarks>
+			*/
+			void SetEraseOnRelease(bool value);
+
+			/**
+			<summary>Gets the NUMA node that buffers mapped from the operating system are placed on, or -1 for wherever they are
+			first touched.</summary>
+			*/
+			int Node();
+
+			/**
+			<summary>Sets the NUMA node that buffers mapped from the operating system are placed on, freeing kept buffers when it
+			changes.</summary>
+			<param name="value">The node, or -1 to leave placement to the operating system.</param>
+			<remarks>The node is preferred, not required: when it runs out of memory, buffers come from other nodes.</remarks>
+			*/
+			void SetNode(int value);
+
+		private:
+			/**
+			<summary>A buffer kept by the pool.</summary>
+			*/
+			struct Region
+			{
+				void* memory;
+				size_t length;
+			};
+
+			std::mutex _mutex;
+			std::vector<Region> _regions;
+			size_t _retainedBytes;
+			bool _eraseOnRelease;
+			int _node;
+
+			// the pool whose limit this one keeps buffers under; itself unless it was created to share another's
+			ScratchPool* const _owner;
+
+			// only used on an owner: its limit, the bytes kept by it and every pool sharing the limit, and those pools
+			std::atomic<size_t> _maxRetainedBytes;
+			std::atomic<size_t> _sharedRetainedBytes;
+			std::mutex _sharersMutex;
+			std::vector<ScratchPool*> _sharers;
+
+			/**
+			<summary>Removes the oldest buffers kept by the pool until the pools sharing its limit keep no more than
+			<paramref name="limit"/> bytes together, or it keeps none. The caller must hold the mutex.</summary>
+			<returns>The removed buffers, which the caller frees with <see cref="FreeRegions"/> once it has released the mutex.</returns>
+			*/
+			std::vector<Region> TrimTo(size_t limit);
+
+			/**
+			<summary>Counts a buffer against the shared limit if it fits under it.</summary>
+			<returns>True when the buffer was counted.</returns>
+			*/
+			bool Charge(size_t length, size_t limit);
+
+			/**
+			<summary>Frees buffers removed by <see cref="TrimTo"/>.</summary>
+			*/
+			static void FreeRegions(const std::vector<Region>& regions);
+
+			/**
+			<summary>Allocates memory from the operating system, with large pages when possible, and faults every page in.</summary>
+			<param name="length">The length of the memory in bytes.</param>
+			<param name="node">The NUMA node to place the memory on, or -1 for any.</param>
+			<returns>The memory, or null if the allocation failed.</returns>
+			*/
+			static void* Allocate(size_t length, int node);
+
+			/**
+			<summary>Frees memory obtained from <see cref="Allocate"/>.</summary>
+			*/
+			static void Free(void* memory, size_t length);
+		};
+	}
+}
@@ -17,11 +17,22 @@
 */
 #include "pch.h"
 #include <limits>
+#include <stdexcept>
 #include "ScryptBlock.h"
+#include "ScratchPool.h"
 
 using namespace Skryptonite::Native;
 
-ScryptBlock::ScryptBlock(unsigned blockCountPerElement, unsigned elementCount)
+ScryptBlock::ScryptBlock(unsigned blockCountPerElement, unsigned elementCount) :
+	ScryptBlock(blockCountPerElement, elementCount, nullptr)
+{
+	// the delegated constructor has completed, so the destructor runs if this throws; the pool is set only once there is memory
+	ScratchPool& pool = ScratchPool::Current();
+	_data = reinterpret_cast<SalsaBlock*>(pool.Acquire(_length));
+	_pool = &pool;
+}
+
+ScryptBlock::ScryptBlock(unsigned blockCountPerElement, unsigned elementCount, SalsaBlock* memory)
 {
 	if (blockCountPerElement == 0)
 		throw std::out_of_range("blockCountPerElement must be greater than 0.");
@@ -33,23 +44,21 @@ ScryptBlock::ScryptBlock(unsigned blockCountPerElement, unsigned elementCount)
 	_elementCount = elementCount;
 	_blockCountPerElement = blockCountPerElement;
 	_length = sizeof(SalsaBlock) * blockCountPerElement * elementCount;
-	
-	_data = reinterpret_cast<SalsaBlock*>(_aligned_malloc(_length, Alignment));
-
-	if (_data == NULL)
-		throw std::bad_alloc();
+	_data = memory;
+	_pool = nullptr;
 }
 
 ScryptBlock::~ScryptBlock()
 {
-	memset(_data, 0, _length);
-	_aligned_free(_data);
+	// caller-owned memory has no pool
+	if (_pool != nullptr)
+		_pool->Release(_data, _length);
 }
 
 SalsaBlock* ScryptBlock::operator[](unsigned i) const
 {
 	if (i >= _elementCount)
-		throw new std::out_of_range("i must be less than ElementCount.");
+		throw std::out_of_range("i must be less than ElementCount.");
 	
-	return _data + i * _blockCountPerElement;
+	return _data + static_cast<size_t>(i) * _blockCountPerElement;
 }
\ No newline at end of file
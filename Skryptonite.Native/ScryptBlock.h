@@ -17,6 +17,7 @@
 */
 #pragma once
 #include "SalsaBlock.h"
+#include "ScratchPool.h"
 #include <memory>
 
 namespace Skryptonite
@@ -25,6 +26,8 @@ namespace Skryptonite
 	{
 		/**
 		<summary>Encapsulates the large block of memory accessed by the Scrypt SMix function.</summary>
+		<remarks>The memory is taken from and returned to the <see cref="ScratchPool::Current"/> pool of the creating thread, unless
+		the caller provides it.</remarks>
 		*/
 		class ScryptBlock
 		{
@@ -44,10 +47,20 @@ namespace Skryptonite
 			<param name="blockCountPerElement">The number of 64-byte blocks composing the buffer data per element.</param>
 			<param name="elementCount">The number of elements composing the memory block.</param>
 			<exception cref="std::out_of_range">Thrown when either parameter is 0.</exception>
-			<exception cref="std::exception">Thrown when the memory allocation fails.</exception>
+			<exception cref="std::bad_alloc">Thrown when the memory allocation fails.</exception>
 			*/
 			ScryptBlock(unsigned blockCountPerElement, unsigned elementCount);
 
+			/**
+			<summary>Wraps caller-owned memory, which is neither allocated nor released.</summary>
+			<param name="blockCountPerElement">The number of 64-byte blocks composing the buffer data per element.</param>
+			<param name="elementCount">The number of elements composing the memory block.</param>
+			<param name="memory">At least 64 * blockCountPerElement * elementCount bytes aligned to 64 bytes, which must outlive this
+			object.</param>
+			<exception cref="std::out_of_range">Thrown when either count is 0.</exception>
+			*/
+			ScryptBlock(unsigned blockCountPerElement, unsigned elementCount, SalsaBlock* memory);
+
 			~ScryptBlock();
 
 			/**
@@ -59,13 +72,12 @@ namespace Skryptonite
 			SalsaBlock* operator[](unsigned i) const;
 
 		private:
-			const int Alignment = 64;
-
 			unsigned _blockCountPerElement;
 			unsigned _elementCount;
 			size_t _length;
 
 			SalsaBlock* _data;
+			ScratchPool* _pool;
 		};
 
 		typedef std::unique_ptr<ScryptBlock> ScryptBlockPtr;
@@ -19,7 +19,7 @@
 #include "SalsaBlock.h"
 #include "ScryptElement.h"
 #include "Salsa20Core.h"
-#include <crtdbg.h>
+#include "CachePolicy.h"
 
 namespace Skryptonite
 {
@@ -42,13 +42,20 @@ namespace Skryptonite
 		{
 		public:
 			/**
-			<summary>Rearranges the input data in an optimal format for SMix.</summary>
-			<typeparam name="TSalsaBlock">The type into which the 64-byte blocks will be loaded and managed.</typeparam>
-			<param name="workingBuffer">A pointer to the SMix working buffer into which the data will be loaded. Must be aligned to at least the cache line size (e.g. 64 bytes).</param>
-			<param name="source">A pointer to the buffer from which the data will be loaded.</param>
-			<param name="blockCount">The length of the buffers in 64-byte blocks.</param>
+			<summary>Performs the first BlockMix of SMix directly on the input data, arranging each 64-byte block optimally as it is
+			loaded and copying it into the large memory block.</summary>
+			<typeparam name="TSalsaBlock">The type into which the 64-byte blocks are loaded and managed.</typeparam>
+			<typeparam name="policy">How <paramref name="copyDestination"/> is written. Must not be <see cref="CachePolicy::Automatic"/>.</typeparam>
+			<typeparam name="fixedBlockCount">The length of an element in 64-byte blocks when known at compile time, otherwise 0.</typeparam>
+			<param name="copyDestination">The first element of the large memory block. Must be aligned to at least the cache line size (e.g. 64 bytes).</param>
+			<param name="source">A pointer to the input data in its original ordering.</param>
+			<param name="mixDestination">A pointer to the buffer which receives the mixed, optimally-arranged data: the working buffer, or the
+			second element of the large memory block. Must be aligned to at least the cache line size (e.g. 64 bytes).</param>
+			<param name="runtimeBlockCount">The length of an element in 64-byte blocks. Ignored when <typeparamref name="fixedBlockCount"/> is not 0.</param>
 			<param name="prepareBlock">A pointer to a function which rearranges the data of a 64-byte block into a format amenable to the Salsa20 hash function.</param>
 			<remarks>
+			Equivalent to arranging the whole element into the working buffer and then calling <see cref="MixBlocks"/> with
+			<see cref="MixBlocksMode::Copy"/>, without the separate pass over the element.
 			Moves the critical last 64-byte block to the front.
 			<paramref name="prepareBlock"/> shifts the data so that the diagonals become rows:
 			0	1	2	3			12	1	6	11
@@ -57,31 +64,101 @@ namespace Skryptonite
 			12	13	14	15			8	13	2	7
 			</remarks>
 			*/
-			template<class TSalsaBlock>
-			static __forceinline void __vectorcall PrepareData(ScryptElementPtr& workingBuffer, SalsaBlock* source, void(*prepareBlock)(TSalsaBlock& arrangedBlock, TSalsaBlock& block))
+			template<class TSalsaBlock, CachePolicy policy, unsigned fixedBlockCount>
+			static __forceinline void __vectorcall PrepareCopyAndMixBlocks(SalsaBlock* copyDestination, SalsaBlock* source, SalsaBlock* mixDestination, unsigned runtimeBlockCount, void(*prepareBlock)(TSalsaBlock& arrangedBlock, TSalsaBlock& block))
 			{
-				_ASSERT(workingBuffer != nullptr && workingBuffer->Data() != nullptr);
-				_ASSERT(workingBuffer->BlockCount() > 0);
+				_ASSERT(copyDestination != nullptr);
 				_ASSERT(source != nullptr);
+				_ASSERT(mixDestination != nullptr);
+				_ASSERT(runtimeBlockCount > 0);
 				_ASSERT(prepareBlock != nullptr);
+				static_assert(policy != CachePolicy::Automatic, "The cache policy must be resolved before mixing.");
+
+				const unsigned blockCount = BlockCount<fixedBlockCount>(runtimeBlockCount);
+				const unsigned halfSalsaBlockCount = blockCount / 2;
+
+				TSalsaBlock lastBlock;
+				LoadAndPrepareBlock(lastBlock, source + blockCount - 1, prepareBlock);
+				StoreFor<policy>(copyDestination++, lastBlock);
+
+				TSalsaBlock previousBlock = lastBlock;
+
+				for (unsigned i = 0; i < blockCount - 1; i++, source++, copyDestination++)
+				{
+					TSalsaBlock currentBlock;
+					LoadAndPrepareBlock(currentBlock, source, prepareBlock);
+					StoreFor<policy>(copyDestination, currentBlock);
+
+					// sort evens to the left half and odds to the right half
+					SalsaBlock* destination = mixDestination + i / 2 + 1;
+					destination += (i % 2 == 0) ? 0 : halfSalsaBlockCount;
+
+					MixBlock(destination, currentBlock, previousBlock);
+
+					previousBlock = currentBlock;
+				}
+
+				MixBlock(mixDestination, lastBlock, previousBlock);
+			}
+
+			/**
+			<summary>The Scrypt BlockMix function from one optimally-arranged buffer into another, without copying the input.</summary>
+			<typeparam name="TSalsaBlock">The type into which the 64-byte blocks are loaded and managed.</typeparam>
+			<typeparam name="fixedBlockCount">The length of the buffers in 64-byte blocks when known at compile time, otherwise 0.</typeparam>
+			<param name="destination">A pointer to the buffer which receives the output. Must be aligned to at least the cache line size (e.g. 64 bytes).</param>
+			<param name="source">A pointer to the input, such as the previous element of the large memory block. Must be aligned to at least the cache line size (e.g. 64 bytes).</param>
+			<param name="runtimeBlockCount">The length of the buffers in 64-byte blocks. Ignored when <typeparamref name="fixedBlockCount"/> is not 0.</param>
+			<remarks>
+			Filling the large memory block with this function stores every element once, where <see cref="MixBlocks"/> with
+			<see cref="MixBlocksMode::Copy"/> stores it both to the large memory block and to the shuffle buffer. The input is read back
+			from the large memory block, so this only pays off when that is still in the cache.
+			</remarks>
+			*/
+			template<class TSalsaBlock, unsigned fixedBlockCount>
+			static __forceinline void __vectorcall MixBlocksInto(SalsaBlock* destination, SalsaBlock* source, unsigned runtimeBlockCount)
+			{
+				_ASSERT(destination != nullptr);
+				_ASSERT(source != nullptr);
+				_ASSERT(runtimeBlockCount > 0);
+
+				const unsigned blockCount = BlockCount<fixedBlockCount>(runtimeBlockCount);
+				const unsigned halfSalsaBlockCount = blockCount / 2;
+
+				TSalsaBlock lastBlock;
+				LoadFromAligned(lastBlock, source++);
 
-				SalsaBlock* destination = workingBuffer->Data() + 1;
+				TSalsaBlock previousBlock = lastBlock;
 
-				for (unsigned i = 0; i < workingBuffer->BlockCount() - 1; i++, source++, destination++)
-					LoadAndPrepareBlock<TSalsaBlock>(destination, source, prepareBlock);
+				for (unsigned i = 0; i < blockCount - 1; i++, source++)
+				{
+					TSalsaBlock currentBlock;
+					LoadFromAligned(currentBlock, source);
 
-				LoadAndPrepareBlock<TSalsaBlock>(workingBuffer->Data(), source, prepareBlock);
+					// sort evens to the left half and odds to the right half
+					SalsaBlock* blockDestination = destination + i / 2 + 1;
+					blockDestination += (i % 2 == 0) ? 0 : halfSalsaBlockCount;
+
+					MixBlock(blockDestination, currentBlock, previousBlock);
+
+					previousBlock = currentBlock;
+				}
+
+				MixBlock(destination, lastBlock, previousBlock);
 			}
 
 			/**
-			<summary>Restores the SMix-optimized data to its original ordering.</summary>
-			<typeparam name="TSalsaBlock">The type into which the 64-byte blocks were loaded and managed.</typeparam>
-			<param name="destination">A pointer to the buffer to which the data will be returned.</param>
-			<param name="workingBuffer">A pointer to the SMix working buffer from which the data will be returned. Must be aligned to at least the cache line size (e.g. 64 bytes).</param>
-			<param name="blockCount">The length of the buffers in 64-byte blocks.</param>
-			<param name="prepareBlock">A pointer to a function which rearranges the data of a 64-byte block from a format amenable to the Salsa20 hash function into its original ordering.</param>
+			<summary>Performs the last BlockMix of SMix, restoring each mixed 64-byte block to its original ordering as it is stored
+			to the output.</summary>
+			<typeparam name="TSalsaBlock">The type into which the 64-byte blocks are loaded and managed.</typeparam>
+			<typeparam name="policy">How <paramref name="xorSource"/> is read. Must not be <see cref="CachePolicy::Automatic"/>.</typeparam>
+			<typeparam name="fixedBlockCount">The length of the working buffer in 64-byte blocks when known at compile time, otherwise 0.</typeparam>
+			<param name="destination">A pointer to the buffer which receives the output in its original ordering.</param>
+			<param name="workingBuffer">A pointer to the SMix working buffer containing the optimally-arranged data. Must be aligned to at least the cache line size (e.g. 64 bytes).</param>
+			<param name="xorSource">The element of the large memory block to xor in. Must be aligned to at least the cache line size (e.g. 64 bytes).</param>
+			<param name="restoreBlock">A pointer to a function which rearranges the data of a 64-byte block from a format amenable to the Salsa20 hash function into its original ordering.</param>
 			<remarks>
-			Restores the critical last 64-byte block from the front.
+			Equivalent to calling <see cref="MixBlocks"/> with <see cref="MixBlocksMode::Xor"/> and then restoring the whole working
+			buffer, without the separate pass over the element. The working buffer is left unchanged.
 			<paramref name="restoreBlock"/> shifts the data so that the rows become diagonals:
 			12	1	6	11			0	1	2	3
 			0	5	10	15	----->	4	5	6	7
@@ -89,42 +166,70 @@ namespace Skryptonite
 			8	13	2	7			12	13	14	15
 			</remarks>
 			*/
-			template<class TSalsaBlock>
-			static __forceinline void __vectorcall RestoreData(SalsaBlock* destination, ScryptElementPtr& workingBuffer, void(*restoreBlock)(TSalsaBlock& block, TSalsaBlock& arrangedBlock))
+			template<class TSalsaBlock, CachePolicy policy, unsigned fixedBlockCount>
+			static __forceinline void __vectorcall XorMixAndRestoreBlocks(SalsaBlock* destination, ScryptElementPtr& workingBuffer, SalsaBlock* xorSource, void(*restoreBlock)(TSalsaBlock& block, TSalsaBlock& arrangedBlock))
 			{
 				_ASSERT(destination != nullptr);
 				_ASSERT(workingBuffer != nullptr && workingBuffer->Data() != nullptr);
 				_ASSERT(workingBuffer->BlockCount() > 0);
+				_ASSERT(xorSource != nullptr);
 				_ASSERT(restoreBlock != nullptr);
-
-				TSalsaBlock arrangedLastBlock, lastBlock;
+				static_assert(policy != CachePolicy::Automatic, "The cache policy must be resolved before mixing.");
 
 				SalsaBlock* currentBlockPosition = workingBuffer->Data();
+				SalsaBlock* xorFutureBlockPosition = xorSource;
+
+				const unsigned blockCount = BlockCount<fixedBlockCount>(workingBuffer->BlockCount());
+				const unsigned halfSalsaBlockCount = blockCount / 2;
+
+				for (unsigned i = 0; i < halfSalsaBlockCount; i++, xorFutureBlockPosition++)
+					PrefetchFor<policy>(xorFutureBlockPosition);
 
-				LoadFromAligned(arrangedLastBlock, currentBlockPosition++);
+				TSalsaBlock lastBlock;
+				LoadFromAligned(lastBlock, currentBlockPosition++);
+				LoadXorFlush<TSalsaBlock, policy>(lastBlock, xorSource++);
 
-				for (unsigned i = 0; i < workingBuffer->BlockCount() - 1; i++, currentBlockPosition++, destination++)
-					LoadAndRestoreBlock<TSalsaBlock>(destination, currentBlockPosition, restoreBlock);
+				TSalsaBlock previousBlock = lastBlock;
 
-				restoreBlock(lastBlock, arrangedLastBlock);
-				StoreToUnaligned(destination, lastBlock);
+				for (unsigned i = 0; i < blockCount - 1; i++, currentBlockPosition++, xorSource++)
+				{
+					TSalsaBlock currentBlock;
+					LoadFromAligned(currentBlock, currentBlockPosition);
+
+					if (i < halfSalsaBlockCount)
+						PrefetchFor<policy>(xorFutureBlockPosition++);
+					LoadXorFlush<TSalsaBlock, policy>(currentBlock, xorSource);
+
+					// evens go to the left half and odds to the right half of the output
+					SalsaBlock* blockDestination = destination + i / 2;
+					blockDestination += (i % 2 == 0) ? 0 : halfSalsaBlockCount;
+
+					MixAndRestoreBlock(blockDestination, currentBlock, previousBlock, restoreBlock);
+
+					previousBlock = currentBlock;
+				}
+
+				MixAndRestoreBlock(destination + blockCount - 1, lastBlock, previousBlock, restoreBlock);
 			}
 
 			/**
 			<summary>The Scrypt BlockMix function. Mixes a buffer of an even number of 64-byte blocks.</summary>
 			<typeparam name="TSalsaBlock">The type into which the 64-byte blocks are loaded and managed.</typeparam>
+			<typeparam name="policy">How <paramref name="otherBuffer"/> is written and read. Must not be <see cref="CachePolicy::Automatic"/>.</typeparam>
+			<typeparam name="mode">Controls how <paramref name="otherBuffer"/> is treated.
+			<see cref="MixBlocksMode::None"/> only does the standard block mixing.
+			<see cref="MixBlocksMode::Copy"/> copies the input data into <paramref name="otherBuffer"/>.
+			<see cref="MixBlocksMode::Xor"/> xors <paramref name="otherBuffer"/> with <paramref name="workingBuffer"/> before mixing each 64-byte block.</typeparam>
+			<typeparam name="fixedBlockCount">The length of the buffers in 64-byte blocks when known at compile time, otherwise 0.</typeparam>
 			<param name="workingBuffer">A pointer to the SMix working buffer containing the optimally-arranged data. Must be aligned to at least the cache line size (e.g. 64 bytes).</param>
 			<param name="otherBuffer">A pointer to a buffer which is used according to <paramref name="mode"/>. Must be aligned to at least the cache line size (e.g. 64 bytes).</param>
 			<param name="shuffleBuffer">A pointer to the buffer into which the results will be stored. Must be aligned to at least the cache line size (e.g. 64 bytes).</param>
-			<param name="blockCount">The length of the buffers in 64-byte blocks.</param>
-			<param name="mode">Controls how <paramref name="otherBuffer"/> is treated.
-			<see cref="MixBlocksMode::None"/> only does the standard block mixing.
-			<see cref="MixBlocksMode::Copy"/> copies the input data into <paramref name="otherBuffer"/>.
-			<see cref="MixBlocksMode::Xor"/> xors <paramref name="otherBuffer"/> with <paramref name="workingBuffer"/> before mixing each 64-byte block.</param>
 			<remarks>
 			Results are temporarily stored in <paramref name="shuffleBuffer"/>, but it is swapped with <paramref name="workingBuffer"/> at the end. As a result, <paramref name="workingBuffer"/> will always
 			contain the output, and <paramref name="shuffleBuffer"/> will always contain the previous input. This mode reduces data copying over the alternative.
 			Relies on the input data being arranged such that the nominal last 64-byte block is placed first in the buffers.
+			The streaming, prefetching, and flushing below apply to the streaming policies. <see cref="CachePolicy::Cached"/> stores and
+			prefetches normally and never flushes, for large memory blocks small enough to stay in the cache.
 			When possible, <see cref="MixBlocksMode::Copy"/> uses streaming store instructions to send the data directly into main memory. This avoids polluting or thrashing the cache during large block generation, since
 			the block is unlikely to fit into any cache. This also helps defeat cache-timing attacks.
 			When possible, <see cref="MixBlocksMode::Xor"/> uses non-temporal prefetching of the first half of the <paramref name="blockCount"/> 64-byte blocks of <paramref name="otherBuffer"/> before doing anything
@@ -132,8 +237,8 @@ namespace Skryptonite
 			flushed from the cache to avoid polluting or thrashing the cache, since the likelihood is high that any given block will not be used again. This also helps defeat cache-timing attacks.
 			</remarks>
 			*/
-			template<class TSalsaBlock>
-			static __forceinline void __vectorcall MixBlocks(ScryptElementPtr& workingBuffer, SalsaBlock* otherBuffer, ScryptElementPtr& shuffleBuffer, MixBlocksMode mode)
+			template<class TSalsaBlock, CachePolicy policy, MixBlocksMode mode, unsigned fixedBlockCount>
+			static __forceinline void __vectorcall MixBlocks(ScryptElementPtr& workingBuffer, SalsaBlock* otherBuffer, ScryptElementPtr& shuffleBuffer)
 			{
 				_ASSERT(workingBuffer != nullptr && workingBuffer->Data() != nullptr);
 				_ASSERT(workingBuffer->BlockCount() > 0);
@@ -141,16 +246,19 @@ namespace Skryptonite
 				_ASSERT(shuffleBuffer->BlockCount() > 0);
 				_ASSERT(workingBuffer->BlockCount() == shuffleBuffer->BlockCount());
 				_ASSERT(mode == MixBlocksMode::None || otherBuffer != nullptr);
+				static_assert(policy != CachePolicy::Automatic, "The cache policy must be resolved before mixing.");
 
 				SalsaBlock* currentBlockPosition = workingBuffer->Data();
 				SalsaBlock* otherCurrentBlockPosition = otherBuffer;
 				SalsaBlock* otherFutureBlockPosition = otherBuffer;
 
-				unsigned halfSalsaBlockCount = workingBuffer->BlockCount() / 2;
+				// the mode and, when fixed, the block count are constants, so the branches on them below are resolved at compile time
+				const unsigned blockCount = BlockCount<fixedBlockCount>(workingBuffer->BlockCount());
+				const unsigned halfSalsaBlockCount = blockCount / 2;
 
 				if (mode == MixBlocksMode::Xor)
 					for (unsigned i = 0; i < halfSalsaBlockCount; i++, otherFutureBlockPosition++)
-						ScryptCommon::PrefetchNonTemporal(otherFutureBlockPosition);
+						PrefetchFor<policy>(otherFutureBlockPosition);
 
 				TSalsaBlock lastBlock;
 				LoadFromAligned(lastBlock, currentBlockPosition++);
@@ -158,16 +266,16 @@ namespace Skryptonite
 				switch (mode)
 				{
 				case MixBlocksMode::Copy:
-					StreamToAligned(otherCurrentBlockPosition++, lastBlock);
+					StoreFor<policy>(otherCurrentBlockPosition++, lastBlock);
 					break;
 				case MixBlocksMode::Xor:
-					LoadXorFlush<TSalsaBlock>(lastBlock, otherCurrentBlockPosition++);
+					LoadXorFlush<TSalsaBlock, policy>(lastBlock, otherCurrentBlockPosition++);
 					break;
 				}
 
 				TSalsaBlock previousBlock = lastBlock;
 
-				for (unsigned i = 0; i < workingBuffer->BlockCount() - 1; i++, currentBlockPosition++, otherCurrentBlockPosition++)
+				for (unsigned i = 0; i < blockCount - 1; i++, currentBlockPosition++, otherCurrentBlockPosition++)
 				{
 					TSalsaBlock currentBlock;
 					LoadFromAligned(currentBlock, currentBlockPosition);
@@ -175,12 +283,12 @@ namespace Skryptonite
 					switch (mode)
 					{
 					case MixBlocksMode::Copy:
-						StreamToAligned(otherCurrentBlockPosition, currentBlock);
+						StoreFor<policy>(otherCurrentBlockPosition, currentBlock);
 						break;
 					case MixBlocksMode::Xor:
 						if (i < halfSalsaBlockCount)
-							ScryptCommon::PrefetchNonTemporal(otherFutureBlockPosition++);
-						LoadXorFlush<TSalsaBlock>(currentBlock, otherCurrentBlockPosition);
+							PrefetchFor<policy>(otherFutureBlockPosition++);
+						LoadXorFlush<TSalsaBlock, policy>(currentBlock, otherCurrentBlockPosition);
 						break;
 					}
 
@@ -198,7 +306,7 @@ namespace Skryptonite
 				workingBuffer.swap(shuffleBuffer);
 			}
 
-#if defined(_M_IX86) || defined(_M_X64)
+#if defined(SKRYPTONITE_X86)
 			/**
 			<summary>Prefetches data from main memory non-temporally.</summary>
 			<param name="blockPosition">The memory location to prefetch.</param>
@@ -221,7 +329,28 @@ namespace Skryptonite
 			*/
 			static __forceinline void __vectorcall Flush(SalsaBlock* blockPosition)
 			{
-				_mm_clflush(blockPosition); // look into detecting and using CLFLUSHOPT eventually; Sky Lake and later
+				_mm_clflush(blockPosition);
+			}
+
+			/**
+			<summary>Flushes data from the cache without ordering the flush against other flushes and stores.</summary>
+			<param name="blockPosition">The memory location to flush.</param>
+			<remarks>
+			Requires CLFLUSHOPT, available since Skylake. Consecutive flushes may proceed in parallel, unlike with <see cref="Flush"/>.
+			</remarks>
+			*/
+			static __forceinline void __vectorcall FlushOptimized(SalsaBlock* blockPosition)
+			{
+				_mm_clflushopt(blockPosition);
+			}
+
+			/**
+			<summary>Prefetches data from main memory into every level of the cache.</summary>
+			<param name="blockPosition">The memory location to prefetch.</param>
+			*/
+			static __forceinline void __vectorcall Prefetch(SalsaBlock* blockPosition)
+			{
+				_mm_prefetch(reinterpret_cast<char*>(blockPosition), _MM_HINT_T0);
 			}
 
 #pragma region 256_Vector_Manipulation
@@ -399,7 +528,7 @@ namespace Skryptonite
 #pragma endregion
 #endif
 
-#if defined(_M_ARM)
+#if defined(SKRYPTONITE_ARM)
 			/**
 			<summary>Prefetches data from main memory.</summary>
 			<remarks>
@@ -424,6 +553,23 @@ namespace Skryptonite
 			{
 			}
 
+			/**
+			<summary>Flushes data from the cache. Does nothing, like <see cref="Flush"/>.</summary>
+			<param name="blockPosition">The memory location to flush.</param>
+			*/
+			static __forceinline void __vectorcall FlushOptimized(SalsaBlock* blockPosition)
+			{
+			}
+
+			/**
+			<summary>Prefetches data from main memory.</summary>
+			<param name="blockPosition">The memory location to prefetch.</param>
+			*/
+			static __forceinline void __vectorcall Prefetch(SalsaBlock* blockPosition)
+			{
+				__prefetch(blockPosition);
+			}
+
 			/**
 			<summary>Loads a 64-byte block from memory using 128-bit registers.</summary>
 			<param name="block">The block to load into.</param>
@@ -504,70 +650,176 @@ namespace Skryptonite
 			}
 #endif
 
-		private:
+#if !defined(SKRYPTONITE_X86) && !defined(SKRYPTONITE_ARM)
 			/**
-			<summary>Loads a 64-byte block from one location, arranges it optimally for Salsa20, and stores it in another location.</summary>
-			<typeparam name="TSalsaBlock">The type into which the 64-byte blocks are loaded and managed.</typeparam>
-			<param name="alignedDestination">The address where the arranged 64-byte block will be stored. Must be aligned to the maximum instruction set requirements.</param>
-			<param name="source">The address of the 64-byte block to be loaded.</param>
-			<param name="prepareBlock">A pointer to a function which rearranges the data of a 64-byte block into a format amenable to the Salsa20 hash function.</param>
-			<remarks>
-			<paramref name="prepareBlock"/> shifts the data so that the diagonals become rows:
-			0	1	2	3			12	1	6	11
-			4	5	6	7	----->	0	5	10	15
-			8	9	10	11	----->	4	9	14	3
-			12	13	14	15			8	13	2	7
-			</remarks>
+			<summary>Prefetches data from main memory non-temporally. Does nothing on architectures without a prefetch hint.</summary>
+			<param name="blockPosition">The memory location to prefetch.</param>
 			*/
-			template<class TSalsaBlock>
-			static __forceinline void __vectorcall LoadAndPrepareBlock(SalsaBlock* alignedDestination, SalsaBlock* source, void(*prepareBlock)(TSalsaBlock& arrangedBlock, TSalsaBlock& block))
+			static __forceinline void __vectorcall PrefetchNonTemporal(SalsaBlock* blockPosition)
 			{
-				_ASSERT(alignedDestination != nullptr);
-				_ASSERT(source != nullptr);
-				_ASSERT(prepareBlock != nullptr);
+			}
 
-				TSalsaBlock block, arrangedBlock;
+			/**
+			<summary>Flushes data from the cache. Does nothing on architectures without a user-mode cache flush.</summary>
+			<param name="blockPosition">The memory location to flush.</param>
+			*/
+			static __forceinline void __vectorcall Flush(SalsaBlock* blockPosition)
+			{
+			}
 
-				LoadFromUnaligned(block, source);
-				prepareBlock(arrangedBlock, block);
-				StoreToAligned(alignedDestination, arrangedBlock);
+			/**
+			<summary>Flushes data from the cache. Does nothing on architectures without a user-mode cache flush.</summary>
+			<param name="blockPosition">The memory location to flush.</param>
+			*/
+			static __forceinline void __vectorcall FlushOptimized(SalsaBlock* blockPosition)
+			{
+			}
+
+			/**
+			<summary>Prefetches data from main memory. Does nothing on architectures without a prefetch hint.</summary>
+			<param name="blockPosition">The memory location to prefetch.</param>
+			*/
+			static __forceinline void __vectorcall Prefetch(SalsaBlock* blockPosition)
+			{
+			}
+#endif
+
+#pragma region 32_Scalar_Manipulation
+			/**
+			<summary>Loads a 64-byte block from memory using 32-bit registers.</summary>
+			<param name="block">The block to load into.</param>
+			<param name="source">The memory location of the block to load.</param>
+			*/
+			static __forceinline void __vectorcall LoadFromAligned(SalsaBlock32x16& block, SalsaBlock* source)
+			{
+				memcpy(block.integers, source->integers, sizeof(SalsaBlock));
+			}
+
+			/**
+			<summary>Loads a 64-byte block from memory using 32-bit registers.</summary>
+			<param name="block">The block to load into.</param>
+			<param name="source">The memory location of the block to load.</param>
+			*/
+			static __forceinline void __vectorcall LoadFromUnaligned(SalsaBlock32x16& block, SalsaBlock* source)
+			{
+				memcpy(block.integers, source->integers, sizeof(SalsaBlock));
+			}
+
+			/**
+			<summary>Saves a 64-byte block to memory using 32-bit registers.</summary>
+			<param name="destination">The memory location of the block to store to.</param>
+			<param name="block">The block to store.</param>
+			*/
+			static __forceinline void __vectorcall StoreToAligned(SalsaBlock* destination, const SalsaBlock32x16& block)
+			{
+				memcpy(destination->integers, block.integers, sizeof(SalsaBlock));
+			}
+
+			/**
+			<summary>Saves a 64-byte block to memory using 32-bit registers.</summary>
+			<param name="destination">The memory location of the block to store to.</param>
+			<param name="block">The block to store.</param>
+			*/
+			static __forceinline void __vectorcall StoreToUnaligned(SalsaBlock* destination, const SalsaBlock32x16& block)
+			{
+				memcpy(destination->integers, block.integers, sizeof(SalsaBlock));
+			}
+
+			/**
+			<summary>Saves a 64-byte block to memory using 32-bit registers. There are no general purpose streaming stores, so this is an ordinary store.</summary>
+			<param name="destination">The memory location of the block to store to.</param>
+			<param name="block">The block to store.</param>
+			*/
+			static __forceinline void __vectorcall StreamToAligned(SalsaBlock* destination, const SalsaBlock32x16& block)
+			{
+				memcpy(destination->integers, block.integers, sizeof(SalsaBlock));
+			}
+
+			/**
+			<summary>Xors one block into the other using 32-bit registers.</summary>
+			<param name="destinationBlock">The block to xor into.</param>
+			<param name="sourceBlock">The block to xor.</param>
+			*/
+			static __forceinline void __vectorcall XorBlock(SalsaBlock32x16& destinationBlock, const SalsaBlock32x16& sourceBlock)
+			{
+				for (unsigned i = 0; i < 16; i++)
+					destinationBlock.integers[i] ^= sourceBlock.integers[i];
+			}
+#pragma endregion
+
+			/**
+			<summary>Prefetches a 64-byte block of the large memory block as <paramref name="policy"/> directs.</summary>
+			<typeparam name="policy">Whether the block should stay in the cache.</typeparam>
+			<param name="blockPosition">The memory location to prefetch.</param>
+			*/
+			template<CachePolicy policy>
+			static __forceinline void __vectorcall PrefetchFor(SalsaBlock* blockPosition)
+			{
+				if (policy == CachePolicy::Cached)
+					Prefetch(blockPosition);
+				else
+					PrefetchNonTemporal(blockPosition);
+			}
+
+			/**
+			<summary>Flushes a 64-byte block of the large memory block from the cache as <paramref name="policy"/> directs.</summary>
+			<typeparam name="policy">Whether and how to flush.</typeparam>
+			<param name="blockPosition">The memory location to flush.</param>
+			*/
+			template<CachePolicy policy>
+			static __forceinline void __vectorcall FlushFor(SalsaBlock* blockPosition)
+			{
+				if (policy == CachePolicy::StreamAndFlush)
+					Flush(blockPosition);
+				else if (policy == CachePolicy::StreamAndFlushOptimized)
+					FlushOptimized(blockPosition);
+			}
+
+
+		private:
+			/**
+			<summary>Gets the length of an element in 64-byte blocks, preferring the compile-time length so that loops over the
+			element have a constant trip count and can be unrolled.</summary>
+			<typeparam name="fixedBlockCount">The length known at compile time, or 0 for a length known only at run time.</typeparam>
+			<param name="runtimeBlockCount">The length known at run time. Must equal <typeparamref name="fixedBlockCount"/> when that is not 0.</param>
+			*/
+			template<unsigned fixedBlockCount>
+			static __forceinline unsigned BlockCount(unsigned runtimeBlockCount)
+			{
+				static_assert(fixedBlockCount % 2 == 0, "An element consists of an even number of 64-byte blocks.");
+				_ASSERT(fixedBlockCount == 0 || fixedBlockCount == runtimeBlockCount);
+
+				return fixedBlockCount != 0 ? fixedBlockCount : runtimeBlockCount;
 			}
 
 			/**
-			<summary>Loads an optimally-arranged 64-byte block from one location, restores it to its original ordering, and stores it in another location.</summary>
+			<summary>Loads a 64-byte block and arranges it optimally for Salsa20.</summary>
 			<typeparam name="TSalsaBlock">The type into which the 64-byte blocks are loaded and managed.</typeparam>
-			<param name="destination">The address of the 64-byte block to be loaded.</param>
-			<param name="alignedSource">The address where the arranged 64-byte block is stored.  Must be aligned to the maximum instruction set requirements.</param>
-			<param name="prepareBlock">A pointer to a function which rearranges the data of a 64-byte block from a format amenable to the Salsa20 hash function into its original ordering.</param>
-			<remarks>
-			<paramref name="restoreBlock"/> shifts the data so that the rows become diagonals:
-			12	1	6	11			0	1	2	3
-			0	5	10	15	----->	4	5	6	7
-			4	9	14	3	----->	8	9	10	11
-			8	13	2	7			12	13	14	15
-			</remarks>
+			<param name="arrangedBlock">Receives the arranged 64-byte block.</param>
+			<param name="source">The address of the 64-byte block to be loaded.</param>
+			<param name="prepareBlock">A pointer to a function which rearranges the data of a 64-byte block into a format amenable to the Salsa20 hash function.</param>
 			*/
 			template<class TSalsaBlock>
-			static __forceinline void __vectorcall LoadAndRestoreBlock(SalsaBlock* destination, SalsaBlock* alignedSource, void(*restoreBlock)(TSalsaBlock& block, TSalsaBlock& arrangedBlock))
+			static __forceinline void __vectorcall LoadAndPrepareBlock(TSalsaBlock& arrangedBlock, SalsaBlock* source, void(*prepareBlock)(TSalsaBlock& arrangedBlock, TSalsaBlock& block))
 			{
-				_ASSERT(destination != nullptr);
-				_ASSERT(alignedSource != nullptr);
-				_ASSERT(restoreBlock != nullptr);
+				_ASSERT(source != nullptr);
+				_ASSERT(prepareBlock != nullptr);
 
-				TSalsaBlock arrangedBlock, block;
+				TSalsaBlock block;
 
-				LoadFromAligned(arrangedBlock, alignedSource);
-				restoreBlock(block, arrangedBlock);
-				StoreToUnaligned(destination, block);
+				LoadFromUnaligned(block, source);
+				prepareBlock(arrangedBlock, block);
 			}
 
 			/**
-			<summary>Loads a 64-byte block from <paramref name="xorBlockPosition"/>, xors it into <paramref name="block"\>, then flushes <paramref name="xorBlockPosition"/> from the cache.</summary>
+			<summary>Loads a 64-byte block from <paramref name="xorBlockPosition"/>, xors it into <paramref name="block"\>, then flushes <paramref name="xorBlockPosition"/> from the cache
+			as <paramref name="policy"/> directs.</summary>
 			<typeparam name="TSalsaBlock">The type into which the 64-byte blocks are loaded and managed.</typeparam>
+			<typeparam name="policy">Whether and how to flush.</typeparam>
 			<param name="block">The 64-byte block xor operand which will contain the result.</param>
 			<param name="xorBlockPosition">A pointer to the location of the block to load, xor, and flush.</param>
 			*/
-			template<class TSalsaBlock>
+			template<class TSalsaBlock, CachePolicy policy>
 			static __forceinline void __vectorcall LoadXorFlush(TSalsaBlock& block, SalsaBlock* xorBlockPosition)
 			{
 				_ASSERT(xorBlockPosition != nullptr);
@@ -576,7 +828,22 @@ namespace Skryptonite
 
 				LoadFromAligned(xorBlock, xorBlockPosition);
 				XorBlock(block, xorBlock);
-				Flush(xorBlockPosition);
+				FlushFor<policy>(xorBlockPosition);
+			}
+
+			/**
+			<summary>Stores a 64-byte block into the large memory block as <paramref name="policy"/> directs.</summary>
+			<typeparam name="policy">Whether to stream the block past the cache.</typeparam>
+			<param name="destination">The memory location to store to. Must be aligned to the maximum instruction set requirements.</param>
+			<param name="block">The block to store.</param>
+			*/
+			template<CachePolicy policy, class TSalsaBlock>
+			static __forceinline void __vectorcall StoreFor(SalsaBlock* destination, const TSalsaBlock& block)
+			{
+				if (policy == CachePolicy::Cached)
+					StoreToAligned(destination, block);
+				else
+					StreamToAligned(destination, block);
 			}
 
 			/**
@@ -592,9 +859,60 @@ namespace Skryptonite
 				_ASSERT(destination != nullptr);
 
 				XorBlock(currentBlock, previousBlock);
-				Salsa20Core::Hash(currentBlock, 8);
+				Salsa20Core::Hash<8>(currentBlock);
 				StoreToAligned(destination, currentBlock);
 			}
+
+			/**
+			<summary>Xors <paramref name="previousBlock"/> into <paramref name="currentBlock"/>, performs Salsa20/8 on the xor result, and stores the final result in its
+			original ordering in <paramref name="destination"/>.</summary>
+			<typeparam name="TSalsaBlock">The type into which the 64-byte blocks are loaded and managed.</typeparam>
+			<param name="destination">The location into which the restored result should be stored. Need not be aligned.</param>
+			<param name="currentBlock">The current 64-byte block. The final, still arranged result is also stored here.</param>
+			<param name="previousBlock">The previous 64-byte block.</param>
+			<param name="restoreBlock">A pointer to a function which rearranges the data of a 64-byte block into its original ordering.</param>
+			*/
+			template<class TSalsaBlock>
+			static __forceinline void __vectorcall MixAndRestoreBlock(SalsaBlock* destination, TSalsaBlock& currentBlock, TSalsaBlock previousBlock, void(*restoreBlock)(TSalsaBlock& block, TSalsaBlock& arrangedBlock))
+			{
+				_ASSERT(destination != nullptr);
+
+				TSalsaBlock block;
+
+				XorBlock(currentBlock, previousBlock);
+				Salsa20Core::Hash<8>(currentBlock);
+				restoreBlock(block, currentBlock);
+				StoreToUnaligned(destination, block);
+			}
 		};
 	}
-}
\ No newline at end of file
+}
+/**
+Explicitly instantiates the block mixing kernels of a backend for one cache policy and element length.
+*/
+#define SKRYPTONITE_INSTANTIATE_POLICY_KERNELS(TBackend, policy, fixedBlockCount) \
+	template void TBackend::PrepareCopyAndMixBlocks<policy, fixedBlockCount>(SalsaBlock*, SalsaBlock*, SalsaBlock*, unsigned); \
+	template void TBackend::XorMixAndRestoreBlocks<policy, fixedBlockCount>(SalsaBlock*, ScryptElementPtr&, SalsaBlock*); \
+	template void TBackend::CopyAndMixBlocks<policy, fixedBlockCount>(SalsaBlock*, ScryptElementPtr&, ScryptElementPtr&); \
+	template void TBackend::XorAndMixBlocks<policy, fixedBlockCount>(ScryptElementPtr&, SalsaBlock*, ScryptElementPtr&);
+
+/**
+Explicitly instantiates the block mixing kernels of a backend for every cache policy and one element length.
+*/
+#define SKRYPTONITE_INSTANTIATE_SIZED_KERNELS(TBackend, fixedBlockCount) \
+	template void TBackend::MixBlocksInto<fixedBlockCount>(SalsaBlock*, SalsaBlock*, unsigned); \
+	SKRYPTONITE_INSTANTIATE_POLICY_KERNELS(TBackend, CachePolicy::StreamAndFlush, fixedBlockCount) \
+	SKRYPTONITE_INSTANTIATE_POLICY_KERNELS(TBackend, CachePolicy::StreamAndFlushOptimized, fixedBlockCount) \
+	SKRYPTONITE_INSTANTIATE_POLICY_KERNELS(TBackend, CachePolicy::Cached, fixedBlockCount)
+
+/**
+Explicitly instantiates the block mixing kernels of a backend for every cache policy, once for any element length and once
+for each of r = 1, 2, 4, 8 and 16, whose loops have a constant trip count. Must match ScryptEngine::SetMixFunctions.
+*/
+#define SKRYPTONITE_INSTANTIATE_BLOCK_KERNELS(TBackend) \
+	SKRYPTONITE_INSTANTIATE_SIZED_KERNELS(TBackend, 0) \
+	SKRYPTONITE_INSTANTIATE_SIZED_KERNELS(TBackend, 2) \
+	SKRYPTONITE_INSTANTIATE_SIZED_KERNELS(TBackend, 4) \
+	SKRYPTONITE_INSTANTIATE_SIZED_KERNELS(TBackend, 8) \
+	SKRYPTONITE_INSTANTIATE_SIZED_KERNELS(TBackend, 16) \
+	SKRYPTONITE_INSTANTIATE_SIZED_KERNELS(TBackend, 32)
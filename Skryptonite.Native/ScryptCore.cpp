@@ -17,163 +17,419 @@
 */
 #include "pch.h"
 #include "ScryptCore.h"
-#include "ScryptElement.h"
+#include "Autotuner.h"
+#include "CostModel.h"
+#include "DerivationCache.h"
+#include "DerivationQueue.h"
+#include "Pbkdf2Sha256.h"
 #include <wrl.h>
 #include <robuffer.h>
-#include "DetectInstructionSet.h"
-
-#if defined(_M_IX86) || defined(_M_X64)
-#include "..\Skryptonite.Native.SSE2\ScryptSSE2.h"
-#include "..\Skryptonite.Native.SSE2\ScryptSSE41.h"
-#include "..\Skryptonite.Native.AVX\ScryptAVX.h"
-#include "..\Skryptonite.Native.AVX2\ScryptAVX2.h"
-#endif
-
-#if defined(_M_ARM)
-#include "..\Skryptonite.Native.NEON\ScryptNEON.h"
-#endif
+#include <chrono>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
 
 using namespace Skryptonite::Native;
 using namespace Windows::Storage::Streams;
 using namespace Microsoft::WRL;
 
+/**
+<summary>Runs native code, converting the standard exceptions it throws into their Windows Runtime equivalents.</summary>
+*/
+template<class TFunction>
+static void TranslateExceptions(TFunction function)
+{
+	try
+	{
+		function();
+	}
+	catch (const std::invalid_argument& e)
+	{
+		std::string message = e.what();
+		throw ref new Platform::InvalidArgumentException(ref new Platform::String(std::wstring(message.begin(), message.end()).c_str()));
+	}
+	catch (const std::bad_alloc&)
+	{
+		throw ref new Platform::OutOfMemoryException("Unable to allocate enough memory to complete SMix.");
+	}
+	catch (const std::runtime_error& e)
+	{
+		std::string message = e.what();
+		throw ref new Platform::FailureException(ref new Platform::String(std::wstring(message.begin(), message.end()).c_str()));
+	}
+}
+
+/**
+<summary>Converts a string to UTF-8.</summary>
+*/
+static std::string ToUtf8(Platform::String^ value)
+{
+	int length = WideCharToMultiByte(CP_UTF8, 0, value->Data(), static_cast<int>(value->Length()), nullptr, 0, nullptr, nullptr);
+	std::string result(length, '\0');
+	WideCharToMultiByte(CP_UTF8, 0, value->Data(), static_cast<int>(value->Length()), &result[0], length, nullptr, nullptr);
+
+	return result;
+}
+
+/**
+<summary>Extracts a pointer to the underlying data from a buffer.</summary>
+*/
+static unsigned char* GetBufferPointer(IBuffer^ buffer)
+{
+	ComPtr<IInspectable> p = reinterpret_cast<IInspectable*>(buffer);
+	ComPtr<IBufferByteAccess> bufferByteAccess;
+	byte* data;
+	p.As(&bufferByteAccess);
+	bufferByteAccess->Buffer(&data);
+
+	return data;
+}
+
+/**
+<summary>Creates a buffer of the given length.</summary>
+*/
+static IBuffer^ CreateBuffer(unsigned length)
+{
+	IBuffer^ buffer = ref new Buffer(length);
+	buffer->Length = length;
+
+	return buffer;
+}
+
 ScryptCore::ScryptCore(IBuffer^ data, unsigned elementsCount, unsigned processingCost)
 {
 	if (data == nullptr)
 		throw ref new Platform::InvalidArgumentException("data must not be null.");
 	if (data->Length == 0)
 		throw ref new Platform::InvalidArgumentException("data must be non-empty.");
-	if (elementsCount == 0)
-		throw ref new Platform::InvalidArgumentException("elementsCount must be greater than 0.");
-	if (processingCost == 0)
-		throw ref new Platform::InvalidArgumentException("procesingCost must be greater than 0.");
-	if ((std::numeric_limits<unsigned>::max)() / elementsCount < 2 * sizeof(SalsaBlock))
-		throw ref new Platform::InvalidArgumentException("128 * elementsCount must be less than 2^32.");
-	if (data->Length % (2 * sizeof(SalsaBlock) * elementsCount) > 0)
-		throw ref new Platform::InvalidArgumentException("data must be non-empty and contain a number of bytes divisible by 128 * elementsCount.");
-	if ((std::numeric_limits<size_t>::max)() / processingCost < data->Length / elementsCount )
-		throw ref new Platform::InvalidArgumentException("processingCost * (data->Length / elementsCount) must be less than addressable memory!");
 	
 	_buffer = data;
-	_salsaBlockCountPerElement = data->Length / (elementsCount * sizeof(SalsaBlock));
-	_elementsCount = elementsCount;
-	_processingCost = processingCost;
-
-	GetBufferPointer();
-	SetFunctions();
-}
-
-void ScryptCore::GetBufferPointer()
-{
-	ComPtr<IInspectable> p = reinterpret_cast<IInspectable*>(_buffer);
-	ComPtr<IBufferByteAccess> buffer;
-	p.As(&buffer);
-	buffer->Buffer(reinterpret_cast<byte**>(&_data));
-}
-
-void ScryptCore::SetFunctions()
-{
-	switch (DetectInstructionSet::MaxInstructionSet)
-	{
-#if defined(_M_IX86) || defined(_M_X64)
-	case InstructionSet::AVX2:
-		PrepareData = ScryptAVX2::PrepareData;
-		CopyAndMixBlocks = ScryptAVX2::CopyAndMixBlocks;
-		XorAndMixBlocks = ScryptAVX2::XorAndMixBlocks;
-		RestoreData = ScryptAVX2::RestoreData;
-		break;
-	case InstructionSet::AVX:
-		PrepareData = ScryptAVX::PrepareData;
-		CopyAndMixBlocks = ScryptAVX::CopyAndMixBlocks;
-		XorAndMixBlocks = ScryptAVX::XorAndMixBlocks;
-		RestoreData = ScryptAVX::RestoreData;
-		break;
-	case InstructionSet::SSE41:
-		PrepareData = ScryptSSE41::PrepareData;
-		CopyAndMixBlocks = ScryptSSE41::CopyAndMixBlocks;
-		XorAndMixBlocks = ScryptSSE41::XorAndMixBlocks;
-		RestoreData = ScryptSSE41::RestoreData;
-		break;
-	case InstructionSet::SSSE3:
-	case InstructionSet::SSE2:
-		PrepareData = ScryptSSE2::PrepareData;
-		CopyAndMixBlocks = ScryptSSE2::CopyAndMixBlocks;
-		XorAndMixBlocks = ScryptSSE2::XorAndMixBlocks;
-		RestoreData = ScryptSSE2::RestoreData;
-		break;
-#endif
-#if defined(_M_ARM)
-	case InstructionSet::NEON:
-		PrepareData = ScryptNEON::PrepareData;
-		CopyAndMixBlocks = ScryptNEON::CopyAndMixBlocks;
-		XorAndMixBlocks = ScryptNEON::XorAndMixBlocks;
-		RestoreData = ScryptNEON::RestoreData;
-		break;
-#endif
-	default:
-		// unrecognized instruction set!
-		break;
-	}
+
+	unsigned char* bufferPointer = GetBufferPointer(data);
+	TranslateExceptions([&]() { _engine = std::make_unique<ScryptEngine>(bufferPointer, data->Length, elementsCount, processingCost); });
 }
 
 void ScryptCore::SMix(unsigned elementIndex)
 {
-	if (elementIndex >= _elementsCount)
-		throw ref new Platform::InvalidArgumentException("elementIndex is out of range.");
+	TranslateExceptions([&]() { _engine->SMix(elementIndex); });
+}
 
-	SalsaBlock* const sourceData = _data + elementIndex * _salsaBlockCountPerElement;
+void ScryptCore::SMixRange(unsigned firstElementIndex, unsigned count)
+{
+	TranslateExceptions([&]() { _engine->SMixRange(firstElementIndex, count); });
+}
 
-	ScryptElementPtr workingBuffer;
-	ScryptElementPtr shuffleBuffer;
-	ScryptBlockPtr scryptBlock;
+void ScryptCore::SMixAll(unsigned threadCount)
+{
+	TranslateExceptions([&]() { _engine->SMixAll(threadCount); });
+}
 
-	try
+void ScryptCore::SMixLanes(const Platform::Array<ScryptCore^>^ cores, const Platform::Array<unsigned>^ elementIndices)
+{
+	if (cores == nullptr || elementIndices == nullptr)
+		throw ref new Platform::InvalidArgumentException("cores and elementIndices must not be null.");
+	if (cores->Length == 0 || cores->Length != elementIndices->Length)
+		throw ref new Platform::InvalidArgumentException("cores and elementIndices must be non-empty and of equal length.");
+
+	std::vector<ScryptEngine*> engines(cores->Length);
+
+	for (unsigned k = 0; k < cores->Length; k++)
 	{
-		workingBuffer = static_cast<ScryptElementPtr>(std::make_unique<ScryptElement>(_salsaBlockCountPerElement, _processingCost));
-		shuffleBuffer = static_cast<ScryptElementPtr>(std::make_unique<ScryptElement>(_salsaBlockCountPerElement, _processingCost));
-		scryptBlock = static_cast<ScryptBlockPtr>(std::make_unique<ScryptBlock>(_salsaBlockCountPerElement, _processingCost));
+		if (cores[k] == nullptr)
+			throw ref new Platform::InvalidArgumentException("cores must not contain null.");
+
+		engines[k] = cores[k]->_engine.get();
 	}
-	catch (std::bad_alloc)
+
+	TranslateExceptions([&]() { ScryptEngine::SMixLanes(engines.data(), elementIndices->Data, cores->Length); });
+}
+
+ResumableSMix^ ScryptCore::BeginSMix(unsigned elementIndex)
+{
+	std::unique_ptr<SMixState> state;
+	TranslateExceptions([&]() { state = std::make_unique<SMixState>(*_engine, elementIndex); });
+
+	return ref new ResumableSMix(this, std::move(state));
+}
+
+IBuffer^ ScryptCore::OneRoundPbkdf2Sha256(IBuffer^ keyMaterial, IBuffer^ salt, unsigned derivedKeyLength)
+{
+	if (keyMaterial == nullptr || salt == nullptr)
+		throw ref new Platform::InvalidArgumentException("keyMaterial and salt must not be null.");
+	if (derivedKeyLength == 0)
+		throw ref new Platform::InvalidArgumentException("derivedKeyLength must be greater than 0.");
+
+	IBuffer^ derivedKey = CreateBuffer(derivedKeyLength);
+
+	Pbkdf2Sha256::DeriveKey(GetBufferPointer(keyMaterial), keyMaterial->Length, GetBufferPointer(salt), salt->Length, 1,
+		GetBufferPointer(derivedKey), derivedKeyLength);
+
+	return derivedKey;
+}
+
+IBuffer^ ScryptCore::DeriveKey(IBuffer^ key, IBuffer^ salt, unsigned elementLengthMultiplier, unsigned processingCost,
+	unsigned parallelization, unsigned derivedKeyLength)
+{
+	if (key == nullptr || salt == nullptr)
+		throw ref new Platform::InvalidArgumentException("key and salt must not be null.");
+
+	IBuffer^ derivedKey = CreateBuffer(derivedKeyLength);
+
+	TranslateExceptions([&]()
 	{
-		throw ref new Platform::OutOfMemoryException("Unable to allocate enough memory to complete SMix.");
+		ScryptEngine::DeriveKey(GetBufferPointer(key), key->Length, GetBufferPointer(salt), salt->Length,
+			elementLengthMultiplier, processingCost, parallelization, GetBufferPointer(derivedKey), derivedKeyLength);
+	});
+
+	return derivedKey;
+}
+
+Platform::Array<IBuffer^>^ ScryptCore::DeriveKeys(const Platform::Array<IBuffer^>^ keys, const Platform::Array<IBuffer^>^ salts,
+	unsigned elementLengthMultiplier, unsigned processingCost, unsigned parallelization, unsigned derivedKeyLength,
+	Skryptonite::Native::CachePolicy cachePolicy, unsigned tradeOffFactor)
+{
+	if (keys == nullptr || salts == nullptr)
+		throw ref new Platform::InvalidArgumentException("keys and salts must not be null.");
+	if (keys->Length != salts->Length)
+		throw ref new Platform::InvalidArgumentException("keys and salts must be of equal length.");
+
+	auto derivedKeys = ref new Platform::Array<IBuffer^>(keys->Length);
+	std::vector<ScryptRequest> requests(keys->Length);
+
+	for (unsigned i = 0; i < keys->Length; i++)
+	{
+		if (keys[i] == nullptr || salts[i] == nullptr)
+			throw ref new Platform::InvalidArgumentException("keys and salts must not contain null.");
+
+		derivedKeys[i] = CreateBuffer(derivedKeyLength);
+		requests[i] = { GetBufferPointer(keys[i]), keys[i]->Length, GetBufferPointer(salts[i]), salts[i]->Length,
+			GetBufferPointer(derivedKeys[i]), derivedKeyLength };
 	}
-	
-	
-	PrepareData(workingBuffer, sourceData);
-	FillScryptBlock(workingBuffer, scryptBlock, shuffleBuffer);
-	MixWithScryptBlock(workingBuffer, scryptBlock, shuffleBuffer);
-	RestoreData(sourceData, workingBuffer);
+
+	TranslateExceptions([&]()
+	{
+		ScryptEngine::DeriveKeys(requests.data(), keys->Length, elementLengthMultiplier, processingCost, parallelization, 0,
+			cachePolicy, tradeOffFactor);
+	});
+
+	return derivedKeys;
 }
 
-void ScryptCore::FillScryptBlock(ScryptElementPtr& workingBuffer, const ScryptBlockPtr& scryptBlock, ScryptElementPtr& shuffleBuffer)
+Windows::Foundation::IAsyncOperation<IBuffer^>^ ScryptCore::DeriveKeyAsync(IBuffer^ key, IBuffer^ salt, unsigned elementLengthMultiplier,
+	unsigned processingCost, unsigned parallelization, unsigned derivedKeyLength)
 {
-	_ASSERT(workingBuffer != nullptr);
-	_ASSERT(scryptBlock != nullptr);
-	_ASSERT(shuffleBuffer != nullptr);
-	_ASSERT(workingBuffer->BlockCount() == shuffleBuffer->BlockCount());
-	_ASSERT(scryptBlock->ElementCount() == _processingCost);
+	if (key == nullptr || salt == nullptr)
+		throw ref new Platform::InvalidArgumentException("key and salt must not be null.");
+
+	DerivationRequest request = { GetBufferPointer(key), key->Length, GetBufferPointer(salt), salt->Length, elementLengthMultiplier,
+		processingCost, parallelization, derivedKeyLength };
+
+	// a null key completes the event when the derivation was cancelled
+	concurrency::task_completion_event<IBuffer^> completed;
+	unsigned long long ticket = 0;
+
+	// submitted before the operation exists, so that invalid arguments and a full queue are reported to the caller
+	TranslateExceptions([&]()
+	{
+		ticket = DerivationQueue::Global().TrySubmit(request, [completed](DerivationResult& result)
+		{
+			switch (result.status)
+			{
+			case DerivationStatus::Completed:
+			{
+				IBuffer^ derivedKey = CreateBuffer(static_cast<unsigned>(result.derivedKey.size()));
+				memcpy(GetBufferPointer(derivedKey), result.derivedKey.data(), result.derivedKey.size());
+				SecureErase(result.derivedKey.data(), result.derivedKey.size());
+				completed.set(derivedKey);
+				break;
+			}
+			case DerivationStatus::Cancelled:
+				completed.set(nullptr);
+				break;
+			case DerivationStatus::OutOfMemory:
+				completed.set_exception(ref new Platform::OutOfMemoryException("Unable to allocate enough memory to complete SMix."));
+				break;
+			default:
+				completed.set_exception(ref new Platform::FailureException("The derivation failed."));
+				break;
+			}
+		});
+	});
+
+	if (ticket == 0)
+		throw ref new Platform::FailureException("The derivation queue is full.");
+
+	return concurrency::create_async([completed, ticket](concurrency::cancellation_token token)
+	{
+		// only a derivation that is still queued can be withdrawn; one that has started finishes normally
+		concurrency::cancellation_token_registration registration = token.register_callback([ticket]()
+		{
+			DerivationQueue::Global().Cancel(ticket);
+		});
+
+		return concurrency::create_task(completed).then([token, registration](IBuffer^ derivedKey)
+		{
+			token.deregister_callback(registration);
 
-	for (unsigned i = 0; i < _processingCost; i++)
-		CopyAndMixBlocks((*scryptBlock)[i], workingBuffer, shuffleBuffer);
+			if (derivedKey == nullptr)
+				concurrency::cancel_current_task();
+
+			return derivedKey;
+		});
+	});
 }
 
-void ScryptCore::MixWithScryptBlock(ScryptElementPtr& workingBuffer, const ScryptBlockPtr& scryptBlock, ScryptElementPtr& shuffleBuffer)
+unsigned ScryptCore::TradeOffFactorForMemory(unsigned elementLengthMultiplier, unsigned processingCost, unsigned long long maxBytes)
 {
-	_ASSERT(workingBuffer != nullptr);
-	_ASSERT(scryptBlock != nullptr);
-	_ASSERT(shuffleBuffer != nullptr);
-	_ASSERT(workingBuffer->BlockCount() == shuffleBuffer->BlockCount());
-	_ASSERT(workingBuffer->IntegerifyDivisor() == scryptBlock->ElementCount());
-	_ASSERT(shuffleBuffer->IntegerifyDivisor() == scryptBlock->ElementCount());
+	unsigned factor = 1;
+	TranslateExceptions([&]() { factor = ScryptEngine::TradeOffFactorForMemory(elementLengthMultiplier, processingCost, maxBytes); });
+
+	return factor;
+}
 
-	for (unsigned i = 0; i < _processingCost; i++)
+InstructionSet ScryptCore::Autotune(unsigned elementLengthMultiplier, unsigned processingCost, unsigned parallelization)
+{
+	InstructionSet instructionSet = InstructionSet::Unknown;
+	TranslateExceptions([&]()
 	{
-		unsigned j = workingBuffer->Integerify();
-		XorAndMixBlocks(workingBuffer, (*scryptBlock)[j], shuffleBuffer);
-	}
+		instructionSet = Autotuner::Calibrate(elementLengthMultiplier, processingCost, parallelization).instructionSet;
+	});
+
+	return instructionSet;
+}
+
+void ScryptCore::SetMemoryBudget(unsigned long long limitBytes, unsigned maxWaitMilliseconds)
+{
+	MemoryBudget::Global().SetMaxWait(std::chrono::milliseconds(maxWaitMilliseconds));
+	MemoryBudget::Global().SetLimit(limitBytes);
+}
+
+void ScryptCore::ConfigureDerivationCache(unsigned maxEntries, unsigned maxKeyLength, unsigned timeToLiveMilliseconds)
+{
+	TranslateExceptions([&]()
+	{
+		DerivationCache::Global().Configure(maxEntries, maxKeyLength, std::chrono::milliseconds(timeToLiveMilliseconds));
+	});
+}
+
+void ScryptCore::ClearDerivationCache()
+{
+	DerivationCache::Global().Clear();
+}
+
+IBuffer^ ScryptCore::TryGetCachedKey(IBuffer^ key, IBuffer^ salt, unsigned elementLengthMultiplier, unsigned processingCost,
+	unsigned parallelization, unsigned derivedKeyLength)
+{
+	if (key == nullptr || salt == nullptr)
+		throw ref new Platform::InvalidArgumentException("key and salt must not be null.");
+
+	if (!DerivationCache::Global().IsEnabled())
+		return nullptr;
+
+	IBuffer^ derivedKey = CreateBuffer(derivedKeyLength);
+	if (!DerivationCache::Global().TryGet(GetBufferPointer(key), key->Length, GetBufferPointer(salt), salt->Length,
+		elementLengthMultiplier, processingCost, parallelization, GetBufferPointer(derivedKey), derivedKeyLength))
+		return nullptr;
+
+	return derivedKey;
+}
+
+void ScryptCore::CacheDerivedKey(IBuffer^ key, IBuffer^ salt, unsigned elementLengthMultiplier, unsigned processingCost,
+	unsigned parallelization, IBuffer^ derivedKey)
+{
+	if (key == nullptr || salt == nullptr || derivedKey == nullptr)
+		throw ref new Platform::InvalidArgumentException("key, salt and derivedKey must not be null.");
+
+	DerivationCache::Global().Put(GetBufferPointer(key), key->Length, GetBufferPointer(salt), salt->Length,
+		elementLengthMultiplier, processingCost, parallelization, GetBufferPointer(derivedKey), derivedKey->Length);
+}
+
+unsigned long long ScryptCore::ScratchLength::get()
+{
+	unsigned long long length = 0;
+	TranslateExceptions([&]()
+	{
+		ScratchRequirements requirements = _engine->ElementScratchRequirements();
+		length = requirements.totalLength + requirements.alignment - 1;
+	});
+
+	return length;
+}
+
+void ScryptCore::SMixWithScratch(unsigned elementIndex, IBuffer^ scratch)
+{
+	if (scratch == nullptr)
+		throw ref new Platform::InvalidArgumentException("scratch must not be null.");
+
+	unsigned char* scratchPointer = GetBufferPointer(scratch);
+
+	TranslateExceptions([&]()
+	{
+		ScryptScratch regions = ScryptEngine::PartitionScratch(scratchPointer, scratch->Capacity, _engine->ElementScratchRequirements());
+		_engine->SMix(elementIndex, regions);
+	});
+}
+
+void ScryptCore::LoadCostModel(Platform::String^ profilePath)
+{
+	if (profilePath == nullptr || profilePath->IsEmpty())
+		throw ref new Platform::InvalidArgumentException("profilePath must not be empty.");
+
+	TranslateExceptions([&]() { CostModel::EnsureProfile(ToUtf8(profilePath)); });
+}
+
+double ScryptCore::PredictMilliseconds(unsigned elementLengthMultiplier, unsigned processingCost, unsigned parallelization,
+	unsigned threadCount)
+{
+	double nanoseconds = 0;
+	TranslateExceptions([&]()
+	{
+		nanoseconds = CostModel::Predict(elementLengthMultiplier, processingCost, parallelization, threadCount).nanoseconds;
+	});
+
+	return nanoseconds / 1e6;
+}
+
+void ScryptCore::ChooseParameters(unsigned long long maxMemoryBytes, unsigned targetMilliseconds, unsigned threadCount,
+	unsigned elementLengthMultiplier, unsigned* processingCost, unsigned* parallelization)
+{
+	TranslateExceptions([&]()
+	{
+		OptimalParameters parameters = CostModel::Optimal(maxMemoryBytes, targetMilliseconds, threadCount, elementLengthMultiplier);
+
+		*processingCost = parameters.processingCost;
+		*parallelization = parameters.parallelization;
+	});
+}
+
+void ScryptCore::TradeOffFactor::set(unsigned value)
+{
+	TranslateExceptions([&]() { _engine->SetTradeOffFactor(value); });
 }
 
 void ScryptCore::EraseBuffer()
 {
-	memset(_data, 0, _buffer->Length);
+	_engine->EraseBuffer();
+}
+
+ResumableSMix::ResumableSMix(ScryptCore^ core, std::unique_ptr<SMixState> state) :
+	_core(core), _state(std::move(state))
+{
+}
+
+bool ResumableSMix::Advance(unsigned long long maxSteps)
+{
+	bool isDone = false;
+	TranslateExceptions([&]() { isDone = _state->Advance(maxSteps); });
+
+	return isDone;
+}
+
+bool ResumableSMix::AdvanceFor(Windows::Foundation::TimeSpan budget)
+{
+	// TimeSpan counts 100-nanosecond ticks
+	std::chrono::duration<long long, std::ratio<1, 10000000>> ticks(budget.Duration);
+
+	return _state->AdvanceFor(std::chrono::duration_cast<std::chrono::steady_clock::duration>(ticks));
 }
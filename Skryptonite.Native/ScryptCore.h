@@ -16,15 +16,17 @@
 * along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 #pragma once
-#include "SalsaBlock.h"
-#include "ScryptElement.h"
-#include "ScryptBlock.h"
-#include "DetectInstructionSet.h"
+#include "DerivationCache.h"
+#include "ScryptEngine.h"
+#include "SMixState.h"
+#include <memory>
 
 namespace Skryptonite
 {
 	namespace Native
 	{
+		ref class ResumableSMix;
+
 		/**
 		<summary>Encapsulates the core Scrypt algorithm.</summary>
 		*/
@@ -51,6 +53,277 @@ namespace Skryptonite
 			*/
 			void SMix(unsigned elementIndex);
 
+			/**
+			<summary>Performs SMix on a contiguous range of elements of the buffer, processing them several at a time when the
+			instruction set allows.</summary>
+			<param name="firstElementIndex">The index of the first element to mix.</param>
+			<param name="count">The number of elements to mix.</param>
+			<remarks>
+			Elements are processed in groups of <see cref="LaneCount"/> by the multi-buffer kernel. Any remainder smaller than
+			<see cref="LaneCount"/> is processed one element at a time with <see cref="SMix"/>.
+			</remarks>
+			<exception cref="Platform::InvalidArgumentException">Thrown when the range extends past ElementsCount.</exception>
+			*/
+			void SMixRange(unsigned firstElementIndex, unsigned count);
+
+			/**
+			<summary>Performs SMix on every element of the buffer on the library's persistent native thread pool.</summary>
+			<param name="threadCount">The largest number of threads to use, including the calling thread, or 0 to use one per
+			hardware thread.</param>
+			<remarks>
+			Full groups of <see cref="LaneCount"/> elements are mixed together and the rest one per thread, without returning to
+			the caller between elements.
+			</remarks>
+			<exception cref="Platform::OutOfMemoryException">Thrown when the working memory cannot be allocated.</exception>
+			*/
+			void SMixAll(unsigned threadCount);
+
+			/**
+			<summary>Gets the bytes of a buffer that is always large enough for <see cref="SMixWithScratch"/>, whatever its
+			alignment, with the current <see cref="TradeOffFactor"/>.</summary>
+			*/
+			property unsigned long long ScratchLength
+			{
+				unsigned long long get();
+			}
+
+			/**
+			<summary>Performs SMix on one element in a caller-owned buffer, so that no memory is allocated and the same buffer can be
+			reused across elements and instances.</summary>
+			<param name="elementIndex">The element index to mix.</param>
+			<param name="scratch">A buffer of at least <see cref="ScratchLength"/> bytes, which must not be used by anything else
+			during the call. It is left holding intermediate values of the derivation.</param>
+			<exception cref="Platform::InvalidArgumentException">Thrown when the element index is out of range, or the buffer is null
+			or too short.</exception>
+			*/
+			void SMixWithScratch(unsigned elementIndex, Windows::Storage::Streams::IBuffer^ scratch);
+
+			/**
+			<summary>Performs SMix on one element from each of several independent buffers at once.</summary>
+			<param name="cores">The cores containing the elements to mix. All must share the same element length and processing cost.</param>
+			<param name="elementIndices">The index of the element to mix within the corresponding core.</param>
+			<remarks>
+			Allows elements of separate derivations with the same parameters to share the multi-buffer kernel. The same element
+			must not appear more than once.
+			</remarks>
+			<exception cref="Platform::InvalidArgumentException">Thrown when the arrays are null, empty, or differ in length, when more
+			than <see cref="LaneCount"/> elements are given, when the cores do not share parameters, or when an element index is out of range.</exception>
+			*/
+			static void SMixLanes(const Platform::Array<ScryptCore^>^ cores, const Platform::Array<unsigned>^ elementIndices);
+
+			/**
+			<summary>Prepares to perform SMix on the given element of the buffer in slices that can be paused, resumed, and cancelled.</summary>
+			<param name="elementIndex">The element index to mix.</param>
+			<returns>The SMix in progress. The element is only written by its last step.</returns>
+			<exception cref="Platform::InvalidArgumentException">Thrown when <paramref name="elementIndex"/> is greater than or equal to
+			ElementsCount.</exception>
+			<exception cref="Platform::OutOfMemoryException">Thrown when the working memory cannot be allocated.</exception>
+			*/
+			ResumableSMix^ BeginSMix(unsigned elementIndex);
+
+			/**
+			<summary>Performs a single iteration of PBKDF2-HMAC-SHA256 natively.</summary>
+			<param name="keyMaterial">The material from which the key will be derived.</param>
+			<param name="salt">The salt used to randomize the derived key.</param>
+			<param name="derivedKeyLength">The length of the derived key in bytes.</param>
+			<returns>The derived key.</returns>
+			<exception cref="Platform::InvalidArgumentException">Thrown when <paramref name="keyMaterial"/> or <paramref name="salt"/> is null,
+			or when <paramref name="derivedKeyLength"/> is 0.</exception>
+			*/
+			static Windows::Storage::Streams::IBuffer^ OneRoundPbkdf2Sha256(Windows::Storage::Streams::IBuffer^ keyMaterial,
+				Windows::Storage::Streams::IBuffer^ salt, unsigned derivedKeyLength);
+
+			/**
+			<summary>Performs a complete Scrypt derivation on the calling thread without leaving native code.</summary>
+			<param name="key">The input key (e.g. user password).</param>
+			<param name="salt">The salt.</param>
+			<param name="elementLengthMultiplier">The "r" parameter.</param>
+			<param name="processingCost">The "N" parameter.</param>
+			<param name="parallelization">The "p" parameter.</param>
+			<param name="derivedKeyLength">The length of the derived key in bytes.</param>
+			<returns>The derived key.</returns>
+			<exception cref="Platform::InvalidArgumentException">Thrown when <paramref name="key"/> or <paramref name="salt"/> is null, or
+			when the parameters are 0 or too large.</exception>
+			<exception cref="Platform::OutOfMemoryException">Thrown when enough memory cannot be allocated.</exception>
+			*/
+			static Windows::Storage::Streams::IBuffer^ DeriveKey(Windows::Storage::Streams::IBuffer^ key, Windows::Storage::Streams::IBuffer^ salt,
+				unsigned elementLengthMultiplier, unsigned processingCost, unsigned parallelization, unsigned derivedKeyLength);
+
+			/**
+			<summary>Performs complete Scrypt derivations of several keys with the same parameters in a single call.</summary>
+			<param name="keys">The input keys (e.g. user passwords).</param>
+			<param name="salts">The salt for the key at the same index.</param>
+			<param name="elementLengthMultiplier">The "r" parameter.</param>
+			<param name="processingCost">The "N" parameter.</param>
+			<param name="parallelization">The "p" parameter.</param>
+			<param name="derivedKeyLength">The length of each derived key in bytes.</param>
+			<param name="cachePolicy">How the large memory blocks are treated by the cache.</param>
+			<param name="tradeOffFactor">The time-memory trade-off factor.</param>
+			<returns>The derived key for each input key, in order.</returns>
+			<remarks>
+			The elements of all the derivations are scheduled together on the native thread pool, so that elements of separate
+			keys share the multi-buffer kernel without returning to the caller between groups.
+			</remarks>
+			<exception cref="Platform::InvalidArgumentException">Thrown when the arrays are null, differ in length or contain null, or
+			when the parameters are 0 or too large.</exception>
+			<exception cref="Platform::OutOfMemoryException">Thrown when enough memory cannot be allocated.</exception>
+			*/
+			static Platform::Array<Windows::Storage::Streams::IBuffer^>^ DeriveKeys(
+				const Platform::Array<Windows::Storage::Streams::IBuffer^>^ keys,
+				const Platform::Array<Windows::Storage::Streams::IBuffer^>^ salts, unsigned elementLengthMultiplier,
+				unsigned processingCost, unsigned parallelization, unsigned derivedKeyLength,
+				Skryptonite::Native::CachePolicy cachePolicy, unsigned tradeOffFactor);
+
+			/**
+			<summary>Queues a complete Scrypt derivation on the native derivation queue and returns without waiting for it.</summary>
+			<param name="key">The input key (e.g. user password), copied before returning.</param>
+			<param name="salt">The salt, copied before returning.</param>
+			<param name="elementLengthMultiplier">The "r" parameter.</param>
+			<param name="processingCost">The "N" parameter.</param>
+			<param name="parallelization">The "p" parameter.</param>
+			<param name="derivedKeyLength">The length of the derived key in bytes.</param>
+			<returns>An operation that completes with the derived key. Cancelling it withdraws the derivation if it has not
+			started.</returns>
+			<exception cref="Platform::InvalidArgumentException">Thrown when <paramref name="key"/> or <paramref name="salt"/> is null, or
+			when the parameters are 0 or too large.</exception>
+			<exception cref="Platform::FailureException">Thrown when the queue is full.</exception>
+			*/
+			static Windows::Foundation::IAsyncOperation<Windows::Storage::Streams::IBuffer^>^ DeriveKeyAsync(
+				Windows::Storage::Streams::IBuffer^ key, Windows::Storage::Streams::IBuffer^ salt, unsigned elementLengthMultiplier,
+				unsigned processingCost, unsigned parallelization, unsigned derivedKeyLength);
+
+			/**
+			<summary>Finds the smallest time-memory trade-off factor whose large memory block fits in a memory budget.</summary>
+			<param name="elementLengthMultiplier">The "r" parameter.</param>
+			<param name="processingCost">The "N" parameter.</param>
+			<param name="maxBytes">The largest number of bytes one large memory block may use. Every thread needs its own.</param>
+			<returns>The factor, 1 when the whole large memory block fits.</returns>
+			<exception cref="Platform::InvalidArgumentException">Thrown when a parameter is 0 or when <paramref name="maxBytes"/> is smaller
+			than one element of 128 * r bytes.</exception>
+			*/
+			static unsigned TradeOffFactorForMemory(unsigned elementLengthMultiplier, unsigned processingCost, unsigned long long maxBytes);
+
+			/**
+			<summary>Times every instruction set the processor supports on a short SMix with the given parameters, and makes
+			instances created afterwards with the same parameters use the fastest one that produces correct results.</summary>
+			<param name="elementLengthMultiplier">The "r" parameter.</param>
+			<param name="processingCost">The "N" parameter.</param>
+			<param name="parallelization">The "p" parameter. A single SMix is timed when it is 1, and the multi-buffer path otherwise.</param>
+			<returns>The chosen instruction set. Later calls with the same parameters return the same choice without timing again.</returns>
+			<exception cref="Platform::InvalidArgumentException">Thrown when a parameter is 0 or too large.</exception>
+			<exception cref="Platform::FailureException">Thrown when no instruction set produces correct results.</exception>
+			<exception cref="Platform::OutOfMemoryException">Thrown when enough memory cannot be allocated.</exception>
+			*/
+			static InstructionSet Autotune(unsigned elementLengthMultiplier, unsigned processingCost, unsigned parallelization);
+
+			/**
+			<summary>Limits the large memory blocks of the SMix elements of all instances running at the same time. Elements that
+			do not fit wait their turn instead of failing with an out of memory exception.</summary>
+			<param name="limitBytes">The limit in bytes, or 0 for none (the default).</param>
+			<param name="maxWaitMilliseconds">The longest an element waits before failing with
+			<see cref="Platform::OutOfMemoryException"/>, or 0 to wait as long as it takes.</param>
+			*/
+			static void SetMemoryBudget(unsigned long long limitBytes, unsigned maxWaitMilliseconds);
+
+			/**
+			<summary>Gets the number of SMix elements waiting for memory under the limit set by <see cref="SetMemoryBudget"/>.</summary>
+			*/
+			static property unsigned MemoryBudgetQueueDepth
+			{
+				unsigned get() { return MemoryBudget::Global().Statistics().queueDepth; }
+			}
+
+			/**
+			<summary>Gets the total time SMix elements have waited for memory, in milliseconds.</summary>
+			*/
+			static property unsigned long long MemoryBudgetWaitMilliseconds
+			{
+				unsigned long long get() { return MemoryBudget::Global().Statistics().totalWaitNanoseconds / 1000000; }
+			}
+
+			/**
+			<summary>Enables, resizes or disables the process-wide cache of derived keys, erasing every cached key. Disabled by
+			default.</summary>
+			<param name="maxEntries">The most derived keys to hold, least recently used first out, or 0 to disable the cache.</param>
+			<param name="maxKeyLength">The longest derived key to hold, in bytes. Longer keys are never cached.</param>
+			<param name="timeToLiveMilliseconds">How long a derived key is held after it is cached.</param>
+			<exception cref="Platform::InvalidArgumentException">Thrown when <paramref name="maxEntries"/> is not 0 and
+			<paramref name="maxKeyLength"/> or <paramref name="timeToLiveMilliseconds"/> is 0.</exception>
+			<exception cref="Platform::OutOfMemoryException">Thrown when the memory for the derived keys cannot be allocated.</exception>
+			*/
+			static void ConfigureDerivationCache(unsigned maxEntries, unsigned maxKeyLength, unsigned timeToLiveMilliseconds);
+
+			/**
+			<summary>Erases every derived key in the cache set up by <see cref="ConfigureDerivationCache"/>.</summary>
+			*/
+			static void ClearDerivationCache();
+
+			/**
+			<summary>Looks up a derived key in the cache set up by <see cref="ConfigureDerivationCache"/>.</summary>
+			<returns>The derived key, or null when the cache does not hold it.</returns>
+			<exception cref="Platform::InvalidArgumentException">Thrown when <paramref name="key"/> or <paramref name="salt"/> is
+			null.</exception>
+			*/
+			static Windows::Storage::Streams::IBuffer^ TryGetCachedKey(Windows::Storage::Streams::IBuffer^ key,
+				Windows::Storage::Streams::IBuffer^ salt, unsigned elementLengthMultiplier, unsigned processingCost,
+				unsigned parallelization, unsigned derivedKeyLength);
+
+			/**
+			<summary>Adds a derived key to the cache set up by <see cref="ConfigureDerivationCache"/>, if it is enabled.</summary>
+			<exception cref="Platform::InvalidArgumentException">Thrown when <paramref name="key"/>, <paramref name="salt"/> or
+			<paramref name="derivedKey"/> is null.</exception>
+			*/
+			static void CacheDerivedKey(Windows::Storage::Streams::IBuffer^ key, Windows::Storage::Streams::IBuffer^ salt,
+				unsigned elementLengthMultiplier, unsigned processingCost, unsigned parallelization,
+				Windows::Storage::Streams::IBuffer^ derivedKey);
+
+			/**
+			<summary>Gets the number of derived keys found in the cache.</summary>
+			*/
+			static property unsigned long long DerivationCacheHits
+			{
+				unsigned long long get() { return DerivationCache::Global().Statistics().hits; }
+			}
+
+			/**
+			<summary>Gets the number of derived keys looked up in the enabled cache and not found.</summary>
+			*/
+			static property unsigned long long DerivationCacheMisses
+			{
+				unsigned long long get() { return DerivationCache::Global().Statistics().misses; }
+			}
+
+			/**
+			<summary>Loads the cost model profile of this processor from a file, or measures one, which takes about a second, and saves
+			it there.</summary>
+			<param name="profilePath">The profile file, which may hold the profiles of several processors.</param>
+			<exception cref="Platform::OutOfMemoryException">Thrown when the measurement cannot allocate its memory.</exception>
+			<exception cref="Platform::FailureException">Thrown when the file cannot be written.</exception>
+			*/
+			static void LoadCostModel(Platform::String^ profilePath);
+
+			/**
+			<summary>Predicts the wall time of a derivation from the cost model, measuring a profile without saving it when none
+			was loaded.</summary>
+			<returns>The predicted time in milliseconds.</returns>
+			*/
+			static double PredictMilliseconds(unsigned elementLengthMultiplier, unsigned processingCost, unsigned parallelization,
+				unsigned threadCount);
+
+			/**
+			<summary>Chooses N and p from the cost model by the rule Scrypt.CreateOptimal applies, measuring a profile without saving
+			it when none was loaded.</summary>
+			<param name="maxMemoryBytes">The most memory one element may use, its large memory block and its data, in bytes.</param>
+			<param name="targetMilliseconds">The time one derivation should take.</param>
+			<param name="threadCount">The threads the elements may be spread over.</param>
+			<param name="elementLengthMultiplier">The block size parameter r.</param>
+			<param name="processingCost">Receives N.</param>
+			<param name="parallelization">Receives p.</param>
+			<exception cref="Platform::OutOfMemoryException">Thrown when the memory limit is too small for an element with N = 16.</exception>
+			*/
+			static void ChooseParameters(unsigned long long maxMemoryBytes, unsigned targetMilliseconds, unsigned threadCount,
+				unsigned elementLengthMultiplier, unsigned* processingCost, unsigned* parallelization);
+
 			/**
 			<summary>Erases the buffer.</summary>
 			<remarks>Should be called after finishing Scrypt and deriving the final key.</remarks>
@@ -62,79 +335,120 @@ namespace Skryptonite
 			*/
 			property unsigned ElementsCount
 			{
-				unsigned get() { return _elementsCount; }
+				unsigned get() { return _engine->ElementsCount(); }
 			}
 
-		private:
-			Windows::Storage::Streams::IBuffer^ _buffer;
-			SalsaBlock* _data;
+			/**
+			<summary>Gets the number of elements the active instruction set can mix at once. 1 when no multi-buffer kernel is available.</summary>
+			*/
+			property unsigned LaneCount
+			{
+				unsigned get() { return _engine->LaneCount(); }
+			}
 
-			unsigned _elementsCount;
-			unsigned _elementLength;
-			unsigned _salsaBlockCountPerElement;
-			unsigned _processingCost;
+			/**
+			<summary>Gets or sets how SMix treats the cache when writing and reading the large memory block. Must not be set while
+			mixing.</summary>
+			*/
+			property Skryptonite::Native::CachePolicy CachePolicy
+			{
+				Skryptonite::Native::CachePolicy get() { return _engine->RequestedCachePolicy(); }
+				void set(Skryptonite::Native::CachePolicy value) { _engine->SetCachePolicy(value); }
+			}
 
 			/**
-			<summary>Extracts a pointer to the underlying data from the buffer.</summary>
+			<summary>Gets the cache policy SMix actually uses after resolving <see cref="CachePolicy::Automatic"/>.</summary>
 			*/
-			void GetBufferPointer();
+			property Skryptonite::Native::CachePolicy ActiveCachePolicy
+			{
+				Skryptonite::Native::CachePolicy get() { return _engine->ActiveCachePolicy(); }
+			}
 
 			/**
-			<summary>Assigns the correct functions based on instruction set.</summary>
+			<summary>Gets or sets the time-memory trade-off factor k: the large memory block keeps only every k-th element and rebuilds
+			the others when they are read. The output is unchanged. Must be greater than 0, and must not be set while mixing.</summary>
 			*/
-			void SetFunctions();
+			property unsigned TradeOffFactor
+			{
+				unsigned get() { return _engine->TradeOffFactor(); }
+				void set(unsigned value);
+			}
+
+		private:
+			Windows::Storage::Streams::IBuffer^ _buffer;
+			std::unique_ptr<ScryptEngine> _engine;
+		};
 
+		/**
+		<summary>An SMix of one element in progress, advanced a bounded number of steps or a time budget at a time.</summary>
+		<remarks>
+		SMix takes 2 * processingCost steps. Advance and AdvanceFor may be called from different threads, but not at the same time;
+		Cancel and the properties may be called from any thread. The cache policy and trade-off factor of the core must not change
+		while the SMix is in progress.
+		</remarks>
+		*/
+		public ref class ResumableSMix sealed
+		{
+		public:
 			/**
-			<summary>Fills the large memory block with data mixed from the initial buffer and returns the final mixed buffer.</summary>
-			<param name="workingBuffer">The element in which the data is input and output.</param>
-			<param name="scryptBlock">The large memory block.</param>
-			<param name="shuffleBuffer">A scratch space used internally.</param>
+			<summary>Performs up to the given number of steps.</summary>
+			<param name="maxSteps">The largest number of steps to perform.</param>
+			<returns>True when no work remains because the SMix has completed or been cancelled.</returns>
+			<exception cref="Platform::InvalidArgumentException">Thrown when <paramref name="maxSteps"/> is 0.</exception>
 			*/
-			void FillScryptBlock(ScryptElementPtr& workingBuffer, const ScryptBlockPtr& scryptBlock, ScryptElementPtr& shuffleBuffer);
+			bool Advance(unsigned long long maxSteps);
 
 			/**
-			<summary>Mixes the working buffer by jumping around the large memory block.</summary>
-			<param name="workingBuffer">The element in which the data is input and output.</param>
-			<param name="scryptBlock">The large memory block.</param>
-			<param name="shuffleBuffer">A scratch space used internally.</param>
+			<summary>Performs steps until the time budget is spent or no work remains. At least one step is performed.</summary>
+			<param name="budget">The time to spend.</param>
+			<returns>True when no work remains because the SMix has completed or been cancelled.</returns>
 			*/
-			void MixWithScryptBlock(ScryptElementPtr& workingBuffer, const ScryptBlockPtr& scryptBlock, ScryptElementPtr& shuffleBuffer);
+			bool AdvanceFor(Windows::Foundation::TimeSpan budget);
 
+			/**
+			<summary>Requests that the SMix stop and release its working memory, leaving the element unchanged.</summary>
+			*/
+			void Cancel() { _state->Cancel(); }
 
-#pragma region Instruction_Set_Specific_Function_Pointers
 			/**
-			<summary>Loads and optimally arranges the data into the working buffer.</summary>
-			<param name="workingBuffer">The element in which the data is input and output.</param>
-			<param name="source">The location from which to load.</param>
+			<summary>Gets whether every step has been performed and the element holds the result.</summary>
 			*/
-			void(*PrepareData)(ScryptElementPtr& workingBuffer, SalsaBlock* source);
+			property bool IsCompleted
+			{
+				bool get() { return _state->IsCompleted(); }
+			}
 
 			/**
-			<summary>Copies the working buffer into a memory location and then mixes the working buffer.</summary>
-			<param name="copyDestination">The location to copy the buffer to.</param>
-			<param name="workingBuffer">The element in which the data is input and output.</param>
-			<param name="shuffleBuffer">A scratch space used internally.</param>
+			<summary>Gets whether the SMix was cancelled before it completed.</summary>
 			*/
-			void(*CopyAndMixBlocks)(SalsaBlock* copyDestination, ScryptElementPtr& workingBuffer, ScryptElementPtr& shuffleBuffer);
+			property bool IsCancelled
+			{
+				bool get() { return _state->IsCancelled(); }
+			}
 
 			/**
-			<summary>Xors the data from a memory location into the working buffer and mixes it.</summary>
-			<param name="workingBuffer">The element in which the data is input and output.</param>
-			<param name="xorSource">The location of the data to xor into the working buffer.</param>
-			<param name="shuffleBuffer">A scratch space used internally.</param>
+			<summary>Gets the number of steps performed so far.</summary>
 			*/
-			void(*XorAndMixBlocks)(ScryptElementPtr& workingBuffer, SalsaBlock* xorSource, ScryptElementPtr& shuffleBuffer);
+			property unsigned long long CompletedSteps
+			{
+				unsigned long long get() { return _state->CompletedSteps(); }
+			}
 
 			/**
-			<summary>Restores and saves the data from the working buffer.</summary>
-			<param name="destination">The location in which to store.</param>
-			<param name="workingBuffer">The element in which the data is input and output.</param>
+			<summary>Gets the number of steps SMix takes, 2 * processingCost.</summary>
 			*/
-			void(*RestoreData)(SalsaBlock* destination, ScryptElementPtr& workingBuffer);
-#pragma endregion
+			property unsigned long long TotalSteps
+			{
+				unsigned long long get() { return _state->TotalSteps(); }
+			}
+
+		internal:
+			ResumableSMix(ScryptCore^ core, std::unique_ptr<SMixState> state);
+
+		private:
+			// keeps the engine and its buffer alive while the state refers to them
+			ScryptCore^ _core;
+			std::unique_ptr<SMixState> _state;
 		};
 	}
 }
-
-
-
@@ -17,11 +17,22 @@
 */
 #include "pch.h"
 #include <limits>
+#include <stdexcept>
 #include "ScryptElement.h"
+#include "ScratchPool.h"
 
 using namespace Skryptonite::Native;
 
-ScryptElement::ScryptElement(unsigned blockCount, unsigned integerifyDivisor)
+ScryptElement::ScryptElement(unsigned blockCount, unsigned integerifyDivisor) :
+	ScryptElement(blockCount, integerifyDivisor, nullptr)
+{
+	// the delegated constructor has completed, so the destructor runs if this throws; the pool is set only once there is memory
+	ScratchPool& pool = ScratchPool::Current();
+	_data = reinterpret_cast<SalsaBlock*>(pool.Acquire(_length));
+	_pool = &pool;
+}
+
+ScryptElement::ScryptElement(unsigned blockCount, unsigned integerifyDivisor, SalsaBlock* memory)
 {
 	if (blockCount == 0)
 		throw std::out_of_range("blockCount must be greater than 0.");
@@ -33,17 +44,15 @@ ScryptElement::ScryptElement(unsigned blockCount, unsigned integerifyDivisor)
 	_blockCount = blockCount;
 	_integerifyDivisor = integerifyDivisor;
 	_length = sizeof(SalsaBlock) * blockCount;
-	
-	_data = reinterpret_cast<SalsaBlock*>(_aligned_malloc(_length, Alignment));
-
-	if (_data == NULL)
-		throw std::bad_alloc();
+	_data = memory;
+	_pool = nullptr;
 }
 
 ScryptElement::~ScryptElement()
 {
-	memset(_data, 0, _length);
-	_aligned_free(_data);
+	// caller-owned memory has no pool
+	if (_pool != nullptr)
+		_pool->Release(_data, _length);
 }
 
 unsigned ScryptElement::Integerify() const
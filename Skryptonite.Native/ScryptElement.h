@@ -17,6 +17,7 @@
 */
 #pragma once
 #include "SalsaBlock.h"
+#include "ScratchPool.h"
 #include <memory>
 
 namespace Skryptonite
@@ -25,6 +26,8 @@ namespace Skryptonite
 	{
 		/**
 		<summary>Encapsulates the working buffer used by the Scrypt SMix function.</summary>
+		<remarks>The memory is taken from and returned to the <see cref="ScratchPool::Current"/> pool of the creating thread, unless
+		the caller provides it.</remarks>
 		*/
 		class ScryptElement
 		{
@@ -49,10 +52,19 @@ namespace Skryptonite
 			<param name="blockCount">The number of 64-byte blocks composing the buffer data.</param>
 			<param name="integerifyDivisor">The divisor to use with <see cref="Integerify"/>.</param>
 			<exception cref="std::out_of_range">Thrown when either parameter is 0.</exception>
-			<exception cref="std::exception">Thrown when the memory allocation fails.</exception>
+			<exception cref="std::bad_alloc">Thrown when the memory allocation fails.</exception>
 			*/
 			ScryptElement(unsigned blockCount, unsigned integerifyDivisor);
 
+			/**
+			<summary>Wraps caller-owned memory, which is neither allocated nor released.</summary>
+			<param name="blockCount">The number of 64-byte blocks composing the buffer data.</param>
+			<param name="integerifyDivisor">The divisor to use with <see cref="Integerify"/>.</param>
+			<param name="memory">At least 64 * blockCount bytes aligned to 64 bytes, which must outlive this object.</param>
+			<exception cref="std::out_of_range">Thrown when either count is 0.</exception>
+			*/
+			ScryptElement(unsigned blockCount, unsigned integerifyDivisor, SalsaBlock* memory);
+
 			~ScryptElement();
 
 			/**
@@ -63,16 +75,15 @@ namespace Skryptonite
 			internally re-arranged so that that 0th element is located at the 4th element.
 			</remarks>
 			*/
-			unsigned ScryptElement::Integerify() const;
+			unsigned Integerify() const;
 
 		private:
-			const int Alignment = 64;
-
 			unsigned _blockCount;
 			unsigned _integerifyDivisor;
 			unsigned _length;
 
 			SalsaBlock* _data;
+			ScratchPool* _pool;
 		};
 
 		typedef std::unique_ptr<ScryptElement> ScryptElementPtr;
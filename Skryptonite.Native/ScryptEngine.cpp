@@ -0,0 +1,1145 @@
+/**
+* Skryptonite - Scrypt library for UWP
+* Copyright © 2016 Nicholas C. Bauer, Ph.D.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "pch.h"
+#include "ScryptEngine.h"
+#include "ScryptElement.h"
+#include "ScryptCommon.h"
+#include "CpuFeatures.h"
+#include "Autotuner.h"
+#include "MappedScratch.h"
+#include "Metrics.h"
+#include "Pbkdf2Sha256.h"
+#include "ScryptScalar.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+#if defined(SKRYPTONITE_X86)
+#include "../Skryptonite.Native.SSE2/ScryptSSE2.h"
+#include "../Skryptonite.Native.SSE2/ScryptSSE41.h"
+#include "../Skryptonite.Native.AVX/ScryptAVX.h"
+#include "../Skryptonite.Native.AVX2/ScryptAVX2.h"
+#include "../Skryptonite.Native.AVX2/ScryptAVX2x8.h"
+#endif
+
+#if defined(SKRYPTONITE_ARM)
+#include "../Skryptonite.Native.NEON/ScryptNEON.h"
+#endif
+
+using namespace Skryptonite::Native;
+
+// the largest number of lanes any multi-buffer kernel mixes at once
+const unsigned MaxLaneCount = 8;
+
+static_assert(ScryptEngine::MaxInterleaveCount <= MaxLaneCount, "MaxLaneCount is too small for the interleaved chains.");
+
+std::atomic<unsigned> ScryptEngine::_interleaveCount(1);
+std::atomic<CachePolicy> ScryptEngine::_defaultCachePolicy(CachePolicy::Automatic);
+std::atomic<unsigned> ScryptEngine::_defaultTradeOffFactor(1);
+std::mutex ScryptEngine::_defaultStorageDirectoryMutex;
+std::string ScryptEngine::_defaultStorageDirectory;
+
+// PBKDF2 can produce at most 2^32 - 1 hash blocks
+const unsigned long long MaxPbkdf2Length = 0xffffffffull * 32;
+
+ScryptEngine::ScryptEngine(unsigned char* data, size_t length, unsigned elementsCount, unsigned processingCost)
+{
+	if (data == nullptr)
+		throw std::invalid_argument("data must not be null.");
+	if (length == 0)
+		throw std::invalid_argument("data must be non-empty.");
+	if (elementsCount == 0)
+		throw std::invalid_argument("elementsCount must be greater than 0.");
+	if (processingCost == 0)
+		throw std::invalid_argument("procesingCost must be greater than 0.");
+	if ((std::numeric_limits<unsigned>::max)() / elementsCount < 2 * sizeof(SalsaBlock))
+		throw std::invalid_argument("128 * elementsCount must be less than 2^32.");
+	if (length % (2 * sizeof(SalsaBlock) * elementsCount) > 0)
+		throw std::invalid_argument("data must be non-empty and contain a number of bytes divisible by 128 * elementsCount.");
+	if (length / elementsCount > (std::numeric_limits<unsigned>::max)())
+		throw std::invalid_argument("data->Length / elementsCount must be less than 2^32.");
+	if ((std::numeric_limits<size_t>::max)() / processingCost < length / elementsCount)
+		throw std::invalid_argument("processingCost * (data->Length / elementsCount) must be less than addressable memory!");
+
+	_data = reinterpret_cast<SalsaBlock*>(data);
+	_length = length;
+	_salsaBlockCountPerElement = static_cast<unsigned>(length / (elementsCount * sizeof(SalsaBlock)));
+	_elementsCount = elementsCount;
+	_processingCost = processingCost;
+	_instructionSet = Autotuner::InstructionSetFor(_salsaBlockCountPerElement / 2, processingCost, elementsCount);
+	_requestedCachePolicy = _defaultCachePolicy;
+	_tradeOffFactor = _defaultTradeOffFactor;
+	_storageDirectory = DefaultStorageDirectory();
+
+	SetFunctions();
+}
+
+void ScryptEngine::SetFunctions()
+{
+	const InstructionSet instructionSet = _instructionSet;
+
+	_laneCount = 1;
+	PrepareLanes = nullptr;
+	CopyAndMixLanes = nullptr;
+	XorAndMixLanes = nullptr;
+	IntegerifyLanes = nullptr;
+	RestoreLanes = nullptr;
+
+#if defined(SKRYPTONITE_X86)
+	// the multi-buffer kernel has no way to rebuild the elements the time-memory trade-off drops, nor to read from a file
+	if (instructionSet == InstructionSet::AVX2 && _tradeOffFactor == 1 && _storageDirectory.empty())
+	{
+		static_assert(ScryptAVX2x8::LaneCount <= MaxLaneCount, "MaxLaneCount is too small for the AVX2 multi-buffer kernel.");
+		_laneCount = ScryptAVX2x8::LaneCount;
+		PrepareLanes = ScryptAVX2x8::PrepareLanes;
+		IntegerifyLanes = ScryptAVX2x8::IntegerifyLanes;
+		RestoreLanes = ScryptAVX2x8::RestoreLanes;
+	}
+#endif
+
+	// without a multi-buffer kernel, several elements can still share a thread by interleaving, unless each waits on storage
+	if (PrepareLanes == nullptr)
+		_laneCount = _storageDirectory.empty() ? _interleaveCount.load() : 1;
+
+	// whether the large memory blocks fit in the cache depends on how many one thread mixes at once
+	_activeCachePolicy = ResolveCachePolicy();
+
+	switch (instructionSet)
+	{
+#if defined(SKRYPTONITE_X86)
+	case InstructionSet::AVX2:
+		SetMixFunctions<ScryptAVX2>();
+		if (PrepareLanes != nullptr)
+			SetLaneMixFunctions<ScryptAVX2x8>();
+		break;
+	case InstructionSet::AVX:
+		SetMixFunctions<ScryptAVX>();
+		break;
+	case InstructionSet::SSE41:
+		SetMixFunctions<ScryptSSE41>();
+		break;
+	case InstructionSet::SSSE3:
+	case InstructionSet::SSE2:
+		SetMixFunctions<ScryptSSE2>();
+		break;
+#endif
+#if defined(SKRYPTONITE_ARM)
+	case InstructionSet::NEON:
+		SetMixFunctions<ScryptNEON>();
+		break;
+#endif
+	default:
+		// unrecognized instruction set; use the portable implementation
+		SetMixFunctions<ScryptScalar>();
+		break;
+	}
+}
+
+CachePolicy ScryptEngine::ResolveCachePolicy() const
+{
+	CachePolicy policy = _requestedCachePolicy;
+
+	if (policy == CachePolicy::Automatic)
+	{
+		const unsigned long long scryptBlockLength = static_cast<unsigned long long>(sizeof(SalsaBlock)) *
+			_salsaBlockCountPerElement * StoredElementCount() * _laneCount;
+		const size_t cacheSize = CpuFeatures::LastLevelCacheSize();
+
+		if (cacheSize > 0 && scryptBlockLength <= cacheSize / 2)
+			policy = CachePolicy::Cached;
+		else
+			policy = CachePolicy::StreamAndFlushOptimized;
+	}
+
+	if (policy == CachePolicy::StreamAndFlushOptimized && !CpuFeatures::ClflushOpt())
+		policy = CachePolicy::StreamAndFlush;
+
+	return policy;
+}
+
+template<class TBackend>
+void ScryptEngine::SetMixFunctions()
+{
+	// the common values of r have kernels whose loops over the element have a constant trip count
+	switch (_salsaBlockCountPerElement)
+	{
+	case 2:
+		SetSizedMixFunctions<TBackend, 2>();
+		break;
+	case 4:
+		SetSizedMixFunctions<TBackend, 4>();
+		break;
+	case 8:
+		SetSizedMixFunctions<TBackend, 8>();
+		break;
+	case 16:
+		SetSizedMixFunctions<TBackend, 16>();
+		break;
+	case 32:
+		SetSizedMixFunctions<TBackend, 32>();
+		break;
+	default:
+		SetSizedMixFunctions<TBackend, 0>();
+		break;
+	}
+}
+
+template<class TBackend, unsigned fixedBlockCount>
+void ScryptEngine::SetSizedMixFunctions()
+{
+	MixBlocksInto = TBackend::template MixBlocksInto<fixedBlockCount>;
+
+	// elements rebuilt by the time-memory trade-off live in scratch memory that is reused at once
+	XorAndMixRebuiltBlocks = TBackend::template XorAndMixBlocks<CachePolicy::Cached, fixedBlockCount>;
+	XorMixAndRestoreRebuiltBlocks = TBackend::template XorMixAndRestoreBlocks<CachePolicy::Cached, fixedBlockCount>;
+
+	switch (_activeCachePolicy)
+	{
+	case CachePolicy::Cached:
+		CopyAndMixBlocks = TBackend::template CopyAndMixBlocks<CachePolicy::Cached, fixedBlockCount>;
+		XorAndMixBlocks = TBackend::template XorAndMixBlocks<CachePolicy::Cached, fixedBlockCount>;
+		PrepareCopyAndMixBlocks = TBackend::template PrepareCopyAndMixBlocks<CachePolicy::Cached, fixedBlockCount>;
+		XorMixAndRestoreBlocks = TBackend::template XorMixAndRestoreBlocks<CachePolicy::Cached, fixedBlockCount>;
+		break;
+	case CachePolicy::StreamAndFlushOptimized:
+		CopyAndMixBlocks = TBackend::template CopyAndMixBlocks<CachePolicy::StreamAndFlushOptimized, fixedBlockCount>;
+		XorAndMixBlocks = TBackend::template XorAndMixBlocks<CachePolicy::StreamAndFlushOptimized, fixedBlockCount>;
+		PrepareCopyAndMixBlocks = TBackend::template PrepareCopyAndMixBlocks<CachePolicy::StreamAndFlushOptimized, fixedBlockCount>;
+		XorMixAndRestoreBlocks = TBackend::template XorMixAndRestoreBlocks<CachePolicy::StreamAndFlushOptimized, fixedBlockCount>;
+		break;
+	default:
+		CopyAndMixBlocks = TBackend::template CopyAndMixBlocks<CachePolicy::StreamAndFlush, fixedBlockCount>;
+		XorAndMixBlocks = TBackend::template XorAndMixBlocks<CachePolicy::StreamAndFlush, fixedBlockCount>;
+		PrepareCopyAndMixBlocks = TBackend::template PrepareCopyAndMixBlocks<CachePolicy::StreamAndFlush, fixedBlockCount>;
+		XorMixAndRestoreBlocks = TBackend::template XorMixAndRestoreBlocks<CachePolicy::StreamAndFlush, fixedBlockCount>;
+		break;
+	}
+}
+
+template<class TBackend>
+void ScryptEngine::SetLaneMixFunctions()
+{
+	switch (_activeCachePolicy)
+	{
+	case CachePolicy::Cached:
+		CopyAndMixLanes = TBackend::template CopyAndMixLanes<CachePolicy::Cached>;
+		XorAndMixLanes = TBackend::template XorAndMixLanes<CachePolicy::Cached>;
+		break;
+	case CachePolicy::StreamAndFlushOptimized:
+		CopyAndMixLanes = TBackend::template CopyAndMixLanes<CachePolicy::StreamAndFlushOptimized>;
+		XorAndMixLanes = TBackend::template XorAndMixLanes<CachePolicy::StreamAndFlushOptimized>;
+		break;
+	default:
+		CopyAndMixLanes = TBackend::template CopyAndMixLanes<CachePolicy::StreamAndFlush>;
+		XorAndMixLanes = TBackend::template XorAndMixLanes<CachePolicy::StreamAndFlush>;
+		break;
+	}
+}
+
+CachePolicy ScryptEngine::DefaultCachePolicy()
+{
+	return _defaultCachePolicy;
+}
+
+void ScryptEngine::SetDefaultCachePolicy(CachePolicy value)
+{
+	_defaultCachePolicy = value;
+}
+
+void ScryptEngine::SetInstructionSet(InstructionSet value)
+{
+	_instructionSet = value;
+	SetFunctions();
+}
+
+void ScryptEngine::SetCachePolicy(CachePolicy value)
+{
+	_requestedCachePolicy = value;
+	SetFunctions();
+}
+
+unsigned ScryptEngine::DefaultTradeOffFactor()
+{
+	return _defaultTradeOffFactor;
+}
+
+void ScryptEngine::SetDefaultTradeOffFactor(unsigned value)
+{
+	if (value == 0)
+		throw std::invalid_argument("value must be greater than 0.");
+
+	_defaultTradeOffFactor = value;
+}
+
+void ScryptEngine::SetTradeOffFactor(unsigned value)
+{
+	if (value == 0)
+		throw std::invalid_argument("value must be greater than 0.");
+
+	_tradeOffFactor = value;
+	SetFunctions();
+}
+
+std::string ScryptEngine::DefaultStorageDirectory()
+{
+	std::lock_guard<std::mutex> lock(_defaultStorageDirectoryMutex);
+	return _defaultStorageDirectory;
+}
+
+void ScryptEngine::SetDefaultStorageDirectory(const std::string& value)
+{
+	if (!value.empty() && !MappedScratch::IsSupported())
+		throw std::runtime_error("Large memory blocks cannot be kept in files on this platform.");
+
+	std::lock_guard<std::mutex> lock(_defaultStorageDirectoryMutex);
+	_defaultStorageDirectory = value;
+}
+
+void ScryptEngine::SetStorageDirectory(const std::string& value)
+{
+	if (!value.empty() && !MappedScratch::IsSupported())
+		throw std::runtime_error("Large memory blocks cannot be kept in files on this platform.");
+
+	_storageDirectory = value;
+	SetFunctions();
+}
+
+unsigned ScryptEngine::TradeOffFactorForMemory(unsigned elementLengthMultiplier, unsigned processingCost, unsigned long long maxBytes)
+{
+	if (elementLengthMultiplier == 0 || processingCost == 0)
+		throw std::invalid_argument("elementLengthMultiplier and processingCost must be greater than 0.");
+
+	const unsigned long long elementLength = 2ull * sizeof(SalsaBlock) * elementLengthMultiplier;
+	if (maxBytes < elementLength)
+		throw std::invalid_argument("maxBytes must be at least one element of 128 * elementLengthMultiplier bytes.");
+
+	const unsigned long long maxElementCount = maxBytes / elementLength;
+	if (maxElementCount >= processingCost)
+		return 1;
+
+	// keeping every k-th element stores ceil(N / k) of them, which is at most maxElementCount for k = ceil(N / maxElementCount)
+	return static_cast<unsigned>((processingCost + maxElementCount - 1) / maxElementCount);
+}
+
+unsigned ScryptEngine::InterleaveCount()
+{
+	return _interleaveCount;
+}
+
+void ScryptEngine::SetInterleaveCount(unsigned value)
+{
+	if (value == 0 || value > MaxInterleaveCount)
+		throw std::invalid_argument("value must be between 1 and MaxInterleaveCount.");
+
+	_interleaveCount = value;
+}
+
+void ScryptEngine::SMix(unsigned elementIndex)
+{
+	if (elementIndex >= _elementsCount)
+		throw std::invalid_argument("elementIndex is out of range.");
+
+	SalsaBlock* const sourceData = _data + static_cast<size_t>(elementIndex) * _salsaBlockCountPerElement;
+
+	if (!_storageDirectory.empty())
+	{
+		SMixOutOfCore(sourceData);
+		return;
+	}
+
+	// waits for memory held by other elements rather than failing to allocate
+	MemoryReservation reservation(MemoryBudget::Global(), ReservationLength(1));
+
+	ScryptElementPtr workingBuffer = std::make_unique<ScryptElement>(_salsaBlockCountPerElement, _processingCost);
+	ScryptElementPtr shuffleBuffer = std::make_unique<ScryptElement>(_salsaBlockCountPerElement, _processingCost);
+	ScryptBlockPtr scryptBlock = std::make_unique<ScryptBlock>(_salsaBlockCountPerElement, StoredElementCount());
+	ScryptElementPtr rebuildBuffer;
+	ScryptElementPtr rebuildShuffleBuffer;
+
+	if (_tradeOffFactor > 1)
+	{
+		rebuildBuffer = std::make_unique<ScryptElement>(_salsaBlockCountPerElement, _processingCost);
+		rebuildShuffleBuffer = std::make_unique<ScryptElement>(_salsaBlockCountPerElement, _processingCost);
+	}
+
+	FillScryptBlock(sourceData, workingBuffer, scryptBlock, shuffleBuffer);
+	MixWithScryptBlock(sourceData, workingBuffer, scryptBlock, shuffleBuffer, rebuildBuffer, rebuildShuffleBuffer);
+}
+
+/**
+<summary>Wraps caller-provided scratch memory in buffer objects on the stack, and lends them to the mixing functions through
+owning pointers that are released, not deleted, when it goes out of scope.</summary>
+*/
+class BorrowedScratch
+{
+public:
+	BorrowedScratch(const ScryptScratch& scratch, unsigned blockCount, unsigned processingCost, unsigned storedElementCount,
+		bool needsRebuild) :
+		_working(blockCount, processingCost, static_cast<SalsaBlock*>(scratch.workingBuffer)),
+		_shuffle(blockCount, processingCost, static_cast<SalsaBlock*>(scratch.shuffleBuffer)),
+		_rebuild(blockCount, processingCost, static_cast<SalsaBlock*>(scratch.rebuildBuffer)),
+		_rebuildShuffle(blockCount, processingCost, static_cast<SalsaBlock*>(scratch.rebuildShuffleBuffer)),
+		_block(blockCount, storedElementCount, static_cast<SalsaBlock*>(scratch.largeMemoryBlock)),
+		workingBuffer(&_working),
+		shuffleBuffer(&_shuffle),
+		rebuildBuffer(needsRebuild ? &_rebuild : nullptr),
+		rebuildShuffleBuffer(needsRebuild ? &_rebuildShuffle : nullptr),
+		scryptBlock(&_block)
+	{
+	}
+
+	~BorrowedScratch()
+	{
+		workingBuffer.release();
+		shuffleBuffer.release();
+		rebuildBuffer.release();
+		rebuildShuffleBuffer.release();
+		scryptBlock.release();
+	}
+
+	BorrowedScratch(const BorrowedScratch&) = delete;
+	BorrowedScratch& operator=(const BorrowedScratch&) = delete;
+
+private:
+	ScryptElement _working;
+	ScryptElement _shuffle;
+	ScryptElement _rebuild;
+	ScryptElement _rebuildShuffle;
+	ScryptBlock _block;
+
+public:
+	ScryptElementPtr workingBuffer;
+	ScryptElementPtr shuffleBuffer;
+	ScryptElementPtr rebuildBuffer;
+	ScryptElementPtr rebuildShuffleBuffer;
+	ScryptBlockPtr scryptBlock;
+};
+
+/**
+<summary>Checks that a caller-provided scratch region is present and aligned.</summary>
+*/
+static void ValidateScratchRegion(const void* region, size_t alignment, const char* message)
+{
+	if (region == nullptr || reinterpret_cast<uintptr_t>(region) % alignment != 0)
+		throw std::invalid_argument(message);
+}
+
+void ScryptEngine::SMix(unsigned elementIndex, const ScryptScratch& scratch)
+{
+	if (elementIndex >= _elementsCount)
+		throw std::invalid_argument("elementIndex is out of range.");
+
+	const bool needsRebuild = _tradeOffFactor > 1;
+
+	ValidateScratchRegion(scratch.largeMemoryBlock, ScratchAlignment, "scratch.largeMemoryBlock must be non-null and aligned to 64 bytes.");
+	ValidateScratchRegion(scratch.workingBuffer, ScratchAlignment, "scratch.workingBuffer must be non-null and aligned to 64 bytes.");
+	ValidateScratchRegion(scratch.shuffleBuffer, ScratchAlignment, "scratch.shuffleBuffer must be non-null and aligned to 64 bytes.");
+
+	if (needsRebuild)
+	{
+		ValidateScratchRegion(scratch.rebuildBuffer, ScratchAlignment, "scratch.rebuildBuffer must be non-null and aligned to 64 bytes.");
+		ValidateScratchRegion(scratch.rebuildShuffleBuffer, ScratchAlignment,
+			"scratch.rebuildShuffleBuffer must be non-null and aligned to 64 bytes.");
+	}
+
+	SalsaBlock* const sourceData = _data + static_cast<size_t>(elementIndex) * _salsaBlockCountPerElement;
+
+	BorrowedScratch borrowed(scratch, _salsaBlockCountPerElement, _processingCost, StoredElementCount(), needsRebuild);
+
+	FillScryptBlock(sourceData, borrowed.workingBuffer, borrowed.scryptBlock, borrowed.shuffleBuffer);
+	MixWithScryptBlock(sourceData, borrowed.workingBuffer, borrowed.scryptBlock, borrowed.shuffleBuffer, borrowed.rebuildBuffer,
+		borrowed.rebuildShuffleBuffer);
+}
+
+void ScryptEngine::SMixOutOfCore(SalsaBlock* source)
+{
+	const ScratchRequirements requirements = ElementScratchRequirements();
+	const size_t elementLength = requirements.bufferLength;
+
+	MappedScratch mapped(_storageDirectory, requirements);
+	BorrowedScratch borrowed(mapped.Scratch(), _salsaBlockCountPerElement, _processingCost, StoredElementCount(), _tradeOffFactor > 1);
+
+	{
+		SKRYPTONITE_METRICS_PHASE(FillScryptBlock, requirements.largeMemoryBlockLength);
+
+		mapped.AdviseSequential();
+		size_t writtenBack = 0;
+
+		for (unsigned i = 0; i < _processingCost; i++)
+		{
+			FillScryptBlockStep(i, source, borrowed.workingBuffer, borrowed.scryptBlock, borrowed.shuffleBuffer);
+
+			// the elements before the one being filled are final, so they are handed to storage in long runs behind the fill
+			const size_t finished = static_cast<size_t>(i / _tradeOffFactor) * elementLength;
+			if (finished - writtenBack >= MappedScratch::WriteBackLength)
+			{
+				mapped.WriteBack(writtenBack, finished - writtenBack);
+				writtenBack = finished;
+			}
+		}
+	}
+
+	{
+		SKRYPTONITE_METRICS_PHASE(MixWithScryptBlock, static_cast<unsigned long long>(elementLength) * _processingCost);
+
+		mapped.AdviseRandom();
+
+		// each read depends on the result of the one before, so none can be requested further ahead; an element spanning
+		// several pages is requested whole, so its pages are read together rather than faulted in one at a time
+		const bool prefetchesElements = elementLength > mapped.PageLength();
+
+		for (unsigned i = 0; i < _processingCost; i++)
+		{
+			unsigned j = borrowed.workingBuffer->Integerify();
+
+			if (prefetchesElements)
+				mapped.Prefetch(static_cast<size_t>(j / _tradeOffFactor) * elementLength, elementLength);
+
+			SalsaBlock* xorSource = LoadScryptBlockElement(j, borrowed.scryptBlock, borrowed.rebuildBuffer, borrowed.rebuildShuffleBuffer);
+			MixWithScryptBlockStep(i, source, borrowed.workingBuffer, xorSource, j % _tradeOffFactor > 0, borrowed.shuffleBuffer);
+		}
+	}
+}
+
+ScratchRequirements ScryptEngine::ScratchRequirementsFor(unsigned elementLengthMultiplier, unsigned processingCost,
+	unsigned tradeOffFactor)
+{
+	if (elementLengthMultiplier == 0 || processingCost == 0 || tradeOffFactor == 0)
+		throw std::invalid_argument("elementLengthMultiplier, processingCost and tradeOffFactor must be greater than 0.");
+
+	const unsigned long long bufferLength = 2ull * sizeof(SalsaBlock) * elementLengthMultiplier;
+	const unsigned storedElementCount = processingCost / tradeOffFactor + (processingCost % tradeOffFactor > 0 ? 1 : 0);
+	const unsigned bufferCount = tradeOffFactor > 1 ? 4 : 2;
+
+	if (bufferLength > (std::numeric_limits<unsigned>::max)()
+		|| (std::numeric_limits<size_t>::max)() / bufferLength < storedElementCount + bufferCount)
+		throw std::invalid_argument("The scratch memory would be larger than addressable memory.");
+
+	ScratchRequirements requirements;
+	requirements.bufferLength = static_cast<size_t>(bufferLength);
+	requirements.largeMemoryBlockLength = requirements.bufferLength * storedElementCount;
+	requirements.bufferCount = bufferCount;
+	requirements.alignment = ScratchAlignment;
+
+	// every region is a whole number of 64-byte blocks, so back to back they stay aligned
+	requirements.totalLength = requirements.largeMemoryBlockLength + requirements.bufferLength * bufferCount;
+
+	return requirements;
+}
+
+ScryptScratch ScryptEngine::PartitionScratch(void* region, size_t length, const ScratchRequirements& requirements)
+{
+	if (region == nullptr)
+		throw std::invalid_argument("region must not be null.");
+
+	const uintptr_t address = reinterpret_cast<uintptr_t>(region);
+	const size_t skipped = (requirements.alignment - address % requirements.alignment) % requirements.alignment;
+
+	if (length < skipped || length - skipped < requirements.totalLength)
+		throw std::invalid_argument("region is too short for the scratch requirements.");
+
+	unsigned char* next = static_cast<unsigned char*>(region) + skipped;
+	auto take = [&next](size_t regionLength)
+	{
+		void* taken = next;
+		next += regionLength;
+		return taken;
+	};
+
+	ScryptScratch scratch;
+	scratch.largeMemoryBlock = take(requirements.largeMemoryBlockLength);
+	scratch.workingBuffer = take(requirements.bufferLength);
+	scratch.shuffleBuffer = take(requirements.bufferLength);
+	scratch.rebuildBuffer = requirements.bufferCount > 2 ? take(requirements.bufferLength) : nullptr;
+	scratch.rebuildShuffleBuffer = requirements.bufferCount > 3 ? take(requirements.bufferLength) : nullptr;
+
+	return scratch;
+}
+
+void ScryptEngine::SMixRange(unsigned firstElementIndex, unsigned count)
+{
+	if (count > _elementsCount || firstElementIndex > _elementsCount - count)
+		throw std::invalid_argument("The range extends past ElementsCount.");
+
+	unsigned i = firstElementIndex;
+	unsigned end = firstElementIndex + count;
+
+	// lane-sliced large memory blocks hold LaneCount runs of processingCost elements
+	if (_laneCount > 1 && (std::numeric_limits<unsigned>::max)() / _laneCount >= _processingCost)
+	{
+		SalsaBlock* elements[MaxLaneCount];
+
+		for (; end - i >= _laneCount; i += _laneCount)
+		{
+			for (unsigned k = 0; k < _laneCount; k++)
+				elements[k] = _data + static_cast<size_t>(i + k) * _salsaBlockCountPerElement;
+
+			MixLanes(elements, _laneCount);
+		}
+
+		// interleaved chains cost nothing when unused, unlike the lanes of the multi-buffer kernel
+		if (PrepareLanes == nullptr && end - i > 1)
+		{
+			for (unsigned k = 0; k < end - i; k++)
+				elements[k] = _data + static_cast<size_t>(i + k) * _salsaBlockCountPerElement;
+
+			MixInterleaved(elements, end - i);
+			i = end;
+		}
+	}
+
+	for (; i < end; i++)
+		SMix(i);
+}
+
+void ScryptEngine::SMixAll(unsigned threadCount)
+{
+	unsigned laneCount = _laneCount;
+	if ((std::numeric_limits<unsigned>::max)() / laneCount < _processingCost)
+		laneCount = 1;
+
+	unsigned groupCount = _elementsCount / laneCount;
+	unsigned remainderStart = groupCount * laneCount;
+
+	ThreadPool::Global().Run(groupCount + (_elementsCount - remainderStart), threadCount, [&](size_t i)
+	{
+		if (i < groupCount)
+			SMixRange(static_cast<unsigned>(i) * laneCount, laneCount);
+		else
+			SMix(remainderStart + static_cast<unsigned>(i - groupCount));
+	});
+}
+
+void ScryptEngine::SMixLanes(ScryptEngine* const* engines, const unsigned* elementIndices, unsigned count)
+{
+	if (engines == nullptr || elementIndices == nullptr)
+		throw std::invalid_argument("engines and elementIndices must not be null.");
+	if (count == 0)
+		throw std::invalid_argument("engines and elementIndices must be non-empty.");
+	if (engines[0] == nullptr)
+		throw std::invalid_argument("engines must not contain null.");
+
+	ScryptEngine* firstEngine = engines[0];
+
+	if (count > firstEngine->_laneCount)
+		throw std::invalid_argument("No more than LaneCount elements may be mixed at once.");
+	if ((std::numeric_limits<unsigned>::max)() / firstEngine->_laneCount < firstEngine->_processingCost)
+		throw std::invalid_argument("processingCost * LaneCount must be less than 2^32.");
+
+	SalsaBlock* elements[MaxLaneCount];
+
+	for (unsigned k = 0; k < count; k++)
+	{
+		ScryptEngine* engine = engines[k];
+
+		if (engine == nullptr)
+			throw std::invalid_argument("engines must not contain null.");
+		if (engine->_salsaBlockCountPerElement != firstEngine->_salsaBlockCountPerElement || engine->_processingCost != firstEngine->_processingCost)
+			throw std::invalid_argument("All engines must share the same element length and processing cost.");
+		if (engine->_tradeOffFactor != firstEngine->_tradeOffFactor)
+			throw std::invalid_argument("All engines must share the same time-memory trade-off factor.");
+		if (elementIndices[k] >= engine->_elementsCount)
+			throw std::invalid_argument("elementIndex is out of range.");
+
+		elements[k] = engine->_data + static_cast<size_t>(elementIndices[k]) * engine->_salsaBlockCountPerElement;
+
+		for (unsigned l = 0; l < k; l++)
+			if (elements[l] == elements[k])
+				throw std::invalid_argument("The same element must not be mixed more than once.");
+	}
+
+	if (count == 1)
+		firstEngine->SMix(elementIndices[0]);
+	else
+		firstEngine->MixLanes(elements, count);
+}
+
+size_t ScryptEngine::ValidateParameters(unsigned elementLengthMultiplier, unsigned processingCost, unsigned parallelization)
+{
+	if (elementLengthMultiplier == 0 || processingCost == 0 || parallelization == 0)
+		throw std::invalid_argument("elementLengthMultiplier, processingCost, and parallelization must be greater than 0.");
+	if (MaxPbkdf2Length / (2 * sizeof(SalsaBlock) * elementLengthMultiplier) < parallelization)
+		throw std::invalid_argument("128 * elementLengthMultiplier * parallelization must be no more than (2^32 - 1) * 32.");
+
+	unsigned long long dataLength = 2ull * sizeof(SalsaBlock) * elementLengthMultiplier * parallelization;
+	if (dataLength > (std::numeric_limits<size_t>::max)())
+		throw std::invalid_argument("128 * elementLengthMultiplier * parallelization must be less than addressable memory.");
+
+	return static_cast<size_t>(dataLength);
+}
+
+void ScryptEngine::ValidateRequest(const ScryptRequest& request)
+{
+	if (request.password == nullptr && request.passwordLength > 0)
+		throw std::invalid_argument("password must not be null.");
+	if (request.salt == nullptr && request.saltLength > 0)
+		throw std::invalid_argument("salt must not be null.");
+	if (request.derivedKey == nullptr || request.derivedKeyLength == 0)
+		throw std::invalid_argument("derivedKey must be non-empty.");
+	if (request.derivedKeyLength > MaxPbkdf2Length)
+		throw std::invalid_argument("derivedKeyLength must be no more than (2^32 - 1) * 32.");
+}
+
+void ScryptEngine::DeriveKey(const unsigned char* password, size_t passwordLength, const unsigned char* salt, size_t saltLength,
+	unsigned elementLengthMultiplier, unsigned processingCost, unsigned parallelization,
+	unsigned char* derivedKey, size_t derivedKeyLength)
+{
+	ValidateRequest({ password, passwordLength, salt, saltLength, derivedKey, derivedKeyLength });
+	std::vector<unsigned char> data(ValidateParameters(elementLengthMultiplier, processingCost, parallelization));
+
+	try
+	{
+		// both PBKDF2 stages share the password's HMAC state
+		Pbkdf2Sha256 pbkdf2(password, passwordLength);
+
+		{
+			SKRYPTONITE_METRICS_PHASE(Pbkdf2Expand, data.size());
+			pbkdf2.DeriveKey(salt, saltLength, 1, data.data(), data.size());
+		}
+
+		ScryptEngine engine(data.data(), data.size(), parallelization, processingCost);
+		engine.SMixRange(0, parallelization);
+
+		{
+			SKRYPTONITE_METRICS_PHASE(Pbkdf2Compress, data.size());
+			pbkdf2.DeriveKey(data.data(), data.size(), 1, derivedKey, derivedKeyLength);
+		}
+	}
+	catch (...)
+	{
+		SKRYPTONITE_METRICS_COUNT(DerivationFailures, 1);
+		SecureErase(data.data(), data.size());
+		throw;
+	}
+
+	SecureErase(data.data(), data.size());
+}
+
+void ScryptEngine::DeriveKeys(const ScryptRequest* requests, unsigned requestCount,
+	unsigned elementLengthMultiplier, unsigned processingCost, unsigned parallelization, unsigned threadCount,
+	Skryptonite::Native::CachePolicy cachePolicy, unsigned tradeOffFactor)
+{
+	if (requests == nullptr && requestCount > 0)
+		throw std::invalid_argument("requests must not be null.");
+
+	size_t dataLength = ValidateParameters(elementLengthMultiplier, processingCost, parallelization);
+
+	for (unsigned i = 0; i < requestCount; i++)
+		ValidateRequest(requests[i]);
+
+	if (requestCount == 0)
+		return;
+	if ((std::numeric_limits<size_t>::max)() / requestCount < dataLength)
+		throw std::invalid_argument("The data of all requests must fit in addressable memory.");
+
+	std::vector<unsigned char> data(dataLength * requestCount);
+
+	try
+	{
+		std::vector<std::unique_ptr<ScryptEngine>> engines(requestCount);
+
+		for (unsigned i = 0; i < requestCount; i++)
+		{
+			engines[i] = std::make_unique<ScryptEngine>(&data[dataLength * i], dataLength, parallelization, processingCost);
+			engines[i]->SetCachePolicy(cachePolicy);
+			engines[i]->SetTradeOffFactor(tradeOffFactor);
+
+			// the elements of every request are mixed together, so a batch takes the lane path even when p is 1
+			engines[i]->SetInstructionSet(Autotuner::InstructionSetFor(elementLengthMultiplier, processingCost,
+				(std::max)(requestCount, parallelization)));
+		}
+
+		// the elements of every request are laid out request by request, and consecutive runs of LaneCount are mixed together
+		unsigned laneCount = engines[0]->_laneCount;
+		if ((std::numeric_limits<unsigned>::max)() / laneCount < processingCost)
+			laneCount = 1;
+
+		unsigned long long unitCount = static_cast<unsigned long long>(requestCount) * parallelization;
+		size_t groupCount = static_cast<size_t>((unitCount + laneCount - 1) / laneCount);
+
+		// each request's PBKDF2 stages share its password's HMAC state
+		std::vector<std::unique_ptr<Pbkdf2Sha256>> pbkdf2s(requestCount);
+
+		ThreadPool::Global().Run(requestCount, threadCount, [&](size_t i)
+		{
+			SKRYPTONITE_METRICS_PHASE(Pbkdf2Expand, dataLength);
+			pbkdf2s[i] = std::make_unique<Pbkdf2Sha256>(requests[i].password, requests[i].passwordLength);
+			pbkdf2s[i]->DeriveKey(requests[i].salt, requests[i].saltLength, 1, &data[dataLength * i], dataLength);
+		});
+
+		ThreadPool::Global().Run(groupCount, threadCount, [&](size_t group)
+		{
+			ScryptEngine* laneEngines[MaxLaneCount];
+			unsigned elementIndices[MaxLaneCount];
+			unsigned long long first = static_cast<unsigned long long>(group) * laneCount;
+			unsigned count = static_cast<unsigned>((std::min)(static_cast<unsigned long long>(laneCount), unitCount - first));
+
+			for (unsigned k = 0; k < count; k++)
+			{
+				laneEngines[k] = engines[static_cast<size_t>((first + k) / parallelization)].get();
+				elementIndices[k] = static_cast<unsigned>((first + k) % parallelization);
+			}
+
+			SMixLanes(laneEngines, elementIndices, count);
+		});
+
+		ThreadPool::Global().Run(requestCount, threadCount, [&](size_t i)
+		{
+			SKRYPTONITE_METRICS_PHASE(Pbkdf2Compress, dataLength);
+			pbkdf2s[i]->DeriveKey(&data[dataLength * i], dataLength, 1, requests[i].derivedKey, requests[i].derivedKeyLength);
+		});
+	}
+	catch (...)
+	{
+		SKRYPTONITE_METRICS_COUNT(DerivationFailures, requestCount);
+		SecureErase(data.data(), data.size());
+		throw;
+	}
+
+	SecureErase(data.data(), data.size());
+}
+
+void ScryptEngine::MixLanes(SalsaBlock* const* elements, unsigned count)
+{
+	_ASSERT(elements != nullptr);
+	_ASSERT(count > 0 && count <= _laneCount);
+
+	if (PrepareLanes == nullptr)
+	{
+		MixInterleaved(elements, count);
+		return;
+	}
+
+	// a group larger than the whole budget would be refused rather than wait, so it is mixed in smaller groups that fit
+	unsigned fittingCount = FittingElementCount(count);
+	if (fittingCount < count)
+	{
+		for (unsigned i = 0; i < count; i += fittingCount)
+		{
+			unsigned partCount = (std::min)(fittingCount, count - i);
+
+			// a single element is cheaper on its own than in a lane of an otherwise idle kernel
+			if (partCount == 1)
+				MixInterleaved(elements + i, 1);
+			else
+				MixLanes(elements + i, partCount);
+		}
+
+		return;
+	}
+
+	SalsaBlock* sources[MaxLaneCount];
+	SalsaBlock* destinations[MaxLaneCount];
+	unsigned laneOffsets[MaxLaneCount];
+
+	for (unsigned k = 0; k < _laneCount; k++)
+	{
+		bool isUsed = k < count;
+
+		sources[k] = elements[isUsed ? k : 0];
+		destinations[k] = isUsed ? elements[k] : nullptr;
+		laneOffsets[k] = (isUsed ? k : 0) * _processingCost;
+	}
+
+	MemoryReservation reservation(MemoryBudget::Global(), ReservationLength(count));
+	ScryptElementPtr workingBuffer;
+	ScryptElementPtr shuffleBuffer;
+	ScryptBlockPtr scryptBlock;
+
+	try
+	{
+		workingBuffer = std::make_unique<ScryptElement>(_salsaBlockCountPerElement * _laneCount, _processingCost);
+		shuffleBuffer = std::make_unique<ScryptElement>(_salsaBlockCountPerElement * _laneCount, _processingCost);
+		scryptBlock = std::make_unique<ScryptBlock>(_salsaBlockCountPerElement, _processingCost * count);
+	}
+	catch (const std::out_of_range&)
+	{
+		// the lanes are too large to mix at once
+		throw std::bad_alloc();
+	}
+
+	PrepareLanes(workingBuffer, sources);
+	FillScryptBlockLanes(workingBuffer, scryptBlock, laneOffsets, shuffleBuffer);
+	MixWithScryptBlockLanes(workingBuffer, scryptBlock, laneOffsets, shuffleBuffer);
+	RestoreLanes(destinations, workingBuffer);
+}
+
+void ScryptEngine::MixInterleaved(SalsaBlock* const* elements, unsigned count)
+{
+	_ASSERT(elements != nullptr);
+	_ASSERT(count > 0 && count <= MaxInterleaveCount);
+
+	unsigned fittingCount = FittingElementCount(count);
+	if (fittingCount < count)
+	{
+		for (unsigned i = 0; i < count; i += fittingCount)
+			MixInterleaved(elements + i, (std::min)(fittingCount, count - i));
+
+		return;
+	}
+
+	// one reservation for every chain, so a thread never holds the memory of some chains while waiting for the rest
+	MemoryReservation reservation(MemoryBudget::Global(), ReservationLength(count));
+	ScryptElementPtr workingBuffers[MaxInterleaveCount];
+	ScryptElementPtr shuffleBuffers[MaxInterleaveCount];
+	ScryptElementPtr rebuildBuffers[MaxInterleaveCount];
+	ScryptElementPtr rebuildShuffleBuffers[MaxInterleaveCount];
+	ScryptBlockPtr scryptBlocks[MaxInterleaveCount];
+	unsigned indices[MaxInterleaveCount];
+
+	for (unsigned k = 0; k < count; k++)
+	{
+		workingBuffers[k] = std::make_unique<ScryptElement>(_salsaBlockCountPerElement, _processingCost);
+		shuffleBuffers[k] = std::make_unique<ScryptElement>(_salsaBlockCountPerElement, _processingCost);
+		scryptBlocks[k] = std::make_unique<ScryptBlock>(_salsaBlockCountPerElement, StoredElementCount());
+
+		if (_tradeOffFactor > 1)
+		{
+			rebuildBuffers[k] = std::make_unique<ScryptElement>(_salsaBlockCountPerElement, _processingCost);
+			rebuildShuffleBuffers[k] = std::make_unique<ScryptElement>(_salsaBlockCountPerElement, _processingCost);
+		}
+	}
+
+	// the large memory blocks are written sequentially, so filling them does not stall
+	{
+		SKRYPTONITE_METRICS_PHASE(FillScryptBlock, static_cast<unsigned long long>(sizeof(SalsaBlock)) * _salsaBlockCountPerElement * StoredElementCount() * count);
+
+		for (unsigned i = 0; i < _processingCost; i++)
+			for (unsigned k = 0; k < count; k++)
+				FillScryptBlockStep(i, elements[k], workingBuffers[k], scryptBlocks[k], shuffleBuffers[k]);
+	}
+
+	SKRYPTONITE_METRICS_PHASE(MixWithScryptBlock, static_cast<unsigned long long>(sizeof(SalsaBlock)) * _salsaBlockCountPerElement * _processingCost * count);
+
+	// each chain requests the kept element it needs next and yields to the others until it arrives
+	for (unsigned k = 0; k < count; k++)
+	{
+		indices[k] = workingBuffers[k]->Integerify();
+		PrefetchElement((*scryptBlocks[k])[indices[k] / _tradeOffFactor]);
+	}
+
+	for (unsigned i = 0; i < _processingCost; i++)
+	{
+		for (unsigned k = 0; k < count; k++)
+		{
+			SalsaBlock* source = LoadScryptBlockElement(indices[k], scryptBlocks[k], rebuildBuffers[k], rebuildShuffleBuffers[k]);
+			MixWithScryptBlockStep(i, elements[k], workingBuffers[k], source, indices[k] % _tradeOffFactor > 0, shuffleBuffers[k]);
+
+			if (i + 1 < _processingCost)
+			{
+				indices[k] = workingBuffers[k]->Integerify();
+				PrefetchElement((*scryptBlocks[k])[indices[k] / _tradeOffFactor]);
+			}
+		}
+	}
+}
+
+unsigned ScryptEngine::FittingElementCount(unsigned count) const
+{
+	unsigned long long limit = MemoryBudget::Global().Limit();
+
+	if (limit == 0 || ReservationLength(count) <= limit)
+		return count;
+
+	// an element larger than the whole limit is left for its own reservation to refuse
+	return static_cast<unsigned>((std::max)(1ull, limit / ReservationLength(1)));
+}
+
+void ScryptEngine::PrefetchElement(SalsaBlock* element) const
+{
+	if (_activeCachePolicy == CachePolicy::Cached)
+	{
+		for (unsigned i = 0; i < _salsaBlockCountPerElement; i++)
+			ScryptCommon::Prefetch(element + i);
+	}
+	else
+	{
+		for (unsigned i = 0; i < _salsaBlockCountPerElement; i++)
+			ScryptCommon::PrefetchNonTemporal(element + i);
+	}
+}
+
+void ScryptEngine::FillScryptBlock(SalsaBlock* source, ScryptElementPtr& workingBuffer, const ScryptBlockPtr& scryptBlock, ScryptElementPtr& shuffleBuffer)
+{
+	_ASSERT(source != nullptr);
+	_ASSERT(workingBuffer != nullptr);
+	_ASSERT(scryptBlock != nullptr);
+	_ASSERT(shuffleBuffer != nullptr);
+	_ASSERT(workingBuffer->BlockCount() == shuffleBuffer->BlockCount());
+	_ASSERT(scryptBlock->ElementCount() == StoredElementCount());
+	SKRYPTONITE_METRICS_PHASE(FillScryptBlock, static_cast<unsigned long long>(sizeof(SalsaBlock)) * _salsaBlockCountPerElement * StoredElementCount());
+
+	for (unsigned i = 0; i < _processingCost; i++)
+		FillScryptBlockStep(i, source, workingBuffer, scryptBlock, shuffleBuffer);
+}
+
+void ScryptEngine::FillScryptBlockStep(unsigned index, SalsaBlock* source, ScryptElementPtr& workingBuffer, const ScryptBlockPtr& scryptBlock, ScryptElementPtr& shuffleBuffer)
+{
+	_ASSERT(index < _processingCost);
+
+	if (_activeCachePolicy == CachePolicy::Cached && _tradeOffFactor == 1)
+	{
+		// the previous element is still in the cache, so mix it from there straight into the next one
+		SalsaBlock* destination = index + 1 < _processingCost ? (*scryptBlock)[index + 1] : workingBuffer->Data();
+
+		if (index == 0)
+			PrepareCopyAndMixBlocks((*scryptBlock)[0], source, destination, _salsaBlockCountPerElement);
+		else
+			MixBlocksInto(destination, (*scryptBlock)[index], _salsaBlockCountPerElement);
+	}
+	else
+	{
+		// the first pass arranges the element as it reads it
+		if (index == 0)
+		{
+			PrepareCopyAndMixBlocks((*scryptBlock)[0], source, workingBuffer->Data(), _salsaBlockCountPerElement);
+		}
+		else if (index % _tradeOffFactor == 0)
+		{
+			CopyAndMixBlocks((*scryptBlock)[index / _tradeOffFactor], workingBuffer, shuffleBuffer);
+		}
+		else
+		{
+			// the time-memory trade-off drops this element, so it is only mixed
+			MixBlocksInto(shuffleBuffer->Data(), workingBuffer->Data(), _salsaBlockCountPerElement);
+			workingBuffer.swap(shuffleBuffer);
+		}
+	}
+}
+
+void ScryptEngine::MixWithScryptBlock(SalsaBlock* destination, ScryptElementPtr& workingBuffer, const ScryptBlockPtr& scryptBlock, ScryptElementPtr& shuffleBuffer,
+	ScryptElementPtr& rebuildBuffer, ScryptElementPtr& rebuildShuffleBuffer)
+{
+	_ASSERT(destination != nullptr);
+	_ASSERT(workingBuffer != nullptr);
+	_ASSERT(scryptBlock != nullptr);
+	_ASSERT(shuffleBuffer != nullptr);
+	_ASSERT(workingBuffer->BlockCount() == shuffleBuffer->BlockCount());
+	_ASSERT(workingBuffer->IntegerifyDivisor() == _processingCost);
+	_ASSERT(shuffleBuffer->IntegerifyDivisor() == _processingCost);
+	_ASSERT(scryptBlock->ElementCount() == StoredElementCount());
+	_ASSERT(_tradeOffFactor == 1 || (rebuildBuffer != nullptr && rebuildShuffleBuffer != nullptr));
+	SKRYPTONITE_METRICS_PHASE(MixWithScryptBlock, static_cast<unsigned long long>(sizeof(SalsaBlock)) * _salsaBlockCountPerElement * _processingCost);
+
+	for (unsigned i = 0; i < _processingCost; i++)
+	{
+		unsigned j = workingBuffer->Integerify();
+		SalsaBlock* xorSource = LoadScryptBlockElement(j, scryptBlock, rebuildBuffer, rebuildShuffleBuffer);
+		MixWithScryptBlockStep(i, destination, workingBuffer, xorSource, j % _tradeOffFactor > 0, shuffleBuffer);
+	}
+}
+
+void ScryptEngine::MixWithScryptBlockStep(unsigned index, SalsaBlock* destination, ScryptElementPtr& workingBuffer, SalsaBlock* xorSource, bool isRebuilt, ScryptElementPtr& shuffleBuffer)
+{
+	_ASSERT(index < _processingCost);
+
+	if (index + 1 < _processingCost)
+	{
+		if (isRebuilt)
+			XorAndMixRebuiltBlocks(workingBuffer, xorSource, shuffleBuffer);
+		else
+			XorAndMixBlocks(workingBuffer, xorSource, shuffleBuffer);
+	}
+	else
+	{
+		// the last pass restores the original ordering as it writes the result
+		if (isRebuilt)
+			XorMixAndRestoreRebuiltBlocks(destination, workingBuffer, xorSource);
+		else
+			XorMixAndRestoreBlocks(destination, workingBuffer, xorSource);
+	}
+}
+
+SalsaBlock* ScryptEngine::LoadScryptBlockElement(unsigned index, const ScryptBlockPtr& scryptBlock, ScryptElementPtr& rebuildBuffer, ScryptElementPtr& rebuildShuffleBuffer)
+{
+	_ASSERT(index < _processingCost);
+
+	SalsaBlock* keptElement = (*scryptBlock)[index / _tradeOffFactor];
+	unsigned rebuildCount = index % _tradeOffFactor;
+
+	if (rebuildCount == 0)
+		return keptElement;
+
+	_ASSERT(rebuildBuffer != nullptr);
+	_ASSERT(rebuildShuffleBuffer != nullptr);
+
+	// each dropped element is the kept element before it mixed once per step in between
+	MixBlocksInto(rebuildBuffer->Data(), keptElement, _salsaBlockCountPerElement);
+
+	for (unsigned i = 1; i < rebuildCount; i++)
+	{
+		MixBlocksInto(rebuildShuffleBuffer->Data(), rebuildBuffer->Data(), _salsaBlockCountPerElement);
+		rebuildBuffer.swap(rebuildShuffleBuffer);
+	}
+
+	return rebuildBuffer->Data();
+}
+
+void ScryptEngine::FillScryptBlockLanes(ScryptElementPtr& workingBuffer, const ScryptBlockPtr& scryptBlock, const unsigned* laneOffsets, ScryptElementPtr& shuffleBuffer)
+{
+	_ASSERT(workingBuffer != nullptr);
+	_ASSERT(scryptBlock != nullptr);
+	_ASSERT(shuffleBuffer != nullptr);
+	_ASSERT(laneOffsets != nullptr);
+	_ASSERT(workingBuffer->BlockCount() == shuffleBuffer->BlockCount());
+	SKRYPTONITE_METRICS_PHASE(FillScryptBlock, static_cast<unsigned long long>(sizeof(SalsaBlock)) * workingBuffer->BlockCount() * _processingCost);
+
+	SalsaBlock* destinations[MaxLaneCount];
+
+	for (unsigned i = 0; i < _processingCost; i++)
+	{
+		for (unsigned k = 0; k < _laneCount; k++)
+			destinations[k] = (*scryptBlock)[laneOffsets[k] + i];
+
+		CopyAndMixLanes(destinations, workingBuffer, shuffleBuffer);
+	}
+}
+
+void ScryptEngine::MixWithScryptBlockLanes(ScryptElementPtr& workingBuffer, const ScryptBlockPtr& scryptBlock, const unsigned* laneOffsets, ScryptElementPtr& shuffleBuffer)
+{
+	_ASSERT(workingBuffer != nullptr);
+	_ASSERT(scryptBlock != nullptr);
+	_ASSERT(shuffleBuffer != nullptr);
+	_ASSERT(laneOffsets != nullptr);
+	_ASSERT(workingBuffer->BlockCount() == shuffleBuffer->BlockCount());
+	_ASSERT(workingBuffer->IntegerifyDivisor() == _processingCost);
+	SKRYPTONITE_METRICS_PHASE(MixWithScryptBlock, static_cast<unsigned long long>(sizeof(SalsaBlock)) * workingBuffer->BlockCount() * _processingCost);
+
+	unsigned indices[MaxLaneCount];
+	SalsaBlock* sources[MaxLaneCount];
+
+	for (unsigned i = 0; i < _processingCost; i++)
+	{
+		IntegerifyLanes(indices, workingBuffer);
+
+		for (unsigned k = 0; k < _laneCount; k++)
+			sources[k] = (*scryptBlock)[laneOffsets[k] + indices[k]];
+
+		XorAndMixLanes(workingBuffer, sources, shuffleBuffer);
+	}
+}
+
+void ScryptEngine::EraseBuffer()
+{
+	SecureErase(_data, _length);
+}
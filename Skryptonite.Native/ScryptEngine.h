@@ -0,0 +1,729 @@
+/**
+* Skryptonite - Scrypt library for UWP
+* Copyright © 2016 Nicholas C. Bauer, Ph.D.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#pragma once
+#include "SalsaBlock.h"
+#include "ScryptElement.h"
+#include "ScryptBlock.h"
+#include "DetectInstructionSet.h"
+#include "CachePolicy.h"
+#include "MemoryBudget.h"
+#include <atomic>
+#include <mutex>
+#include <string>
+
+namespace Skryptonite
+{
+	namespace Native
+	{
+		/**
+		<summary>One password and salt pair of a batch derivation, with the memory that receives its derived key.</summary>
+		*/
+		struct ScryptRequest
+		{
+			const unsigned char* password;
+			size_t passwordLength;
+			const unsigned char* salt;
+			size_t saltLength;
+			unsigned char* derivedKey;
+			size_t derivedKeyLength;
+		};
+
+		/**
+		<summary>The memory SMix of one element needs when the caller provides it.</summary>
+		*/
+		struct ScratchRequirements
+		{
+			/**
+			<summary>The bytes of the large memory block, 128 * r * N, less under the time-memory trade-off.</summary>
+			*/
+			size_t largeMemoryBlockLength;
+
+			/**
+			<summary>The bytes of each working buffer, 128 * r.</summary>
+			*/
+			size_t bufferLength;
+
+			/**
+			<summary>The number of working buffers: the working and shuffle buffers, plus two rebuild buffers under the time-memory
+			trade-off.</summary>
+			*/
+			unsigned bufferCount;
+
+			/**
+			<summary>The alignment every region must have, in bytes.</summary>
+			*/
+			size_t alignment;
+
+			/**
+			<summary>The bytes of one aligned region that holds every other region back to back.</summary>
+			*/
+			size_t totalLength;
+		};
+
+		/**
+		<summary>Caller-owned memory for SMix of one element. The regions must not overlap, must be aligned as
+		<see cref="ScratchRequirements"/> says, and must not be used by anything else during the SMix.</summary>
+		*/
+		struct ScryptScratch
+		{
+			void* largeMemoryBlock;
+			void* workingBuffer;
+			void* shuffleBuffer;
+
+			/**
+			<summary>Needed only under the time-memory trade-off; may be null otherwise.</summary>
+			*/
+			void* rebuildBuffer;
+
+			/**
+			<summary>Needed only under the time-memory trade-off; may be null otherwise.</summary>
+			*/
+			void* rebuildShuffleBuffer;
+		};
+
+		class SMixState;
+
+		/**
+		<summary>Encapsulates the core Scrypt algorithm over caller-owned memory, independent of the Windows Runtime.</summary>
+		*/
+		class ScryptEngine
+		{
+			// performs the steps of SMix one at a time
+			friend class SMixState;
+
+			// validates derivations when they are submitted rather than when they run
+			friend class DerivationQueue;
+
+			// validates derivations before looking them up
+			friend class DerivationCache;
+
+		public:
+			/**
+			<summary>Inititializes the algorithm.</summary>
+			<param name="data">The data generated by PBKDF2 to process. Must remain valid for the lifetime of this object.</param>
+			<param name="length">The length of <paramref name="data"/> in bytes.</param>
+			<param name="elementsCount">The number of independent SMix elements the data is divided into.</param>
+			<param name="processingCost">The number of elements to use in the large memory block and the number of
+			random jumps through the large memory block.</param>
+			<exception cref="std::invalid_argument">Thrown when <paramref name="data"/> is null or 0 length, when
+			<paramref name="elementsCount"/> or <paramref name="processingCost"/> are 0, or when <paramref name="length"/>
+			is not a multiple of 128 * elementsCount, or if an overflow would occur.</exception>
+			*/
+			ScryptEngine(unsigned char* data, size_t length, unsigned elementsCount, unsigned processingCost);
+
+			/**
+			<summary>Performs SMix on the given element of the data.</summary>
+			<param name="elementIndex">The element index to mix.</param>
+			<exception cref="std::invalid_argument">Thrown when <paramref name="elementIndex"/> is greater than or equal to
+			<see cref="ElementsCount"/>.</exception>
+			<remarks>
+			The large memory block is kept in a file in <see cref="StorageDirectory"/> when one is set.
+			</remarks>
+			<exception cref="std::bad_alloc">Thrown when the working memory cannot be allocated or reserved from
+			<see cref="MemoryBudget::Global"/>, or when there is not enough storage for the file.</exception>
+			<exception cref="std::runtime_error">Thrown when the file cannot be created or mapped.</exception>
+			*/
+			void SMix(unsigned elementIndex);
+
+			/**
+			<summary>Performs SMix on the given element of the data in caller-provided memory, without allocating anything.</summary>
+			<param name="elementIndex">The element index to mix.</param>
+			<param name="scratch">The regions to mix in, sized by <see cref="ScratchRequirementsFor"/> with this engine's
+			parameters and time-memory trade-off factor.</param>
+			<remarks>
+			The memory is not reserved from <see cref="MemoryBudget::Global"/>, and it is left holding intermediate values of the
+			derivation, so the caller should erase it before reusing it for anything else. One element is mixed at a time; the
+			multi-buffer kernel is not used.
+			</remarks>
+			<exception cref="std::invalid_argument">Thrown when <paramref name="elementIndex"/> is greater than or equal to
+			<see cref="ElementsCount"/>, or when a region that is needed is null or misaligned.</exception>
+			*/
+			void SMix(unsigned elementIndex, const ScryptScratch& scratch);
+
+			/**
+			<summary>Gets the memory SMix of one element needs when the caller provides it.</summary>
+			<param name="elementLengthMultiplier">The block size parameter r.</param>
+			<param name="processingCost">The CPU/memory cost parameter N.</param>
+			<param name="tradeOffFactor">The time-memory trade-off factor k.</param>
+			<exception cref="std::invalid_argument">Thrown when a parameter is 0 or the memory exceeds addressable memory.</exception>
+			*/
+			static ScratchRequirements ScratchRequirementsFor(unsigned elementLengthMultiplier, unsigned processingCost,
+				unsigned tradeOffFactor);
+
+			/**
+			<summary>Divides one region into the regions of <see cref="ScryptScratch"/>, skipping bytes at the start as needed to
+			align it.</summary>
+			<param name="region">The region, which need not be aligned.</param>
+			<param name="length">The length of <paramref name="region"/> in bytes. It must be at least
+			<see cref="ScratchRequirements::totalLength"/> plus the bytes skipped to align it, which are fewer than
+			<see cref="ScratchRequirements::alignment"/>.</param>
+			<param name="requirements">The requirements to divide the region by.</param>
+			<returns>The regions.</returns>
+			<exception cref="std::invalid_argument">Thrown when <paramref name="region"/> is null or too short.</exception>
+			*/
+			static ScryptScratch PartitionScratch(void* region, size_t length, const ScratchRequirements& requirements);
+
+			/**
+			<summary>Gets the memory SMix of one element of this engine needs when the caller provides it, with its current
+			time-memory trade-off factor.</summary>
+			*/
+			ScratchRequirements ElementScratchRequirements() const
+			{
+				return ScratchRequirementsFor(_salsaBlockCountPerElement / 2, _processingCost, _tradeOffFactor);
+			}
+
+			/**
+			<summary>Performs SMix on a contiguous range of elements of the data, processing them several at a time when the
+			instruction set allows.</summary>
+			<param name="firstElementIndex">The index of the first element to mix.</param>
+			<param name="count">The number of elements to mix.</param>
+			<remarks>
+			Elements are processed in groups of <see cref="LaneCount"/> by the multi-buffer kernel. Any remainder smaller than
+			<see cref="LaneCount"/> is processed one element at a time with <see cref="SMix"/>, except that interleaved chains
+			take the remainder together.
+			</remarks>
+			<exception cref="std::invalid_argument">Thrown when the range extends past <see cref="ElementsCount"/>.</exception>
+			<exception cref="std::bad_alloc">Thrown when the working memory cannot be allocated.</exception>
+			*/
+			void SMixRange(unsigned firstElementIndex, unsigned count);
+
+			/**
+			<summary>Performs SMix on every element of the data, spreading them over the threads of <see cref="ThreadPool::Global"/>.</summary>
+			<param name="threadCount">The largest number of threads to use, including the calling thread, or 0 to use all of them.</param>
+			<remarks>
+			Full groups of <see cref="LaneCount"/> elements are mixed together as by <see cref="SMixRange"/>, and the remaining
+			elements are mixed one per thread, so the whole of the work for p elements is scheduled by one call.
+			</remarks>
+			<exception cref="std::bad_alloc">Thrown when the working memory cannot be allocated.</exception>
+			*/
+			void SMixAll(unsigned threadCount);
+
+			/**
+			<summary>Performs SMix on one element from each of several independent engines at once.</summary>
+			<param name="engines">The engines containing the elements to mix. All must share the same element length and processing cost.</param>
+			<param name="elementIndices">The index of the element to mix within the corresponding engine.</param>
+			<param name="count">The number of entries in <paramref name="engines"/> and <paramref name="elementIndices"/>.</param>
+			<remarks>
+			Allows elements of separate derivations with the same parameters to share the multi-buffer kernel. The same element
+			must not appear more than once.
+			</remarks>
+			<exception cref="std::invalid_argument">Thrown when the arrays are null or empty, when more than <see cref="LaneCount"/>
+			elements are given, when the engines do not share parameters, or when an element index is out of range.</exception>
+			<exception cref="std::bad_alloc">Thrown when the working memory cannot be allocated.</exception>
+			*/
+			static void SMixLanes(ScryptEngine* const* engines, const unsigned* elementIndices, unsigned count);
+
+			/**
+			<summary>Computes a complete Scrypt key derivation as described in RFC 7914.</summary>
+			<param name="password">The password. May be null when <paramref name="passwordLength"/> is 0.</param>
+			<param name="passwordLength">The length of the password in bytes.</param>
+			<param name="salt">The salt. May be null when <paramref name="saltLength"/> is 0.</param>
+			<param name="saltLength">The length of the salt in bytes.</param>
+			<param name="elementLengthMultiplier">The block size parameter r.</param>
+			<param name="processingCost">The CPU/memory cost parameter N.</param>
+			<param name="parallelization">The parallelization parameter p.</param>
+			<param name="derivedKey">Receives the derived key.</param>
+			<param name="derivedKeyLength">The length of the derived key in bytes.</param>
+			<exception cref="std::invalid_argument">Thrown when a parameter is 0, when a required pointer is null, or when
+			the parameters are too large.</exception>
+			<exception cref="std::bad_alloc">Thrown when the working memory cannot be allocated.</exception>
+			*/
+			static void DeriveKey(const unsigned char* password, size_t passwordLength, const unsigned char* salt, size_t saltLength,
+				unsigned elementLengthMultiplier, unsigned processingCost, unsigned parallelization,
+				unsigned char* derivedKey, size_t derivedKeyLength);
+
+			/**
+			<summary>Computes several Scrypt key derivations that share parameters, spreading their work over several threads.</summary>
+			<param name="requests">The password and salt pairs to derive keys from.</param>
+			<param name="requestCount">The number of entries in <paramref name="requests"/>.</param>
+			<param name="elementLengthMultiplier">The block size parameter r.</param>
+			<param name="processingCost">The CPU/memory cost parameter N.</param>
+			<param name="parallelization">The parallelization parameter p.</param>
+			<param name="threadCount">The largest number of threads to use, or 0 to use one per hardware thread.</param>
+			<param name="cachePolicy">How the large memory blocks are treated by the cache.</param>
+			<param name="tradeOffFactor">The time-memory trade-off factor, as for <see cref="SetTradeOffFactor"/>.</param>
+			<remarks>
+			Every request is split into its p SMix elements, and the elements of all requests are mixed in groups of
+			<see cref="LaneCount"/> regardless of which request they belong to. Even with p = 1, a batch keeps every thread
+			and every lane busy. Only <paramref name="threadCount"/> large memory blocks are allocated at any time.
+			</remarks>
+			<exception cref="std::invalid_argument">Thrown when <paramref name="requests"/> is null, when a request or parameter is
+			invalid as for <see cref="DeriveKey"/>, or when <paramref name="tradeOffFactor"/> is 0.</exception>
+			<exception cref="std::bad_alloc">Thrown when the working memory cannot be allocated.</exception>
+			*/
+			static void DeriveKeys(const ScryptRequest* requests, unsigned requestCount,
+				unsigned elementLengthMultiplier, unsigned processingCost, unsigned parallelization, unsigned threadCount,
+				Skryptonite::Native::CachePolicy cachePolicy = DefaultCachePolicy(), unsigned tradeOffFactor = DefaultTradeOffFactor());
+
+			/**
+			<summary>Erases the data.</summary>
+			<remarks>Should be called after finishing Scrypt and deriving the final key.</remarks>
+			*/
+			void EraseBuffer();
+
+			/**
+			<summary>Gets the number of independent elements present in the data.</summary>
+			*/
+			unsigned ElementsCount() const { return _elementsCount; }
+
+			/**
+			<summary>Gets the number of elements this engine mixes at once: the lanes of the multi-buffer kernel when the instruction
+			set has one and every element is kept, otherwise <see cref="InterleaveCount"/> at the time the engine was created, or 1
+			when the large memory blocks are kept in files.</summary>
+			*/
+			unsigned LaneCount() const { return _laneCount; }
+
+			/**
+			<summary>Gets the number of independent SMix chains one thread interleaves when no multi-buffer kernel is available.</summary>
+			<remarks>
+			Each chain prefetches the element of the large memory block it reads next and then lets the other chains mix while that
+			element arrives from memory, hiding latency when the large memory block is much larger than the caches. Every chain
+			needs its own large memory block, so this multiplies the memory used per thread. 1, the default, disables interleaving.
+			</remarks>
+			*/
+			static unsigned InterleaveCount();
+
+			/**
+			<summary>Sets the number of independent SMix chains one thread interleaves when no multi-buffer kernel is available.</summary>
+			<param name="value">The number of chains, between 1 and <see cref="MaxInterleaveCount"/>. Affects engines created afterwards.</param>
+			<exception cref="std::invalid_argument">Thrown when <paramref name="value"/> is out of range.</exception>
+			*/
+			static void SetInterleaveCount(unsigned value);
+
+			/**
+			<summary>The largest number of chains that can be interleaved.</summary>
+			*/
+			static const unsigned MaxInterleaveCount = 8;
+
+			/**
+			<summary>The alignment, in bytes, of every region of caller-provided scratch memory.</summary>
+			*/
+			static const size_t ScratchAlignment = 64;
+
+			/**
+			<summary>Gets the instruction set whose kernels this engine mixes with.</summary>
+			*/
+			Skryptonite::Native::InstructionSet ActiveInstructionSet() const { return _instructionSet; }
+
+			/**
+			<summary>Sets the instruction set whose kernels this engine mixes with.</summary>
+			<param name="value">The instruction set. Engines start with the one <see cref="Autotuner"/> measured fastest for their
+			parameters, when it has, otherwise with <see cref="CpuFeatures::MaxInstructionSet"/>.</param>
+			<remarks>
+			Setting a level not supported by the current system may result in exceptions. Must not be called while the engine is mixing.
+			</remarks>
+			*/
+			void SetInstructionSet(Skryptonite::Native::InstructionSet value);
+
+			/**
+			<summary>Gets the cache policy new engines start with.</summary>
+			*/
+			static Skryptonite::Native::CachePolicy DefaultCachePolicy();
+
+			/**
+			<summary>Sets the cache policy new engines start with.</summary>
+			<param name="value">The policy. Affects engines created afterwards.</param>
+			*/
+			static void SetDefaultCachePolicy(Skryptonite::Native::CachePolicy value);
+
+			/**
+			<summary>Gets the cache policy requested for this engine, which may be <see cref="CachePolicy::Automatic"/>.</summary>
+			*/
+			Skryptonite::Native::CachePolicy RequestedCachePolicy() const { return _requestedCachePolicy; }
+
+			/**
+			<summary>Gets the cache policy this engine actually mixes with, after resolving <see cref="CachePolicy::Automatic"/> and
+			falling back when the processor lacks CLFLUSHOPT.</summary>
+			*/
+			Skryptonite::Native::CachePolicy ActiveCachePolicy() const { return _activeCachePolicy; }
+
+			/**
+			<summary>Sets how this engine treats the cache when writing and reading the large memory block.</summary>
+			<param name="value">The policy.</param>
+			<remarks>
+			<see cref="CachePolicy::Automatic"/> caches the large memory block when the blocks one thread mixes at once fill no more
+			than half of the last-level cache, leaving the rest to other threads and data. Must not be called while the engine is mixing.
+			</remarks>
+			*/
+			void SetCachePolicy(Skryptonite::Native::CachePolicy value);
+
+			/**
+			<summary>Gets the time-memory trade-off factor new engines start with.</summary>
+			*/
+			static unsigned DefaultTradeOffFactor();
+
+			/**
+			<summary>Sets the time-memory trade-off factor new engines start with.</summary>
+			<param name="value">The factor. Affects engines created afterwards.</param>
+			<exception cref="std::invalid_argument">Thrown when <paramref name="value"/> is 0.</exception>
+			*/
+			static void SetDefaultTradeOffFactor(unsigned value);
+
+			/**
+			<summary>Gets the time-memory trade-off factor k: the large memory block keeps only every k-th element.</summary>
+			*/
+			unsigned TradeOffFactor() const { return _tradeOffFactor; }
+
+			/**
+			<summary>Sets the time-memory trade-off factor k, so that the large memory block keeps only every k-th element and
+			rebuilds the others from the nearest kept element when they are read.</summary>
+			<param name="value">The factor. 1, the default, keeps every element.</param>
+			<remarks>
+			The output is unchanged. The large memory block shrinks to ceil(processingCost / k) elements, but the element read
+			at each of the processingCost random jumps must first be rebuilt with (k - 1) / 2 extra BlockMix calls on average,
+			so SMix costs about processingCost * (k + 3) / 2 BlockMix calls instead of 2 * processingCost. The multi-buffer
+			kernel is not used when k is greater than 1. Must not be called while the engine is mixing.
+			</remarks>
+			<exception cref="std::invalid_argument">Thrown when <paramref name="value"/> is 0.</exception>
+			*/
+			void SetTradeOffFactor(unsigned value);
+
+			/**
+			<summary>Finds the smallest time-memory trade-off factor whose large memory block fits in a memory budget.</summary>
+			<param name="elementLengthMultiplier">The block size parameter r.</param>
+			<param name="processingCost">The CPU/memory cost parameter N.</param>
+			<param name="maxBytes">The largest number of bytes one large memory block may use.</param>
+			<returns>The factor, 1 when the whole large memory block fits.</returns>
+			<remarks>The budget is per large memory block; every thread and every interleaved chain needs its own.</remarks>
+			<exception cref="std::invalid_argument">Thrown when a parameter is 0 or when <paramref name="maxBytes"/> is smaller
+			than one element of 128 * r bytes.</exception>
+			*/
+			static unsigned TradeOffFactorForMemory(unsigned elementLengthMultiplier, unsigned processingCost, unsigned long long maxBytes);
+
+			/**
+			<summary>Gets the directory new engines keep their large memory blocks in, or an empty string when they keep them in
+			RAM.</summary>
+			*/
+			static std::string DefaultStorageDirectory();
+
+			/**
+			<summary>Sets the directory new engines keep their large memory blocks in.</summary>
+			<param name="value">The directory as UTF-8, or an empty string to keep them in RAM. Affects engines created afterwards.</param>
+			<exception cref="std::runtime_error">Thrown when <paramref name="value"/> is not empty and the platform cannot keep
+			large memory blocks in files.</exception>
+			*/
+			static void SetDefaultStorageDirectory(const std::string& value);
+
+			/**
+			<summary>Gets the directory this engine keeps its large memory blocks in, or an empty string when it keeps them in RAM.</summary>
+			*/
+			const std::string& StorageDirectory() const { return _storageDirectory; }
+
+			/**
+			<summary>Sets the directory this engine keeps its large memory blocks in, as memory-mapped temporary files instead of RAM.</summary>
+			<param name="value">A directory on fast local storage as UTF-8, or an empty string to keep them in RAM, the default.</param>
+			<remarks>
+			For offline derivations whose large memory blocks are larger than the memory available. The output is unchanged. Each
+			element being mixed has its own <see cref="MappedScratch"/> file of 128 * r * ceil(processingCost / k) bytes, and
+			elements are mixed one per thread, so the threads' reads of the files overlap. The files are not counted by the
+			<see cref="MemoryBudget"/>. <see cref="SMixState"/> and caller-provided scratch memory are unaffected. Must not be
+			called while the engine is mixing.
+			</remarks>
+			<exception cref="std::runtime_error">Thrown when <paramref name="value"/> is not empty and the platform cannot keep
+			large memory blocks in files.</exception>
+			*/
+			void SetStorageDirectory(const std::string& value);
+
+		private:
+			static std::atomic<unsigned> _interleaveCount;
+			static std::atomic<Skryptonite::Native::CachePolicy> _defaultCachePolicy;
+			static std::atomic<unsigned> _defaultTradeOffFactor;
+			static std::mutex _defaultStorageDirectoryMutex;
+			static std::string _defaultStorageDirectory;
+
+			SalsaBlock* _data;
+			size_t _length;
+
+			unsigned _elementsCount;
+			unsigned _salsaBlockCountPerElement;
+			unsigned _processingCost;
+			unsigned _laneCount;
+			Skryptonite::Native::InstructionSet _instructionSet;
+			Skryptonite::Native::CachePolicy _requestedCachePolicy;
+			Skryptonite::Native::CachePolicy _activeCachePolicy;
+			unsigned _tradeOffFactor;
+			std::string _storageDirectory;
+
+			/**
+			<summary>Assigns the correct functions based on instruction set and cache policy.</summary>
+			*/
+			void SetFunctions();
+
+			/**
+			<summary>Resolves the requested cache policy for the current lane count and processor.</summary>
+			*/
+			Skryptonite::Native::CachePolicy ResolveCachePolicy() const;
+
+			/**
+			<summary>Gets the number of elements the large memory block keeps under the time-memory trade-off.</summary>
+			*/
+			unsigned StoredElementCount() const { return _processingCost / _tradeOffFactor + (_processingCost % _tradeOffFactor > 0 ? 1 : 0); }
+
+			/**
+			<summary>Gets the bytes of large memory block that mixing the given number of elements at once reserves from the
+			<see cref="MemoryBudget"/>.</summary>
+			*/
+			unsigned long long ReservationLength(unsigned count) const
+			{
+				return static_cast<unsigned long long>(sizeof(SalsaBlock)) * _salsaBlockCountPerElement * StoredElementCount() * count;
+			}
+
+			/**
+			<summary>Obtains an element of the large memory block, rebuilding it from the nearest kept element when the
+			time-memory trade-off did not keep it.</summary>
+			<param name="index">The index of the element, from 0 to processingCost - 1.</param>
+			<param name="scryptBlock">The large memory block.</param>
+			<param name="rebuildBuffer">Receives the rebuilt element. May be null when the trade-off factor is 1.</param>
+			<param name="rebuildShuffleBuffer">A scratch space used internally. May be null when the trade-off factor is 1.</param>
+			<returns>A pointer to the element, inside either <paramref name="scryptBlock"/> or <paramref name="rebuildBuffer"/>.</returns>
+			*/
+			SalsaBlock* LoadScryptBlockElement(unsigned index, const ScryptBlockPtr& scryptBlock, ScryptElementPtr& rebuildBuffer, ScryptElementPtr& rebuildShuffleBuffer);
+
+			/**
+			<summary>Assigns the block mixing functions of a backend specialized for the active cache policy and, for r = 1, 2, 4, 8
+			and 16, for the element length.</summary>
+			*/
+			template<class TBackend>
+			void SetMixFunctions();
+
+			/**
+			<summary>Assigns the block mixing functions of a backend specialized for the active cache policy and an element length.</summary>
+			<typeparam name="fixedBlockCount">The element length in 64-byte blocks, or 0 for the kernels that take any length.</typeparam>
+			*/
+			template<class TBackend, unsigned fixedBlockCount>
+			void SetSizedMixFunctions();
+
+			/**
+			<summary>Assigns the lane mixing functions of a multi-buffer backend specialized for the active cache policy.</summary>
+			*/
+			template<class TBackend>
+			void SetLaneMixFunctions();
+
+			/**
+			<summary>Validates the parameters of a complete derivation.</summary>
+			<returns>The length of the data generated by the first PBKDF2 stage in bytes.</returns>
+			<exception cref="std::invalid_argument">Thrown when a parameter is 0 or the parameters are too large.</exception>
+			*/
+			static size_t ValidateParameters(unsigned elementLengthMultiplier, unsigned processingCost, unsigned parallelization);
+
+			/**
+			<summary>Validates the buffers of a single derivation.</summary>
+			<exception cref="std::invalid_argument">Thrown when a required pointer is null or the derived key length is invalid.</exception>
+			*/
+			static void ValidateRequest(const ScryptRequest& request);
+
+			/**
+			<summary>Performs SMix on an element with its large memory block in a file in <see cref="StorageDirectory"/>, writing
+			the file back as it is filled and reading it with hints suited to random access.</summary>
+			<param name="source">The element of the data, in its original ordering.</param>
+			*/
+			void SMixOutOfCore(SalsaBlock* source);
+
+			/**
+			<summary>Fills the large memory block with data mixed from an element of the data and returns the final mixed buffer.</summary>
+			<param name="source">The element of the data to start from, in its original ordering.</param>
+			<param name="workingBuffer">The element which receives the arranged output.</param>
+			<param name="scryptBlock">The large memory block.</param>
+			<param name="shuffleBuffer">A scratch space used internally.</param>
+			*/
+			void FillScryptBlock(SalsaBlock* source, ScryptElementPtr& workingBuffer, const ScryptBlockPtr& scryptBlock, ScryptElementPtr& shuffleBuffer);
+
+			/**
+			<summary>Computes one element of the large memory block, or the working buffer after the last one.</summary>
+			<param name="index">The index of the element of the large memory block to fill, from 0 to processingCost - 1.</param>
+			<param name="source">The element of the data to start from, in its original ordering.</param>
+			<param name="workingBuffer">The element which receives the arranged output of the last step.</param>
+			<param name="scryptBlock">The large memory block.</param>
+			<param name="shuffleBuffer">A scratch space used internally.</param>
+			<remarks>
+			With <see cref="CachePolicy::Cached"/>, each element is mixed straight from the large memory block into the next one, so
+			the working and shuffle buffers are only used by the last step. The streaming policies write the large memory block past
+			the cache and instead mix in the working buffer, copying its input out to the large memory block, as does every policy
+			when the time-memory trade-off drops elements; dropped elements are only mixed.
+			</remarks>
+			*/
+			void FillScryptBlockStep(unsigned index, SalsaBlock* source, ScryptElementPtr& workingBuffer, const ScryptBlockPtr& scryptBlock, ScryptElementPtr& shuffleBuffer);
+
+			/**
+			<summary>Mixes the working buffer by jumping around the large memory block and stores the result in its original ordering.</summary>
+			<param name="destination">The element of the data which receives the result.</param>
+			<param name="workingBuffer">The element in which the arranged data is input.</param>
+			<param name="scryptBlock">The large memory block.</param>
+			<param name="shuffleBuffer">A scratch space used internally.</param>
+			<param name="rebuildBuffer">Receives elements rebuilt under the time-memory trade-off; may be null without it.</param>
+			<param name="rebuildShuffleBuffer">A scratch space for rebuilding; may be null without the time-memory trade-off.</param>
+			*/
+			void MixWithScryptBlock(SalsaBlock* destination, ScryptElementPtr& workingBuffer, const ScryptBlockPtr& scryptBlock, ScryptElementPtr& shuffleBuffer,
+				ScryptElementPtr& rebuildBuffer, ScryptElementPtr& rebuildShuffleBuffer);
+
+			/**
+			<summary>Performs one random jump of the mixing pass: xors an element of the large memory block into the working buffer and
+			mixes it, storing the result in its original ordering on the last jump.</summary>
+			<param name="index">The index of the jump, from 0 to processingCost - 1.</param>
+			<param name="destination">The element of the data which receives the result of the last jump.</param>
+			<param name="workingBuffer">The element in which the arranged data is input and output.</param>
+			<param name="xorSource">The element of the large memory block to xor in, as returned by <see cref="LoadScryptBlockElement"/>.</param>
+			<param name="isRebuilt">Whether <paramref name="xorSource"/> was rebuilt into scratch memory rather than read from the large memory block.</param>
+			<param name="shuffleBuffer">A scratch space used internally.</param>
+			*/
+			void MixWithScryptBlockStep(unsigned index, SalsaBlock* destination, ScryptElementPtr& workingBuffer, SalsaBlock* xorSource, bool isRebuilt, ScryptElementPtr& shuffleBuffer);
+
+			/**
+			<summary>Performs SMix on up to <see cref="LaneCount"/> elements at once using the multi-buffer kernel, or by interleaving
+			them when the instruction set has none.</summary>
+			<param name="elements">Pointers to the elements to mix in place.</param>
+			<param name="count">The number of valid pointers in <paramref name="elements"/>. Must be between 1 and <see cref="LaneCount"/>.</param>
+			<remarks>
+			Unused lanes repeat the first element and share its large memory block, so they only cost computation. When the
+			elements together need more than the limit of <see cref="MemoryBudget::Global"/>, they are mixed in groups that fit.
+			</remarks>
+			*/
+			void MixLanes(SalsaBlock* const* elements, unsigned count);
+
+			/**
+			<summary>Performs SMix on several elements on one thread, switching between them at every step so that the read of one
+			element's large memory block overlaps with the mixing of the others.</summary>
+			<param name="elements">Pointers to the elements to mix in place.</param>
+			<param name="count">The number of valid pointers in <paramref name="elements"/>. Must be between 1 and <see cref="MaxInterleaveCount"/>.</param>
+			<remarks>When the chains together need more than the limit of <see cref="MemoryBudget::Global"/>, they are mixed in
+			groups that fit.</remarks>
+			*/
+			void MixInterleaved(SalsaBlock* const* elements, unsigned count);
+
+			/**
+			<summary>Gets how many of the given number of elements can be mixed together within the limit of
+			<see cref="MemoryBudget::Global"/>: all of them when they fit, otherwise as many as fit, and at least 1.</summary>
+			*/
+			unsigned FittingElementCount(unsigned count) const;
+
+			/**
+			<summary>Starts loading every 64-byte block of an element of the large memory block into the cache.</summary>
+			*/
+			void PrefetchElement(SalsaBlock* element) const;
+
+			/**
+			<summary>Fills the large memory block of every lane with data mixed from the initial lanes.</summary>
+			<param name="workingBuffer">The lane-sliced element in which the data is input and output.</param>
+			<param name="scryptBlock">The large memory block, holding <see cref="LaneCount"/> consecutive runs of processingCost elements.</param>
+			<param name="laneOffsets">The index of the first element of each lane's run in <paramref name="scryptBlock"/>.</param>
+			<param name="shuffleBuffer">A scratch space used internally.</param>
+			*/
+			void FillScryptBlockLanes(ScryptElementPtr& workingBuffer, const ScryptBlockPtr& scryptBlock, const unsigned* laneOffsets, ScryptElementPtr& shuffleBuffer);
+
+			/**
+			<summary>Mixes every lane of the working buffer by jumping around its own run of the large memory block.</summary>
+			<param name="workingBuffer">The lane-sliced element in which the data is input and output.</param>
+			<param name="scryptBlock">The large memory block, holding <see cref="LaneCount"/> consecutive runs of processingCost elements.</param>
+			<param name="laneOffsets">The index of the first element of each lane's run in <paramref name="scryptBlock"/>.</param>
+			<param name="shuffleBuffer">A scratch space used internally.</param>
+			*/
+			void MixWithScryptBlockLanes(ScryptElementPtr& workingBuffer, const ScryptBlockPtr& scryptBlock, const unsigned* laneOffsets, ScryptElementPtr& shuffleBuffer);
+
+
+#pragma region Instruction_Set_Specific_Function_Pointers
+			/**
+			<summary>Loads and optimally arranges the data, copies it into a memory location, and mixes it into another.</summary>
+			<param name="copyDestination">The location to copy the arranged data to.</param>
+			<param name="source">The location from which to load.</param>
+			<param name="mixDestination">The location which receives the mixed data.</param>
+			<param name="blockCount">The length of an element in 64-byte blocks.</param>
+			*/
+			void(*PrepareCopyAndMixBlocks)(SalsaBlock* copyDestination, SalsaBlock* source, SalsaBlock* mixDestination, unsigned blockCount);
+
+			/**
+			<summary>Mixes optimally arranged data from one memory location into another without copying it.</summary>
+			<param name="destination">The location which receives the mixed data.</param>
+			<param name="source">The location of the data to mix.</param>
+			<param name="blockCount">The length of an element in 64-byte blocks.</param>
+			*/
+			void(*MixBlocksInto)(SalsaBlock* destination, SalsaBlock* source, unsigned blockCount);
+
+			/**
+			<summary>Copies the working buffer into a memory location and then mixes the working buffer.</summary>
+			<param name="copyDestination">The location to copy the buffer to.</param>
+			<param name="workingBuffer">The element in which the data is input and output.</param>
+			<param name="shuffleBuffer">A scratch space used internally.</param>
+			*/
+			void(*CopyAndMixBlocks)(SalsaBlock* copyDestination, ScryptElementPtr& workingBuffer, ScryptElementPtr& shuffleBuffer);
+
+			/**
+			<summary>Xors the data from a memory location into the working buffer and mixes it.</summary>
+			<param name="workingBuffer">The element in which the data is input and output.</param>
+			<param name="xorSource">The location of the data to xor into the working buffer.</param>
+			<param name="shuffleBuffer">A scratch space used internally.</param>
+			*/
+			void(*XorAndMixBlocks)(ScryptElementPtr& workingBuffer, SalsaBlock* xorSource, ScryptElementPtr& shuffleBuffer);
+
+			/**
+			<summary>Xors the data from a memory location into the working buffer, mixes it, and saves the result in its original ordering.</summary>
+			<param name="destination">The location in which to store.</param>
+			<param name="workingBuffer">The element containing the data to mix. Left unchanged.</param>
+			<param name="xorSource">The location of the data to xor into the working buffer.</param>
+			*/
+			void(*XorMixAndRestoreBlocks)(SalsaBlock* destination, ScryptElementPtr& workingBuffer, SalsaBlock* xorSource);
+
+			/**
+			<summary>As <see cref="XorAndMixBlocks"/>, but for an element rebuilt into cached scratch memory by the time-memory trade-off.</summary>
+			*/
+			void(*XorAndMixRebuiltBlocks)(ScryptElementPtr& workingBuffer, SalsaBlock* xorSource, ScryptElementPtr& shuffleBuffer);
+
+			/**
+			<summary>As <see cref="XorMixAndRestoreBlocks"/>, but for an element rebuilt into cached scratch memory by the time-memory trade-off.</summary>
+			*/
+			void(*XorMixAndRestoreRebuiltBlocks)(SalsaBlock* destination, ScryptElementPtr& workingBuffer, SalsaBlock* xorSource);
+
+			/**
+			<summary>Loads one element per lane into the lane-sliced working buffer.</summary>
+			<param name="workingBuffer">The lane-sliced element in which the data is input and output.</param>
+			<param name="sources">The location of each lane's element.</param>
+			*/
+			void(*PrepareLanes)(ScryptElementPtr& workingBuffer, SalsaBlock* const* sources);
+
+			/**
+			<summary>Copies each lane of the working buffer into its own memory location and then mixes all lanes.</summary>
+			<param name="copyDestinations">The location to copy each lane to.</param>
+			<param name="workingBuffer">The lane-sliced element in which the data is input and output.</param>
+			<param name="shuffleBuffer">A scratch space used internally.</param>
+			*/
+			void(*CopyAndMixLanes)(SalsaBlock* const* copyDestinations, ScryptElementPtr& workingBuffer, ScryptElementPtr& shuffleBuffer);
+
+			/**
+			<summary>Xors the data from each lane's memory location into the working buffer and mixes all lanes.</summary>
+			<param name="workingBuffer">The lane-sliced element in which the data is input and output.</param>
+			<param name="xorSources">The location of the data to xor into each lane.</param>
+			<param name="shuffleBuffer">A scratch space used internally.</param>
+			*/
+			void(*XorAndMixLanes)(ScryptElementPtr& workingBuffer, SalsaBlock* const* xorSources, ScryptElementPtr& shuffleBuffer);
+
+			/**
+			<summary>Computes Integerify for every lane of the working buffer.</summary>
+			<param name="indices">Receives one index per lane.</param>
+			<param name="workingBuffer">The lane-sliced element.</param>
+			*/
+			void(*IntegerifyLanes)(unsigned* indices, const ScryptElementPtr& workingBuffer);
+
+			/**
+			<summary>Saves each lane of the working buffer back to its element.</summary>
+			<param name="destinations">The location of each lane's element. Null entries are skipped.</param>
+			<param name="workingBuffer">The lane-sliced element in which the data is input and output.</param>
+			*/
+			void(*RestoreLanes)(SalsaBlock* const* destinations, ScryptElementPtr& workingBuffer);
+#pragma endregion
+		};
+	}
+}
@@ -0,0 +1,69 @@
+/**
+* Skryptonite - Scrypt library for UWP
+* Copyright © 2016 Nicholas C. Bauer, Ph.D.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "pch.h"
+#include "ScryptScalar.h"
+#include "ScryptCommon.h"
+
+using namespace Skryptonite::Native;
+
+// the original position of the word stored at each arranged position
+const unsigned ArrangedPositions[16] = { 12, 1, 6, 11, 0, 5, 10, 15, 4, 9, 14, 3, 8, 13, 2, 7 };
+
+template<CachePolicy policy, unsigned fixedBlockCount>
+void ScryptScalar::PrepareCopyAndMixBlocks(SalsaBlock* copyDestination, SalsaBlock* source, SalsaBlock* mixDestination, unsigned blockCount)
+{
+	ScryptCommon::PrepareCopyAndMixBlocks<SalsaBlock32x16, policy, fixedBlockCount>(copyDestination, source, mixDestination, blockCount, PrepareBlock);
+}
+
+void ScryptScalar::PrepareBlock(SalsaBlock32x16& arrangedBlock, SalsaBlock32x16& block)
+{
+	for (unsigned i = 0; i < 16; i++)
+		arrangedBlock.integers[i] = block.integers[ArrangedPositions[i]];
+}
+
+template<CachePolicy policy, unsigned fixedBlockCount>
+void ScryptScalar::XorMixAndRestoreBlocks(SalsaBlock* destination, ScryptElementPtr& workingBuffer, SalsaBlock* xorSource)
+{
+	ScryptCommon::XorMixAndRestoreBlocks<SalsaBlock32x16, policy, fixedBlockCount>(destination, workingBuffer, xorSource, RestoreBlock);
+}
+
+void ScryptScalar::RestoreBlock(SalsaBlock32x16& block, SalsaBlock32x16& arrangedBlock)
+{
+	for (unsigned i = 0; i < 16; i++)
+		block.integers[ArrangedPositions[i]] = arrangedBlock.integers[i];
+}
+
+template<unsigned fixedBlockCount>
+void ScryptScalar::MixBlocksInto(SalsaBlock* destination, SalsaBlock* source, unsigned blockCount)
+{
+	ScryptCommon::MixBlocksInto<SalsaBlock32x16, fixedBlockCount>(destination, source, blockCount);
+}
+
+template<CachePolicy policy, unsigned fixedBlockCount>
+void ScryptScalar::CopyAndMixBlocks(SalsaBlock* copyDestination, ScryptElementPtr& workingBuffer, ScryptElementPtr& shuffleBuffer)
+{
+	ScryptCommon::MixBlocks<SalsaBlock32x16, policy, MixBlocksMode::Copy, fixedBlockCount>(workingBuffer, copyDestination, shuffleBuffer);
+}
+
+template<CachePolicy policy, unsigned fixedBlockCount>
+void ScryptScalar::XorAndMixBlocks(ScryptElementPtr& workingBuffer, SalsaBlock* xorSource, ScryptElementPtr& shuffleBuffer)
+{
+	ScryptCommon::MixBlocks<SalsaBlock32x16, policy, MixBlocksMode::Xor, fixedBlockCount>(workingBuffer, xorSource, shuffleBuffer);
+}
+
+SKRYPTONITE_INSTANTIATE_BLOCK_KERNELS(ScryptScalar)
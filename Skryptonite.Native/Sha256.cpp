@@ -0,0 +1,185 @@
+/**
+* Skryptonite - Scrypt library for UWP
+* Copyright © 2016 Nicholas C. Bauer, Ph.D.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "pch.h"
+#include "Sha256.h"
+
+using namespace Skryptonite::Native;
+
+const unsigned Sha256::InitialState[8] =
+{
+	0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+};
+
+const unsigned Sha256::RoundConstants[64] =
+{
+	0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+	0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+	0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+	0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+	0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+	0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+	0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+	0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+static __forceinline unsigned RotateRight(unsigned value, unsigned magnitude)
+{
+	return (value >> magnitude) | (value << (32 - magnitude));
+}
+
+static __forceinline unsigned LoadBigEndian(const unsigned char* source)
+{
+	return (static_cast<unsigned>(source[0]) << 24) | (static_cast<unsigned>(source[1]) << 16) |
+		(static_cast<unsigned>(source[2]) << 8) | static_cast<unsigned>(source[3]);
+}
+
+static __forceinline void StoreBigEndian(unsigned char* destination, unsigned value)
+{
+	destination[0] = static_cast<unsigned char>(value >> 24);
+	destination[1] = static_cast<unsigned char>(value >> 16);
+	destination[2] = static_cast<unsigned char>(value >> 8);
+	destination[3] = static_cast<unsigned char>(value);
+}
+
+Sha256::Sha256()
+{
+	Initialize();
+}
+
+Sha256::~Sha256()
+{
+	SecureErase(_state, sizeof(_state));
+	SecureErase(_buffer, sizeof(_buffer));
+}
+
+void Sha256::Initialize()
+{
+	memcpy(_state, InitialState, sizeof(_state));
+	_bufferLength = 0;
+	_messageLength = 0;
+}
+
+void Sha256::Update(const unsigned char* data, size_t length)
+{
+	if (length == 0)
+		return;
+
+	_messageLength += length;
+
+	if (_bufferLength > 0)
+	{
+		size_t count = (length < BlockLength - _bufferLength) ? length : BlockLength - _bufferLength;
+
+		memcpy(_buffer + _bufferLength, data, count);
+		_bufferLength += count;
+		data += count;
+		length -= count;
+
+		if (_bufferLength < BlockLength)
+			return;
+
+		Transform(_state, _buffer);
+		_bufferLength = 0;
+	}
+
+	for (; length >= BlockLength; data += BlockLength, length -= BlockLength)
+		Transform(_state, data);
+
+	if (length > 0)
+	{
+		memcpy(_buffer, data, length);
+		_bufferLength = length;
+	}
+}
+
+void Sha256::Final(unsigned char* hash)
+{
+	unsigned long long messageBits = _messageLength * 8;
+
+	// pad with a single 1 bit, then zeroes up to the 64-bit big-endian message length
+	_buffer[_bufferLength++] = 0x80;
+
+	if (_bufferLength > BlockLength - 8)
+	{
+		memset(_buffer + _bufferLength, 0, BlockLength - _bufferLength);
+		Transform(_state, _buffer);
+		_bufferLength = 0;
+	}
+
+	memset(_buffer + _bufferLength, 0, BlockLength - 8 - _bufferLength);
+	StoreBigEndian(_buffer + BlockLength - 8, static_cast<unsigned>(messageBits >> 32));
+	StoreBigEndian(_buffer + BlockLength - 4, static_cast<unsigned>(messageBits));
+	Transform(_state, _buffer);
+
+	for (unsigned i = 0; i < 8; i++)
+		StoreBigEndian(hash + i * 4, _state[i]);
+}
+
+void Sha256::TransformLanes(unsigned* const* states, const unsigned char* const* blocks, unsigned count)
+{
+	for (unsigned k = 0; k < count; k++)
+		Transform(states[k], blocks[k]);
+}
+
+void Sha256::Transform(unsigned* state, const unsigned char* block)
+{
+	unsigned w[64];
+
+	for (unsigned i = 0; i < 16; i++)
+		w[i] = LoadBigEndian(block + i * 4);
+
+	for (unsigned i = 16; i < 64; i++)
+	{
+		unsigned s0 = RotateRight(w[i - 15], 7) ^ RotateRight(w[i - 15], 18) ^ (w[i - 15] >> 3);
+		unsigned s1 = RotateRight(w[i - 2], 17) ^ RotateRight(w[i - 2], 19) ^ (w[i - 2] >> 10);
+		w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+	}
+
+	unsigned a = state[0], b = state[1], c = state[2], d = state[3];
+	unsigned e = state[4], f = state[5], g = state[6], h = state[7];
+
+	for (unsigned i = 0; i < 64; i++)
+	{
+		unsigned s1 = RotateRight(e, 6) ^ RotateRight(e, 11) ^ RotateRight(e, 25);
+		unsigned choice = (e & f) ^ (~e & g);
+		unsigned temp1 = h + s1 + choice + RoundConstants[i] + w[i];
+		unsigned s0 = RotateRight(a, 2) ^ RotateRight(a, 13) ^ RotateRight(a, 22);
+		unsigned majority = (a & b) ^ (a & c) ^ (b & c);
+		unsigned temp2 = s0 + majority;
+
+		h = g;
+		g = f;
+		f = e;
+		e = d + temp1;
+		d = c;
+		c = b;
+		b = a;
+		a = temp1 + temp2;
+	}
+
+	state[0] += a;
+	state[1] += b;
+	state[2] += c;
+	state[3] += d;
+	state[4] += e;
+	state[5] += f;
+	state[6] += g;
+	state[7] += h;
+
+	SecureErase(w, sizeof(w));
+}
@@ -0,0 +1,95 @@
+/**
+* Skryptonite - Scrypt library for UWP
+* Copyright © 2016 Nicholas C. Bauer, Ph.D.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#pragma once
+#include "Platform.h"
+
+namespace Skryptonite
+{
+	namespace Native
+	{
+		/**
+		<summary>Computes SHA-256 hashes as described in FIPS 180-4.</summary>
+		*/
+		class Sha256
+		{
+		public:
+			/**
+			<summary>The length of a hash in bytes.</summary>
+			*/
+			static const unsigned HashLength = 32;
+
+			/**
+			<summary>The length of a message block in bytes.</summary>
+			*/
+			static const unsigned BlockLength = 64;
+
+			/**
+			<summary>The initial hash value.</summary>
+			*/
+			static const unsigned InitialState[8];
+
+			/**
+			<summary>The round constants.</summary>
+			*/
+			static const unsigned RoundConstants[64];
+
+			Sha256();
+
+			~Sha256();
+
+			/**
+			<summary>Resets the hash to its initial state, discarding any data already added.</summary>
+			*/
+			void Initialize();
+
+			/**
+			<summary>Adds data to the message being hashed.</summary>
+			<param name="data">The data to add. May be null when <paramref name="length"/> is 0.</param>
+			<param name="length">The number of bytes to add.</param>
+			*/
+			void Update(const unsigned char* data, size_t length);
+
+			/**
+			<summary>Completes the hash. The object must be initialized again before reuse.</summary>
+			<param name="hash">Receives <see cref="HashLength"/> bytes.</param>
+			*/
+			void Final(unsigned char* hash);
+
+			/**
+			<summary>Runs the compression function over one message block.</summary>
+			<param name="state">The hash state to update.</param>
+			<param name="block">The <see cref="BlockLength"/> byte message block.</param>
+			*/
+			static void Transform(unsigned* state, const unsigned char* block);
+
+			/**
+			<summary>Runs the compression function over one message block for each of several independent hashes.</summary>
+			<param name="states">The hash state of each lane.</param>
+			<param name="blocks">The message block of each lane.</param>
+			<param name="count">The number of lanes.</param>
+			*/
+			static void TransformLanes(unsigned* const* states, const unsigned char* const* blocks, unsigned count);
+
+		private:
+			unsigned _state[8];
+			unsigned char _buffer[BlockLength];
+			size_t _bufferLength;
+			unsigned long long _messageLength;
+		};
+	}
+}
@@ -0,0 +1,719 @@
+/**
+* Skryptonite - Scrypt library for UWP
+* Copyright © 2016 Nicholas C. Bauer, Ph.D.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "pch.h"
+#include "Skryptonite.h"
+#include "Autotuner.h"
+#include "CostModel.h"
+#include "CpuFeatures.h"
+#include "DerivationCache.h"
+#include "DerivationQueue.h"
+#include "ScryptEngine.h"
+#include "ScratchPool.h"
+#include "MemoryBudget.h"
+#include "Metrics.h"
+#include "ProcessorTopology.h"
+#include "SMixState.h"
+#include "ThreadPool.h"
+#include <chrono>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <vector>
+
+using namespace Skryptonite::Native;
+
+static_assert(static_cast<int>(CachePolicy::Automatic) == SKRYPTONITE_CACHE_AUTOMATIC &&
+	static_cast<int>(CachePolicy::StreamAndFlush) == SKRYPTONITE_CACHE_STREAM_AND_FLUSH &&
+	static_cast<int>(CachePolicy::StreamAndFlushOptimized) == SKRYPTONITE_CACHE_STREAM_AND_FLUSH_OPTIMIZED &&
+	static_cast<int>(CachePolicy::Cached) == SKRYPTONITE_CACHE_CACHED, "skryptonite_cache_policy must mirror CachePolicy.");
+static_assert(static_cast<int>(MetricsPhase::ScratchRelease) == SKRYPTONITE_PHASE_SCRATCH_RELEASE &&
+	static_cast<int>(MetricsPhase::Count) == SKRYPTONITE_PHASE_SCRATCH_RELEASE + 1, "skryptonite_metrics_phase must mirror MetricsPhase.");
+static_assert(static_cast<int>(MetricsCounter::DerivationFailures) == SKRYPTONITE_COUNTER_DERIVATION_FAILURES &&
+	static_cast<int>(MetricsCounter::Count) == SKRYPTONITE_COUNTER_DERIVATION_FAILURES + 1, "skryptonite_metrics_counter must mirror MetricsCounter.");
+static_assert(static_cast<int>(HardwareEvent::MemoryStallCycles) == SKRYPTONITE_EVENT_MEMORY_STALL_CYCLES &&
+	static_cast<int>(HardwareEvent::Count) == sizeof(skryptonite_phase_hardware_events::events) / sizeof(uint64_t),
+	"skryptonite_hardware_event must mirror HardwareEvent.");
+
+/**
+<summary>An SMix in progress together with the engine it mixes through.</summary>
+*/
+struct skryptonite_smix_state
+{
+	std::unique_ptr<ScryptEngine> engine;
+	std::unique_ptr<SMixState> state;
+};
+
+/**
+<summary>Runs native code, converting the exceptions it throws into status codes so none cross the C boundary.</summary>
+*/
+template<class TFunction>
+static skryptonite_status TranslateExceptions(TFunction function)
+{
+	try
+	{
+		function();
+		return SKRYPTONITE_OK;
+	}
+	catch (const std::invalid_argument&)
+	{
+		return SKRYPTONITE_INVALID_ARGUMENT;
+	}
+	catch (const std::bad_alloc&)
+	{
+		return SKRYPTONITE_OUT_OF_MEMORY;
+	}
+	catch (...)
+	{
+		return SKRYPTONITE_ERROR;
+	}
+}
+
+skryptonite_status skryptonite_smix(uint8_t* data, size_t length, uint32_t elementsCount, uint32_t processingCost,
+	uint32_t firstElementIndex, uint32_t count)
+{
+	return TranslateExceptions([&]()
+	{
+		ScryptEngine engine(data, length, elementsCount, processingCost);
+		engine.SMixRange(firstElementIndex, count);
+	});
+}
+
+skryptonite_status skryptonite_smix_scratch_requirements(uint32_t elementLengthMultiplier, uint32_t processingCost,
+	skryptonite_scratch_requirements* requirements)
+{
+	return TranslateExceptions([&]()
+	{
+		if (requirements == nullptr)
+			throw std::invalid_argument("requirements must not be null.");
+
+		ScratchRequirements native = ScryptEngine::ScratchRequirementsFor(elementLengthMultiplier, processingCost,
+			ScryptEngine::DefaultTradeOffFactor());
+
+		requirements->largeMemoryBlockBytes = native.largeMemoryBlockLength;
+		requirements->bufferBytes = native.bufferLength;
+		requirements->bufferCount = native.bufferCount;
+		requirements->alignment = static_cast<uint32_t>(native.alignment);
+		requirements->totalBytes = native.totalLength;
+	});
+}
+
+skryptonite_status skryptonite_scratch_partition(void* region, size_t length, const skryptonite_scratch_requirements* requirements,
+	skryptonite_scratch* scratch)
+{
+	return TranslateExceptions([&]()
+	{
+		if (requirements == nullptr || scratch == nullptr)
+			throw std::invalid_argument("requirements and scratch must not be null.");
+		if (requirements->alignment == 0 || requirements->totalBytes > (std::numeric_limits<size_t>::max)())
+			throw std::invalid_argument("requirements are not valid.");
+
+		ScratchRequirements native;
+		native.largeMemoryBlockLength = static_cast<size_t>(requirements->largeMemoryBlockBytes);
+		native.bufferLength = static_cast<size_t>(requirements->bufferBytes);
+		native.bufferCount = requirements->bufferCount;
+		native.alignment = requirements->alignment;
+		native.totalLength = static_cast<size_t>(requirements->totalBytes);
+
+		ScryptScratch regions = ScryptEngine::PartitionScratch(region, length, native);
+
+		scratch->largeMemoryBlock = regions.largeMemoryBlock;
+		scratch->workingBuffer = regions.workingBuffer;
+		scratch->shuffleBuffer = regions.shuffleBuffer;
+		scratch->rebuildBuffer = regions.rebuildBuffer;
+		scratch->rebuildShuffleBuffer = regions.rebuildShuffleBuffer;
+	});
+}
+
+skryptonite_status skryptonite_smix_with_scratch(uint8_t* data, size_t length, uint32_t elementsCount, uint32_t processingCost,
+	uint32_t elementIndex, const skryptonite_scratch* scratch)
+{
+	return TranslateExceptions([&]()
+	{
+		if (scratch == nullptr)
+			throw std::invalid_argument("scratch must not be null.");
+
+		ScryptEngine engine(data, length, elementsCount, processingCost);
+		engine.SMix(elementIndex, { scratch->largeMemoryBlock, scratch->workingBuffer, scratch->shuffleBuffer, scratch->rebuildBuffer,
+			scratch->rebuildShuffleBuffer });
+	});
+}
+
+skryptonite_status skryptonite_smix_all(uint8_t* data, size_t length, uint32_t elementsCount, uint32_t processingCost,
+	uint32_t threadCount)
+{
+	return TranslateExceptions([&]()
+	{
+		ScryptEngine engine(data, length, elementsCount, processingCost);
+		engine.SMixAll(threadCount);
+	});
+}
+
+skryptonite_status skryptonite_smix_begin(uint8_t* data, size_t length, uint32_t elementsCount, uint32_t processingCost,
+	uint32_t elementIndex, skryptonite_smix_state** state)
+{
+	return TranslateExceptions([&]()
+	{
+		if (state == nullptr)
+			throw std::invalid_argument("state must not be null.");
+
+		auto smix = std::make_unique<skryptonite_smix_state>();
+		smix->engine = std::make_unique<ScryptEngine>(data, length, elementsCount, processingCost);
+		smix->state = std::make_unique<SMixState>(*smix->engine, elementIndex);
+
+		*state = smix.release();
+	});
+}
+
+skryptonite_status skryptonite_smix_advance(skryptonite_smix_state* state, uint64_t maxSteps, int* isDone)
+{
+	return TranslateExceptions([&]()
+	{
+		if (state == nullptr)
+			throw std::invalid_argument("state must not be null.");
+
+		bool done = state->state->Advance(maxSteps);
+
+		if (isDone != nullptr)
+			*isDone = done ? 1 : 0;
+	});
+}
+
+skryptonite_status skryptonite_smix_advance_for(skryptonite_smix_state* state, uint64_t budgetNanoseconds, int* isDone)
+{
+	return TranslateExceptions([&]()
+	{
+		if (state == nullptr)
+			throw std::invalid_argument("state must not be null.");
+
+		// budgets too long to represent are as good as unbounded
+		auto budget = (std::chrono::steady_clock::duration::max)();
+		if (budgetNanoseconds < static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(budget).count()))
+			budget = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::nanoseconds(budgetNanoseconds));
+
+		bool done = state->state->AdvanceFor(budget);
+
+		if (isDone != nullptr)
+			*isDone = done ? 1 : 0;
+	});
+}
+
+void skryptonite_smix_cancel(skryptonite_smix_state* state)
+{
+	if (state != nullptr)
+		state->state->Cancel();
+}
+
+uint64_t skryptonite_smix_progress(const skryptonite_smix_state* state, uint64_t* totalSteps)
+{
+	if (state == nullptr)
+		return 0;
+
+	if (totalSteps != nullptr)
+		*totalSteps = state->state->TotalSteps();
+
+	return state->state->CompletedSteps();
+}
+
+void skryptonite_smix_free(skryptonite_smix_state* state)
+{
+	delete state;
+}
+
+skryptonite_status skryptonite_scrypt(const uint8_t* password, size_t passwordLength, const uint8_t* salt, size_t saltLength,
+	uint32_t elementLengthMultiplier, uint32_t processingCost, uint32_t parallelization,
+	uint8_t* derivedKey, size_t derivedKeyLength)
+{
+	return TranslateExceptions([&]()
+	{
+		DerivationCache::Global().DeriveKey(password, passwordLength, salt, saltLength, elementLengthMultiplier, processingCost, parallelization,
+			derivedKey, derivedKeyLength);
+	});
+}
+
+skryptonite_status skryptonite_scrypt_batch(const skryptonite_request* requests, uint32_t requestCount,
+	uint32_t elementLengthMultiplier, uint32_t processingCost, uint32_t parallelization, uint32_t threadCount)
+{
+	return TranslateExceptions([&]()
+	{
+		if (requests == nullptr && requestCount > 0)
+			throw std::invalid_argument("requests must not be null.");
+
+		std::vector<ScryptRequest> engineRequests(requestCount);
+
+		for (uint32_t i = 0; i < requestCount; i++)
+			engineRequests[i] = { requests[i].password, requests[i].passwordLength, requests[i].salt, requests[i].saltLength,
+				requests[i].derivedKey, requests[i].derivedKeyLength };
+
+		ScryptEngine::DeriveKeys(engineRequests.data(), requestCount, elementLengthMultiplier, processingCost, parallelization, threadCount);
+	});
+}
+
+/**
+<summary>Converts the outcome of a queued derivation for the portable API.</summary>
+*/
+static skryptonite_status ToStatus(DerivationStatus status)
+{
+	switch (status)
+	{
+	case DerivationStatus::Completed:
+		return SKRYPTONITE_OK;
+	case DerivationStatus::Cancelled:
+		return SKRYPTONITE_CANCELLED;
+	case DerivationStatus::OutOfMemory:
+		return SKRYPTONITE_OUT_OF_MEMORY;
+	default:
+		return SKRYPTONITE_ERROR;
+	}
+}
+
+skryptonite_status skryptonite_scrypt_submit(const uint8_t* password, size_t passwordLength, const uint8_t* salt, size_t saltLength,
+	uint32_t elementLengthMultiplier, uint32_t processingCost, uint32_t parallelization, size_t derivedKeyLength,
+	skryptonite_completion completion, void* context, uint64_t* ticket)
+{
+	skryptonite_status status = SKRYPTONITE_OK;
+
+	skryptonite_status translated = TranslateExceptions([&]()
+	{
+		if (completion == nullptr)
+			throw std::invalid_argument("completion must not be null.");
+
+		DerivationRequest request = { password, passwordLength, salt, saltLength, elementLengthMultiplier, processingCost,
+			parallelization, derivedKeyLength };
+
+		unsigned long long submitted = DerivationQueue::Global().TrySubmit(request, [completion, context](DerivationResult& result)
+		{
+			const bool hasKey = !result.derivedKey.empty();
+			completion(context, result.ticket, ToStatus(result.status), hasKey ? result.derivedKey.data() : nullptr,
+				result.derivedKey.size());
+			SecureErase(result.derivedKey.data(), result.derivedKey.size());
+		});
+
+		if (submitted == 0)
+			status = SKRYPTONITE_QUEUE_FULL;
+		if (ticket != nullptr)
+			*ticket = submitted;
+	});
+
+	return translated != SKRYPTONITE_OK ? translated : status;
+}
+
+int skryptonite_scrypt_cancel(uint64_t ticket)
+{
+	return DerivationQueue::Global().Cancel(ticket) ? 1 : 0;
+}
+
+skryptonite_status skryptonite_queue_set_max_depth(uint32_t maxDepth)
+{
+	return TranslateExceptions([&]() { DerivationQueue::Global().SetMaxDepth(maxDepth); });
+}
+
+skryptonite_status skryptonite_queue_summary(skryptonite_queue_statistics* statistics)
+{
+	return TranslateExceptions([&]()
+	{
+		if (statistics == nullptr)
+			throw std::invalid_argument("statistics must not be null.");
+
+		DerivationQueueStatistics queue = DerivationQueue::Global().Statistics();
+
+		statistics->queueDepth = queue.queueDepth;
+		statistics->peakQueueDepth = queue.peakQueueDepth;
+		statistics->submitted = queue.submitted;
+		statistics->rejected = queue.rejected;
+		statistics->completed = queue.completed;
+		statistics->cancelled = queue.cancelled;
+		statistics->failed = queue.failed;
+		statistics->batches = queue.batches;
+	});
+}
+
+void skryptonite_queue_wait_idle(void)
+{
+	DerivationQueue::Global().WaitIdle();
+}
+
+skryptonite_status skryptonite_derivation_cache_configure(uint32_t maxEntries, uint32_t maxKeyLength,
+	uint32_t timeToLiveMilliseconds)
+{
+	return TranslateExceptions([&]()
+	{
+		DerivationCache::Global().Configure(maxEntries, maxKeyLength > 0 ? maxKeyLength : DerivationCache::DefaultMaxKeyLength,
+			std::chrono::milliseconds(timeToLiveMilliseconds));
+	});
+}
+
+void skryptonite_derivation_cache_clear(void)
+{
+	DerivationCache::Global().Clear();
+}
+
+skryptonite_status skryptonite_derivation_cache_summary(skryptonite_derivation_cache_statistics* statistics)
+{
+	return TranslateExceptions([&]()
+	{
+		if (statistics == nullptr)
+			throw std::invalid_argument("statistics must not be null.");
+
+		DerivationCacheStatistics cache = DerivationCache::Global().Statistics();
+
+		statistics->entries = cache.entries;
+		statistics->maxEntries = cache.maxEntries;
+		statistics->hits = cache.hits;
+		statistics->misses = cache.misses;
+		statistics->evictions = cache.evictions;
+		statistics->expirations = cache.expirations;
+		statistics->bypasses = cache.bypasses;
+		statistics->lockedBytes = cache.lockedBytes;
+	});
+}
+
+skryptonite_status skryptonite_set_interleave_count(uint32_t interleaveCount)
+{
+	return TranslateExceptions([&]() { ScryptEngine::SetInterleaveCount(interleaveCount); });
+}
+
+skryptonite_status skryptonite_set_cache_policy(uint32_t policy)
+{
+	return TranslateExceptions([&]()
+	{
+		if (policy > SKRYPTONITE_CACHE_CACHED)
+			throw std::invalid_argument("policy is not a cache policy.");
+
+		ScryptEngine::SetDefaultCachePolicy(static_cast<CachePolicy>(policy));
+	});
+}
+
+skryptonite_status skryptonite_set_tradeoff_factor(uint32_t factor)
+{
+	return TranslateExceptions([&]() { ScryptEngine::SetDefaultTradeOffFactor(factor); });
+}
+
+skryptonite_status skryptonite_tradeoff_factor_for_memory(uint32_t elementLengthMultiplier, uint32_t processingCost, uint64_t maxBytes,
+	uint32_t* factor)
+{
+	return TranslateExceptions([&]()
+	{
+		if (factor == nullptr)
+			throw std::invalid_argument("factor must not be null.");
+
+		*factor = ScryptEngine::TradeOffFactorForMemory(elementLengthMultiplier, processingCost, maxBytes);
+	});
+}
+
+skryptonite_status skryptonite_set_storage_directory(const char* directory)
+{
+	return TranslateExceptions([&]() { ScryptEngine::SetDefaultStorageDirectory(directory != nullptr ? directory : ""); });
+}
+
+skryptonite_status skryptonite_autotune(uint32_t elementLengthMultiplier, uint32_t processingCost, uint32_t parallelization,
+	uint32_t* instructionSet)
+{
+	return TranslateExceptions([&]()
+	{
+		AutotuneResult result = Autotuner::Calibrate(elementLengthMultiplier, processingCost, parallelization);
+
+		if (instructionSet != nullptr)
+			*instructionSet = static_cast<uint32_t>(result.instructionSet);
+	});
+}
+
+skryptonite_status skryptonite_autotune_measurement(uint32_t elementLengthMultiplier, uint32_t processingCost, uint32_t parallelization,
+	uint32_t instructionSet, double* nanosecondsPerElement)
+{
+	return TranslateExceptions([&]()
+	{
+		if (nanosecondsPerElement == nullptr)
+			throw std::invalid_argument("nanosecondsPerElement must not be null.");
+
+		AutotuneResult result;
+		if (!Autotuner::TryGetResult(elementLengthMultiplier, processingCost, parallelization, result))
+			throw std::invalid_argument("The parameters have not been calibrated.");
+
+		for (const BackendMeasurement& measurement : result.measurements)
+		{
+			if (static_cast<uint32_t>(measurement.instructionSet) == instructionSet)
+			{
+				*nanosecondsPerElement = measurement.isVerified ? measurement.nanosecondsPerElement : 0;
+				return;
+			}
+		}
+
+		throw std::invalid_argument("instructionSet was not measured.");
+	});
+}
+
+void skryptonite_autotune_reset(void)
+{
+	Autotuner::Reset();
+}
+
+const char* skryptonite_instruction_set_name(uint32_t instructionSet)
+{
+	return CpuFeatures::InstructionSetName(static_cast<InstructionSet>(instructionSet));
+}
+
+/**
+<summary>Summarizes a histogram for the portable API.</summary>
+*/
+static skryptonite_histogram_summary Summarize(const HistogramSnapshot& histogram)
+{
+	return { histogram.count, histogram.sum, histogram.min, histogram.max, histogram.ValueAtPercentile(50),
+		histogram.ValueAtPercentile(90), histogram.ValueAtPercentile(99), histogram.ValueAtPercentile(99.9) };
+}
+
+int skryptonite_metrics_available(void)
+{
+	return Metrics::IsCompiledIn() ? 1 : 0;
+}
+
+void skryptonite_metrics_set_enabled(int enabled)
+{
+	Metrics::SetEnabled(enabled != 0);
+}
+
+void skryptonite_metrics_reset(void)
+{
+	Metrics::Reset();
+}
+
+skryptonite_status skryptonite_metrics_phase_summary(uint32_t phase, skryptonite_phase_metrics* metrics)
+{
+	return TranslateExceptions([&]()
+	{
+		if (phase >= static_cast<uint32_t>(MetricsPhase::Count))
+			throw std::invalid_argument("phase is not a metrics phase.");
+		if (metrics == nullptr)
+			throw std::invalid_argument("metrics must not be null.");
+
+		MetricsSnapshot snapshot = Metrics::Snapshot();
+		const PhaseSnapshot& phaseSnapshot = snapshot.phases[phase];
+
+		*metrics = { Summarize(phaseSnapshot.wallTime), Summarize(phaseSnapshot.cpuTime), phaseSnapshot.bytes };
+	});
+}
+
+skryptonite_status skryptonite_metrics_counter_value(uint32_t counter, uint64_t* value)
+{
+	return TranslateExceptions([&]()
+	{
+		if (counter >= static_cast<uint32_t>(MetricsCounter::Count))
+			throw std::invalid_argument("counter is not a metrics counter.");
+		if (value == nullptr)
+			throw std::invalid_argument("value must not be null.");
+
+		*value = Metrics::Snapshot().counters[counter];
+	});
+}
+
+uint32_t skryptonite_hardware_events_available(void)
+{
+	return HardwareCounters::AvailableEvents();
+}
+
+void skryptonite_metrics_set_hardware_counters_enabled(int enabled)
+{
+	Metrics::SetHardwareCountersEnabled(enabled != 0);
+}
+
+skryptonite_status skryptonite_metrics_phase_hardware_events(uint32_t phase, skryptonite_phase_hardware_events* events)
+{
+	return TranslateExceptions([&]()
+	{
+		if (phase >= static_cast<uint32_t>(MetricsPhase::Count))
+			throw std::invalid_argument("phase is not a metrics phase.");
+		if (events == nullptr)
+			throw std::invalid_argument("events must not be null.");
+
+		MetricsSnapshot snapshot = Metrics::Snapshot();
+		const PhaseSnapshot& phaseSnapshot = snapshot.phases[phase];
+
+		events->samples = phaseSnapshot.hardwareSamples;
+		for (size_t i = 0; i < static_cast<size_t>(HardwareEvent::Count); i++)
+			events->events[i] = phaseSnapshot.hardwareEvents[i];
+	});
+}
+
+void skryptonite_scratch_set_limit(size_t maxRetainedBytes)
+{
+	// the pools of the thread pool workers share the limit, so they are trimmed along with the shared pool
+	ScratchPool::Global().SetMaxRetainedBytes(maxRetainedBytes);
+}
+
+void skryptonite_scratch_trim(void)
+{
+	ScratchPool::Global().Trim();
+	ThreadPool::Global().TrimScratch();
+}
+
+uint32_t skryptonite_thread_count(void)
+{
+	return ThreadPool::Global().ThreadCount();
+}
+
+void skryptonite_set_thread_pinning(int enabled)
+{
+	ThreadPool::Global().SetPinThreads(enabled != 0);
+}
+
+void skryptonite_memory_budget_set_limit(uint64_t limitBytes, uint32_t maxWaitMilliseconds)
+{
+	MemoryBudget::Global().SetMaxWait(std::chrono::milliseconds(maxWaitMilliseconds));
+	MemoryBudget::Global().SetLimit(limitBytes);
+}
+
+skryptonite_status skryptonite_memory_budget_summary(skryptonite_memory_budget_statistics* statistics)
+{
+	return TranslateExceptions([&]()
+	{
+		if (statistics == nullptr)
+			throw std::invalid_argument("statistics must not be null.");
+
+		MemoryBudgetStatistics budget = MemoryBudget::Global().Statistics();
+
+		statistics->limitBytes = budget.limitBytes;
+		statistics->reservedBytes = budget.reservedBytes;
+		statistics->peakReservedBytes = budget.peakReservedBytes;
+		statistics->queueDepth = budget.queueDepth;
+		statistics->peakQueueDepth = budget.peakQueueDepth;
+		statistics->admissions = budget.admissions;
+		statistics->waits = budget.waits;
+		statistics->rejections = budget.rejections;
+		statistics->totalWaitNanoseconds = budget.totalWaitNanoseconds;
+		statistics->maxWaitNanoseconds = budget.maxWaitNanoseconds;
+	});
+}
+
+void skryptonite_memory_budget_reset_statistics(void)
+{
+	MemoryBudget::Global().ResetStatistics();
+}
+
+uint32_t skryptonite_numa_node_count(void)
+{
+	return ProcessorTopology::NodeCount();
+}
+
+void skryptonite_set_numa_placement(int enabled)
+{
+	ThreadPool::Global().SetNumaPlacement(enabled != 0);
+}
+
+skryptonite_status skryptonite_cost_model_calibrate(const char* profilePath)
+{
+	return TranslateExceptions([&]()
+	{
+		CostModel::Calibrate();
+
+		if (profilePath != nullptr)
+			CostModel::Save(profilePath);
+	});
+}
+
+skryptonite_status skryptonite_cost_model_load_or_calibrate(const char* profilePath)
+{
+	return TranslateExceptions([&]()
+	{
+		if (profilePath == nullptr)
+			throw std::invalid_argument("profilePath must not be null.");
+
+		CostModel::EnsureProfile(profilePath);
+	});
+}
+
+skryptonite_status skryptonite_cost_model_profile(skryptonite_hardware_profile* profile)
+{
+	return TranslateExceptions([&]()
+	{
+		if (profile == nullptr)
+			throw std::invalid_argument("profile must not be null.");
+
+		HardwareProfile current;
+		if (!CostModel::TryGetProfile(current))
+			throw std::invalid_argument("There is no profile.");
+
+		memset(profile->processorName, 0, sizeof(profile->processorName));
+		current.processorName.copy(profile->processorName, sizeof(profile->processorName) - 1);
+		profile->instructionSet = static_cast<uint32_t>(current.instructionSet);
+		profile->laneCount = current.laneCount;
+		profile->salsaBlocksPerSecond = current.salsaBlocksPerSecond;
+		profile->bandCount = static_cast<uint32_t>(current.bands.size());
+	});
+}
+
+skryptonite_status skryptonite_cost_model_band(uint32_t index, skryptonite_cost_band* band)
+{
+	return TranslateExceptions([&]()
+	{
+		if (band == nullptr)
+			throw std::invalid_argument("band must not be null.");
+
+		HardwareProfile current;
+		if (!CostModel::TryGetProfile(current))
+			throw std::invalid_argument("There is no profile.");
+		if (index >= current.bands.size())
+			throw std::invalid_argument("index must be less than the band count.");
+
+		const CostBand& source = current.bands[index];
+
+		band->footprintBytes = source.footprintBytes;
+		band->laneNanosecondsPerBlock = source.laneNanosecondsPerBlock;
+		band->nanosecondsPerBlock = source.nanosecondsPerBlock;
+		band->fillBytesPerSecond = source.fillBytesPerSecond;
+		band->readNanoseconds = source.readNanoseconds;
+	});
+}
+
+skryptonite_status skryptonite_cost_model_predict(uint32_t elementLengthMultiplier, uint32_t processingCost, uint32_t parallelization,
+	uint32_t threadCount, double* nanoseconds, uint64_t* bytes)
+{
+	return TranslateExceptions([&]()
+	{
+		if (nanoseconds == nullptr)
+			throw std::invalid_argument("nanoseconds must not be null.");
+
+		CostPrediction prediction = CostModel::Predict(elementLengthMultiplier, processingCost, parallelization, threadCount);
+
+		*nanoseconds = prediction.nanoseconds;
+		if (bytes != nullptr)
+			*bytes = prediction.bytes;
+	});
+}
+
+skryptonite_status skryptonite_cost_model_optimal(uint64_t maxMemoryBytes, uint32_t targetMilliseconds, uint32_t threadCount,
+	uint32_t elementLengthMultiplier, uint32_t* processingCost, uint32_t* parallelization, uint32_t* maxThreads)
+{
+	return TranslateExceptions([&]()
+	{
+		if (processingCost == nullptr || parallelization == nullptr)
+			throw std::invalid_argument("processingCost and parallelization must not be null.");
+
+		OptimalParameters parameters = CostModel::Optimal(maxMemoryBytes, targetMilliseconds, threadCount, elementLengthMultiplier);
+
+		*processingCost = parameters.processingCost;
+		*parallelization = parameters.parallelization;
+		if (maxThreads != nullptr)
+			*maxThreads = parameters.threadCount;
+	});
+}
+
+void skryptonite_cost_model_reset(void)
+{
+	CostModel::Reset();
+}
@@ -0,0 +1,738 @@
+/**
+* Skryptonite - Scrypt library for UWP
+* Copyright © 2016 Nicholas C. Bauer, Ph.D.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+Portable C interface to the native Scrypt core. Usable from C, C++, or any language with a C foreign function interface,
+without the Windows Runtime.
+*/
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+<summary>Status codes returned by the portable API.</summary>
+*/
+typedef enum skryptonite_status
+{
+	SKRYPTONITE_OK = 0,
+	SKRYPTONITE_INVALID_ARGUMENT = 1,
+	SKRYPTONITE_OUT_OF_MEMORY = 2,
+	SKRYPTONITE_ERROR = 3,
+	SKRYPTONITE_QUEUE_FULL = 4,
+	SKRYPTONITE_CANCELLED = 5
+} skryptonite_status;
+
+/**
+<summary>How SMix treats the cache when writing and reading the large memory block. Mirrors Skryptonite::Native::CachePolicy.</summary>
+*/
+typedef enum skryptonite_cache_policy
+{
+	SKRYPTONITE_CACHE_AUTOMATIC = 0,
+	SKRYPTONITE_CACHE_STREAM_AND_FLUSH = 1,
+	SKRYPTONITE_CACHE_STREAM_AND_FLUSH_OPTIMIZED = 2,
+	SKRYPTONITE_CACHE_CACHED = 3
+} skryptonite_cache_policy;
+
+/**
+<summary>Performs SMix in place on a contiguous range of elements of a buffer generated by PBKDF2.</summary>
+<param name="data">The data to process.</param>
+<param name="length">The length of <paramref name="data"/> in bytes. Must be a multiple of 128 * elementsCount.</param>
+<param name="elementsCount">The number of independent SMix elements the data is divided into (p).</param>
+<param name="processingCost">The number of elements in the large memory block and of random jumps through it (N).</param>
+<param name="firstElementIndex">The index of the first element to mix.</param>
+<param name="count">The number of elements to mix.</param>
+<returns>SKRYPTONITE_OK on success, otherwise the reason for failure.</returns>
+*/
+skryptonite_status skryptonite_smix(uint8_t* data, size_t length, uint32_t elementsCount, uint32_t processingCost,
+	uint32_t firstElementIndex, uint32_t count);
+
+/**
+<summary>Performs SMix in place on every element of a buffer generated by PBKDF2, spreading the elements over the threads of the
+library's persistent thread pool.</summary>
+<param name="data">The data to process.</param>
+<param name="length">The length of <paramref name="data"/> in bytes. Must be a multiple of 128 * elementsCount.</param>
+<param name="elementsCount">The number of independent SMix elements the data is divided into (p).</param>
+<param name="processingCost">The number of elements in the large memory block and of random jumps through it (N).</param>
+<param name="threadCount">The largest number of threads to use, including the calling thread, or 0 to use one per hardware thread.</param>
+<returns>SKRYPTONITE_OK on success, otherwise the reason for failure.</returns>
+*/
+skryptonite_status skryptonite_smix_all(uint8_t* data, size_t length, uint32_t elementsCount, uint32_t processingCost,
+	uint32_t threadCount);
+
+/**
+<summary>The memory SMix of one element needs when the caller provides it. Mirrors Skryptonite::Native::ScratchRequirements.</summary>
+*/
+typedef struct skryptonite_scratch_requirements
+{
+	uint64_t largeMemoryBlockBytes;
+	uint64_t bufferBytes;
+	uint32_t bufferCount;
+	uint32_t alignment;
+	uint64_t totalBytes;
+} skryptonite_scratch_requirements;
+
+/**
+<summary>Caller-owned memory for SMix of one element. Mirrors Skryptonite::Native::ScryptScratch.</summary>
+*/
+typedef struct skryptonite_scratch
+{
+	void* largeMemoryBlock;
+	void* workingBuffer;
+	void* shuffleBuffer;
+	void* rebuildBuffer;
+	void* rebuildShuffleBuffer;
+} skryptonite_scratch;
+
+/**
+<summary>Gets the exact memory skryptonite_smix_with_scratch() needs with the current time-memory trade-off factor.</summary>
+<param name="elementLengthMultiplier">The block size parameter r.</param>
+<param name="processingCost">The CPU/memory cost parameter N.</param>
+<param name="requirements">Receives the bytes of the large memory block and of each of bufferCount working buffers, the alignment
+of every region, and the bytes of one aligned region that holds them all.</param>
+<returns>SKRYPTONITE_OK on success, otherwise SKRYPTONITE_INVALID_ARGUMENT.</returns>
+*/
+skryptonite_status skryptonite_smix_scratch_requirements(uint32_t elementLengthMultiplier, uint32_t processingCost,
+	skryptonite_scratch_requirements* requirements);
+
+/**
+<summary>Divides one caller-owned region into the regions of a skryptonite_scratch, skipping bytes at the start to align it.</summary>
+<param name="region">The region, which need not be aligned.</param>
+<param name="length">The length of <paramref name="region"/>. totalBytes + alignment - 1 is always enough.</param>
+<param name="requirements">The requirements from skryptonite_smix_scratch_requirements().</param>
+<param name="scratch">Receives the regions.</param>
+<returns>SKRYPTONITE_OK on success, otherwise SKRYPTONITE_INVALID_ARGUMENT.</returns>
+*/
+skryptonite_status skryptonite_scratch_partition(void* region, size_t length, const skryptonite_scratch_requirements* requirements,
+	skryptonite_scratch* scratch);
+
+/**
+<summary>Performs SMix in place on one element of a buffer generated by PBKDF2, in caller-owned memory and without allocating.</summary>
+<param name="data">The data to process.</param>
+<param name="length">The length of <paramref name="data"/> in bytes. Must be a multiple of 128 * elementsCount.</param>
+<param name="elementsCount">The number of independent SMix elements the data is divided into (p).</param>
+<param name="processingCost">The number of elements in the large memory block and of random jumps through it (N).</param>
+<param name="elementIndex">The index of the element to mix.</param>
+<param name="scratch">The regions to mix in, sized and aligned as skryptonite_smix_scratch_requirements() says.</param>
+<returns>SKRYPTONITE_OK on success, otherwise SKRYPTONITE_INVALID_ARGUMENT.</returns>
+<remarks>The scratch memory is not counted by the memory budget and is left holding intermediate values of the derivation; erase
+it before using it for anything else. Different elements may be mixed on different threads with separate scratch memory.</remarks>
+*/
+skryptonite_status skryptonite_smix_with_scratch(uint8_t* data, size_t length, uint32_t elementsCount, uint32_t processingCost,
+	uint32_t elementIndex, const skryptonite_scratch* scratch);
+
+/**
+<summary>An SMix of one element in progress, advanced a bounded number of steps at a time.</summary>
+*/
+typedef struct skryptonite_smix_state skryptonite_smix_state;
+
+/**
+<summary>Prepares to perform SMix on one element of a buffer generated by PBKDF2 in several slices.</summary>
+<param name="data">The data to process. Must remain valid until the state is freed.</param>
+<param name="length">The length of <paramref name="data"/> in bytes. Must be a multiple of 128 * elementsCount.</param>
+<param name="elementsCount">The number of independent SMix elements the data is divided into (p).</param>
+<param name="processingCost">The number of elements in the large memory block and of random jumps through it (N).</param>
+<param name="elementIndex">The index of the element to mix.</param>
+<param name="state">Receives the state, which must be freed with skryptonite_smix_free().</param>
+<returns>SKRYPTONITE_OK on success, otherwise the reason for failure.</returns>
+<remarks>SMix takes 2 * N steps. The element is only written by the last one, so a cancelled state leaves it unchanged.</remarks>
+*/
+skryptonite_status skryptonite_smix_begin(uint8_t* data, size_t length, uint32_t elementsCount, uint32_t processingCost,
+	uint32_t elementIndex, skryptonite_smix_state** state);
+
+/**
+<summary>Performs up to the given number of SMix steps.</summary>
+<param name="state">The state.</param>
+<param name="maxSteps">The largest number of steps to perform. Must be greater than 0.</param>
+<param name="isDone">Receives 1 when no work remains because the SMix has completed or been cancelled, otherwise 0. May be null.</param>
+<returns>SKRYPTONITE_OK on success, otherwise the reason for failure.</returns>
+*/
+skryptonite_status skryptonite_smix_advance(skryptonite_smix_state* state, uint64_t maxSteps, int* isDone);
+
+/**
+<summary>Performs SMix steps until the time budget is spent or no work remains. At least one step is performed.</summary>
+<param name="state">The state.</param>
+<param name="budgetNanoseconds">The time to spend.</param>
+<param name="isDone">Receives 1 when no work remains because the SMix has completed or been cancelled, otherwise 0. May be null.</param>
+<returns>SKRYPTONITE_OK on success, otherwise the reason for failure.</returns>
+*/
+skryptonite_status skryptonite_smix_advance_for(skryptonite_smix_state* state, uint64_t budgetNanoseconds, int* isDone);
+
+/**
+<summary>Requests that the SMix stop and release its working memory. May be called from any thread, even while another is advancing it.</summary>
+*/
+void skryptonite_smix_cancel(skryptonite_smix_state* state);
+
+/**
+<summary>Reports the progress of the SMix.</summary>
+<param name="state">The state.</param>
+<param name="totalSteps">Receives the number of steps SMix takes, 2 * N. May be null.</param>
+<returns>The number of steps performed so far, equal to the total once the element holds the result.</returns>
+*/
+uint64_t skryptonite_smix_progress(const skryptonite_smix_state* state, uint64_t* totalSteps);
+
+/**
+<summary>Frees the state, abandoning the SMix if it has not completed. Does nothing when <paramref name="state"/> is null.</summary>
+*/
+void skryptonite_smix_free(skryptonite_smix_state* state);
+
+/**
+<summary>Computes a complete Scrypt key derivation as described in RFC 7914.</summary>
+<param name="password">The password. May be null when <paramref name="passwordLength"/> is 0.</param>
+<param name="passwordLength">The length of the password in bytes.</param>
+<param name="salt">The salt. May be null when <paramref name="saltLength"/> is 0.</param>
+<param name="saltLength">The length of the salt in bytes.</param>
+<param name="elementLengthMultiplier">The block size parameter r.</param>
+<param name="processingCost">The CPU/memory cost parameter N.</param>
+<param name="parallelization">The parallelization parameter p.</param>
+<param name="derivedKey">Receives the derived key.</param>
+<param name="derivedKeyLength">The length of the derived key in bytes.</param>
+<returns>SKRYPTONITE_OK on success, otherwise the reason for failure.</returns>
+<remarks>Answered from the derivation cache when skryptonite_derivation_cache_configure() has enabled it and it holds the
+derivation.</remarks>
+*/
+skryptonite_status skryptonite_scrypt(const uint8_t* password, size_t passwordLength, const uint8_t* salt, size_t saltLength,
+	uint32_t elementLengthMultiplier, uint32_t processingCost, uint32_t parallelization,
+	uint8_t* derivedKey, size_t derivedKeyLength);
+
+/**
+<summary>One password and salt pair of a batch derivation, with the memory that receives its derived key.</summary>
+*/
+typedef struct skryptonite_request
+{
+	const uint8_t* password;
+	size_t passwordLength;
+	const uint8_t* salt;
+	size_t saltLength;
+	uint8_t* derivedKey;
+	size_t derivedKeyLength;
+} skryptonite_request;
+
+/**
+<summary>Computes several Scrypt key derivations that share parameters, spreading every request's SMix elements over several threads.</summary>
+<param name="requests">The password and salt pairs to derive keys from.</param>
+<param name="requestCount">The number of entries in <paramref name="requests"/>.</param>
+<param name="elementLengthMultiplier">The block size parameter r.</param>
+<param name="processingCost">The CPU/memory cost parameter N.</param>
+<param name="parallelization">The parallelization parameter p.</param>
+<param name="threadCount">The largest number of threads to use, or 0 to use one per hardware thread.</param>
+<returns>SKRYPTONITE_OK on success, otherwise the reason for failure. No derived key is valid on failure.</returns>
+*/
+skryptonite_status skryptonite_scrypt_batch(const skryptonite_request* requests, uint32_t requestCount,
+	uint32_t elementLengthMultiplier, uint32_t processingCost, uint32_t parallelization, uint32_t threadCount);
+
+/**
+<summary>Receives the outcome of a derivation submitted with skryptonite_scrypt_submit().</summary>
+<param name="context">The context given at submission.</param>
+<param name="ticket">The ticket returned at submission.</param>
+<param name="status">SKRYPTONITE_OK, SKRYPTONITE_CANCELLED, SKRYPTONITE_OUT_OF_MEMORY or SKRYPTONITE_ERROR.</param>
+<param name="derivedKey">The derived key when status is SKRYPTONITE_OK, otherwise null. Valid only during the call, and erased
+after it.</param>
+<param name="derivedKeyLength">The length of the derived key in bytes, or 0.</param>
+*/
+typedef void (*skryptonite_completion)(void* context, uint64_t ticket, skryptonite_status status, const uint8_t* derivedKey,
+	size_t derivedKeyLength);
+
+/**
+<summary>Queues a derivation to run on the library's dispatcher thread and returns at once.</summary>
+<param name="password">The password, copied before returning. May be null when <paramref name="passwordLength"/> is 0.</param>
+<param name="passwordLength">The length of the password in bytes.</param>
+<param name="salt">The salt, copied before returning. May be null when <paramref name="saltLength"/> is 0.</param>
+<param name="saltLength">The length of the salt in bytes.</param>
+<param name="elementLengthMultiplier">The block size parameter r.</param>
+<param name="processingCost">The CPU/memory cost parameter N.</param>
+<param name="parallelization">The parallelization parameter p.</param>
+<param name="derivedKeyLength">The length of the derived key in bytes.</param>
+<param name="completion">Receives the outcome, on the dispatcher thread or on the thread that cancels the derivation. It should
+return quickly.</param>
+<param name="context">Passed to <paramref name="completion"/>.</param>
+<param name="ticket">Receives the ticket that identifies the derivation, or may be null.</param>
+<returns>SKRYPTONITE_OK when queued, SKRYPTONITE_QUEUE_FULL when the queue is at its maximum depth, or
+SKRYPTONITE_INVALID_ARGUMENT.</returns>
+<remarks>The dispatcher takes every derivation queued since it last woke, up to 64 at once, and runs those sharing parameters
+together as skryptonite_scrypt_batch() does.</remarks>
+*/
+skryptonite_status skryptonite_scrypt_submit(const uint8_t* password, size_t passwordLength, const uint8_t* salt, size_t saltLength,
+	uint32_t elementLengthMultiplier, uint32_t processingCost, uint32_t parallelization, size_t derivedKeyLength,
+	skryptonite_completion completion, void* context, uint64_t* ticket);
+
+/**
+<summary>Removes a queued derivation, whose completion then receives SKRYPTONITE_CANCELLED on the calling thread.</summary>
+<returns>1 when the derivation was still queued, 0 when it has started, finished, or was never submitted.</returns>
+*/
+int skryptonite_scrypt_cancel(uint64_t ticket);
+
+/**
+<summary>A snapshot of the derivation queue. Mirrors Skryptonite::Native::DerivationQueueStatistics.</summary>
+*/
+typedef struct skryptonite_queue_statistics
+{
+	uint32_t queueDepth;
+	uint32_t peakQueueDepth;
+	uint64_t submitted;
+	uint64_t rejected;
+	uint64_t completed;
+	uint64_t cancelled;
+	uint64_t failed;
+	uint64_t batches;
+} skryptonite_queue_statistics;
+
+/**
+<summary>Sets the most derivations that may wait in the queue, 1024 by default.</summary>
+<returns>SKRYPTONITE_OK on success, otherwise SKRYPTONITE_INVALID_ARGUMENT.</returns>
+*/
+skryptonite_status skryptonite_queue_set_max_depth(uint32_t maxDepth);
+
+/**
+<summary>Reads the state and counters of the derivation queue.</summary>
+<param name="statistics">Receives the statistics.</param>
+<returns>SKRYPTONITE_OK on success, otherwise SKRYPTONITE_INVALID_ARGUMENT.</returns>
+*/
+skryptonite_status skryptonite_queue_summary(skryptonite_queue_statistics* statistics);
+
+/**
+<summary>Waits until no submitted derivation is queued or running, for example before unloading the library.</summary>
+*/
+void skryptonite_queue_wait_idle(void);
+
+/**
+<summary>A snapshot of the derivation cache. Mirrors Skryptonite::Native::DerivationCacheStatistics.</summary>
+*/
+typedef struct skryptonite_derivation_cache_statistics
+{
+	uint64_t entries;
+	uint64_t maxEntries;
+	uint64_t hits;
+	uint64_t misses;
+	uint64_t evictions;
+	uint64_t expirations;
+	uint64_t bypasses;
+	uint64_t lockedBytes;
+} skryptonite_derivation_cache_statistics;
+
+/**
+<summary>Enables, resizes or disables the cache skryptonite_scrypt() consults, erasing every cached key. Disabled by
+default.</summary>
+<param name="maxEntries">The most derived keys to hold, least recently used first out, or 0 to disable the cache.</param>
+<param name="maxKeyLength">The longest derived key to hold, in bytes, or 0 for 64. Longer keys are derived every time.</param>
+<param name="timeToLiveMilliseconds">How long a derived key is held after it is derived.</param>
+<returns>SKRYPTONITE_OK on success, otherwise the reason for failure.</returns>
+<remarks>Entries are found by a keyed hash of the inputs rather than the inputs themselves, and the derived keys are kept in
+memory locked against paging where the operating system allows and erased when they leave the cache.</remarks>
+*/
+skryptonite_status skryptonite_derivation_cache_configure(uint32_t maxEntries, uint32_t maxKeyLength,
+	uint32_t timeToLiveMilliseconds);
+
+/**
+<summary>Erases every cached derived key, keeping the limits and the counters.</summary>
+*/
+void skryptonite_derivation_cache_clear(void);
+
+/**
+<summary>Reads the state and counters of the derivation cache.</summary>
+<param name="statistics">Receives the statistics.</param>
+<returns>SKRYPTONITE_OK on success, otherwise SKRYPTONITE_INVALID_ARGUMENT.</returns>
+*/
+skryptonite_status skryptonite_derivation_cache_summary(skryptonite_derivation_cache_statistics* statistics);
+
+/**
+<summary>Sets the number of independent SMix chains one thread interleaves to hide memory latency when the instruction set has
+no multi-buffer kernel.</summary>
+<param name="interleaveCount">The number of chains, from 1 (no interleaving, the default) to 8. Each chain needs its own
+128 * r * N bytes of memory.</param>
+<returns>SKRYPTONITE_OK on success, otherwise SKRYPTONITE_INVALID_ARGUMENT.</returns>
+*/
+skryptonite_status skryptonite_set_interleave_count(uint32_t interleaveCount);
+
+/**
+<summary>Sets how SMix treats the cache when writing and reading the large memory block in every later call.</summary>
+<param name="policy">One of the skryptonite_cache_policy values. SKRYPTONITE_CACHE_AUTOMATIC, the default, caches the large
+memory block only when it fits in half of the last-level cache.</param>
+<returns>SKRYPTONITE_OK on success, otherwise SKRYPTONITE_INVALID_ARGUMENT.</returns>
+*/
+skryptonite_status skryptonite_set_cache_policy(uint32_t policy);
+
+/**
+<summary>Sets the time-memory trade-off factor k of every later call: the large memory block keeps only every k-th element and
+rebuilds the others when they are read.</summary>
+<param name="factor">The factor. 1, the default, keeps every element. The output is unchanged, but SMix uses about 1/k of the
+memory and costs about N * (k + 3) / 2 BlockMix calls instead of 2 * N.</param>
+<returns>SKRYPTONITE_OK on success, otherwise SKRYPTONITE_INVALID_ARGUMENT.</returns>
+*/
+skryptonite_status skryptonite_set_tradeoff_factor(uint32_t factor);
+
+/**
+<summary>Finds the smallest time-memory trade-off factor whose large memory block fits in a memory budget.</summary>
+<param name="elementLengthMultiplier">The block size parameter r.</param>
+<param name="processingCost">The CPU/memory cost parameter N.</param>
+<param name="maxBytes">The largest number of bytes one large memory block may use. Every thread and interleaved chain needs its own.</param>
+<param name="factor">Receives the factor, 1 when the whole large memory block fits.</param>
+<returns>SKRYPTONITE_OK on success, otherwise SKRYPTONITE_INVALID_ARGUMENT.</returns>
+*/
+skryptonite_status skryptonite_tradeoff_factor_for_memory(uint32_t elementLengthMultiplier, uint32_t processingCost, uint64_t maxBytes,
+	uint32_t* factor);
+
+/**
+<summary>Sets the directory in which every later call keeps its large memory blocks, as memory-mapped temporary files, for
+derivations whose large memory blocks do not fit in RAM.</summary>
+<param name="directory">A directory on fast local storage as UTF-8, or null or empty to keep the large memory blocks in RAM, the
+default. Each element being mixed needs 128 * r * N bytes there, and the files are erased before they are deleted.</param>
+<returns>SKRYPTONITE_OK on success, otherwise SKRYPTONITE_ERROR when the platform cannot keep large memory blocks in files.</returns>
+<remarks>The derived key is unchanged. Derivations fail with SKRYPTONITE_OUT_OF_MEMORY when the storage is full, and with
+SKRYPTONITE_ERROR when a file cannot be created in the directory.</remarks>
+*/
+skryptonite_status skryptonite_set_storage_directory(const char* directory);
+
+/**
+<summary>Times every instruction set backend the processor supports on a short SMix with the given parameters, and makes every later
+call with the same parameters use the fastest one that reproduces known answers.</summary>
+<param name="elementLengthMultiplier">The block size parameter r.</param>
+<param name="processingCost">The CPU/memory cost parameter N. The large memory block is capped at 16 MiB per element while timing.</param>
+<param name="parallelization">The parallelization parameter p. A single SMix is timed when it is 1, and the multi-buffer path otherwise,
+and the two choices are kept apart.</param>
+<param name="instructionSet">Receives the chosen instruction set, a Skryptonite::Native::InstructionSet value of which 0 is the
+portable implementation. May be null.</param>
+<returns>SKRYPTONITE_OK on success, otherwise the reason for failure.</returns>
+<remarks>Each backend mixes the timed path four times, one warm-up and three timed runs. The choice is kept for the life of the process,
+so later calls with the same parameters return at once.</remarks>
+*/
+skryptonite_status skryptonite_autotune(uint32_t elementLengthMultiplier, uint32_t processingCost, uint32_t parallelization,
+	uint32_t* instructionSet);
+
+/**
+<summary>Reads the time skryptonite_autotune() measured for one backend.</summary>
+<param name="elementLengthMultiplier">The block size parameter r that was calibrated.</param>
+<param name="processingCost">The CPU/memory cost parameter N that was calibrated.</param>
+<param name="parallelization">The parallelization parameter p that was calibrated.</param>
+<param name="instructionSet">The backend, as returned by skryptonite_autotune().</param>
+<param name="nanosecondsPerElement">Receives the time to mix one element, or 0 when the backend produced wrong results.</param>
+<returns>SKRYPTONITE_OK on success, otherwise SKRYPTONITE_INVALID_ARGUMENT, also when the parameters were not calibrated or the
+processor lacks the backend.</returns>
+*/
+skryptonite_status skryptonite_autotune_measurement(uint32_t elementLengthMultiplier, uint32_t processingCost, uint32_t parallelization,
+	uint32_t instructionSet, double* nanosecondsPerElement);
+
+/**
+<summary>Forgets every choice made by skryptonite_autotune().</summary>
+*/
+void skryptonite_autotune_reset(void);
+
+/**
+<summary>Gets a display name for an instruction set returned by skryptonite_autotune(), such as "AVX2" or "Scalar".</summary>
+*/
+const char* skryptonite_instruction_set_name(uint32_t instructionSet);
+
+/**
+<summary>The phases of a derivation whose durations are recorded. Mirrors Skryptonite::Native::MetricsPhase.</summary>
+*/
+typedef enum skryptonite_metrics_phase
+{
+	SKRYPTONITE_PHASE_PBKDF2_EXPAND = 0,
+	SKRYPTONITE_PHASE_FILL = 1,
+	SKRYPTONITE_PHASE_MIX = 2,
+	SKRYPTONITE_PHASE_PBKDF2_COMPRESS = 3,
+	SKRYPTONITE_PHASE_SCRATCH_ACQUIRE = 4,
+	SKRYPTONITE_PHASE_SCRATCH_RELEASE = 5
+} skryptonite_metrics_phase;
+
+/**
+<summary>The events that are counted. Mirrors Skryptonite::Native::MetricsCounter.</summary>
+*/
+typedef enum skryptonite_metrics_counter
+{
+	SKRYPTONITE_COUNTER_SCRATCH_ALLOCATIONS = 0,
+	SKRYPTONITE_COUNTER_SCRATCH_ALLOCATED_BYTES = 1,
+	SKRYPTONITE_COUNTER_SCRATCH_REUSES = 2,
+	SKRYPTONITE_COUNTER_SCRATCH_ALLOCATION_FAILURES = 3,
+	SKRYPTONITE_COUNTER_DERIVATION_FAILURES = 4
+} skryptonite_metrics_counter;
+
+/**
+<summary>The processor events counted around phases. Mirrors Skryptonite::Native::HardwareEvent.</summary>
+*/
+typedef enum skryptonite_hardware_event
+{
+	SKRYPTONITE_EVENT_CYCLES = 0,
+	SKRYPTONITE_EVENT_INSTRUCTIONS = 1,
+	SKRYPTONITE_EVENT_LLC_MISSES = 2,
+	SKRYPTONITE_EVENT_DTLB_MISSES = 3,
+	SKRYPTONITE_EVENT_MEMORY_STALL_CYCLES = 4
+} skryptonite_hardware_event;
+
+/**
+<summary>A summary of a histogram of nanosecond durations. Percentiles are accurate to within 1/16 of their value.</summary>
+*/
+typedef struct skryptonite_histogram_summary
+{
+	uint64_t count;
+	uint64_t sum;
+	uint64_t min;
+	uint64_t max;
+	uint64_t p50;
+	uint64_t p90;
+	uint64_t p99;
+	uint64_t p999;
+} skryptonite_histogram_summary;
+
+/**
+<summary>The recorded durations of one phase.</summary>
+*/
+typedef struct skryptonite_phase_metrics
+{
+	skryptonite_histogram_summary wallTime;
+	skryptonite_histogram_summary cpuTime;
+	uint64_t bytes;
+} skryptonite_phase_metrics;
+
+/**
+<summary>The processor events counted during the samples of one phase that read the hardware counters.</summary>
+*/
+typedef struct skryptonite_phase_hardware_events
+{
+	uint64_t samples;
+
+	/**
+	<summary>Indexed by skryptonite_hardware_event. 0 for the events that are not available.</summary>
+	*/
+	uint64_t events[5];
+} skryptonite_phase_hardware_events;
+
+/**
+<summary>Gets whether metrics recording was compiled in with the SKRYPTONITE_ENABLE_METRICS build option.</summary>
+<returns>1 when compiled in, otherwise 0, in which case every metric reads as 0.</returns>
+*/
+int skryptonite_metrics_available(void);
+
+/**
+<summary>Turns metrics recording on (the default when compiled in) or off.</summary>
+*/
+void skryptonite_metrics_set_enabled(int enabled);
+
+/**
+<summary>Clears every metric.</summary>
+*/
+void skryptonite_metrics_reset(void);
+
+/**
+<summary>Reads the recorded durations of a phase.</summary>
+<param name="phase">One of the skryptonite_metrics_phase values.</param>
+<param name="metrics">Receives the durations.</param>
+<returns>SKRYPTONITE_OK on success, otherwise SKRYPTONITE_INVALID_ARGUMENT.</returns>
+*/
+skryptonite_status skryptonite_metrics_phase_summary(uint32_t phase, skryptonite_phase_metrics* metrics);
+
+/**
+<summary>Reads a counter.</summary>
+<param name="counter">One of the skryptonite_metrics_counter values.</param>
+<param name="value">Receives the count.</param>
+<returns>SKRYPTONITE_OK on success, otherwise SKRYPTONITE_INVALID_ARGUMENT.</returns>
+*/
+skryptonite_status skryptonite_metrics_counter_value(uint32_t counter, uint64_t* value);
+
+/**
+<summary>Gets the processor events the calling thread can count, through perf_event_open on Linux.</summary>
+<returns>One bit per skryptonite_hardware_event, or 0 when the counters are not available.</returns>
+*/
+uint32_t skryptonite_hardware_events_available(void);
+
+/**
+<summary>Turns reading the processor's counters around the PBKDF2, fill and mix phases on or off (the default). Has no effect
+unless metrics recording was compiled in.</summary>
+*/
+void skryptonite_metrics_set_hardware_counters_enabled(int enabled);
+
+/**
+<summary>Reads the processor events counted during a phase.</summary>
+<param name="phase">One of the skryptonite_metrics_phase values.</param>
+<param name="events">Receives the events.</param>
+<returns>SKRYPTONITE_OK on success, otherwise SKRYPTONITE_INVALID_ARGUMENT.</returns>
+*/
+skryptonite_status skryptonite_metrics_phase_hardware_events(uint32_t phase, skryptonite_phase_hardware_events* events);
+
+/**
+<summary>Sets the largest number of bytes of SMix scratch memory kept between derivations, freeing any kept beyond it.</summary>
+<param name="maxRetainedBytes">The limit in bytes. 0 frees scratch memory as soon as each derivation finishes.</param>
+<remarks>Keeping the memory of recent parameters avoids allocating and faulting in the large memory block on every derivation.</remarks>
+*/
+void skryptonite_scratch_set_limit(size_t maxRetainedBytes);
+
+/**
+<summary>Frees all SMix scratch memory kept between derivations.</summary>
+*/
+void skryptonite_scratch_trim(void);
+
+/**
+<summary>Gets the number of threads the persistent thread pool runs SMix elements on, including the calling thread.</summary>
+*/
+uint32_t skryptonite_thread_count(void);
+
+/**
+<summary>Sets whether the threads of the persistent thread pool are bound to processors, one per core before the second hardware
+thread of any core. Off by default; takes effect from the next derivation.</summary>
+<param name="enabled">Nonzero to bind the threads, 0 to let them run on any processor.</param>
+*/
+void skryptonite_set_thread_pinning(int enabled);
+
+/**
+<summary>How the memory budget has been used. Mirrors Skryptonite::Native::MemoryBudgetStatistics.</summary>
+*/
+typedef struct skryptonite_memory_budget_statistics
+{
+	uint64_t limitBytes;
+	uint64_t reservedBytes;
+	uint64_t peakReservedBytes;
+	uint32_t queueDepth;
+	uint32_t peakQueueDepth;
+	uint64_t admissions;
+	uint64_t waits;
+	uint64_t rejections;
+	uint64_t totalWaitNanoseconds;
+	uint64_t maxWaitNanoseconds;
+} skryptonite_memory_budget_statistics;
+
+/**
+<summary>Limits the large memory blocks of SMix elements running at the same time. An element that does not fit waits, first
+come first served, until running elements release enough memory.</summary>
+<param name="limitBytes">The limit in bytes, or 0 for none (the default). Each running element reserves 128 * r * N bytes,
+less under the time-memory trade-off.</param>
+<param name="maxWaitMilliseconds">The longest an element waits before its derivation fails with SKRYPTONITE_OUT_OF_MEMORY, or 0
+to wait as long as it takes.</param>
+<remarks>An element larger than the whole limit fails at once. Resumable SMix never waits: skryptonite_smix_begin() fails with
+SKRYPTONITE_OUT_OF_MEMORY when the element does not fit now. Scratch memory kept between derivations counts against the limit,
+and is freed as far as needed whenever an element starts or finishes.</remarks>
+*/
+void skryptonite_memory_budget_set_limit(uint64_t limitBytes, uint32_t maxWaitMilliseconds);
+
+/**
+<summary>Reads the use of the memory budget, including how many elements are waiting and how long they have waited.</summary>
+<param name="statistics">Receives the statistics.</param>
+<returns>SKRYPTONITE_OK on success, otherwise SKRYPTONITE_INVALID_ARGUMENT.</returns>
+*/
+skryptonite_status skryptonite_memory_budget_summary(skryptonite_memory_budget_statistics* statistics);
+
+/**
+<summary>Clears the counters and peaks of the memory budget.</summary>
+*/
+void skryptonite_memory_budget_reset_statistics(void);
+
+/**
+<summary>Gets the number of NUMA nodes with processors the library may run on. 1 on machines without NUMA.</summary>
+*/
+uint32_t skryptonite_numa_node_count(void);
+
+/**
+<summary>Sets whether each thread of the persistent thread pool stays on one NUMA node and takes its large memory blocks from
+that node's memory. On by default; has no effect with a single node. Takes effect from the next derivation.</summary>
+<param name="enabled">Nonzero to keep threads and their memory on one node, 0 to leave placement to the operating system.</param>
+*/
+void skryptonite_set_numa_placement(int enabled);
+
+/**
+<summary>The measured costs of one footprint of the cost model. Mirrors Skryptonite::Native::CostBand.</summary>
+*/
+typedef struct skryptonite_cost_band
+{
+	uint64_t footprintBytes;
+	double laneNanosecondsPerBlock;
+	double nanosecondsPerBlock;
+	double fillBytesPerSecond;
+	double readNanoseconds;
+} skryptonite_cost_band;
+
+/**
+<summary>The current profile of the cost model, without its bands. Mirrors Skryptonite::Native::HardwareProfile.</summary>
+*/
+typedef struct skryptonite_hardware_profile
+{
+	char processorName[64];
+	uint32_t instructionSet;
+	uint32_t laneCount;
+	double salsaBlocksPerSecond;
+	uint32_t bandCount;
+} skryptonite_hardware_profile;
+
+/**
+<summary>Measures this processor for the cost model, which takes about a second, and optionally saves the profile.</summary>
+<param name="profilePath">The profile file to save to, or null to keep the profile in memory only.</param>
+<returns>SKRYPTONITE_OK on success, SKRYPTONITE_OUT_OF_MEMORY, or SKRYPTONITE_ERROR when the file cannot be written.</returns>
+*/
+skryptonite_status skryptonite_cost_model_calibrate(const char* profilePath);
+
+/**
+<summary>Loads the profile of this processor from a file, or measures one and saves it there when the file has none.</summary>
+<param name="profilePath">The profile file, which may hold the profiles of several processors.</param>
+<returns>SKRYPTONITE_OK on success, SKRYPTONITE_INVALID_ARGUMENT when profilePath is null, SKRYPTONITE_OUT_OF_MEMORY, or
+SKRYPTONITE_ERROR when the file cannot be written.</returns>
+*/
+skryptonite_status skryptonite_cost_model_load_or_calibrate(const char* profilePath);
+
+/**
+<summary>Reads the current profile of the cost model.</summary>
+<param name="profile">Receives the profile. processorName is truncated to fit and always terminated.</param>
+<returns>SKRYPTONITE_OK on success, otherwise SKRYPTONITE_INVALID_ARGUMENT, also when there is no profile.</returns>
+*/
+skryptonite_status skryptonite_cost_model_profile(skryptonite_hardware_profile* profile);
+
+/**
+<summary>Reads one band of the current profile of the cost model.</summary>
+<param name="index">The band, smallest footprint first, below the profile's bandCount.</param>
+<param name="band">Receives the band.</param>
+<returns>SKRYPTONITE_OK on success, otherwise SKRYPTONITE_INVALID_ARGUMENT, also when there is no profile.</returns>
+*/
+skryptonite_status skryptonite_cost_model_band(uint32_t index, skryptonite_cost_band* band);
+
+/**
+<summary>Predicts the time and memory of a derivation, measuring a profile without saving it when there is none.</summary>
+<param name="elementLengthMultiplier">The block size parameter r.</param>
+<param name="processingCost">The CPU/memory cost parameter N.</param>
+<param name="parallelization">The parallelization parameter p.</param>
+<param name="threadCount">The threads the elements are spread over.</param>
+<param name="nanoseconds">Receives the predicted wall time.</param>
+<param name="bytes">Receives the predicted memory, or may be null.</param>
+<returns>SKRYPTONITE_OK on success, otherwise SKRYPTONITE_INVALID_ARGUMENT or SKRYPTONITE_OUT_OF_MEMORY.</returns>
+*/
+skryptonite_status skryptonite_cost_model_predict(uint32_t elementLengthMultiplier, uint32_t processingCost, uint32_t parallelization,
+	uint32_t threadCount, double* nanoseconds, uint64_t* bytes);
+
+/**
+<summary>Chooses N and p for a memory limit and a target time from the cost model, measuring a profile without saving it when
+there is none. Follows the rule of Scrypt.CreateOptimal without running a single derivation.</summary>
+<param name="maxMemoryBytes">The most memory one element may use, its large memory block and its data, in bytes.</param>
+<param name="targetMilliseconds">The time one derivation should take.</param>
+<param name="threadCount">The threads the elements may be spread over.</param>
+<param name="elementLengthMultiplier">The block size parameter r.</param>
+<param name="processingCost">Receives N, at least 16.</param>
+<param name="parallelization">Receives p, at least 1.</param>
+<param name="maxThreads">Receives the threads worth using, or may be null.</param>
+<returns>SKRYPTONITE_OK on success, otherwise SKRYPTONITE_INVALID_ARGUMENT, or SKRYPTONITE_OUT_OF_MEMORY when the memory limit is
+too small for an element with N = 16 or a profile cannot be measured.</returns>
+*/
+skryptonite_status skryptonite_cost_model_optimal(uint64_t maxMemoryBytes, uint32_t targetMilliseconds, uint32_t threadCount,
+	uint32_t elementLengthMultiplier, uint32_t* processingCost, uint32_t* parallelization, uint32_t* maxThreads);
+
+/**
+<summary>Forgets the current profile of the cost model.</summary>
+*/
+void skryptonite_cost_model_reset(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,386 @@
+/**
+* Skryptonite - Scrypt library for UWP
+* Copyright © 2016 Nicholas C. Bauer, Ph.D.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "pch.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <stdexcept>
+#include <system_error>
+
+#if defined(_WIN32) && !defined(__cplusplus_winrt)
+#define SKRYPTONITE_WIN32_AFFINITY
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#elif defined(__linux__)
+#define SKRYPTONITE_LINUX_AFFINITY
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+using namespace Skryptonite::Native;
+
+// set on every thread while it runs indices of a loop, so loops started from inside one run inline instead of waiting for themselves
+static thread_local bool IsInLoop = false;
+
+ThreadPool& ThreadPool::Global()
+{
+	// never destroyed: joining threads while the process or library is unloading can deadlock
+	static ThreadPool* pool = new ThreadPool(0);
+	return *pool;
+}
+
+ThreadPool::ThreadPool(unsigned threadCount) :
+	_threadCount(threadCount > 0 ? threadCount : (std::max)(std::thread::hardware_concurrency(), 1u)),
+	_pinThreads(false),
+	_numaPlacement(true),
+	_nodeCount(1),
+	_isShuttingDown(false)
+{
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_isShuttingDown = true;
+	}
+
+	_wake.notify_all();
+
+	for (auto& worker : _workers)
+		worker->thread.join();
+}
+
+unsigned ThreadPool::ThreadCount() const
+{
+	return _threadCount;
+}
+
+bool ThreadPool::PinThreads() const
+{
+	return _pinThreads;
+}
+
+void ThreadPool::SetPinThreads(bool value)
+{
+	_pinThreads = value;
+}
+
+bool ThreadPool::NumaPlacement() const
+{
+	return _numaPlacement;
+}
+
+void ThreadPool::SetNumaPlacement(bool value)
+{
+	_numaPlacement = value;
+}
+
+unsigned ThreadPool::WorkerNode(unsigned index)
+{
+	std::lock_guard<std::mutex> lock(_runMutex);
+	StartWorkers();
+
+	if (index >= _workers.size())
+		throw std::out_of_range("index must be less than the number of workers.");
+
+	return _workers[index]->node;
+}
+
+void ThreadPool::TrimScratch()
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+
+	for (auto& worker : _workers)
+		worker->scratch.Trim();
+}
+
+void ThreadPool::Run(size_t count, unsigned threadCount, const std::function<void(size_t)>& function)
+{
+	if (count == 0)
+		return;
+	if (threadCount == 0 || threadCount > _threadCount)
+		threadCount = _threadCount;
+	if (threadCount > count)
+		threadCount = static_cast<unsigned>(count);
+
+	// a nested loop runs on the calling thread, since the workers it would wait for may be running the loop it is part of
+	if (threadCount == 1 || IsInLoop)
+	{
+		for (size_t i = 0; i < count; i++)
+			function(i);
+		return;
+	}
+
+	std::unique_lock<std::mutex> runLock(_runMutex);
+	StartWorkers();
+
+	// run with the workers that could be started
+	threadCount = (std::min)(threadCount, static_cast<unsigned>(_workers.size()) + 1);
+
+	Loop loop;
+	loop.function = &function;
+	loop.shares.reset(new Share[threadCount]);
+	loop.threadCount = threadCount;
+	loop.activeWorkers = 0;
+	loop.isJoined.reset(new bool[threadCount]());
+	loop.isStopped = false;
+
+	for (unsigned s = 0; s < threadCount; s++)
+	{
+		loop.shares[s].begin = count / threadCount * s + (std::min)(static_cast<size_t>(s), count % threadCount);
+		loop.shares[s].end = count / threadCount * (s + 1) + (std::min)(static_cast<size_t>(s + 1), count % threadCount);
+	}
+
+	// the workers keep buffers under the same rules and within the same limit as the shared pool, on their own node
+	bool eraseOnRelease = ScratchPool::Global().EraseOnRelease();
+	bool isPlaced = _numaPlacement && _nodeCount > 1;
+
+	for (unsigned w = 0; w < threadCount - 1; w++)
+	{
+		_workers[w]->scratch.SetEraseOnRelease(eraseOnRelease);
+		_workers[w]->scratch.SetNode(isPlaced ? static_cast<int>(_workers[w]->node) : -1);
+	}
+
+	runLock.unlock();
+
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_loops.push_back(&loop);
+	}
+
+	_wake.notify_all();
+
+	IsInLoop = true;
+	RunShare(loop, 0);
+	IsInLoop = false;
+
+	// no index is left to start, so workers that have not joined yet need not; the loop lives on this stack until those that
+	// did have finished theirs
+	{
+		std::unique_lock<std::mutex> lock(_mutex);
+		_loops.erase(std::find(_loops.begin(), _loops.end(), &loop));
+		_done.wait(lock, [&]() { return loop.activeWorkers == 0; });
+	}
+
+	if (loop.error)
+		std::rethrow_exception(loop.error);
+}
+
+void ThreadPool::StartWorkers()
+{
+	if (_workers.size() + 1 >= _threadCount)
+		return;
+
+	if (_processorOrder.empty())
+	{
+		_processorOrder = ProcessorTopology::ProcessorOrder();
+		_nodeCount = ProcessorTopology::NodeCount();
+
+		for (unsigned processor : _processorOrder)
+			_processorNodes.push_back(ProcessorTopology::NodeOfProcessor(processor));
+	}
+
+	std::lock_guard<std::mutex> lock(_mutex);
+
+	try
+	{
+		while (_workers.size() + 1 < _threadCount)
+		{
+			auto worker = std::make_unique<Worker>();
+			unsigned index = static_cast<unsigned>(_workers.size());
+
+			// worker 0 shares the first processor with nothing but the unbound calling thread
+			worker->node = _processorNodes.empty() ? 0 : _processorNodes[(index + 1) % _processorNodes.size()];
+			worker->binding = Binding::Any;
+
+			// loops that started before the worker existed have no share for it, however late the thread gets going
+			worker->thread = std::thread(&ThreadPool::WorkerMain, this, index);
+			_workers.push_back(std::move(worker));
+		}
+	}
+	catch (const std::system_error&)
+	{
+		// no more threads can be started now; the next loop tries again
+	}
+}
+
+void ThreadPool::WorkerMain(unsigned index)
+{
+	Worker* worker;
+
+	IsInLoop = true;
+
+	for (;;)
+	{
+		Loop* loop;
+
+		{
+			std::unique_lock<std::mutex> lock(_mutex);
+			_wake.wait(lock, [&]() { return _isShuttingDown || NextLoop(index) != nullptr; });
+
+			if (_isShuttingDown)
+				return;
+
+			loop = NextLoop(index);
+			loop->isJoined[index + 1] = true;
+			loop->activeWorkers++;
+			worker = _workers[index].get();
+		}
+
+		ScratchPool::SetCurrent(&worker->scratch);
+
+		Binding binding = _pinThreads ? Binding::Processor : _numaPlacement && _nodeCount > 1 ? Binding::Node : Binding::Any;
+		if (binding != worker->binding && !_processorOrder.empty())
+		{
+			BindCurrentThread(ProcessorsFor(index, binding));
+			worker->binding = binding;
+		}
+
+		RunShare(*loop, index + 1);
+
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			if (--loop->activeWorkers == 0)
+				_done.notify_all();
+		}
+	}
+}
+
+ThreadPool::Loop* ThreadPool::NextLoop(unsigned index) const
+{
+	for (Loop* loop : _loops)
+	{
+		if (index + 1 < loop->threadCount && !loop->isJoined[index + 1] && !loop->isStopped)
+			return loop;
+	}
+
+	return nullptr;
+}
+
+void ThreadPool::RunShare(Loop& loop, unsigned shareIndex)
+{
+	size_t index;
+
+	while (!loop.isStopped && (TakeOwn(loop.shares[shareIndex], index) || Steal(loop, shareIndex, index)))
+	{
+		try
+		{
+			(*loop.function)(index);
+		}
+		catch (...)
+		{
+			std::lock_guard<std::mutex> lock(loop.errorMutex);
+			if (!loop.error)
+				loop.error = std::current_exception();
+			loop.isStopped = true;
+		}
+	}
+}
+
+bool ThreadPool::TakeOwn(Share& share, size_t& index)
+{
+	std::lock_guard<std::mutex> lock(share.mutex);
+
+	if (share.begin == share.end)
+		return false;
+
+	index = share.begin++;
+	return true;
+}
+
+bool ThreadPool::Steal(Loop& loop, unsigned shareIndex, size_t& index)
+{
+	for (unsigned offset = 1; offset < loop.threadCount; offset++)
+	{
+		Share& victim = loop.shares[(shareIndex + offset) % loop.threadCount];
+		size_t first;
+		size_t end;
+
+		{
+			std::lock_guard<std::mutex> lock(victim.mutex);
+
+			size_t remaining = victim.end - victim.begin;
+			if (remaining == 0)
+				continue;
+
+			end = victim.end;
+			first = end - (remaining + 1) / 2;
+			victim.end = first;
+		}
+
+		// the share is empty, so other threads only look at it until it is refilled
+		Share& own = loop.shares[shareIndex];
+		std::lock_guard<std::mutex> lock(own.mutex);
+		own.begin = first + 1;
+		own.end = end;
+
+		index = first;
+		return true;
+	}
+
+	return false;
+}
+
+std::vector<unsigned> ThreadPool::ProcessorsFor(unsigned index, Binding binding) const
+{
+	size_t position = (index + 1) % _processorOrder.size();
+
+	switch (binding)
+	{
+	case Binding::Processor:
+		return std::vector<unsigned>(1, _processorOrder[position]);
+	case Binding::Node:
+	{
+		std::vector<unsigned> processors;
+		for (size_t i = 0; i < _processorOrder.size(); i++)
+			if (_processorNodes[i] == _processorNodes[position])
+				processors.push_back(_processorOrder[i]);
+		return processors;
+	}
+	default:
+		return _processorOrder;
+	}
+}
+
+void ThreadPool::BindCurrentThread(const std::vector<unsigned>& processors)
+{
+#if defined(SKRYPTONITE_LINUX_AFFINITY)
+	cpu_set_t mask;
+	CPU_ZERO(&mask);
+
+	for (unsigned p : processors)
+		if (p < CPU_SETSIZE)
+			CPU_SET(p, &mask);
+
+	// binding is only a hint; a refusal leaves the thread where it was
+	pthread_setaffinity_np(pthread_self(), sizeof(mask), &mask);
+#elif defined(SKRYPTONITE_WIN32_AFFINITY)
+	DWORD_PTR mask = 0;
+
+	for (unsigned p : processors)
+		if (p < sizeof(DWORD_PTR) * 8)
+			mask |= static_cast<DWORD_PTR>(1) << p;
+
+	if (mask != 0)
+		SetThreadAffinityMask(GetCurrentThread(), mask);
+#else
+	(void)processors;
+#endif
+}
@@ -0,0 +1,254 @@
+/**
+* Skryptonite - Scrypt library for UWP
+* Copyright © 2016 Nicholas C. Bauer, Ph.D.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#pragma once
+#include "Platform.h"
+#include "ScratchPool.h"
+#include "ProcessorTopology.h"
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Skryptonite
+{
+	namespace Native
+	{
+		/**
+		<summary>A set of persistent worker threads that share out the indices of a loop, stealing from each other when their own
+		share runs out.</summary>
+		<remarks>
+		Every call to <see cref="Run"/> splits the indices evenly between the calling thread and the workers. Each thread takes its own
+		indices from the front of its share; a thread whose share is empty takes the back half of the next share that has
+		indices left. SMix elements all cost the same, so stealing mostly evens out threads that were descheduled or started late.
+		Workers are started by the first call and wait between calls, so a derivation does not pay for creating threads.
+		Every worker mixes with its own <see cref="ScratchPool"/>, so its large memory blocks are reused by the same thread,
+		without contending for the lock of the shared pool, and are faulted in by the processor that uses them. What the workers
+		keep counts against the limit of the shared pool.
+		On a machine with several NUMA nodes, each worker is assigned a node in turn, runs on that node's processors and
+		takes its memory from that node, unless <see cref="SetNumaPlacement"/> turns this off.
+		</remarks>
+		*/
+		class ThreadPool
+		{
+		public:
+			/**
+			<summary>Gets the pool used by every engine, with one thread per hardware thread.</summary>
+			*/
+			static ThreadPool& Global();
+
+			/**
+			<summary>Creates a pool. No thread is started until the first call to <see cref="Run"/>.</summary>
+			<param name="threadCount">The number of threads that run each loop, including the calling thread, or 0 for one per
+			hardware thread.</param>
+			*/
+			explicit ThreadPool(unsigned threadCount);
+
+			/**
+			<summary>Stops and joins the workers.</summary>
+			*/
+			~ThreadPool();
+
+			ThreadPool(const ThreadPool&) = delete;
+			ThreadPool& operator=(const ThreadPool&) = delete;
+
+			/**
+			<summary>Gets the number of threads that run each loop, including the calling thread.</summary>
+			*/
+			unsigned ThreadCount() const;
+
+			/**
+			<summary>Runs a function once for every index in [0, count) on up to threadCount threads, including the calling thread.</summary>
+			<param name="count">The number of indices.</param>
+			<param name="threadCount">The largest number of threads to use, or 0 to use all of them.</param>
+			<param name="function">The function to run. Called concurrently from several threads.</param>
+			<remarks>
+			The first exception thrown stops further indices from being started and is rethrown once every thread has finished.
+			Loops started by several callers at once run side by side: each caller works through its own loop, and every worker
+			joins the oldest loop it has not yet joined, so a worker that finishes its part of one loop helps with the next. A loop
+			started from inside another loop runs on the calling thread alone, since the workers may all be waiting on it.
+			</remarks>
+			*/
+			void Run(size_t count, unsigned threadCount, const std::function<void(size_t)>& function);
+
+			/**
+			<summary>Gets whether workers are bound to processors.</summary>
+			*/
+			bool PinThreads() const;
+
+			/**
+			<summary>Sets whether workers are bound to processors, taking effect at the start of the next loop.</summary>
+			<remarks>
+			Workers are bound in the order of <see cref="ProcessorTopology::ProcessorOrder"/>, so they occupy one hardware thread of
+			every core before sharing a core with another worker, and they stay near the large memory blocks they reuse. The calling
+			thread is never bound. Off by default, since other work on the machine may want the same processors.
+			</remarks>
+			*/
+			void SetPinThreads(bool value);
+
+			/**
+			<summary>Frees every buffer kept by the scratch pools of the workers.</summary>
+			*/
+			void TrimScratch();
+
+			/**
+			<summary>Gets whether workers are kept on the NUMA node of the memory they mix with.</summary>
+			*/
+			bool NumaPlacement() const;
+
+			/**
+			<summary>Sets whether workers are kept on the NUMA node of the memory they mix with, taking effect at the start of the
+			next loop.</summary>
+			<remarks>
+			On by default. Has no effect on a machine with a single node. Workers take turns between nodes, so the threads of any
+			loop divide the memory bandwidth of every node. A worker bound by <see cref="SetPinThreads"/> runs on a processor of
+			its node.
+			</remarks>
+			*/
+			void SetNumaPlacement(bool value);
+
+			/**
+			<summary>Gets the NUMA node of the memory a worker mixes with.</summary>
+			<param name="index">The index of the worker, from 0 to <see cref="ThreadCount"/> - 2.</param>
+			*/
+			unsigned WorkerNode(unsigned index);
+
+		private:
+			/**
+			<summary>The indices one thread has not yet started.</summary>
+			*/
+			struct Share
+			{
+				std::mutex mutex;
+				size_t begin;
+				size_t end;
+			};
+
+			/**
+			<summary>One call to <see cref="Run"/>.</summary>
+			*/
+			struct Loop
+			{
+				const std::function<void(size_t)>* function;
+				std::unique_ptr<Share[]> shares;
+				unsigned threadCount;
+
+				// guarded by the pool's mutex: the workers running indices of the loop, and the shares whose worker has joined it
+				unsigned activeWorkers;
+				std::unique_ptr<bool[]> isJoined;
+
+				std::atomic<bool> isStopped;
+				std::exception_ptr error;
+				std::mutex errorMutex;
+			};
+
+			/**
+			<summary>The processors a worker is allowed to run on.</summary>
+			*/
+			enum class Binding
+			{
+				Any,
+				Node,
+				Processor
+			};
+
+			/**
+			<summary>A persistent thread and the memory it mixes with, kept under the limit of the shared pool.</summary>
+			*/
+			struct Worker
+			{
+				Worker() :
+					scratch(ScratchPool::Global())
+				{
+				}
+
+				std::thread thread;
+				ScratchPool scratch;
+				unsigned node;
+				Binding binding;
+			};
+
+			unsigned _threadCount;
+			std::atomic<bool> _pinThreads;
+			std::atomic<bool> _numaPlacement;
+			std::vector<unsigned> _processorOrder;
+			std::vector<unsigned> _processorNodes;
+			unsigned _nodeCount;
+
+			// held while the workers are started and prepared for a loop
+			std::mutex _runMutex;
+
+			std::mutex _mutex;
+			std::condition_variable _wake;
+			std::condition_variable _done;
+			std::vector<std::unique_ptr<Worker>> _workers;
+
+			// the loops whose callers are still running them, oldest first
+			std::vector<Loop*> _loops;
+			bool _isShuttingDown;
+
+			/**
+			<summary>Starts the workers that are not running yet. The caller must hold the run mutex.</summary>
+			*/
+			void StartWorkers();
+
+			/**
+			<summary>The body of worker <paramref name="index"/>, whose share in a loop is share index + 1.</summary>
+			<param name="index">The index of the worker.</param>
+			*/
+			void WorkerMain(unsigned index);
+
+			/**
+			<summary>Gets the oldest loop that worker <paramref name="index"/> has a share in and has not joined. The caller must
+			hold the mutex.</summary>
+			<returns>The loop, or null when there is none.</returns>
+			*/
+			Loop* NextLoop(unsigned index) const;
+
+			/**
+			<summary>Runs indices of a loop, first from the given share and then from the others, until none remain.</summary>
+			*/
+			static void RunShare(Loop& loop, unsigned shareIndex);
+
+			/**
+			<summary>Takes the next index of a share.</summary>
+			<returns>True when the share had an index left.</returns>
+			*/
+			static bool TakeOwn(Share& share, size_t& index);
+
+			/**
+			<summary>Moves the back half of the next other share with indices left into the given one and takes its first index.</summary>
+			<returns>True when another share had an index left.</returns>
+			*/
+			static bool Steal(Loop& loop, unsigned shareIndex, size_t& index);
+
+			/**
+			<summary>Gets the processors a worker should run on.</summary>
+			*/
+			std::vector<unsigned> ProcessorsFor(unsigned index, Binding binding) const;
+
+			/**
+			<summary>Restricts the calling thread to the given processors.</summary>
+			*/
+			static void BindCurrentThread(const std::vector<unsigned>& processors);
+		};
+	}
+}
@@ -1,4 +1,6 @@
 ﻿#pragma once
 
+#if defined(__cplusplus_winrt)
 #include <collection.h>
 #include <ppltasks.h>
+#endif
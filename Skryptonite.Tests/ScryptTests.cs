@@ -136,6 +136,104 @@ namespace Skryptonite.Tests
                 );
         }
 
+        [TestMethod]
+        public void DeriveKeys_Matches_DeriveKey()
+        {
+            var scrypt = new Scrypt(2, 64, 3);
+            var keys = new IBuffer[11];
+            var salts = new IBuffer[11];
+
+            for (int i = 0; i < keys.Length; i++)
+            {
+                keys[i] = ConvertStringToBinary("password" + i, BinaryStringEncoding.Utf8);
+                salts[i] = ConvertStringToBinary(new string('s', i), BinaryStringEncoding.Utf8);
+            }
+
+            var derivedKeys = scrypt.DeriveKeys(keys, salts, 64);
+
+            Assert.AreEqual(keys.Length, derivedKeys.Count);
+            for (int i = 0; i < keys.Length; i++)
+                Assert.AreEqual(EncodeToHexString(scrypt.DeriveKey(keys[i], salts[i], 64)), EncodeToHexString(derivedKeys[i]));
+        }
+
+        [TestMethod]
+        public void DeriveKey_Matches_For_Every_Cache_Policy()
+        {
+            var key = ConvertStringToBinary("password", BinaryStringEncoding.Utf8);
+            var salt = ConvertStringToBinary("NaCl", BinaryStringEncoding.Utf8);
+            string expected = EncodeToHexString(new Scrypt(2, 64, 3).DeriveKey(key, salt, 64));
+
+            foreach (CachePolicy policy in Enum.GetValues(typeof(CachePolicy)))
+            {
+                var scrypt = new Scrypt(2, 64, 3) { CachePolicy = policy };
+                Assert.AreEqual(expected, EncodeToHexString(scrypt.DeriveKey(key, salt, 64)));
+            }
+        }
+
+        [TestMethod]
+        public void DeriveKey_Matches_For_Every_Trade_Off_Factor()
+        {
+            var key = ConvertStringToBinary("password", BinaryStringEncoding.Utf8);
+            var salt = ConvertStringToBinary("NaCl", BinaryStringEncoding.Utf8);
+            string expected = EncodeToHexString(new Scrypt(2, 64, 3).DeriveKey(key, salt, 64));
+
+            foreach (uint factor in new uint[] { 2, 3, 64, 100 })
+            {
+                var scrypt = new Scrypt(2, 64, 3) { TradeOffFactor = factor };
+                Assert.AreEqual(expected, EncodeToHexString(scrypt.DeriveKey(key, salt, 64)));
+            }
+
+            Assert.ThrowsException<ArgumentOutOfRangeException>(() => new Scrypt(2, 64, 3) { TradeOffFactor = 0 });
+            Assert.AreEqual(11u, ScryptCore.TradeOffFactorForMemory(8, 1024, 1024 * 100));
+        }
+
+        [TestMethod]
+        public void DeriveKeys_Throws_On_Bad_Parameters()
+        {
+            var empty = new Windows.Storage.Streams.Buffer(0);
+
+            Assert.ThrowsException<ArgumentNullException>(
+                    () => new Scrypt(1, 16, 1).DeriveKeys(null, new IBuffer[] { empty }, 64)
+                );
+            Assert.ThrowsException<ArgumentNullException>(
+                    () => new Scrypt(1, 16, 1).DeriveKeys(new IBuffer[] { empty }, new IBuffer[] { null }, 64)
+                );
+            Assert.ThrowsException<ArgumentException>(
+                    () => new Scrypt(1, 16, 1).DeriveKeys(new IBuffer[] { empty }, new IBuffer[] { empty, empty }, 64)
+                );
+            Assert.ThrowsException<ArgumentOutOfRangeException>(
+                    () => new Scrypt(1, 16, 1).DeriveKeys(new IBuffer[] { empty }, new IBuffer[] { empty }, 0)
+                );
+        }
+
+        [TestMethod]
+        public void ResumableSMix_Matches_SMix()
+        {
+            byte[] bytes;
+            CopyToByteArray(GenerateRandom(256 * 2), out bytes);
+
+            IBuffer expectedBuffer = CreateFromByteArray(bytes);
+            new ScryptCore(expectedBuffer, 2, 64).SMixRange(0, 2);
+
+            IBuffer buffer = CreateFromByteArray(bytes);
+            var core = new ScryptCore(buffer, 2, 64);
+            var stepped = core.BeginSMix(0);
+            var timed = core.BeginSMix(1);
+
+            Assert.AreEqual(128ul, stepped.TotalSteps);
+            while (!stepped.Advance(10)) ;
+            while (!timed.AdvanceFor(TimeSpan.FromMilliseconds(1))) ;
+
+            Assert.IsTrue(stepped.IsCompleted && timed.IsCompleted);
+            Assert.AreEqual(EncodeToHexString(expectedBuffer), EncodeToHexString(buffer));
+
+            var cancelled = new ScryptCore(CreateFromByteArray(bytes), 2, 64).BeginSMix(0);
+            cancelled.Cancel();
+            Assert.IsTrue(cancelled.Advance(1));
+            Assert.IsTrue(cancelled.IsCancelled);
+            Assert.AreEqual(0ul, cancelled.CompletedSteps);
+        }
+
 #if X86_64
         [TestMethod]
         public void Scrypt_Test_Vectors_AVX2()
@@ -171,6 +269,30 @@ namespace Skryptonite.Tests
             DetectInstructionSet.MaxInstructionSet = InstructionSet.SSE2;
             Scrypt_Test_Vectors();
         }
+
+        [TestMethod]
+        public void ScryptCore_SMixLanes_Matches_SMix()
+        {
+            DetectInstructionSet.MaxInstructionSet = InstructionSet.AVX2;
+
+            byte[] bytes;
+            CopyToByteArray(GenerateRandom(256 * 2), out bytes);
+
+            IBuffer sequentialBuffer = CreateFromByteArray(bytes);
+            var sequential = new ScryptCore(sequentialBuffer, 2, 64);
+            sequential.SMix(0);
+            sequential.SMix(1);
+
+            IBuffer buffer1 = CreateFromByteArray(bytes);
+            IBuffer buffer2 = CreateFromByteArray(bytes);
+            var core1 = new ScryptCore(buffer1, 2, 64);
+            var core2 = new ScryptCore(buffer2, 2, 64);
+            ScryptCore.SMixLanes(new[] { core1, core2, core1, core2 }, new uint[] { 0, 0, 1, 1 });
+
+            Assert.AreEqual((uint)8, core1.LaneCount);
+            Assert.AreEqual(EncodeToHexString(sequentialBuffer), EncodeToHexString(buffer1));
+            Assert.AreEqual(EncodeToHexString(sequentialBuffer), EncodeToHexString(buffer2));
+        }
 #elif ARM
         [TestMethod]
         public void Scrypt_Test_Vectors_NEON()
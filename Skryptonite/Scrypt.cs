@@ -17,14 +17,18 @@
  */
 using Skryptonite.Native;
 using System;
+using System.Collections.Generic;
 using System.Diagnostics;
 using System.Diagnostics.Contracts;
 using System.IO;
+using System.Linq;
+using System.Runtime.InteropServices;
 using System.Runtime.InteropServices.WindowsRuntime;
+using System.Threading;
 using System.Threading.Tasks;
 using Windows.ApplicationModel;
 using Windows.Security.Cryptography;
-using Windows.Security.Cryptography.Core;
+using Windows.Storage;
 using Windows.Storage.Streams;
 using Windows.System;
 using static Windows.Security.Cryptography.CryptographicBuffer;
@@ -53,7 +57,7 @@ namespace Skryptonite
         #region Private Constants
 
         const uint DefaultElementLengthMultiplier = 16;
-        static readonly KeyDerivationAlgorithmProvider pbkdf2Sha256 = KeyDerivationAlgorithmProvider.OpenAlgorithm(KeyDerivationAlgorithmNames.Pbkdf2Sha256);
+        const string CostModelFileName = "Skryptonite.profile";
         static readonly bool Is64bit = Package.Current.Id.Architecture == ProcessorArchitecture.X64;
         static readonly ulong memoryLimit = Is64bit ? ulong.MaxValue : uint.MaxValue;
 
@@ -63,6 +67,7 @@ namespace Skryptonite
 
         uint processingCost;
         int maxThreads = 1;
+        uint tradeOffFactor = 1;
 
         #endregion
 
@@ -138,6 +143,34 @@ namespace Skryptonite
             }
         }
 
+        /// <summary>
+        /// Gets or sets how the large memory block is treated by the cache. <see cref="CachePolicy.Automatic"/>, the default, caches it
+        /// only when it fits comfortably in the last-level cache and otherwise streams it past the cache.
+        /// </summary>
+        public CachePolicy CachePolicy { get; set; } = CachePolicy.Automatic;
+
+        /// <summary>
+        /// Gets or sets the time-memory trade-off factor k. The large memory block keeps only every k-th element and rebuilds the others when they
+        /// are read, so it uses about 1 / k of the memory while SMix costs about <see cref="ProcessingCost"/> * (k + 3) / 2 BlockMix calls instead
+        /// of 2 * <see cref="ProcessingCost"/>. The derived key is unchanged. 1, the default, keeps every element.
+        /// </summary>
+        /// <exception cref="ArgumentOutOfRangeException">Thrown when the value to be set is 0.</exception>
+        public uint TradeOffFactor
+        {
+            get
+            {
+                Contract.Ensures(Contract.Result<uint>() > 0);
+                return tradeOffFactor;
+            }
+            set
+            {
+                if (value == 0)
+                    throw new ArgumentOutOfRangeException(nameof(value), value, "Must be > 0.");
+
+                tradeOffFactor = value;
+            }
+        }
+
         #endregion
 
         #region Derived Parameters
@@ -207,96 +240,80 @@ namespace Skryptonite
         /// <summary>
         /// Produces a <see cref="Scrypt"/> with factors optimized for memory usage and time.
         /// </summary>
-        /// <param name="desiredMemoryUsage">The desired large memory block size, in bytes.</param>
+        /// <param name="desiredMemoryUsage">The desired memory usage of one element, its large memory block and its 2 kB of data, in bytes.</param>
         /// <param name="desiredComputationTime">The desired amount of computation time to use, in milliseconds.</param>
-        /// <returns>The optimized Scrypt object. May be null in the event that your device is severely constrained (less than ~32 kB available
-        /// for the large memory block.)</returns>
+        /// <returns>The optimized Scrypt object, or null if <paramref name="desiredMemoryUsage"/> is too small for the smallest parameters
+        /// (less than 34 kB) or the cost model cannot be measured.</returns>
         /// <remarks>
-        /// The amount of memory consumed by the large memory block is guaranteed to be as close to <paramref name="desiredMemoryUsage"/> as possible
-        /// without going over, though will not be less than 32 kB. At least 16 MB is recommended.
+        /// The amount of memory consumed by one element is guaranteed to be as close to <paramref name="desiredMemoryUsage"/> as possible
+        /// without going over; the smallest parameters need 32 kB for the large memory block plus 2 kB of data, and a smaller limit yields null
+        /// rather than parameters that exceed it. At least 16 MB is recommended.
         /// The desired computation time will be met as closely as possible. Be aware that other processes running on your device can affect the
         /// output parameters; if your system is under heavy load, the parameters chosen will be weaker than those chosen when your system is idle.
         /// The amount of memory consumed by the large memory block will be reduced if necessary to match the time constraint.
         /// Automatically accounts for multithreaded processing.
+        /// The parameters are predicted from a cost model of the processor rather than found by running derivations. The model is measured
+        /// on the first call and saved in the app's local folder, so later calls, also in later sessions, return in microseconds.
         /// </remarks>
         public static Scrypt CreateOptimal(uint desiredMemoryUsage, uint desiredComputationTime)
         {
             Contract.Ensures(Contract.Result<Scrypt>() == null || Contract.Result<Scrypt>().ElementLengthMultiplier == DefaultElementLengthMultiplier);
             Contract.Ensures(Contract.Result<Scrypt>() == null || Contract.Result<Scrypt>().ProcessingCost >= 16);
 
-            uint minProcessingCost = 16;
-            uint maxProcessingCost = Math.Max(minProcessingCost, desiredMemoryUsage / (ElementUnitLength * DefaultElementLengthMultiplier));
-            uint targetProcessingCost = minProcessingCost;
-
-            IBuffer password = ConvertStringToBinary("password", BinaryStringEncoding.Utf8);
-            IBuffer salt = ConvertStringToBinary("salt", BinaryStringEncoding.Utf8);
-
-            var timer = new Stopwatch();
-
-            Scrypt scrypt;
-
-            bool noMoreMemory = false;
-            uint oneIterationMilliseconds = 0;
-
-            // determine the optimal processing cost parameter
-            for (uint i = minProcessingCost; i <= maxProcessingCost; i *= 2)
+            // the cost model is measured once per processor and kept with the app, so only the first call takes about a second
+            try
             {
-                scrypt = new Scrypt(DefaultElementLengthMultiplier, i, 1);
-
-                try
-                {
-                    timer.Restart();
-                    scrypt.DeriveKey(password, salt, 32);
-                    timer.Stop();
-
-                    Contract.Assume(timer.ElapsedMilliseconds <= uint.MaxValue);
-
-                    oneIterationMilliseconds = (uint)timer.ElapsedMilliseconds;
-                    targetProcessingCost = i;
-
-                    if (oneIterationMilliseconds > desiredComputationTime)
-                        break;
-                }
-                catch (OutOfMemoryException)
-                {
-                    if (i == minProcessingCost)
-                        return null;
-
-                    noMoreMemory = true;                    
-                    break;
-                }
+                ScryptCore.LoadCostModel(Path.Combine(ApplicationData.Current.LocalFolder.Path, CostModelFileName));
             }
-
-            uint threadedIterationMilliseconds = oneIterationMilliseconds;
-
-            // determine how much parallel processing is possible within memory constraints
-            int threads = noMoreMemory ? 1 : Math.Max(1, Environment.ProcessorCount - 1);
-            while (threads > 1)
+            catch (OutOfMemoryException)
             {
-                try
-                {
-                    scrypt = new Scrypt(DefaultElementLengthMultiplier, targetProcessingCost, (uint)threads) { MaxThreads = threads };
-                    timer.Restart();
-                    scrypt.DeriveKey(password, salt, 32);
-                    timer.Stop();
-
-                    Contract.Assume(timer.ElapsedMilliseconds <= uint.MaxValue);
+                return null;
+            }
+            catch (Exception)
+            {
+                // without app data the profile is measured by ChooseParameters and kept in memory only
+            }
 
-                    threadedIterationMilliseconds = (uint)timer.ElapsedMilliseconds;
+            int threads = Math.Max(1, Environment.ProcessorCount - 1);
+            uint targetProcessingCost;
+            uint targetParallelization;
 
-                    break;
-                }
-                catch (OutOfMemoryException)
-                {
-                    threads--;
-                }
+            try
+            {
+                ScryptCore.ChooseParameters(Math.Max(1u, desiredMemoryUsage), Math.Max(1u, desiredComputationTime), (uint)threads,
+                    DefaultElementLengthMultiplier, out targetProcessingCost, out targetParallelization);
+            }
+            catch (OutOfMemoryException)
+            {
+                return null;
             }
-
-            uint targetParallelization = Math.Max(1, (uint)threads * desiredComputationTime / threadedIterationMilliseconds);
 
             return new Scrypt(DefaultElementLengthMultiplier, targetProcessingCost, targetParallelization) { MaxThreads = (int)Math.Min(threads, targetParallelization) };
         }
 
+        /// <summary>
+        /// Keeps recently derived keys so that <see cref="DeriveKey"/> answers repeated derivations with the same inputs without running Scrypt.
+        /// </summary>
+        /// <param name="maxEntries">The most derived keys to hold, least recently used first out, or 0 to disable the cache (the default).</param>
+        /// <param name="timeToLive">How long a derived key is held after it is derived.</param>
+        /// <param name="maxKeyLength">The longest derived key to hold, in bytes. Longer keys are derived every time.</param>
+        /// <exception cref="ArgumentOutOfRangeException">Thrown if <paramref name="maxEntries"/> is not 0 and <paramref name="timeToLive"/> is
+        /// shorter than a millisecond or <paramref name="maxKeyLength"/> is 0.</exception>
+        /// <remarks>
+        /// The cache is shared by every <see cref="Scrypt"/> in the process. Keys are found by a keyed hash of the password, salt, parameters and
+        /// derived key length, never by the inputs themselves, and are held in memory that is locked against paging where the system allows and
+        /// erased when they leave the cache. Configuring the cache again erases every key it holds.
+        /// </remarks>
+        public static void ConfigureDerivedKeyCache(uint maxEntries, TimeSpan timeToLive, uint maxKeyLength = 64)
+        {
+            if (maxEntries > 0 && (timeToLive.TotalMilliseconds < 1 || timeToLive.TotalMilliseconds > uint.MaxValue))
+                throw new ArgumentOutOfRangeException(nameof(timeToLive), "Must be between 1 ms and uint.MaxValue ms.");
+            if (maxEntries > 0 && maxKeyLength == 0)
+                throw new ArgumentOutOfRangeException(nameof(maxKeyLength), "Must be > 0.");
+
+            ScryptCore.ConfigureDerivationCache(maxEntries, maxKeyLength, maxEntries > 0 ? (uint)timeToLive.TotalMilliseconds : 0);
+        }
+
         #endregion
 
         #region Public Methods
@@ -311,6 +328,7 @@ namespace Skryptonite
         /// <exception cref="ArgumentNullException">Thrown if either <paramref name="key"/> or <paramref name="salt"/> are null.</exception>
         /// <exception cref="ArgumentOutOfRangeException">Thrown if <paramref name="derivedKeyLength"/> is 0.</exception>
         /// <exception cref="OutOfMemoryException">Thrown if enough memory cannot be allocated to perform Scrypt with the given parameters at this time.</exception>
+        /// <remarks>Answered from the cache set up by <see cref="ConfigureDerivedKeyCache"/> when it holds the derivation.</remarks>
         public IBuffer DeriveKey(IBuffer key, IBuffer salt, uint derivedKeyLength)
         {
             if (key == null)
@@ -322,33 +340,141 @@ namespace Skryptonite
             
             Contract.Ensures(Contract.Result<IBuffer>() != null);
 
-            IBuffer bufferData = OneRoundPbkdf2Sha256(key, salt, WorkingBufferLength);
+            IBuffer derivedKey = ScryptCore.TryGetCachedKey(key, salt, ElementLengthMultiplier, ProcessingCost, Parallelization, derivedKeyLength);
+            if (derivedKey != null)
+                return derivedKey;
+
+            derivedKey = DeriveUncachedKey(key, salt, derivedKeyLength);
+            ScryptCore.CacheDerivedKey(key, salt, ElementLengthMultiplier, ProcessingCost, Parallelization, derivedKey);
+
+            return derivedKey;
+        }
+
+        /// <summary>
+        /// Derives a stronger key from a weaker key using Scrypt without blocking the calling thread.
+        /// </summary>
+        /// <param name="key">The input key (e.g. user password).</param>
+        /// <param name="salt">The salt. Used to thwart precomputation attacks.</param>
+        /// <param name="derivedKeyLength">The desired length of the derived key in bytes. Must be greater than 0.</param>
+        /// <param name="cancellationToken">Withdraws the derivation if it has not started yet.</param>
+        /// <returns>A task that completes with a derived key of the desired length.</returns>
+        /// <remarks>
+        /// The derivation waits in a bounded native queue and runs on a native dispatcher thread, which takes every derivation
+        /// queued since it last woke and runs those with the same parameters together, as <see cref="DeriveKeys"/> does. Queued
+        /// derivations always use the native scheduling, so <see cref="MaxThreads"/>, <see cref="CachePolicy"/> and
+        /// <see cref="TradeOffFactor"/> do not apply.
+        /// </remarks>
+        /// <exception cref="ArgumentNullException">Thrown if either <paramref name="key"/> or <paramref name="salt"/> are null.</exception>
+        /// <exception cref="ArgumentOutOfRangeException">Thrown if <paramref name="derivedKeyLength"/> is 0.</exception>
+        /// <exception cref="InvalidOperationException">Thrown if the queue is full.</exception>
+        public Task<IBuffer> DeriveKeyAsync(IBuffer key, IBuffer salt, uint derivedKeyLength, CancellationToken cancellationToken = default(CancellationToken))
+        {
+            if (key == null)
+                throw new ArgumentNullException(nameof(key));
+            if (salt == null)
+                throw new ArgumentNullException(nameof(salt));
+            if (derivedKeyLength == 0)
+                throw new ArgumentOutOfRangeException(nameof(derivedKeyLength), "Must be > 0.");
+
+            Contract.Ensures(Contract.Result<Task<IBuffer>>() != null);
+
+            try
+            {
+                return ScryptCore.DeriveKeyAsync(key, salt, ElementLengthMultiplier, ProcessingCost, Parallelization, derivedKeyLength)
+                    .AsTask(cancellationToken);
+            }
+            catch (COMException e)
+            {
+                throw new InvalidOperationException("Too many derivations are waiting to run.", e);
+            }
+        }
+
+        /// <summary>
+        /// Derives stronger keys from several weaker keys at once using Scrypt with the same parameters.
+        /// </summary>
+        /// <param name="keys">The input keys (e.g. user passwords).</param>
+        /// <param name="salts">The salt for each key, in the same order as <paramref name="keys"/>.</param>
+        /// <param name="derivedKeyLength">The desired length of each derived key in bytes. Must be greater than 0.</param>
+        /// <returns>The derived key for each input key, in the same order as <paramref name="keys"/>.</returns>
+        /// <remarks>
+        /// Every derivation is split into its <see cref="Parallelization"/> elements, and the elements of all derivations are mixed
+        /// across every processor by the native thread pool, several at a time when the instruction set allows, in a single call
+        /// into native code. Unlike <see cref="DeriveKey"/>, a batch keeps the whole machine busy even when
+        /// <see cref="Parallelization"/> is 1, so <see cref="MaxThreads"/> does not apply.
+        /// </remarks>
+        /// <exception cref="ArgumentNullException">Thrown if <paramref name="keys"/>, <paramref name="salts"/>, or any of their entries are null.</exception>
+        /// <exception cref="ArgumentException">Thrown if <paramref name="keys"/> and <paramref name="salts"/> differ in length.</exception>
+        /// <exception cref="ArgumentOutOfRangeException">Thrown if <paramref name="derivedKeyLength"/> is 0.</exception>
+        /// <exception cref="OutOfMemoryException">Thrown if enough memory cannot be allocated to perform Scrypt with the given parameters at this time.</exception>
+        public IList<IBuffer> DeriveKeys(IList<IBuffer> keys, IList<IBuffer> salts, uint derivedKeyLength)
+        {
+            if (keys == null)
+                throw new ArgumentNullException(nameof(keys));
+            if (salts == null)
+                throw new ArgumentNullException(nameof(salts));
+            if (keys.Count != salts.Count)
+                throw new ArgumentException("Must contain one salt per key.", nameof(salts));
+            if (keys.Contains(null))
+                throw new ArgumentNullException(nameof(keys));
+            if (salts.Contains(null))
+                throw new ArgumentNullException(nameof(salts));
+            if (derivedKeyLength == 0)
+                throw new ArgumentOutOfRangeException(nameof(derivedKeyLength), "Must be > 0.");
 
-            var scryptCore = new ScryptCore(bufferData, Parallelization, ProcessingCost);
+            Contract.Ensures(Contract.Result<IList<IBuffer>>() != null);
 
-            var options = new ParallelOptions() { MaxDegreeOfParallelism = maxThreads };
+            if (keys.Count == 0)
+                return new IBuffer[0];
 
+            // the native thread pool schedules the elements of every derivation, so the whole batch is one transition
             try
             {
-                Parallel.For(0, Parallelization, options, (long i) => scryptCore.SMix((uint)i));
+                return ScryptCore.DeriveKeys(keys.ToArray(), salts.ToArray(), ElementLengthMultiplier, ProcessingCost, Parallelization,
+                    derivedKeyLength, CachePolicy, TradeOffFactor);
+            }
+            catch (OutOfMemoryException)
+            {
+                throw new OutOfMemoryException("Unable to allocate enough memory to perform Scrypt for these parameters at this time.");
             }
-            catch (AggregateException ex)
+        }
+
+        #endregion
+
+        #region Private Methods
+
+        /// <summary>
+        /// Derives a key with Scrypt without consulting the cache set up by <see cref="ConfigureDerivedKeyCache"/>.
+        /// </summary>
+        IBuffer DeriveUncachedKey(IBuffer key, IBuffer salt, uint derivedKeyLength)
+        {
+            // with a single thread there is nothing to schedule, so the whole derivation stays in native code
+            if (maxThreads == 1 && CachePolicy == CachePolicy.Automatic && TradeOffFactor == 1)
             {
-                bool outOfMemory = false;
-                foreach (var innerEx in ex.InnerExceptions)
-                    if (innerEx is OutOfMemoryException)
-                    {
-                        outOfMemory = true;
-                        break;
-                    }
-
-                if (outOfMemory)
+                try
+                {
+                    return ScryptCore.DeriveKey(key, salt, ElementLengthMultiplier, ProcessingCost, Parallelization, derivedKeyLength);
+                }
+                catch (OutOfMemoryException)
                 {
-                    scryptCore.EraseBuffer();
                     throw new OutOfMemoryException("Unable to allocate enough memory to perform Scrypt for these parameters at this time.");
                 }
             }
 
+            IBuffer bufferData = OneRoundPbkdf2Sha256(key, salt, WorkingBufferLength);
+
+            var scryptCore = new ScryptCore(bufferData, Parallelization, ProcessingCost) { CachePolicy = CachePolicy, TradeOffFactor = TradeOffFactor };
+
+            // the native thread pool schedules every element, so there is one transition for the whole of SMix
+            try
+            {
+                scryptCore.SMixAll((uint)maxThreads);
+            }
+            catch (OutOfMemoryException)
+            {
+                scryptCore.EraseBuffer();
+                throw new OutOfMemoryException("Unable to allocate enough memory to perform Scrypt for these parameters at this time.");
+            }
+
             IBuffer derivedKey = OneRoundPbkdf2Sha256(key, bufferData, derivedKeyLength);
 
             scryptCore.EraseBuffer();
@@ -356,10 +482,6 @@ namespace Skryptonite
             return derivedKey;
         }
 
-        #endregion
-
-        #region Private Methods
-
         /// <summary>
         /// Performs a single iteration of PBKDF2-SHA-256.
         /// </summary>
@@ -374,11 +496,7 @@ namespace Skryptonite
             Contract.Ensures(Contract.Result<IBuffer>() != null);
             Contract.Ensures(Contract.Result<IBuffer>().Length == derivedKeyLength);
 
-            CryptographicKey key = pbkdf2Sha256.CreateKey(keyMaterial);
-            var parameters = KeyDerivationParameters.BuildForPbkdf2(salt, 1);
-            IBuffer derivedKey = CryptographicEngine.DeriveKeyMaterial(key, parameters, derivedKeyLength);
-
-            return derivedKey;
+            return ScryptCore.OneRoundPbkdf2Sha256(keyMaterial, salt, derivedKeyLength);
         }
         
         #endregion